@@ -51,6 +51,12 @@ void HardFault_Handler(void);
 void SVC_Handler(void);
 void PendSV_Handler(void);
 void SysTick_Handler(void);
+void DMA1_Channel1_IRQHandler(void);
+void DMA1_Channel2_3_IRQHandler(void);
+void TIM6_DAC_LPTIM1_IRQHandler(void);
+void TIM7_LPTIM2_IRQHandler(void);
+void I2C1_IRQHandler(void);
+void USART2_LPUART2_IRQHandler(void);
 /* USER CODE BEGIN EFP */
 
 /* USER CODE END EFP */
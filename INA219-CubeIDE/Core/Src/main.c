@@ -21,20 +21,41 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
-#include <stdio.h>
-#include <stdarg.h>
-
 #include "ina219.h"
+#include "embedd_bus_sched.h"
+#include "embedd_sampler.h"
+#include "embedd_ring.h"
+#include "embedd_filter.h"
+#include "embedd_telemetry.h"
+#include "embedd_log.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
 /* USER CODE BEGIN PTD */
-
+// An I2C controller: its HAL handle, the completion of the DMA transfer currently running on it
+// and the read part of a combined transfer, started with a repeated START when the write part completes
+typedef struct
+{
+  I2C_HandleTypeDef *hi2c;
+  embedd_bus_done_t done;
+  void *done_ctx;
+  uint16_t rd_addr;
+  uint8_t *rd_ptr;
+  uint32_t rd_size;
+} i2c_port_t;
 /* USER CODE END PTD */
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
 #define INA219_I2C_DEV_ADDR 0x40
+#define INA219_SHUNT_UOHM   100000 // 0.1 Ohm shunt of the common INA219 breakout boards
+#define INA219_SAMPLE_US    25000  // sampling period, 100 us up to minutes
+#define TELEMETRY_RECORDS   16     // sample records per telemetry frame
+#define TELEMETRY_AGE_US    100000 // longest time a record waits for its frame
+
+// never waits for the port, a full queue drops the line and counts it; text, or tokens
+// for tools/tlog_decode.py when built with EMBEDD_LOG_TOKENIZED=1
+#define debug(level, ...)   EMBEDD_LOG(&usart2_log, level, __VA_ARGS__)
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -44,28 +65,126 @@ INA219_I2C_DEVICE_DEFINE(current_sensor, "INA219")
 
 /* Private variables ---------------------------------------------------------*/
 I2C_HandleTypeDef hi2c1;
+DMA_HandleTypeDef hdma_i2c1_rx;
+DMA_HandleTypeDef hdma_i2c1_tx;
+
+TIM_HandleTypeDef htim6;
+TIM_HandleTypeDef htim7;
 
 UART_HandleTypeDef huart2;
+DMA_HandleTypeDef hdma_usart2_tx;
 
 /* USER CODE BEGIN PV */
-uint8_t debug_buf[100];
+
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_I2C1_Init(void);
 static void MX_USART2_UART_Init(void);
+static void MX_TIM6_Init(void);
+static void MX_TIM7_Init(void);
 /* USER CODE BEGIN PFP */
 static EMBEDD_RESULT ina219_bus_write(const struct embedd_device_t* dev, const uint8_t* data_ptr, uint32_t data_size);
 static EMBEDD_RESULT ina219_bus_read(const struct embedd_device_t* dev, uint8_t* data_ptr, uint32_t data_size);
-
-static void debug(const char *format, ...) __attribute__ ((format (printf, 1, 2)));
+static EMBEDD_RESULT ina219_bus_write_read(const struct embedd_device_t* dev, const uint8_t* wr_ptr, uint32_t wr_size, uint8_t* rd_ptr, uint32_t rd_size);
+static EMBEDD_RESULT ina219_bus_write_async(const struct embedd_device_t* dev, const uint8_t* data_ptr, uint32_t data_size, embedd_bus_done_t done, void* ctx);
+static EMBEDD_RESULT ina219_bus_read_async(const struct embedd_device_t* dev, uint8_t* data_ptr, uint32_t data_size, embedd_bus_done_t done, void* ctx);
+static EMBEDD_RESULT ina219_bus_write_read_async(const struct embedd_device_t* dev, const uint8_t* wr_ptr, uint32_t wr_size, uint8_t* rd_ptr, uint32_t rd_size, embedd_bus_done_t done, void* ctx);
+static EMBEDD_RESULT ina219_bus_abort(const struct embedd_device_t* dev);
+static uint32_t tim_clock_mhz(void);
+static EMBEDD_RESULT tim6_set_period(void* ctx, uint32_t period_us);
+static EMBEDD_RESULT tim7_arm(void* ctx, uint32_t delay_us);
+static void current_sensor_start(void* ctx);
+static void current_sensor_sampled(const ina219_sample_t* sample, void* user);
+static EMBEDD_RESULT usart2_send(void* ctx, const uint8_t* data, uint32_t size);
+static bool usart2_busy(void* ctx);
+static uint32_t usart2_baud(void* ctx, uint32_t baud, bool apply);
+static uint32_t usart2_crc(void* ctx, const uint8_t* data, uint32_t size);
+static uint32_t usart2_log_send(void* ctx, const uint8_t* data, uint32_t size);
+
+static void debug_flush(uint32_t timeout_ms);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
-static embedd_bus_t ina219_bus = { .write = ina219_bus_write, .read = ina219_bus_read };
+static embedd_bus_t ina219_bus = {
+    .write       = ina219_bus_write,
+    .read        = ina219_bus_read,
+    .write_read  = ina219_bus_write_read,
+    .write_async = ina219_bus_write_async,
+    .read_async  = ina219_bus_read_async,
+    .write_read_async = ina219_bus_write_read_async,
+    .abort       = ina219_bus_abort
+};
+
+// The controllers the bus functions serve, a device selects one with the port of its I2C configuration
+static i2c_port_t i2c1_port = { .hi2c = &hi2c1 };
+static i2c_port_t *const i2c_ports[] = { &i2c1_port };
+
+// Transactions of all devices on I2C1 are ordered by this scheduler
+static embedd_bus_sched_t i2c1_sched;
+static embedd_bus_sched_client_t current_sensor_bus;
+
+// Conversion constants of the sensor when auto-ranging is not available
+static ina219_scale_t current_sensor_scale;
+
+// PGA and bus range follow the load, each PGA setting has its own calibration
+static const ina219_autorange_cfg_t current_sensor_range_cfg = {
+  .up_pct = 90, .down_pct = 70,
+  .pg_min = INA219_CONFIGURATION_PG_GAIN_EQ_1_RANGE_EQ_40_MV,
+  .pg_max = INA219_CONFIGURATION_PG_GAIN_EQ_8_RANGE_EQ_320_MV,
+  .brng_auto = true, .brng = INA219_CONFIGURATION_BRNG_EQ_32V_FSR,
+  .bus_up_mv = 15000, .bus_down_mv = 14000,
+  .dwell_us = 1000000, .settle_us = 2000,
+};
+static ina219_autorange_t current_sensor_range;
+
+// Conversions are started by TIM6 and read when TIM7 expires, one conversion time later
+INA219_ASYNC_DEFINE(current_sensor_async, current_sensor, 4)
+static ina219_trigger_t current_sensor_trigger;
+
+// TIM6 paces the sampling, the samples are queued for the main loop
+static embedd_sampler_t current_sensor_sampler;
+EMBEDD_RING_DEFINE(current_sensor_samples, ina219_sample_t, 16)
+
+// Charge and energy drawn since start, integrated over every sample
+static ina219_energy_t current_sensor_energy;
+
+// Statistics over one-second windows, the latest summary is reported
+static ina219_stats_t current_sensor_stats;
+
+// Software filters between acquisition and the report, one chain per channel:
+// spikes are rejected before smoothing the current, the bus voltage is averaged
+EMBEDD_FILTER_MEDIAN_DEFINE(current_sensor_spikes, 3)
+static embedd_filter_stage_t current_sensor_smooth;
+static embedd_filter_chain_t current_sensor_current_filter;
+EMBEDD_FILTER_MA_DEFINE(current_sensor_bus_average, 4)
+static embedd_filter_chain_t current_sensor_bus_filter;
+
+// USART2 talks text until the host asks for the binary telemetry stream
+static embedd_telemetry_port_t usart2_port = {
+    .send = usart2_send,
+    .busy = usart2_busy,
+    .baud = usart2_baud,
+    .crc  = usart2_crc,
+    .ctx  = &huart2
+};
+EMBEDD_TELEMETRY_DEFINE(telemetry, EMBEDD_TELEMETRY_HEADER_SIZE + TELEMETRY_RECORDS * sizeof(ina219_telemetry_sample_t) + EMBEDD_TELEMETRY_CRC_SIZE, 32)
+EMBEDD_RING_DEFINE(usart2_rx, uint8_t, 64)
+static uint8_t usart2_rx_byte;
+
+// text lines queue up and leave by DMA; errors go first, debug lines are dropped first.
+// A chunk takes 5.6 ms at 115200 baud, the longest a waiting telemetry frame is held up
+static const embedd_log_port_t usart2_log_port = {
+    .send      = usart2_log_send,
+    .busy      = usart2_busy,
+    .max_chunk = 64,
+    .ctx       = &huart2
+};
+EMBEDD_LOG_DEFINE(usart2_log, 256, 1024, 512)
 /* USER CODE END 0 */
 
 /**
@@ -97,53 +216,234 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_I2C1_Init();
   MX_USART2_UART_Init();
+  MX_TIM6_Init();
+  MX_TIM7_Init();
   /* USER CODE BEGIN 2 */
+  embedd_log_init( &usart2_log, &usart2_log_port );
+
   // device's bus initialization
-  current_sensor.bus = &ina219_bus;
+  embedd_bus_sched_init( &i2c1_sched, &ina219_bus );
+  embedd_bus_sched_client_init( &current_sensor_bus, &i2c1_sched, 0, 0 );
+  current_sensor.bus = &current_sensor_bus.bus;
 
-  embedd_i2c_dev_cfg_t current_sensor_cfg = {.addr = INA219_I2C_DEV_ADDR};
+  embedd_i2c_dev_cfg_t current_sensor_cfg = {.addr = INA219_I2C_DEV_ADDR, .port = &i2c1_port};
   embedd_i2c_set_dev_config( &current_sensor, &current_sensor_cfg );
+
+  // the device invariants are checked once here, see INA219_STATIC_DISPATCH
+  if( ina219_check_device( &current_sensor ) != EMBEDD_RESULT_OK )
+  {
+	  debug(EMBEDD_LOG_ERROR, "INA219 device is not set up!\r\n");
+	  debug_flush(100);
+	  Error_Handler();
+  }
+
+  // configuration and calibration are changed through their shadow copies from here on
+  if( ina219_shadow_resync( &current_sensor ) != EMBEDD_RESULT_OK )
+  {
+	  debug(EMBEDD_LOG_ERROR, "INA219 shadow registers resync failed!\r\n");
+  }
+
+  // averaging over 16 samples: 17 ms per shunt and bus conversion, read well within the 25 ms period of TIM6
+  ina219_shadow_set_sadc( &current_sensor, INA219_CONFIGURATION_SADC_16_SAMPLES );
+  ina219_shadow_set_badc( &current_sensor, INA219_CONFIGURATION_BADC_16_SAMPLES );
+  if( ina219_shadow_commit( &current_sensor ) != EMBEDD_RESULT_OK )
+  {
+	  debug(EMBEDD_LOG_ERROR, "INA219 configuration failed!\r\n");
+  }
+
+  // the device computes current and power from here on, starting in the widest range
+  if( ina219_autorange_init( &current_sensor_range, &current_sensor, &current_sensor_range_cfg, INA219_SHUNT_UOHM ) != EMBEDD_RESULT_OK )
+  {
+	  // uncalibrated: current from the shunt voltage, the power-on defaults PGA /8, 32 V range
+	  debug(EMBEDD_LOG_ERROR, "INA219 auto-ranging failed!\r\n");
+	  ina219_scale_init( &current_sensor_scale, 0, INA219_SHUNT_UOHM,
+	                     INA219_CONFIGURATION_PG_GAIN_EQ_8_RANGE_EQ_320_MV, INA219_CONFIGURATION_BRNG_EQ_32V_FSR );
+  }
+
+  // Register values, measurements taken from a single conversion
+  ina219_snapshot_t snapshot = {0};
+
+  // Read all registers
+  if (INA219_READ_SNAPSHOT( current_sensor, snapshot ) == EMBEDD_RESULT_OK)
+  {
+    /* USER CODE BEGIN IN CASE OF SUCCESS */
+	  // the snapshot holds the registers back to back in register map order
+	  const uint8_t *raw = (const uint8_t*)&snapshot;
+	  debug(EMBEDD_LOG_INFO, "Register map:\r\n");
+	  for (size_t i = 0; i < INA219_REGMAP_COUNT; i++)
+	  {
+		  debug(EMBEDD_LOG_INFO, "  %-17s - 0x%04X\r\n", ina219_regmap[i].name, ina219_reg_word(raw));
+		  raw += ina219_regmap[i].size;
+	  }
+    /* USER CODE END IN CASE OF SUCCESS */
+  }
+  else
+  {
+    /* USER CODE BEGIN IN CASE OF ERROR */
+	  debug(EMBEDD_LOG_ERROR, "Registers reading error!\r\n");
+    /* USER CODE END IN CASE OF ERROR */
+  }
+
+  // samples lost on the way are bridged, from 100 sampling periods on the time is counted as lost
+  ina219_energy_init( &current_sensor_energy, INA219_SAMPLE_US, 0 );
+  ina219_stats_init( &current_sensor_stats, ( 1000000 + INA219_SAMPLE_US - 1 ) / INA219_SAMPLE_US );
+
+  embedd_filter_chain_init( &current_sensor_current_filter );
+  embedd_filter_median_init( &current_sensor_spikes, current_sensor_spikes_values, current_sensor_spikes_sorted, 3 );
+  embedd_filter_iir_init( &current_sensor_smooth, 2 );
+  embedd_filter_chain_append( &current_sensor_current_filter, &current_sensor_spikes );
+  embedd_filter_chain_append( &current_sensor_current_filter, &current_sensor_smooth );
+  embedd_filter_chain_init( &current_sensor_bus_filter );
+  embedd_filter_ma_init( &current_sensor_bus_average, current_sensor_bus_average_values, 4 );
+  embedd_filter_chain_append( &current_sensor_bus_filter, &current_sensor_bus_average );
+
+  // the CRC unit computes the CRC-32 of the telemetry frames
+  __HAL_RCC_CRC_CLK_ENABLE();
+  usart2_port.max_baud = HAL_RCC_GetPCLK1Freq() / 8U;
+  embedd_telemetry_cfg_t telemetry_cfg = {
+      .record_type = INA219_TELEMETRY_SAMPLE, .record_size = sizeof(ina219_telemetry_sample_t),
+      .baud = 115200, .max_age_us = TELEMETRY_AGE_US, .period_us = INA219_SAMPLE_US,
+  };
+  if( embedd_telemetry_init( &telemetry, &usart2_port, &telemetry_cfg ) != EMBEDD_RESULT_OK ||
+      HAL_UART_Receive_IT( &huart2, &usart2_rx_byte, 1 ) != HAL_OK )
+  {
+	  debug(EMBEDD_LOG_ERROR, "Telemetry start failed!\r\n");
+  }
+
+  // switches to triggered conversions, each one started by a TIM6 period
+  if( ina219_trigger_init( &current_sensor_trigger, &current_sensor_async, tim7_arm, &htim7, current_sensor_sampled, NULL ) != EMBEDD_RESULT_OK )
+  {
+	  debug(EMBEDD_LOG_ERROR, "INA219 triggered acquisition failed!\r\n");
+  }
+  else if( embedd_sampler_init( &current_sensor_sampler, tim6_set_period, &htim6, UINT32_MAX / tim_clock_mhz(),
+                                current_sensor_start, &current_sensor_trigger, NULL, 0 ) != EMBEDD_RESULT_OK ||
+           embedd_sampler_set_period( &current_sensor_sampler, INA219_SAMPLE_US ) != EMBEDD_RESULT_OK )
+  {
+	  debug(EMBEDD_LOG_ERROR, "Sampling start failed!\r\n");
+  }
   /* USER CODE END 2 */
 
   /* Infinite loop */
   /* USER CODE BEGIN WHILE */
+  uint32_t report_tick = HAL_GetTick();
+  ina219_measurement_t meas = {0};
+  uint8_t meas_range = 0;
+  ina219_stats_record_t window = {0};
+  int32_t filtered_current_ua = 0;
+  int32_t filtered_bus_mv = 0;
   while (1)
   {
-	  // Variables to store register values
-	  uint16_t config_reg        = 0;
-	  uint16_t shunt_voltage_reg = 0;
-	  uint16_t bus_voltage_reg   = 0;
-	  uint16_t power_reg         = 0;
-	  uint16_t current_reg       = 0;
-	  uint16_t calibration_reg   = 0;
-
-	  // Read all registers
-	  if (INA219_READ_REG( current_sensor, ina219_configuration, config_reg )        == EMBEDD_RESULT_OK &&
-	      INA219_READ_REG( current_sensor, ina219_shunt_voltage, shunt_voltage_reg ) == EMBEDD_RESULT_OK &&
-	  	  INA219_READ_REG( current_sensor, ina219_bus_voltage,   bus_voltage_reg )   == EMBEDD_RESULT_OK &&
-	   	  INA219_READ_REG( current_sensor, ina219_power,         power_reg )         == EMBEDD_RESULT_OK &&
-	   	  INA219_READ_REG( current_sensor, ina219_current,       current_reg )       == EMBEDD_RESULT_OK &&
-	   	  INA219_READ_REG( current_sensor, ina219_calibration,   calibration_reg )   == EMBEDD_RESULT_OK)
+	  // drain the samples of the timer interrupts; errors are counted in the statistics
+	  ina219_sample_t sample;
+	  while (embedd_ring_pop(&current_sensor_samples, &sample))
+	  {
+		  ina219_autorange_tag(&current_sensor_range, &sample);
+		  const ina219_scale_t *scale = ina219_autorange_scale(&current_sensor_range, sample.range);
+		  ina219_convert_sample(scale != NULL ? scale : &current_sensor_scale, &sample, &meas);
+		  meas_range = sample.range;
+		  ina219_energy_add(&current_sensor_energy, &meas, sample.timestamp_us);
+		  ina219_stats_add(&current_sensor_stats, &meas, sample.timestamp_us, &window);
+		  if (!(meas.flags & INA219_MEAS_FLAG_OVF))
+		  {
+			  embedd_filter_chain_process(&current_sensor_current_filter, meas.current_ua, &filtered_current_ua);
+		  }
+		  embedd_filter_chain_process(&current_sensor_bus_filter, (int32_t)meas.bus_mv, &filtered_bus_mv);
+
+		  ina219_telemetry_sample_t record;
+		  ina219_telemetry_sample(&meas, sample.timestamp_us, sample.range, &record);
+		  embedd_telemetry_add(&telemetry, &record, sample.timestamp_us);
+		  // a range switch accesses the device directly, no conversion may be in flight;
+		  // between two samples there always is time for it
+		  if (scale != NULL && ina219_trigger_hold(&current_sensor_trigger))
+		  {
+			  if (ina219_autorange_update(&current_sensor_range, &sample) != EMBEDD_RESULT_OK)
+			  {
+				  debug(EMBEDD_LOG_ERROR, "INA219 range switch failed!\r\n");
+			  }
+			  ina219_trigger_release(&current_sensor_trigger);
+		  }
+	  }
+	  ina219_async_process(&current_sensor_async);
+
+	  // commands of the host, answers and frames waiting for the port
+	  uint8_t rx_byte;
+	  while (embedd_ring_pop(&usart2_rx, &rx_byte))
 	  {
-	    /* USER CODE BEGIN IN CASE OF SUCCESS */
-		  debug("Register map:\r\n");
-		  debug("  CONFIGURATION     - 0x%04X\r\n", config_reg);
-		  debug("  SHUNT_VOLTAGE     - 0x%04X\r\n", shunt_voltage_reg);
-		  debug("  BUS_VOLTAGE       - 0x%04X\r\n", bus_voltage_reg);
-		  debug("  POWER             - 0x%04X\r\n", power_reg);
-		  debug("  CURRENT           - 0x%04X\r\n", current_reg);
-		  debug("  CALIBRATION       - 0x%04X\r\n", calibration_reg);
-	    /* USER CODE END IN CASE OF SUCCESS */
+		  embedd_telemetry_receive(&telemetry, &rx_byte, 1);
 	  }
-	  else
+	  embedd_telemetry_process(&telemetry, embedd_hal_get_us());
+	  // text only gets the port the telemetry leaves free
+	  embedd_log_process(&usart2_log);
+
+	  if (HAL_GetTick() - report_tick >= 5000) // Report every 5 seconds
 	  {
-	    /* USER CODE BEGIN IN CASE OF ERROR */
-		  debug("Registers reading error!\r\n");
-	    /* USER CODE END IN CASE OF ERROR */
+		  report_tick += 5000;
+		  debug(EMBEDD_LOG_INFO, "Shunt %ld uV, bus %lu mV, current %ld uA, power %lu uW, range %u, flags 0x%02X\r\n",
+		        (long)meas.shunt_uv, (unsigned long)meas.bus_mv, (long)meas.current_ua,
+		        (unsigned long)meas.power_uw, meas_range, meas.flags);
+		  debug(EMBEDD_LOG_INFO, "Filtered current %ld uA, bus %ld mV\r\n", (long)filtered_current_ua, (long)filtered_bus_mv);
+
+		  ina219_energy_reading_t energy;
+		  ina219_energy_read( &current_sensor_energy, NULL, &energy );
+		  debug(EMBEDD_LOG_INFO, "Charge %ld uAh, energy %lu uWh, average %ld uA %lu uW over %lu s, %lu missed, %lu s lost\r\n",
+		        (long)energy.charge_uah, (unsigned long)energy.energy_uwh,
+		        (long)energy.avg_current_ua, (unsigned long)energy.avg_power_uw,
+		        (unsigned long)( energy.time_us / 1000000U ), (unsigned long)energy.missed,
+		        (unsigned long)( energy.lost_us / 1000000U ));
+
+		  debug(EMBEDD_LOG_INFO, "Window %lu ms: current %ld..%ld uA mean %ld rms %lu, bus %ld..%ld mV mean %ld, power %ld..%ld uW mean %ld\r\n",
+		        (unsigned long)( ( window.end_us - window.start_us ) / 1000U ),
+		        (long)window.current_ua.min, (long)window.current_ua.max, (long)window.current_ua.mean,
+		        (unsigned long)window.current_ua.rms,
+		        (long)window.bus_mv.min, (long)window.bus_mv.max, (long)window.bus_mv.mean,
+		        (long)window.power_uw.min, (long)window.power_uw.max, (long)window.power_uw.mean);
+
+		  embedd_sampler_stats_t sampler_stats;
+		  embedd_sampler_get_stats( &current_sensor_sampler, &sampler_stats, true );
+		  debug(EMBEDD_LOG_DEBUG, "Sampling %lu.%03lu Hz of %lu.%03lu Hz (drift %ld ppm), interval %lu..%lu us, jitter %lu/%lu us, %lu samples\r\n",
+		        (unsigned long)( sampler_stats.achieved_mhz / 1000 ), (unsigned long)( sampler_stats.achieved_mhz % 1000 ),
+		        (unsigned long)( sampler_stats.requested_mhz / 1000 ), (unsigned long)( sampler_stats.requested_mhz % 1000 ),
+		        (long)sampler_stats.drift_ppm,
+		        (unsigned long)sampler_stats.interval_min_us, (unsigned long)sampler_stats.interval_max_us,
+		        (unsigned long)sampler_stats.jitter_avg_us, (unsigned long)sampler_stats.jitter_max_us,
+		        (unsigned long)sampler_stats.results);
+
+		  embedd_ring_stats_t ring_stats;
+		  embedd_ring_get_stats( &current_sensor_samples, &ring_stats, true );
+		  debug(EMBEDD_LOG_DEBUG, "Sample queue %lu/%lu high water, %lu overflows\r\n",
+		        (unsigned long)ring_stats.high_water, (unsigned long)ring_stats.capacity,
+		        (unsigned long)ring_stats.overflows);
+
+		  ina219_trigger_stats_t trigger_stats;
+		  ina219_trigger_get_stats( &current_sensor_trigger, &trigger_stats, true );
+		  debug(EMBEDD_LOG_DEBUG, "INA219 %lu triggered, %lu completed, %lu late, %lu overruns, %lu errors\r\n",
+		        (unsigned long)trigger_stats.triggered, (unsigned long)trigger_stats.completed,
+		        (unsigned long)trigger_stats.late, (unsigned long)trigger_stats.overruns,
+		        (unsigned long)trigger_stats.errors);
+
+		  embedd_bus_sched_stats_t bus_stats;
+		  embedd_bus_sched_get_stats( &i2c1_sched, &bus_stats, true );
+		  debug(EMBEDD_LOG_DEBUG, "I2C1 utilization %lu.%02lu%%, %lu transactions, %lu errors\r\n",
+		        (unsigned long)( bus_stats.utilization / 100 ), (unsigned long)( bus_stats.utilization % 100 ),
+		        (unsigned long)bus_stats.completed, (unsigned long)bus_stats.errors);
+
+		  uint32_t log_dropped[EMBEDD_LOG_LEVELS];
+		  for (uint32_t level = 0; level < EMBEDD_LOG_LEVELS; level++)
+		  {
+			  embedd_log_stats_t log_stats;
+			  embedd_log_get_stats( &usart2_log, (embedd_log_level_t)level, &log_stats, true );
+			  log_dropped[level] = log_stats.dropped;
+		  }
+		  debug(EMBEDD_LOG_DEBUG, "Log dropped %lu error, %lu info, %lu debug lines\r\n",
+		        (unsigned long)log_dropped[EMBEDD_LOG_ERROR], (unsigned long)log_dropped[EMBEDD_LOG_INFO],
+		        (unsigned long)log_dropped[EMBEDD_LOG_DEBUG]);
 	  }
-	  HAL_Delay(5000); // Wait 5 seconds before reading again
+
+	  // everything else happens in interrupts
+	  __WFI();
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
@@ -239,6 +539,85 @@ static void MX_I2C1_Init(void)
 
 }
 
+/**
+  * @brief TIM6 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM6_Init(void)
+{
+
+  /* USER CODE BEGIN TIM6_Init 0 */
+
+  /* USER CODE END TIM6_Init 0 */
+
+  TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+  /* USER CODE BEGIN TIM6_Init 1 */
+
+  /* USER CODE END TIM6_Init 1 */
+  htim6.Instance = TIM6;
+  htim6.Init.Prescaler = 15;
+  htim6.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim6.Init.Period = 24999;
+  htim6.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_Base_Init(&htim6) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim6, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN TIM6_Init 2 */
+
+  /* USER CODE END TIM6_Init 2 */
+
+}
+
+/**
+  * @brief TIM7 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM7_Init(void)
+{
+
+  /* USER CODE BEGIN TIM7_Init 0 */
+
+  /* USER CODE END TIM7_Init 0 */
+
+  TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+  /* USER CODE BEGIN TIM7_Init 1 */
+
+  /* USER CODE END TIM7_Init 1 */
+  htim7.Instance = TIM7;
+  htim7.Init.Prescaler = 15;
+  htim7.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim7.Init.Period = 65535;
+  htim7.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_Base_Init(&htim7) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim7, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN TIM7_Init 2 */
+  // one-shot: the counter stops at its update event, started by tim7_arm()
+  htim7.Instance->CR1 |= TIM_CR1_OPM;
+  __HAL_TIM_CLEAR_FLAG(&htim7, TIM_FLAG_UPDATE);
+  __HAL_TIM_ENABLE_IT(&htim7, TIM_IT_UPDATE);
+  /* USER CODE END TIM7_Init 2 */
+
+}
+
 /**
   * @brief USART2 Initialization Function
   * @param None
@@ -287,6 +666,25 @@ static void MX_USART2_UART_Init(void)
 
 }
 
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* DMA interrupt init */
+  /* DMA1_Channel1_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel1_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+  /* DMA1_Channel2_3_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel2_3_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
@@ -328,13 +726,14 @@ EMBEDD_RESULT ina219_bus_write(const struct embedd_device_t* dev, const uint8_t*
 
   //Extracting I2C configurations from the device object
   embedd_i2c_dev_cfg_t* dev_cfg = embedd_i2c_get_dev_config( dev );
-  if( dev_cfg == NULL )
+  if( ( dev_cfg == NULL ) || ( dev_cfg->port == NULL ) )
   {
       return EMBEDD_RESULT_ERR;
   }
+  i2c_port_t *port = (i2c_port_t*)dev_cfg->port;
 
   //Writing data to the bus
-  HAL_StatusTypeDef status = HAL_I2C_Master_Transmit(&hi2c1, (dev_cfg->addr << 1), (uint8_t*)data_ptr, data_size, 100 );
+  HAL_StatusTypeDef status = HAL_I2C_Master_Transmit(port->hi2c, (dev_cfg->addr << 1), (uint8_t*)data_ptr, data_size, 100 );
   if( status != HAL_OK)
   {
       return EMBEDD_RESULT_ERR;
@@ -352,12 +751,14 @@ EMBEDD_RESULT ina219_bus_read(const struct embedd_device_t* dev, uint8_t* data_p
 
   //Extracting I2C configurations from the device object
   embedd_i2c_dev_cfg_t* dev_cfg = embedd_i2c_get_dev_config( dev );
-  if( dev_cfg == NULL ){
+  if( ( dev_cfg == NULL ) || ( dev_cfg->port == NULL ) )
+  {
       return EMBEDD_RESULT_ERR;
   }
+  i2c_port_t *port = (i2c_port_t*)dev_cfg->port;
 
   //Reading data from the bus
-  HAL_StatusTypeDef status = HAL_I2C_Master_Receive(&hi2c1, (dev_cfg->addr << 1), data_ptr, data_size, 100 );
+  HAL_StatusTypeDef status = HAL_I2C_Master_Receive(port->hi2c, (dev_cfg->addr << 1), data_ptr, data_size, 100 );
   if( status != HAL_OK)
   {
       return EMBEDD_RESULT_ERR;
@@ -366,20 +767,525 @@ EMBEDD_RESULT ina219_bus_read(const struct embedd_device_t* dev, uint8_t* data_p
   return EMBEDD_RESULT_OK;
 }
 
+// Waits for the interrupt driven transfer on the port to finish, a transfer still running after timeout_ms is aborted
+static HAL_StatusTypeDef i2c_port_wait(i2c_port_t *port, uint16_t dev_addr, uint32_t timeout_ms)
+{
+  uint32_t tickstart = HAL_GetTick();
+  while( HAL_I2C_GetState(port->hi2c) != HAL_I2C_STATE_READY )
+  {
+      if( ( HAL_GetTick() - tickstart ) > timeout_ms )
+      {
+          HAL_I2C_Master_Abort_IT(port->hi2c, dev_addr );
+          return HAL_TIMEOUT;
+      }
+  }
+  return ( HAL_I2C_GetError(port->hi2c) == HAL_I2C_ERROR_NONE ) ? HAL_OK : HAL_ERROR;
+}
+
+EMBEDD_RESULT ina219_bus_write_read(const struct embedd_device_t* dev, const uint8_t* wr_ptr, uint32_t wr_size, uint8_t* rd_ptr, uint32_t rd_size)
+{
+  if( ( dev == NULL ) || ( wr_ptr == NULL ) || ( rd_ptr == NULL ) )
+  {
+      return EMBEDD_RESULT_ERR;
+  }
+
+  //Extracting I2C configurations from the device object
+  embedd_i2c_dev_cfg_t* dev_cfg = embedd_i2c_get_dev_config( dev );
+  if( ( dev_cfg == NULL ) || ( dev_cfg->port == NULL ) )
+  {
+      return EMBEDD_RESULT_ERR;
+  }
+  i2c_port_t *port = (i2c_port_t*)dev_cfg->port;
+
+  //A 1 or 2 byte write is a register address: write it and read back with a repeated START
+  HAL_StatusTypeDef status;
+  if( wr_size == 1 )
+  {
+      status = HAL_I2C_Mem_Read(port->hi2c, (dev_cfg->addr << 1), wr_ptr[0], I2C_MEMADD_SIZE_8BIT, rd_ptr, rd_size, 100 );
+  }
+  else if( wr_size == 2 )
+  {
+      status = HAL_I2C_Mem_Read(port->hi2c, (dev_cfg->addr << 1), ( (uint16_t)wr_ptr[0] << 8 ) | wr_ptr[1], I2C_MEMADD_SIZE_16BIT, rd_ptr, rd_size, 100 );
+  }
+  else if( embedd_hal_in_isr() )
+  {
+      //The sequential transfer completes in the I2C interrupt, which cannot run here
+      return EMBEDD_RESULT_ERR;
+  }
+  else
+  {
+      //Longer writes: the write ends without a STOP and the read follows with a repeated START
+      status = HAL_I2C_Master_Seq_Transmit_IT(port->hi2c, (dev_cfg->addr << 1), (uint8_t*)wr_ptr, wr_size, I2C_FIRST_FRAME );
+      if( status == HAL_OK )
+      {
+          status = i2c_port_wait( port, (dev_cfg->addr << 1), 100 );
+      }
+      if( status == HAL_OK )
+      {
+          status = HAL_I2C_Master_Seq_Receive_IT(port->hi2c, (dev_cfg->addr << 1), rd_ptr, rd_size, I2C_LAST_FRAME );
+      }
+      if( status == HAL_OK )
+      {
+          status = i2c_port_wait( port, (dev_cfg->addr << 1), 100 );
+      }
+  }
+  if( status != HAL_OK)
+  {
+      return EMBEDD_RESULT_ERR;
+  }
+
+  return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT ina219_bus_write_async(const struct embedd_device_t* dev, const uint8_t* data_ptr, uint32_t data_size, embedd_bus_done_t done, void* ctx)
+{
+  if( ( dev == NULL ) || ( data_ptr == NULL ) || ( done == NULL ) )
+  {
+    return EMBEDD_RESULT_ERR;
+  }
+
+  embedd_i2c_dev_cfg_t* dev_cfg = embedd_i2c_get_dev_config( dev );
+  if( ( dev_cfg == NULL ) || ( dev_cfg->port == NULL ) )
+  {
+      return EMBEDD_RESULT_ERR;
+  }
+  i2c_port_t *port = (i2c_port_t*)dev_cfg->port;
+
+  port->done     = done;
+  port->done_ctx = ctx;
+  HAL_StatusTypeDef status = HAL_I2C_Master_Transmit_DMA(port->hi2c, (dev_cfg->addr << 1), (uint8_t*)data_ptr, data_size );
+  if( status != HAL_OK)
+  {
+      port->done = NULL;
+      return EMBEDD_RESULT_ERR;
+  }
+
+  return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT ina219_bus_read_async(const struct embedd_device_t* dev, uint8_t* data_ptr, uint32_t data_size, embedd_bus_done_t done, void* ctx)
+{
+  if( ( dev == NULL ) || ( data_ptr == NULL ) || ( done == NULL ) )
+  {
+    return EMBEDD_RESULT_ERR;
+  }
+
+  embedd_i2c_dev_cfg_t* dev_cfg = embedd_i2c_get_dev_config( dev );
+  if( ( dev_cfg == NULL ) || ( dev_cfg->port == NULL ) )
+  {
+      return EMBEDD_RESULT_ERR;
+  }
+  i2c_port_t *port = (i2c_port_t*)dev_cfg->port;
+
+  port->done     = done;
+  port->done_ctx = ctx;
+  HAL_StatusTypeDef status = HAL_I2C_Master_Receive_DMA(port->hi2c, (dev_cfg->addr << 1), data_ptr, data_size );
+  if( status != HAL_OK)
+  {
+      port->done = NULL;
+      return EMBEDD_RESULT_ERR;
+  }
+
+  return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT ina219_bus_write_read_async(const struct embedd_device_t* dev, const uint8_t* wr_ptr, uint32_t wr_size, uint8_t* rd_ptr, uint32_t rd_size, embedd_bus_done_t done, void* ctx)
+{
+  if( ( dev == NULL ) || ( wr_ptr == NULL ) || ( rd_ptr == NULL ) || ( done == NULL ) )
+  {
+    return EMBEDD_RESULT_ERR;
+  }
+
+  embedd_i2c_dev_cfg_t* dev_cfg = embedd_i2c_get_dev_config( dev );
+  if( ( dev_cfg == NULL ) || ( dev_cfg->port == NULL ) )
+  {
+      return EMBEDD_RESULT_ERR;
+  }
+  i2c_port_t *port = (i2c_port_t*)dev_cfg->port;
+
+  //The write ends without a STOP, the read is started from its completion with a repeated START
+  port->done     = done;
+  port->done_ctx = ctx;
+  port->rd_addr  = dev_cfg->addr << 1;
+  port->rd_ptr   = rd_ptr;
+  port->rd_size  = rd_size;
+  HAL_StatusTypeDef status = HAL_I2C_Master_Seq_Transmit_DMA(port->hi2c, (dev_cfg->addr << 1), (uint8_t*)wr_ptr, wr_size, I2C_FIRST_FRAME );
+  if( status != HAL_OK)
+  {
+      port->done = NULL;
+      port->rd_ptr = NULL;
+      return EMBEDD_RESULT_ERR;
+  }
+
+  return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT ina219_bus_abort(const struct embedd_device_t* dev)
+{
+  if( dev == NULL )
+  {
+    return EMBEDD_RESULT_ERR;
+  }
+
+  embedd_i2c_dev_cfg_t* dev_cfg = embedd_i2c_get_dev_config( dev );
+  if( ( dev_cfg == NULL ) || ( dev_cfg->port == NULL ) )
+  {
+      return EMBEDD_RESULT_ERR;
+  }
+  i2c_port_t *port = (i2c_port_t*)dev_cfg->port;
+
+  //The completion of the aborted transfer, and the read part of a combined one, must not run any more
+  uint32_t state = embedd_hal_critical_enter();
+  port->done   = NULL;
+  port->rd_ptr = NULL;
+  embedd_hal_critical_exit( state );
+  if( HAL_I2C_GetState(port->hi2c) == HAL_I2C_STATE_READY )
+  {
+      return EMBEDD_RESULT_OK;
+  }
+
+  //The abort sends a STOP and stops the DMA channel in the I2C interrupt
+  if( HAL_I2C_Master_Abort_IT(port->hi2c, (dev_cfg->addr << 1) ) == HAL_OK )
+  {
+      uint32_t tickstart = HAL_GetTick();
+      while( ( HAL_GetTick() - tickstart ) <= 10U )
+      {
+          if( HAL_I2C_GetState(port->hi2c) == HAL_I2C_STATE_READY )
+          {
+              return EMBEDD_RESULT_OK;
+          }
+      }
+  }
+
+  //A controller which does not stop is reset, its MSP de-initialization stops the DMA channels
+  HAL_I2C_DeInit(port->hi2c);
+  if( HAL_I2C_Init(port->hi2c) != HAL_OK )
+  {
+      return EMBEDD_RESULT_ERR;
+  }
+  return EMBEDD_RESULT_OK;
+}
+
+uint32_t tim_clock_mhz(void)
+{
+  // the timers run at twice PCLK when APB is divided
+  uint32_t clock = HAL_RCC_GetPCLK1Freq();
+  if( ( RCC->CFGR & RCC_CFGR_PPRE ) != 0U )
+  {
+      clock *= 2U;
+  }
+  return clock / 1000000U;
+}
+
+EMBEDD_RESULT tim6_set_period(void* ctx, uint32_t period_us)
+{
+  TIM_HandleTypeDef *htim = (TIM_HandleTypeDef*)ctx;
+  if( htim == NULL )
+  {
+      return EMBEDD_RESULT_ERR;
+  }
+
+  HAL_TIM_Base_Stop_IT(htim);
+  if( period_us == 0 )
+  {
+      return EMBEDD_RESULT_OK;
+  }
+
+  // 16 bit prescaler and counter: the smallest prescaler dividing the period exactly, if a close one does
+  uint64_t ticks = (uint64_t)period_us * tim_clock_mhz();
+  if( ( ticks < 2U ) || ( ticks > UINT32_MAX ) )
+  {
+      return EMBEDD_RESULT_ERR;
+  }
+  uint32_t prescaler = (uint32_t)( ( ticks + 0xFFFFU ) >> 16 );
+  for( uint32_t p = prescaler; ( p <= 0x10000U ) && ( p < prescaler + 1024U ); p++ )
+  {
+      if( ( (uint32_t)ticks % p ) == 0U )
+      {
+          prescaler = p;
+          break;
+      }
+  }
+  __HAL_TIM_SET_PRESCALER(htim, prescaler - 1U);
+  __HAL_TIM_SET_AUTORELOAD(htim, (uint32_t)ticks / prescaler - 1U);
+  __HAL_TIM_SET_COUNTER(htim, 0);
+  // load the prescaler now, not at the end of the first period
+  htim->Instance->EGR = TIM_EGR_UG;
+  __HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_UPDATE);
+
+  if( HAL_TIM_Base_Start_IT(htim) != HAL_OK )
+  {
+      return EMBEDD_RESULT_ERR;
+  }
+  return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT tim7_arm(void* ctx, uint32_t delay_us)
+{
+  TIM_HandleTypeDef *htim = (TIM_HandleTypeDef*)ctx;
+  if( ( htim == NULL ) || ( delay_us == 0 ) )
+  {
+      return EMBEDD_RESULT_ERR;
+  }
+
+  // 16 bit prescaler and counter: up to 2^32 timer clocks, 268 s at 16 MHz, covering
+  // the 136.2 ms of shunt and bus at 128 samples; the delay is rounded up, never expiring early
+  uint64_t ticks = (uint64_t)delay_us * tim_clock_mhz();
+  if( ticks > ( (uint64_t)1U << 32 ) )
+  {
+      return EMBEDD_RESULT_ERR;
+  }
+  uint32_t prescaler = (uint32_t)( ( ticks + 0xFFFFU ) >> 16 );
+  uint32_t period = (uint32_t)( ( ticks + prescaler - 1U ) / prescaler );
+
+  __HAL_TIM_DISABLE(htim);
+  __HAL_TIM_SET_PRESCALER(htim, prescaler - 1U);
+  __HAL_TIM_SET_AUTORELOAD(htim, period - 1U);
+  __HAL_TIM_SET_COUNTER(htim, 0);
+  // load the prescaler now, the update event must not reach the interrupt
+  __HAL_TIM_DISABLE_IT(htim, TIM_IT_UPDATE);
+  htim->Instance->EGR = TIM_EGR_UG;
+  __HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_UPDATE);
+  __HAL_TIM_ENABLE_IT(htim, TIM_IT_UPDATE);
+  __HAL_TIM_ENABLE(htim);
+
+  return EMBEDD_RESULT_OK;
+}
+
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+  if( htim == &htim6 )
+  {
+      embedd_sampler_tick( &current_sensor_sampler );
+  }
+  else if( htim == &htim7 )
+  {
+      ina219_trigger_timeout( &current_sensor_trigger );
+  }
+}
+
+void current_sensor_start(void* ctx)
+{
+  ina219_trigger_tick( (ina219_trigger_t*)ctx );
+}
+
+void current_sensor_sampled(const ina219_sample_t* sample, void* user)
+{
+  // a full queue drops the sample and counts it as an overflow
+  embedd_ring_push( &current_sensor_samples, sample );
+  embedd_sampler_post( &current_sensor_sampler, NULL );
+}
+
+// The port of a HAL handle, NULL for a controller the bus functions do not serve
+static i2c_port_t *i2c_port_find(I2C_HandleTypeDef *hi2c)
+{
+  for( uint32_t i = 0; i < sizeof(i2c_ports) / sizeof(i2c_ports[0]); i++ )
+  {
+      if( i2c_ports[i]->hi2c == hi2c )
+      {
+          return i2c_ports[i];
+      }
+  }
+  return NULL;
+}
+
+static void i2c_port_complete(i2c_port_t *port, EMBEDD_RESULT result)
+{
+  embedd_bus_done_t done = port->done;
+  port->done = NULL;
+  port->rd_ptr = NULL;
+  if( done != NULL )
+  {
+      done( port->done_ctx, result );
+  }
+}
+
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+  i2c_port_t *port = i2c_port_find( hi2c );
+  if( port != NULL )
+  {
+      if( port->rd_ptr != NULL )
+      {
+          uint8_t *rd_ptr = port->rd_ptr;
+          port->rd_ptr = NULL;
+          if( HAL_I2C_Master_Seq_Receive_DMA(hi2c, port->rd_addr, rd_ptr, port->rd_size, I2C_LAST_FRAME ) != HAL_OK )
+          {
+              i2c_port_complete( port, EMBEDD_RESULT_ERR );
+          }
+          return;
+      }
+      i2c_port_complete( port, EMBEDD_RESULT_OK );
+  }
+}
+
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+  i2c_port_t *port = i2c_port_find( hi2c );
+  if( port != NULL )
+  {
+      i2c_port_complete( port, EMBEDD_RESULT_OK );
+  }
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+  i2c_port_t *port = i2c_port_find( hi2c );
+  if( port != NULL )
+  {
+      i2c_port_complete( port, EMBEDD_RESULT_ERR );
+  }
+}
+
+uint32_t embedd_hal_critical_enter( void )
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+void embedd_hal_critical_exit( uint32_t state )
+{
+    __set_PRIMASK(state);
+}
+
 void embedd_hal_sleep( uint32_t mseconds )
 {
     HAL_Delay(mseconds);
 }
 
-void debug(const char *format, ...)
+uint32_t embedd_hal_get_us( void )
+{
+    // Milliseconds from the HAL tick plus the elapsed part of the current
+    // SysTick period; re-read if the tick advanced in between.
+    uint32_t ms;
+    uint32_t val;
+    uint32_t pending;
+    do
+    {
+        ms      = HAL_GetTick();
+        val     = SysTick->VAL;
+        pending = SCB->ICSR & SCB_ICSR_PENDSTSET_Msk;
+    } while( ms != HAL_GetTick() );
+
+    // In an interrupt blocking SysTick the counter may have wrapped already
+    // without the tick being counted: a reloaded counter means it has.
+    if( ( pending != 0U ) && ( val > ( SysTick->LOAD / 2U ) ) )
+    {
+        ms++;
+    }
+
+    return ( ms * 1000U ) + ( ( SysTick->LOAD - val ) / ( SystemCoreClock / 1000000U ) );
+}
+
+bool embedd_hal_in_isr( void )
+{
+    // an active exception or masked interrupts keep the I2C1 callbacks from running
+    return ( __get_IPSR() != 0U ) || ( __get_PRIMASK() != 0U );
+}
+
+void embedd_hal_sleep_us( uint32_t useconds )
+{
+    uint32_t start = embedd_hal_get_us();
+    while( ( embedd_hal_get_us() - start ) < useconds )
+    {
+    }
+}
+
+EMBEDD_RESULT usart2_send(void* ctx, const uint8_t* data, uint32_t size)
+{
+  if( HAL_UART_Transmit_DMA( (UART_HandleTypeDef*)ctx, (uint8_t*)data, (uint16_t)size ) != HAL_OK )
+  {
+      return EMBEDD_RESULT_ERR;
+  }
+  return EMBEDD_RESULT_OK;
+}
+
+uint32_t usart2_log_send(void* ctx, const uint8_t* data, uint32_t size)
+{
+  // while the binary stream owns the port, text travels in LOG frames between the data frames
+  if( embedd_telemetry_streaming( &telemetry ) )
+  {
+      return embedd_telemetry_send_log( &telemetry, data, size );
+  }
+  return ( usart2_send( ctx, data, size ) == EMBEDD_RESULT_OK ) ? size : 0;
+}
+
+bool usart2_busy(void* ctx)
+{
+  return ((UART_HandleTypeDef*)ctx)->gState != HAL_UART_STATE_READY;
+}
+
+uint32_t usart2_baud(void* ctx, uint32_t baud, bool apply)
+{
+  UART_HandleTypeDef *huart = (UART_HandleTypeDef*)ctx;
+  uint32_t clock = HAL_RCC_GetPCLK1Freq();
+  if( ( baud == 0 ) || ( baud > clock / 8U ) )
+  {
+      return 0;
+  }
+
+  // 16 times oversampling tolerates more clock error, 8 times reaches twice the rate
+  bool over8 = ( baud > clock / 16U );
+  uint32_t ref = over8 ? 2U * clock : clock;
+  uint32_t actual = ref / ( ( ref + baud / 2U ) / baud );
+  if( ( actual > baud + baud / 50U ) || ( actual + baud / 50U < baud ) )
+  {
+      return 0;
+  }
+
+  if( apply )
+  {
+      HAL_UART_AbortReceive( huart );
+      huart->Init.BaudRate = baud;
+      huart->Init.OverSampling = over8 ? UART_OVERSAMPLING_8 : UART_OVERSAMPLING_16;
+      if( HAL_UART_Init( huart ) != HAL_OK )
+      {
+          return 0;
+      }
+      HAL_UART_Receive_IT( huart, &usart2_rx_byte, 1 );
+  }
+  return actual;
+}
+
+uint32_t usart2_crc(void* ctx, const uint8_t* data, uint32_t size)
+{
+  // default polynomial and initial value, bit-reversed bytes in and result out: the CRC-32 of zlib
+  CRC->CR = CRC_CR_REV_IN_0 | CRC_CR_REV_OUT | CRC_CR_RESET;
+  for( uint32_t i = 0; i < size; i++ )
+  {
+      *(__IO uint8_t*)&CRC->DR = data[i];
+  }
+  return ~CRC->DR;
+}
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
 {
-    va_list args;
+  if( huart == &huart2 )
+  {
+      // a full queue drops the byte, the frame then fails its CRC
+      embedd_ring_push( &usart2_rx, &usart2_rx_byte );
+      HAL_UART_Receive_IT( huart, &usart2_rx_byte, 1 );
+  }
+}
 
-    va_start(args, format);
-    uint16_t debug_msg_size = vsnprintf((char *)debug_buf, sizeof debug_buf, format, args);
-    va_end(args);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+  // overrun or framing errors, e.g. while the host changes its baud rate: keep receiving
+  if( ( huart == &huart2 ) && ( huart->RxState == HAL_UART_STATE_READY ) )
+  {
+      HAL_UART_Receive_IT( huart, &usart2_rx_byte, 1 );
+  }
+}
 
-    HAL_UART_Transmit(&huart2, debug_buf, debug_msg_size, 100);
+void debug_flush(uint32_t timeout_ms)
+{
+    // for the last words before the main loop is left
+    uint32_t start = HAL_GetTick();
+    while (embedd_log_pending(&usart2_log) != 0 && HAL_GetTick() - start < timeout_ms)
+    {
+        embedd_log_process(&usart2_log);
+    }
 }
 /* USER CODE END 4 */
 
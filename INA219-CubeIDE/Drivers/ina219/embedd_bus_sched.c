@@ -0,0 +1,411 @@
+/******************************************************************************
+* Company: Embedd Limited
+*
+* File: embedd_bus_sched.c
+*
+* Description: Provides a transaction scheduler sharing one bus between devices
+*
+* Software License Agreement:
+*
+* This code is proprietary to Embedd Limited and may not be distributed
+* or copied without the express permission of Embedd Limited. This code
+* is provided "as is" without warranty of any kind, either expressed or
+* implied, including but not limited to the implied warranties of
+* merchantability and fitness for a particular purpose. This code is intended
+* for use only within the user's organization by its employees and authorized
+* agents, and may not be disclosed or used for any other purpose without
+* prior written consent from Embedd Limited.
+*
+* Unauthorized distribution or use of this code, or any portion of it,
+* including but not limited to publishing online or making it open source,
+* may result in severe civil and criminal penalties, and will be prosecuted to
+* the maximum extent possible under the law.
+*
+* ©️ 2024 Embedd Limited. All Rights Reserved.
+******************************************************************************/
+
+#include "embedd_bus_sched.h"
+#include "embedd_device.h"
+
+static void embedd_bus_sched_run( embedd_bus_sched_t *sched );
+
+static bool embedd_bus_txn_before( const embedd_bus_txn_t *a, const embedd_bus_txn_t *b )
+{
+    if( a->priority != b->priority ) {
+        return a->priority > b->priority;
+    }
+    if( !a->has_deadline ) {
+        return false;
+    }
+    if( !b->has_deadline ) {
+        return true;
+    }
+    return (int32_t)( a->deadline - b->deadline ) < 0;
+}
+
+// hands the bus from the active transaction to the first waiting one
+static void embedd_bus_sched_next( embedd_bus_sched_t *sched, embedd_bus_txn_t *txn )
+{
+    uint32_t state = embedd_hal_critical_enter();
+    embedd_bus_txn_t *next = sched->queue;
+    if( next != NULL ) {
+        sched->queue = next->next;
+    } else {
+        sched->busy_us += embedd_hal_get_us() - sched->busy_since;
+    }
+    sched->active = next;
+    sched->cancelling = 0;
+    txn->queued = 0;
+    embedd_hal_critical_exit( state );
+
+    if( next != NULL ) {
+        embedd_bus_sched_run( sched );
+    }
+}
+
+static void embedd_bus_sched_finish( embedd_bus_sched_t *sched, embedd_bus_txn_t *txn, EMBEDD_RESULT result )
+{
+    if( result == EMBEDD_RESULT_OK ) {
+        sched->completed++;
+    } else {
+        sched->errors++;
+    }
+
+    // the next transaction is started before the callback runs, so the bus never waits for it
+    embedd_bus_sched_next( sched, txn );
+    if( txn->done != NULL ) {
+        txn->done( txn, result );
+    }
+}
+
+static void embedd_bus_sched_done( void *ctx, EMBEDD_RESULT result )
+{
+    embedd_bus_sched_t *sched = (embedd_bus_sched_t*)ctx;
+    embedd_bus_txn_t *txn = sched->active;
+    if( sched->cancelling ) {
+        // the transaction is being aborted, embedd_bus_sched_cancel finishes it
+        sched->cancel_done = 1;
+        return;
+    }
+    if( result != EMBEDD_RESULT_OK || ++txn->seg >= txn->segs_num ) {
+        embedd_bus_sched_finish( sched, txn, result );
+        return;
+    }
+    embedd_bus_sched_run( sched );
+}
+
+static void embedd_bus_sched_run( embedd_bus_sched_t *sched )
+{
+    embedd_bus_txn_t *txn = sched->active;
+    if( txn->seg == 0 && txn->has_deadline ) {
+        if( (int32_t)( embedd_hal_get_us() - txn->deadline ) > 0 ) {
+            sched->late++;
+        }
+    }
+    const embedd_bus_seg_t *seg = &txn->segs[txn->seg];
+    EMBEDD_RESULT result;
+    if( ( txn->seg + 1U < txn->segs_num ) && ( sched->bus->write_read_async != NULL ) &&
+        ( seg[0].dir == EMBEDD_BUS_SEG_WRITE ) && ( seg[1].dir == EMBEDD_BUS_SEG_READ ) ) {
+        // a write followed by a read runs with a repeated START, its completion ends both segments
+        txn->seg++;
+        result = sched->bus->write_read_async( txn->dev, seg[0].data, seg[0].size, seg[1].data, seg[1].size, embedd_bus_sched_done, sched );
+    } else if( seg->dir == EMBEDD_BUS_SEG_WRITE ) {
+        result = sched->bus->write_async( txn->dev, seg->data, seg->size, embedd_bus_sched_done, sched );
+    } else {
+        result = sched->bus->read_async( txn->dev, seg->data, seg->size, embedd_bus_sched_done, sched );
+    }
+    if( result != EMBEDD_RESULT_OK ) {
+        embedd_bus_sched_finish( sched, txn, result );
+    }
+}
+
+EMBEDD_RESULT embedd_bus_sched_init( embedd_bus_sched_t *sched, const embedd_bus_t *bus )
+{
+    if( ( sched == NULL ) || ( bus == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    if( ( bus->write_async == NULL ) || ( bus->read_async == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    sched->bus          = bus;
+    sched->queue        = NULL;
+    sched->active       = NULL;
+    sched->window_start = embedd_hal_get_us();
+    sched->busy_since   = sched->window_start;
+    sched->busy_us      = 0;
+    sched->completed    = 0;
+    sched->errors       = 0;
+    sched->late         = 0;
+    sched->cancelling   = 0;
+    sched->cancel_done  = 0;
+    return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT embedd_bus_sched_submit( embedd_bus_sched_t *sched, embedd_bus_txn_t *txn )
+{
+    if( ( sched == NULL ) || ( sched->bus == NULL ) || ( txn == NULL ) || ( txn->dev == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    if( ( txn->segs_num == 0 ) || ( txn->segs_num > EMBEDD_BUS_TXN_MAX_SEGS ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+
+    uint32_t state = embedd_hal_critical_enter();
+    if( txn->queued ) {
+        embedd_hal_critical_exit( state );
+        return EMBEDD_RESULT_ERR;
+    }
+    txn->queued = 1;
+    txn->seg    = 0;
+    bool start = ( sched->active == NULL );
+    if( start ) {
+        sched->active     = txn;
+        sched->busy_since = embedd_hal_get_us();
+    } else {
+        embedd_bus_txn_t **link = &sched->queue;
+        while( ( *link != NULL ) && !embedd_bus_txn_before( txn, *link ) ) {
+            link = &(*link)->next;
+        }
+        txn->next = *link;
+        *link = txn;
+    }
+    embedd_hal_critical_exit( state );
+
+    if( start ) {
+        embedd_bus_sched_run( sched );
+    }
+    return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT embedd_bus_sched_cancel( embedd_bus_sched_t *sched, embedd_bus_txn_t *txn )
+{
+    if( ( sched == NULL ) || ( txn == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+
+    uint32_t state = embedd_hal_critical_enter();
+    if( !txn->queued ) {
+        embedd_hal_critical_exit( state );
+        return EMBEDD_RESULT_OK;
+    }
+    if( sched->active != txn ) {
+        embedd_bus_txn_t **link = &sched->queue;
+        while( ( *link != NULL ) && ( *link != txn ) ) {
+            link = &(*link)->next;
+        }
+        if( *link != NULL ) {
+            *link = txn->next;
+        }
+        txn->queued = 0;
+        embedd_hal_critical_exit( state );
+        return EMBEDD_RESULT_OK;
+    }
+    if( sched->bus->abort == NULL ) {
+        embedd_hal_critical_exit( state );
+        return EMBEDD_RESULT_ERR;
+    }
+    // from here a completion of the transaction only sets cancel_done
+    sched->cancelling  = 1;
+    sched->cancel_done = 0;
+    embedd_hal_critical_exit( state );
+
+    EMBEDD_RESULT result = sched->bus->abort( txn->dev );
+    state = embedd_hal_critical_enter();
+    if( ( result != EMBEDD_RESULT_OK ) && !sched->cancel_done ) {
+        // still running, its completion finishes it as usual
+        sched->cancelling = 0;
+        embedd_hal_critical_exit( state );
+        return EMBEDD_RESULT_ERR;
+    }
+    embedd_hal_critical_exit( state );
+
+    sched->errors++;
+    embedd_bus_sched_next( sched, txn );
+    return EMBEDD_RESULT_OK;
+}
+
+bool embedd_bus_sched_busy( const embedd_bus_sched_t *sched )
+{
+    return ( sched != NULL ) && ( sched->active != NULL );
+}
+
+void embedd_bus_sched_get_stats( embedd_bus_sched_t *sched, embedd_bus_sched_stats_t *stats, bool reset )
+{
+    if( ( sched == NULL ) || ( stats == NULL ) ) {
+        return;
+    }
+    uint32_t state = embedd_hal_critical_enter();
+    uint32_t now  = embedd_hal_get_us();
+    uint32_t busy = sched->busy_us;
+    if( sched->active != NULL ) {
+        busy += now - sched->busy_since;
+    }
+    stats->elapsed_us  = now - sched->window_start;
+    stats->busy_us     = busy;
+    stats->completed   = sched->completed;
+    stats->errors      = sched->errors;
+    stats->late        = sched->late;
+    if( reset ) {
+        sched->window_start = now;
+        sched->busy_since   = now;
+        sched->busy_us      = 0;
+        sched->completed    = 0;
+        sched->errors       = 0;
+        sched->late         = 0;
+    }
+    embedd_hal_critical_exit( state );
+
+    stats->utilization = ( stats->elapsed_us != 0 ) ?
+        (uint32_t)( ( (uint64_t)stats->busy_us * 10000U ) / stats->elapsed_us ) : 0;
+}
+
+static void embedd_bus_sched_client_done( embedd_bus_txn_t *txn, EMBEDD_RESULT result )
+{
+    embedd_bus_sched_client_t *client = (embedd_bus_sched_client_t*)txn->user;
+    embedd_bus_done_t done = client->done;
+    client->result = result;
+    if( done != NULL ) {
+        client->done = NULL;
+        done( client->ctx, result );
+    }
+}
+
+static EMBEDD_RESULT embedd_bus_sched_client_submit( const struct embedd_device_t *dev, const uint8_t *wr_ptr, uint32_t wr_size,
+                                                     uint8_t *rd_ptr, uint32_t rd_size, embedd_bus_done_t done, void *ctx )
+{
+    if( ( dev == NULL ) || ( dev->bus == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    // the bus functions are the first member of the client
+    embedd_bus_sched_client_t *client = (embedd_bus_sched_client_t*)dev->bus;
+    embedd_bus_txn_t *txn = &client->txn;
+    if( txn->queued ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    // waiting with interrupts unable to complete the transfer never ends
+    if( ( done == NULL ) && embedd_hal_in_isr() ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    txn->dev = dev;
+    txn->segs_num = 0;
+    if( wr_ptr != NULL ) {
+        txn->segs[txn->segs_num++] = (embedd_bus_seg_t){ .data = (uint8_t*)wr_ptr, .size = wr_size, .dir = EMBEDD_BUS_SEG_WRITE };
+    }
+    if( rd_ptr != NULL ) {
+        txn->segs[txn->segs_num++] = (embedd_bus_seg_t){ .data = rd_ptr, .size = rd_size, .dir = EMBEDD_BUS_SEG_READ };
+    }
+    txn->has_deadline = ( client->latency_us != 0 );
+    if( txn->has_deadline ) {
+        txn->deadline = embedd_hal_get_us() + client->latency_us;
+    }
+    client->done   = done;
+    client->ctx    = ctx;
+    client->result = EMBEDD_RESULT_ERR;
+    if( embedd_bus_sched_submit( client->sched, txn ) != EMBEDD_RESULT_OK ) {
+        client->done = NULL;
+        return EMBEDD_RESULT_ERR;
+    }
+    if( done != NULL ) {
+        return EMBEDD_RESULT_OK;
+    }
+    embedd_hal_deadline_t timeout;
+    embedd_hal_deadline_arm( &timeout, EMBEDD_BUS_SCHED_TIMEOUT_US );
+    while( txn->queued ) {
+        if( embedd_hal_deadline_expired( &timeout ) ) {
+            // the transfer must not outlive the caller's buffers
+            embedd_bus_sched_cancel( client->sched, txn );
+            return EMBEDD_RESULT_ERR;
+        }
+        // a time base moving only in the sleep functions must advance too
+        embedd_hal_sleep_us( 1U );
+    }
+    return client->result;
+}
+
+static EMBEDD_RESULT embedd_bus_sched_client_abort( const struct embedd_device_t *dev )
+{
+    if( ( dev == NULL ) || ( dev->bus == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    embedd_bus_sched_client_t *client = (embedd_bus_sched_client_t*)dev->bus;
+    EMBEDD_RESULT result = embedd_bus_sched_cancel( client->sched, &client->txn );
+    if( result == EMBEDD_RESULT_OK ) {
+        client->done = NULL;
+    }
+    return result;
+}
+
+static EMBEDD_RESULT embedd_bus_sched_client_write( const struct embedd_device_t *dev, const uint8_t *data_ptr, uint32_t data_size )
+{
+    if( data_ptr == NULL ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    return embedd_bus_sched_client_submit( dev, data_ptr, data_size, NULL, 0, NULL, NULL );
+}
+
+static EMBEDD_RESULT embedd_bus_sched_client_read( const struct embedd_device_t *dev, uint8_t *data_ptr, uint32_t data_size )
+{
+    if( data_ptr == NULL ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    return embedd_bus_sched_client_submit( dev, NULL, 0, data_ptr, data_size, NULL, NULL );
+}
+
+static EMBEDD_RESULT embedd_bus_sched_client_write_read( const struct embedd_device_t *dev, const uint8_t *wr_ptr, uint32_t wr_size, uint8_t *rd_ptr, uint32_t rd_size )
+{
+    if( ( wr_ptr == NULL ) || ( rd_ptr == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    return embedd_bus_sched_client_submit( dev, wr_ptr, wr_size, rd_ptr, rd_size, NULL, NULL );
+}
+
+static EMBEDD_RESULT embedd_bus_sched_client_write_read_async( const struct embedd_device_t *dev, const uint8_t *wr_ptr, uint32_t wr_size, uint8_t *rd_ptr, uint32_t rd_size, embedd_bus_done_t done, void *ctx )
+{
+    if( ( wr_ptr == NULL ) || ( rd_ptr == NULL ) || ( done == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    return embedd_bus_sched_client_submit( dev, wr_ptr, wr_size, rd_ptr, rd_size, done, ctx );
+}
+
+static EMBEDD_RESULT embedd_bus_sched_client_write_async( const struct embedd_device_t *dev, const uint8_t *data_ptr, uint32_t data_size, embedd_bus_done_t done, void *ctx )
+{
+    if( ( data_ptr == NULL ) || ( done == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    return embedd_bus_sched_client_submit( dev, data_ptr, data_size, NULL, 0, done, ctx );
+}
+
+static EMBEDD_RESULT embedd_bus_sched_client_read_async( const struct embedd_device_t *dev, uint8_t *data_ptr, uint32_t data_size, embedd_bus_done_t done, void *ctx )
+{
+    if( ( data_ptr == NULL ) || ( done == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    return embedd_bus_sched_client_submit( dev, NULL, 0, data_ptr, data_size, done, ctx );
+}
+
+EMBEDD_RESULT embedd_bus_sched_client_init( embedd_bus_sched_client_t *client, embedd_bus_sched_t *sched, uint8_t priority, uint32_t latency_us )
+{
+    if( ( client == NULL ) || ( sched == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    client->bus = (embedd_bus_t){
+        .write       = embedd_bus_sched_client_write,
+        .read        = embedd_bus_sched_client_read,
+        .write_async = embedd_bus_sched_client_write_async,
+        .read_async  = embedd_bus_sched_client_read_async,
+        .write_read  = embedd_bus_sched_client_write_read,
+        .transfer    = NULL,
+        .write_read_async = embedd_bus_sched_client_write_read_async,
+        .abort       = embedd_bus_sched_client_abort
+    };
+    client->sched          = sched;
+    client->txn            = (embedd_bus_txn_t){ 0 };
+    client->txn.priority   = priority;
+    client->txn.done       = embedd_bus_sched_client_done;
+    client->txn.user       = client;
+    client->latency_us     = latency_us;
+    client->done           = NULL;
+    client->ctx            = NULL;
+    client->result         = EMBEDD_RESULT_OK;
+    return EMBEDD_RESULT_OK;
+}
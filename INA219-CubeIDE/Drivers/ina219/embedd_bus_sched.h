@@ -0,0 +1,248 @@
+/******************************************************************************
+* Company: Embedd Limited
+*
+* File: embedd_bus_sched.h
+*
+* Description: Provides a transaction scheduler sharing one bus between devices
+*
+* Software License Agreement:
+*
+* This code is proprietary to Embedd Limited and may not be distributed
+* or copied without the express permission of Embedd Limited. This code
+* is provided "as is" without warranty of any kind, either expressed or
+* implied, including but not limited to the implied warranties of
+* merchantability and fitness for a particular purpose. This code is intended
+* for use only within the user's organization by its employees and authorized
+* agents, and may not be disclosed or used for any other purpose without
+* prior written consent from Embedd Limited.
+*
+* Unauthorized distribution or use of this code, or any portion of it,
+* including but not limited to publishing online or making it open source,
+* may result in severe civil and criminal penalties, and will be prosecuted to
+* the maximum extent possible under the law.
+*
+* ©️ 2024 Embedd Limited. All Rights Reserved.
+******************************************************************************/
+
+#ifndef _SRC_EMBEDD_BUS_SCHED_H
+#define _SRC_EMBEDD_BUS_SCHED_H
+
+#include "embedd_hal.h"
+
+/*!
+ *  \def   EMBEDD_BUS_TXN_MAX_SEGS
+ *  \brief Maximal number of segments of one scheduled transaction
+ */
+#ifndef EMBEDD_BUS_TXN_MAX_SEGS
+#define EMBEDD_BUS_TXN_MAX_SEGS 2
+#endif
+
+/*!
+ *  \def   EMBEDD_BUS_SCHED_TIMEOUT_US
+ *  \brief Time a blocking transfer of a client waits for the scheduler before it fails
+ */
+#ifndef EMBEDD_BUS_SCHED_TIMEOUT_US
+#define EMBEDD_BUS_SCHED_TIMEOUT_US 100000U
+#endif
+
+struct embedd_bus_txn_t;
+
+/*!
+ *  \typedef    embedd_bus_txn_done_t
+ *  \brief      completion callback of a scheduled transaction, usually called from interrupt context
+ *
+ *  \param      txn       pointer to the finished transaction, it may be submitted again from here
+ *  \param      result    EMBEDD_RESULT_OK if all segments succeeded
+ */
+typedef void (*embedd_bus_txn_done_t)(struct embedd_bus_txn_t *txn, EMBEDD_RESULT result);
+
+/*!
+ *  \struct     embedd_bus_txn_t
+ *  \brief      transaction descriptor owned by the caller
+ *
+ *  The descriptor must stay valid from @embedd_bus_sched_submit until its
+ *  @done callback is called. Transactions with a higher priority run first;
+ *  among equal priorities the earliest deadline runs first and transactions
+ *  without a deadline run last, in submission order.
+ *
+ *  \param      next          link of the scheduler queue, private
+ *  \param      dev           device the transaction is addressed to
+ *  \param      segs          segments, run one after another on the bus
+ *  \param      segs_num      number of used segments
+ *  \param      priority      priority, higher runs first
+ *  \param      has_deadline  non-zero if @deadline is valid
+ *  \param      deadline      value of @embedd_hal_get_us the transaction should start by
+ *  \param      done          completion callback, may be NULL
+ *  \param      user          user pointer, not used by the scheduler
+ *  \param      seg           index of the segment in progress, private
+ *  \param      queued        non-zero from submission until completion, private
+ */
+typedef struct embedd_bus_txn_t {
+    struct embedd_bus_txn_t *next;
+    const struct embedd_device_t *dev;
+    embedd_bus_seg_t segs[EMBEDD_BUS_TXN_MAX_SEGS];
+    uint8_t segs_num;
+    uint8_t priority;
+    uint8_t has_deadline;
+    uint32_t deadline;
+    embedd_bus_txn_done_t done;
+    void *user;
+    uint8_t seg;
+    volatile uint8_t queued;
+} embedd_bus_txn_t;
+
+/*!
+ *  \struct     embedd_bus_sched_t
+ *  \brief      scheduler owning one bus
+ *
+ *  \param      bus           bus running the transfers, write_async and read_async are required,
+ *                            write_read_async keeps a write followed by a read in one transfer
+ *  \param      queue         transactions waiting for the bus, in running order
+ *  \param      active        transaction in progress or NULL
+ *  \param      window_start  time the statistics window started at
+ *  \param      busy_since    time the bus became busy at
+ *  \param      busy_us       time the bus was busy within the window, excluding the current busy period
+ *  \param      completed     number of transactions finished successfully
+ *  \param      errors        number of transactions finished with an error
+ *  \param      late          number of transactions started after their deadline
+ *  \param      cancelling    non-zero while @embedd_bus_sched_cancel aborts the active transaction, private
+ *  \param      cancel_done   non-zero if the active transaction completed while it was aborted, private
+ */
+typedef struct {
+    const embedd_bus_t *bus;
+    embedd_bus_txn_t *queue;
+    embedd_bus_txn_t *volatile active;
+    uint32_t window_start;
+    uint32_t busy_since;
+    uint32_t busy_us;
+    uint32_t completed;
+    uint32_t errors;
+    uint32_t late;
+    volatile uint8_t cancelling;
+    volatile uint8_t cancel_done;
+} embedd_bus_sched_t;
+
+/*!
+ *  \struct     embedd_bus_sched_stats_t
+ *  \brief      scheduler statistics since the last reset
+ *
+ *  \param      elapsed_us    length of the statistics window
+ *  \param      busy_us       time the bus was busy within the window
+ *  \param      utilization   busy_us / elapsed_us in 1/10000 units
+ *  \param      completed     number of transactions finished successfully
+ *  \param      errors        number of transactions finished with an error
+ *  \param      late          number of transactions started after their deadline
+ */
+typedef struct {
+    uint32_t elapsed_us;
+    uint32_t busy_us;
+    uint32_t utilization;
+    uint32_t completed;
+    uint32_t errors;
+    uint32_t late;
+} embedd_bus_sched_stats_t;
+
+/*!
+ *  \struct     embedd_bus_sched_client_t
+ *  \brief      per-device bus routing every transfer of the device through a scheduler
+ *
+ *  Set the device's bus to @bus to let unmodified drivers share the scheduled
+ *  bus. A combined write_read keeps both parts together, so no transfer of
+ *  another device gets in between, and runs with a repeated START when the
+ *  scheduled bus has write_read_async. The blocking functions wait for the
+ *  scheduler up to EMBEDD_BUS_SCHED_TIMEOUT_US and fail at once when
+ *  @embedd_hal_in_isr is true. A transfer which times out is cancelled with
+ *  @embedd_bus_sched_cancel before the function returns. @abort of the
+ *  client cancels its asynchronous transfer the same way.
+ *
+ *  \param      bus           bus functions of the client, must stay the first member
+ *  \param      sched         scheduler the transfers are submitted to
+ *  \param      txn           transaction of the transfer in progress
+ *  \param      latency_us    deadline of a transfer relative to its submission, 0 for none
+ *  \param      done          completion callback of the asynchronous transfer in progress
+ *  \param      ctx           context pointer of @done
+ *  \param      result        result of the blocking transfer in progress
+ */
+typedef struct {
+    embedd_bus_t bus;
+    embedd_bus_sched_t *sched;
+    embedd_bus_txn_t txn;
+    uint32_t latency_us;
+    embedd_bus_done_t done;
+    void *ctx;
+    volatile EMBEDD_RESULT result;
+} embedd_bus_sched_client_t;
+
+/*!
+ *  \fn       embedd_bus_sched_init
+ *  \brief    initializes a scheduler and starts its statistics window
+ *
+ *  \param    sched  pointer to the scheduler
+ *  \param    bus    bus running the transfers
+ *
+ *  \result   EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT embedd_bus_sched_init( embedd_bus_sched_t *sched, const embedd_bus_t *bus );
+
+/*!
+ *  \fn       embedd_bus_sched_submit
+ *  \brief    queues a transaction and starts it at once if the bus is idle
+ *
+ *  \param    sched  pointer to the scheduler
+ *  \param    txn    pointer to the transaction, not queued already
+ *
+ *  \result   EMBEDD_RESULT_OK if the transaction was queued, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT embedd_bus_sched_submit( embedd_bus_sched_t *sched, embedd_bus_txn_t *txn );
+
+/*!
+ *  \fn       embedd_bus_sched_cancel
+ *  \brief    withdraws a transaction without calling its completion callback
+ *
+ *  A waiting transaction is removed from the queue. The transaction in
+ *  progress is stopped with the abort function of the bus, counted as an
+ *  error, and the next one is started. Must not be called from interrupt
+ *  context.
+ *
+ *  \param    sched  pointer to the scheduler
+ *  \param    txn    pointer to the transaction
+ *
+ *  \result   EMBEDD_RESULT_OK if the transaction is no longer queued, EMBEDD_RESULT_ERR
+ *            if it is in progress and the bus has no abort function or failed to stop
+ */
+EMBEDD_RESULT embedd_bus_sched_cancel( embedd_bus_sched_t *sched, embedd_bus_txn_t *txn );
+
+/*!
+ *  \fn       embedd_bus_sched_busy
+ *  \brief    checks if a transaction is in progress or waiting
+ *
+ *  \param    sched  pointer to the scheduler
+ *
+ *  \result   true if the bus is busy
+ */
+bool embedd_bus_sched_busy( const embedd_bus_sched_t *sched );
+
+/*!
+ *  \fn       embedd_bus_sched_get_stats
+ *  \brief    reads the statistics and optionally starts a new window
+ *
+ *  \param    sched  pointer to the scheduler
+ *  \param    stats  pointer to the statistics to fill in
+ *  \param    reset  true to start a new statistics window
+ */
+void embedd_bus_sched_get_stats( embedd_bus_sched_t *sched, embedd_bus_sched_stats_t *stats, bool reset );
+
+/*!
+ *  \fn       embedd_bus_sched_client_init
+ *  \brief    initializes a per-device bus submitting to a scheduler
+ *
+ *  \param    client      pointer to the client
+ *  \param    sched       pointer to the scheduler
+ *  \param    priority    priority of the client's transactions
+ *  \param    latency_us  deadline of a transfer relative to its submission, 0 for none
+ *
+ *  \result   EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT embedd_bus_sched_client_init( embedd_bus_sched_client_t *client, embedd_bus_sched_t *sched, uint8_t priority, uint32_t latency_us );
+
+#endif //_SRC_EMBEDD_BUS_SCHED_H
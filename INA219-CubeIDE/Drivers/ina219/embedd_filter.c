@@ -0,0 +1,325 @@
+/******************************************************************************
+* Company: Embedd Limited
+*
+* File: embedd_filter.c
+*
+* Description: Provides chainable fixed-point sample filters
+*
+* Software License Agreement:
+*
+* This code is proprietary to Embedd Limited and may not be distributed
+* or copied without the express permission of Embedd Limited. This code
+* is provided "as is" without warranty of any kind, either expressed or
+* implied, including but not limited to the implied warranties of
+* merchantability and fitness for a particular purpose. This code is intended
+* for use only within the user's organization by its employees and authorized
+* agents, and may not be disclosed or used for any other purpose without
+* prior written consent from Embedd Limited.
+*
+* Unauthorized distribution or use of this code, or any portion of it,
+* including but not limited to publishing online or making it open source,
+* may result in severe civil and criminal penalties, and will be prosecuted to
+* the maximum extent possible under the law.
+*
+* ©️ 2024 Embedd Limited. All Rights Reserved.
+******************************************************************************/
+
+#include "embedd_filter.h"
+
+// signed division rounded to nearest, halves away from zero
+static int64_t embedd_filter_div_round( int64_t value, uint64_t divisor )
+{
+    if( value < 0 ) {
+        return -(int64_t)( ( (uint64_t)-value + divisor / 2U ) / divisor );
+    }
+    return (int64_t)( ( (uint64_t)value + divisor / 2U ) / divisor );
+}
+
+// floor division by 2^shift rounded to nearest, halves towards plus infinity
+static int64_t embedd_filter_shift_round( int64_t value, uint8_t shift )
+{
+    if( shift == 0 ) {
+        return value;
+    }
+    return ( value + ( 1LL << ( shift - 1U ) ) ) >> shift;
+}
+
+static uint8_t embedd_filter_log2( uint32_t value )
+{
+    uint8_t shift = 0;
+    while( ( 1UL << shift ) < value ) {
+        shift++;
+    }
+    return shift;
+}
+
+EMBEDD_RESULT embedd_filter_ma_init( embedd_filter_stage_t *stage, int32_t *values, uint32_t length )
+{
+    if( ( stage == NULL ) || ( values == NULL ) || ( length == 0 ) || ( length > EMBEDD_FILTER_MA_MAX_LENGTH ) ||
+        ( ( length & ( length - 1U ) ) != 0 ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    *stage = (embedd_filter_stage_t){ .type = EMBEDD_FILTER_MA };
+    stage->u.ma.values = values;
+    stage->u.ma.shift  = embedd_filter_log2( length );
+    return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT embedd_filter_iir_init( embedd_filter_stage_t *stage, uint8_t shift )
+{
+    if( ( stage == NULL ) || ( shift == 0 ) || ( shift > 16U ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    *stage = (embedd_filter_stage_t){ .type = EMBEDD_FILTER_IIR };
+    stage->u.iir.shift = shift;
+    return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT embedd_filter_median_init( embedd_filter_stage_t *stage, int32_t *values, int32_t *sorted, uint32_t length )
+{
+    if( ( stage == NULL ) || ( values == NULL ) || ( sorted == NULL ) || ( ( length & 1U ) == 0 ) ||
+        ( length > EMBEDD_FILTER_MEDIAN_MAX_LENGTH ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    *stage = (embedd_filter_stage_t){ .type = EMBEDD_FILTER_MEDIAN };
+    stage->u.median.values = values;
+    stage->u.median.sorted = sorted;
+    stage->u.median.length = (uint8_t)length;
+    return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT embedd_filter_cic_init( embedd_filter_stage_t *stage, uint8_t order, uint32_t decimation )
+{
+    if( ( stage == NULL ) || ( order == 0 ) || ( order > EMBEDD_FILTER_CIC_MAX_ORDER ) || ( decimation < 2U ) ||
+        ( decimation > EMBEDD_FILTER_CIC_MAX_DECIMATION ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    // the integrators would lose the top bits of an int32_t input
+    if( (uint32_t)embedd_filter_log2( decimation ) * order > EMBEDD_FILTER_CIC_MAX_GROWTH ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    *stage = (embedd_filter_stage_t){ .type = EMBEDD_FILTER_CIC };
+    stage->u.cic.order      = order;
+    stage->u.cic.decimation = (uint16_t)decimation;
+    stage->u.cic.gain       = 1;
+    for( uint8_t i = 0; i < order; i++ ) {
+        stage->u.cic.gain *= decimation;
+    }
+    // a shift replaces the division of a power-of-two decimation
+    stage->u.cic.gain_shift = ( ( decimation & ( decimation - 1U ) ) == 0 ) ? (uint8_t)( embedd_filter_log2( decimation ) * order ) : 0;
+    embedd_filter_stage_reset( stage );
+    return EMBEDD_RESULT_OK;
+}
+
+void embedd_filter_stage_reset( embedd_filter_stage_t *stage )
+{
+    if( stage == NULL ) {
+        return;
+    }
+    switch( stage->type ) {
+    case EMBEDD_FILTER_MA:
+        stage->u.ma.primed = 0;
+        break;
+    case EMBEDD_FILTER_IIR:
+        stage->u.iir.primed = 0;
+        break;
+    case EMBEDD_FILTER_MEDIAN:
+        stage->u.median.primed = 0;
+        break;
+    case EMBEDD_FILTER_CIC:
+        for( uint8_t i = 0; i < EMBEDD_FILTER_CIC_MAX_ORDER; i++ ) {
+            stage->u.cic.integ[i] = 0;
+            stage->u.cic.comb[i]  = 0;
+        }
+        stage->u.cic.phase  = 0;
+        stage->u.cic.settle = stage->u.cic.order;
+        break;
+    default:
+        break;
+    }
+}
+
+static int32_t embedd_filter_ma( embedd_filter_stage_t *stage, int32_t in )
+{
+    uint32_t length = 1UL << stage->u.ma.shift;
+    if( !stage->u.ma.primed ) {
+        for( uint32_t i = 0; i < length; i++ ) {
+            stage->u.ma.values[i] = in;
+        }
+        stage->u.ma.sum    = (int64_t)in * length;
+        stage->u.ma.index  = 0;
+        stage->u.ma.primed = 1;
+        return in;
+    }
+    uint16_t index = stage->u.ma.index;
+    stage->u.ma.sum += (int64_t)in - stage->u.ma.values[index];
+    stage->u.ma.values[index] = in;
+    stage->u.ma.index = (uint16_t)( ( index + 1U ) & ( length - 1U ) );
+    return (int32_t)embedd_filter_shift_round( stage->u.ma.sum, stage->u.ma.shift );
+}
+
+static int32_t embedd_filter_iir( embedd_filter_stage_t *stage, int32_t in )
+{
+    int64_t x_q16 = (int64_t)in * 65536;
+    if( !stage->u.iir.primed ) {
+        stage->u.iir.y_q16  = x_q16;
+        stage->u.iir.primed = 1;
+        return in;
+    }
+    // the 16 fraction bits keep small steps from getting stuck below 2^shift
+    stage->u.iir.y_q16 += ( x_q16 - stage->u.iir.y_q16 ) >> stage->u.iir.shift;
+    return (int32_t)embedd_filter_shift_round( stage->u.iir.y_q16, 16 );
+}
+
+static int32_t embedd_filter_median( embedd_filter_stage_t *stage, int32_t in )
+{
+    uint8_t length  = stage->u.median.length;
+    int32_t *sorted = stage->u.median.sorted;
+    if( !stage->u.median.primed ) {
+        for( uint8_t i = 0; i < length; i++ ) {
+            stage->u.median.values[i] = in;
+            sorted[i] = in;
+        }
+        stage->u.median.index  = 0;
+        stage->u.median.primed = 1;
+        return in;
+    }
+    // replace the oldest value in the sorted copy and move the new one into place
+    int32_t old = stage->u.median.values[stage->u.median.index];
+    stage->u.median.values[stage->u.median.index] = in;
+    stage->u.median.index = ( stage->u.median.index + 1U == length ) ? 0 : (uint8_t)( stage->u.median.index + 1U );
+    uint8_t pos = 0;
+    while( sorted[pos] != old ) {
+        pos++;
+    }
+    while( ( pos > 0 ) && ( sorted[pos - 1U] > in ) ) {
+        sorted[pos] = sorted[pos - 1U];
+        pos--;
+    }
+    while( ( pos + 1U < length ) && ( sorted[pos + 1U] < in ) ) {
+        sorted[pos] = sorted[pos + 1U];
+        pos++;
+    }
+    sorted[pos] = in;
+    return sorted[length / 2U];
+}
+
+static bool embedd_filter_cic( embedd_filter_stage_t *stage, int32_t in, int32_t *out )
+{
+    uint8_t order = stage->u.cic.order;
+    // modulo 2^64 arithmetic, the wrap-arounds cancel in the combs
+    uint64_t acc = (uint64_t)(int64_t)in;
+    for( uint8_t i = 0; i < order; i++ ) {
+        stage->u.cic.integ[i] += acc;
+        acc = stage->u.cic.integ[i];
+    }
+    if( ++stage->u.cic.phase < stage->u.cic.decimation ) {
+        return false;
+    }
+    stage->u.cic.phase = 0;
+    for( uint8_t i = 0; i < order; i++ ) {
+        uint64_t delayed = stage->u.cic.comb[i];
+        stage->u.cic.comb[i] = acc;
+        acc -= delayed;
+    }
+    if( stage->u.cic.settle != 0 ) {
+        // the comb delays still hold the zeros of the reset
+        stage->u.cic.settle--;
+        return false;
+    }
+    if( stage->u.cic.gain_shift != 0 ) {
+        *out = (int32_t)embedd_filter_shift_round( (int64_t)acc, stage->u.cic.gain_shift );
+    } else {
+        *out = (int32_t)embedd_filter_div_round( (int64_t)acc, stage->u.cic.gain );
+    }
+    return true;
+}
+
+bool embedd_filter_stage_process( embedd_filter_stage_t *stage, int32_t in, int32_t *out )
+{
+    if( ( stage == NULL ) || ( out == NULL ) ) {
+        return false;
+    }
+    switch( stage->type ) {
+    case EMBEDD_FILTER_MA:
+        *out = embedd_filter_ma( stage, in );
+        return true;
+    case EMBEDD_FILTER_IIR:
+        *out = embedd_filter_iir( stage, in );
+        return true;
+    case EMBEDD_FILTER_MEDIAN:
+        *out = embedd_filter_median( stage, in );
+        return true;
+    case EMBEDD_FILTER_CIC:
+        return embedd_filter_cic( stage, in, out );
+    default:
+        return false;
+    }
+}
+
+void embedd_filter_chain_init( embedd_filter_chain_t *chain )
+{
+    if( chain == NULL ) {
+        return;
+    }
+    chain->head    = NULL;
+    chain->inputs  = 0;
+    chain->outputs = 0;
+}
+
+EMBEDD_RESULT embedd_filter_chain_append( embedd_filter_chain_t *chain, embedd_filter_stage_t *stage )
+{
+    if( ( chain == NULL ) || ( stage == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    embedd_filter_stage_t **link = &chain->head;
+    while( *link != NULL ) {
+        if( *link == stage ) {
+            return EMBEDD_RESULT_ERR;
+        }
+        link = &( *link )->next;
+    }
+    stage->next = NULL;
+    embedd_filter_stage_reset( stage );
+    *link = stage;
+    return EMBEDD_RESULT_OK;
+}
+
+void embedd_filter_chain_clear( embedd_filter_chain_t *chain )
+{
+    if( chain == NULL ) {
+        return;
+    }
+    while( chain->head != NULL ) {
+        embedd_filter_stage_t *stage = chain->head;
+        chain->head = stage->next;
+        stage->next = NULL;
+    }
+}
+
+void embedd_filter_chain_reset( embedd_filter_chain_t *chain )
+{
+    if( chain == NULL ) {
+        return;
+    }
+    for( embedd_filter_stage_t *stage = chain->head; stage != NULL; stage = stage->next ) {
+        embedd_filter_stage_reset( stage );
+    }
+}
+
+bool embedd_filter_chain_process( embedd_filter_chain_t *chain, int32_t in, int32_t *out )
+{
+    if( ( chain == NULL ) || ( out == NULL ) ) {
+        return false;
+    }
+    chain->inputs++;
+    int32_t value = in;
+    for( embedd_filter_stage_t *stage = chain->head; stage != NULL; stage = stage->next ) {
+        if( !embedd_filter_stage_process( stage, value, &value ) ) {
+            return false;
+        }
+    }
+    chain->outputs++;
+    *out = value;
+    return true;
+}
@@ -0,0 +1,292 @@
+/******************************************************************************
+* Company: Embedd Limited
+*
+* File: embedd_filter.h
+*
+* Description: Provides chainable fixed-point sample filters
+*
+* Software License Agreement:
+*
+* This code is proprietary to Embedd Limited and may not be distributed
+* or copied without the express permission of Embedd Limited. This code
+* is provided "as is" without warranty of any kind, either expressed or
+* implied, including but not limited to the implied warranties of
+* merchantability and fitness for a particular purpose. This code is intended
+* for use only within the user's organization by its employees and authorized
+* agents, and may not be disclosed or used for any other purpose without
+* prior written consent from Embedd Limited.
+*
+* Unauthorized distribution or use of this code, or any portion of it,
+* including but not limited to publishing online or making it open source,
+* may result in severe civil and criminal penalties, and will be prosecuted to
+* the maximum extent possible under the law.
+*
+* ©️ 2024 Embedd Limited. All Rights Reserved.
+******************************************************************************/
+
+#ifndef _SRC_EMBEDD_FILTER_H
+#define _SRC_EMBEDD_FILTER_H
+
+#include "embedd_hal.h"
+
+/*!
+ *  \def        EMBEDD_FILTER_MA_MAX_LENGTH
+ *  \brief      longest moving average, a power of two
+ */
+#define EMBEDD_FILTER_MA_MAX_LENGTH     256U
+
+/*!
+ *  \def        EMBEDD_FILTER_MEDIAN_MAX_LENGTH
+ *  \brief      longest median window, an odd number
+ */
+#define EMBEDD_FILTER_MEDIAN_MAX_LENGTH 15U
+
+/*!
+ *  \def        EMBEDD_FILTER_CIC_MAX_ORDER
+ *  \brief      highest number of CIC integrator and comb pairs
+ */
+#define EMBEDD_FILTER_CIC_MAX_ORDER     4U
+
+/*!
+ *  \def        EMBEDD_FILTER_CIC_MAX_DECIMATION
+ *  \brief      highest CIC decimation
+ */
+#define EMBEDD_FILTER_CIC_MAX_DECIMATION 256U
+
+/*!
+ *  \def        EMBEDD_FILTER_CIC_MAX_GROWTH
+ *  \brief      highest CIC bit growth order * log2(decimation), the 32-bit input and the growth fill the 63-bit accumulator
+ */
+#define EMBEDD_FILTER_CIC_MAX_GROWTH    31U
+
+/*!
+ *  \enum       embedd_filter_type_t
+ *  \brief      filter stage types
+ */
+typedef enum {
+    EMBEDD_FILTER_MA = 0,   //!< moving average over a power-of-two number of values
+    EMBEDD_FILTER_IIR,      //!< single-pole low pass, y += (x - y) / 2^shift
+    EMBEDD_FILTER_MEDIAN,   //!< median of an odd number of values, rejects spikes
+    EMBEDD_FILTER_CIC,      //!< cascaded integrator-comb, outputs every decimation values
+} embedd_filter_type_t;
+
+/*!
+ *  \struct     embedd_filter_stage_t
+ *  \brief      filter stage, initialized with one of the embedd_filter_*_init functions
+ *
+ *  The moving average and the median start with their window filled with the
+ *  first value, the low pass starts at the first value. The CIC stage holds
+ *  back its first order outputs while its combs fill.
+ *
+ *  \param      type        stage type
+ *  \param      next        next stage of the chain, private
+ *  \param      ma          moving average state: values, sum, index, shift and primed flag
+ *  \param      iir         low pass state: output in 1/65536 units, shift and primed flag
+ *  \param      median      median state: values in arrival and in sorted order, index, length and primed flag
+ *  \param      cic         CIC state: integrators, comb delays, order, decimation, phase and gain
+ */
+typedef struct embedd_filter_stage {
+    embedd_filter_type_t type;
+    struct embedd_filter_stage *next;
+    union {
+        struct {
+            int32_t  *values;
+            int64_t  sum;
+            uint16_t index;
+            uint8_t  shift;
+            uint8_t  primed;
+        } ma;
+        struct {
+            int64_t  y_q16;
+            uint8_t  shift;
+            uint8_t  primed;
+        } iir;
+        struct {
+            int32_t  *values;
+            int32_t  *sorted;
+            uint8_t  index;
+            uint8_t  length;
+            uint8_t  primed;
+        } median;
+        struct {
+            uint64_t integ[EMBEDD_FILTER_CIC_MAX_ORDER];
+            uint64_t comb[EMBEDD_FILTER_CIC_MAX_ORDER];
+            uint64_t gain;
+            uint16_t decimation;
+            uint16_t phase;
+            uint8_t  order;
+            uint8_t  gain_shift;
+            uint8_t  settle;
+        } cic;
+    } u;
+} embedd_filter_stage_t;
+
+/*!
+ *  \struct     embedd_filter_chain_t
+ *  \brief      stages applied one after the other to the values of one channel
+ *
+ *  \param      head      first stage, NULL passes the values through
+ *  \param      inputs    values processed
+ *  \param      outputs   values output
+ */
+typedef struct {
+    embedd_filter_stage_t *head;
+    uint32_t inputs;
+    uint32_t outputs;
+} embedd_filter_chain_t;
+
+/*!
+ *  \macro  EMBEDD_FILTER_MA_DEFINE
+ *  \brief  creates a moving average stage with static storage
+ *
+ *  \param  var       name of the stage's variable
+ *  \param  _length   number of values averaged, a power of two
+ */
+#define EMBEDD_FILTER_MA_DEFINE(var, _length)\
+  _Static_assert( ( (_length) != 0 ) && ( ( (_length) & ( (_length) - 1 ) ) == 0 ) && ( (_length) <= EMBEDD_FILTER_MA_MAX_LENGTH ),\
+                  #var " length must be a power of two up to EMBEDD_FILTER_MA_MAX_LENGTH" );\
+  static int32_t var##_values[_length];\
+  embedd_filter_stage_t var;
+
+/*!
+ *  \macro  EMBEDD_FILTER_MEDIAN_DEFINE
+ *  \brief  creates a median stage with static storage
+ *
+ *  \param  var       name of the stage's variable
+ *  \param  _length   number of values, odd
+ */
+#define EMBEDD_FILTER_MEDIAN_DEFINE(var, _length)\
+  _Static_assert( ( ( (_length) & 1 ) != 0 ) && ( (_length) <= EMBEDD_FILTER_MEDIAN_MAX_LENGTH ),\
+                  #var " length must be odd and up to EMBEDD_FILTER_MEDIAN_MAX_LENGTH" );\
+  static int32_t var##_values[_length];\
+  static int32_t var##_sorted[_length];\
+  embedd_filter_stage_t var;
+
+/*!
+ *  \fn       embedd_filter_ma_init
+ *  \brief    initializes a moving average stage
+ *
+ *  \param    stage    pointer to the stage
+ *  \param    values   storage for length values, var##_values of @EMBEDD_FILTER_MA_DEFINE
+ *  \param    length   number of values averaged, a power of two up to @EMBEDD_FILTER_MA_MAX_LENGTH
+ *
+ *  \result   EMBEDD_RESULT_OK on success, EMBEDD_RESULT_ERR for invalid arguments
+ */
+EMBEDD_RESULT embedd_filter_ma_init( embedd_filter_stage_t *stage, int32_t *values, uint32_t length );
+
+/*!
+ *  \fn       embedd_filter_iir_init
+ *  \brief    initializes a single-pole low pass stage
+ *
+ *  The time constant is about 2^shift values, e.g. a shift of 3 settles to
+ *  63 % within 8 values.
+ *
+ *  \param    stage    pointer to the stage
+ *  \param    shift    1 to 16
+ *
+ *  \result   EMBEDD_RESULT_OK on success, EMBEDD_RESULT_ERR for invalid arguments
+ */
+EMBEDD_RESULT embedd_filter_iir_init( embedd_filter_stage_t *stage, uint8_t shift );
+
+/*!
+ *  \fn       embedd_filter_median_init
+ *  \brief    initializes a median stage
+ *
+ *  \param    stage    pointer to the stage
+ *  \param    values   storage for length values, var##_values of @EMBEDD_FILTER_MEDIAN_DEFINE
+ *  \param    sorted   storage for length values, var##_sorted of @EMBEDD_FILTER_MEDIAN_DEFINE
+ *  \param    length   odd number of values up to @EMBEDD_FILTER_MEDIAN_MAX_LENGTH
+ *
+ *  \result   EMBEDD_RESULT_OK on success, EMBEDD_RESULT_ERR for invalid arguments
+ */
+EMBEDD_RESULT embedd_filter_median_init( embedd_filter_stage_t *stage, int32_t *values, int32_t *sorted, uint32_t length );
+
+/*!
+ *  \fn       embedd_filter_cic_init
+ *  \brief    initializes a decimating cascaded integrator-comb stage
+ *
+ *  The gain decimation^order is divided out, a shift when the decimation is
+ *  a power of two. The integrators wrap around modulo 2^64, which is exact
+ *  as long as the input and the bit growth order * log2(decimation) fit in 63 bits,
+ *  so a growth above @EMBEDD_FILTER_CIC_MAX_GROWTH is rejected, e.g. order 4 with a
+ *  decimation above 128; log2 of a decimation other than a power of two is rounded up.
+ *
+ *  \param    stage        pointer to the stage
+ *  \param    order        number of integrator and comb pairs, 1 to @EMBEDD_FILTER_CIC_MAX_ORDER
+ *  \param    decimation   one output every decimation values, 2 to @EMBEDD_FILTER_CIC_MAX_DECIMATION
+ *
+ *  \result   EMBEDD_RESULT_OK on success, EMBEDD_RESULT_ERR for invalid arguments or too much bit growth
+ */
+EMBEDD_RESULT embedd_filter_cic_init( embedd_filter_stage_t *stage, uint8_t order, uint32_t decimation );
+
+/*!
+ *  \fn       embedd_filter_stage_reset
+ *  \brief    forgets the history of a stage, the next value primes it again
+ *
+ *  \param    stage    pointer to the stage
+ */
+void embedd_filter_stage_reset( embedd_filter_stage_t *stage );
+
+/*!
+ *  \fn       embedd_filter_stage_process
+ *  \brief    passes one value through a single stage
+ *
+ *  \param    stage    pointer to the stage
+ *  \param    in       input value
+ *  \param    out      pointer to the output value
+ *
+ *  \result   true if @out was written, false while a decimating stage collects values
+ */
+bool embedd_filter_stage_process( embedd_filter_stage_t *stage, int32_t in, int32_t *out );
+
+/*!
+ *  \fn       embedd_filter_chain_init
+ *  \brief    initializes an empty chain, which passes values through
+ *
+ *  \param    chain    pointer to the chain
+ */
+void embedd_filter_chain_init( embedd_filter_chain_t *chain );
+
+/*!
+ *  \fn       embedd_filter_chain_append
+ *  \brief    appends an initialized stage to the end of a chain
+ *
+ *  A stage belongs to one chain at a time. Stages may be appended between
+ *  values, the new stage is primed by its first value.
+ *
+ *  \param    chain    pointer to the chain
+ *  \param    stage    pointer to the stage
+ *
+ *  \result   EMBEDD_RESULT_OK on success, EMBEDD_RESULT_ERR if the stage already is in the chain
+ */
+EMBEDD_RESULT embedd_filter_chain_append( embedd_filter_chain_t *chain, embedd_filter_stage_t *stage );
+
+/*!
+ *  \fn       embedd_filter_chain_clear
+ *  \brief    removes all stages from a chain
+ *
+ *  \param    chain    pointer to the chain
+ */
+void embedd_filter_chain_clear( embedd_filter_chain_t *chain );
+
+/*!
+ *  \fn       embedd_filter_chain_reset
+ *  \brief    forgets the history of all stages of a chain
+ *
+ *  \param    chain    pointer to the chain
+ */
+void embedd_filter_chain_reset( embedd_filter_chain_t *chain );
+
+/*!
+ *  \fn       embedd_filter_chain_process
+ *  \brief    passes one value through all stages of a chain
+ *
+ *  \param    chain    pointer to the chain
+ *  \param    in       input value
+ *  \param    out      pointer to the output value
+ *
+ *  \result   true if @out was written, false while a decimating stage collects values
+ */
+bool embedd_filter_chain_process( embedd_filter_chain_t *chain, int32_t in, int32_t *out );
+
+#endif //_SRC_EMBEDD_FILTER_H
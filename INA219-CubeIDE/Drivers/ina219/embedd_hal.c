@@ -25,9 +25,122 @@
 ******************************************************************************/
 
 #include "embedd_hal.h"
+#include "embedd_device.h"
 
 
 __attribute__((weak)) void embedd_hal_sleep( uint32_t mseconds )
 {
     
 }
+
+__attribute__((weak)) void embedd_hal_sleep_us( uint32_t useconds )
+{
+    if( useconds != 0 ) {
+        embedd_hal_sleep( ( useconds + 999U ) / 1000U );
+    }
+}
+
+__attribute__((weak)) uint32_t embedd_hal_get_us( void )
+{
+    return 0;
+}
+
+__attribute__((weak)) uint32_t embedd_hal_critical_enter( void )
+{
+    return 0;
+}
+
+__attribute__((weak)) void embedd_hal_critical_exit( uint32_t state )
+{
+
+}
+
+__attribute__((weak)) bool embedd_hal_in_isr( void )
+{
+    return false;
+}
+
+EMBEDD_RESULT embedd_bus_write_read( const struct embedd_device_t* dev, const uint8_t* wr_ptr, uint32_t wr_size, uint8_t* rd_ptr, uint32_t rd_size )
+{
+    if( ( dev == NULL ) || ( dev->bus == NULL ) || ( wr_ptr == NULL ) || ( rd_ptr == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    const embedd_bus_t *bus = dev->bus;
+    if( bus->write_read != NULL ) {
+        return bus->write_read( dev, wr_ptr, wr_size, rd_ptr, rd_size );
+    }
+    if( bus->transfer != NULL ) {
+        embedd_bus_seg_t segs[2] = {
+            { .data = (uint8_t*)wr_ptr, .size = wr_size, .dir = EMBEDD_BUS_SEG_WRITE },
+            { .data = rd_ptr,           .size = rd_size, .dir = EMBEDD_BUS_SEG_READ  }
+        };
+        return bus->transfer( dev, segs, 2 );
+    }
+    if( ( bus->write == NULL ) || ( bus->read == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    if( bus->write( dev, wr_ptr, wr_size ) != EMBEDD_RESULT_OK ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    return bus->read( dev, rd_ptr, rd_size );
+}
+
+EMBEDD_RESULT embedd_bus_transfer( const struct embedd_device_t* dev, const embedd_bus_seg_t* segs, uint32_t segs_num )
+{
+    if( ( dev == NULL ) || ( dev->bus == NULL ) || ( segs == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    const embedd_bus_t *bus = dev->bus;
+    if( bus->transfer != NULL ) {
+        return bus->transfer( dev, segs, segs_num );
+    }
+    if( ( segs_num == 2 ) && ( bus->write_read != NULL ) &&
+        ( segs[0].dir == EMBEDD_BUS_SEG_WRITE ) && ( segs[1].dir == EMBEDD_BUS_SEG_READ ) ) {
+        return bus->write_read( dev, segs[0].data, segs[0].size, segs[1].data, segs[1].size );
+    }
+    for( uint32_t i = 0; i < segs_num; i++ ) {
+        EMBEDD_RESULT result = EMBEDD_RESULT_ERR;
+        if( ( segs[i].dir == EMBEDD_BUS_SEG_WRITE ) && ( bus->write != NULL ) ) {
+            result = bus->write( dev, segs[i].data, segs[i].size );
+        } else if( ( segs[i].dir == EMBEDD_BUS_SEG_READ ) && ( bus->read != NULL ) ) {
+            result = bus->read( dev, segs[i].data, segs[i].size );
+        }
+        if( result != EMBEDD_RESULT_OK ) {
+            return result;
+        }
+    }
+    return EMBEDD_RESULT_OK;
+}
+
+void embedd_hal_deadline_arm( embedd_hal_deadline_t *deadline, uint32_t useconds )
+{
+    if( deadline == NULL ) {
+        return;
+    }
+    if( useconds == 0 ) {
+        deadline->armed = 0;
+        return;
+    }
+    deadline->ready_at = embedd_hal_get_us() + useconds;
+    deadline->armed = 1;
+}
+
+bool embedd_hal_deadline_expired( const embedd_hal_deadline_t *deadline )
+{
+    if( ( deadline == NULL ) || ( deadline->armed == 0 ) ) {
+        return true;
+    }
+    return (int32_t)( embedd_hal_get_us() - deadline->ready_at ) >= 0;
+}
+
+void embedd_hal_deadline_wait( embedd_hal_deadline_t *deadline )
+{
+    if( ( deadline == NULL ) || ( deadline->armed == 0 ) ) {
+        return;
+    }
+    int32_t remaining = (int32_t)( deadline->ready_at - embedd_hal_get_us() );
+    if( remaining > 0 ) {
+        embedd_hal_sleep_us( (uint32_t)remaining );
+    }
+    deadline->armed = 0;
+}
@@ -29,6 +29,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 #include "embedd_error.h"
 
 struct embedd_device_t;
@@ -55,18 +56,123 @@ typedef struct {
     void *configs;
 } embedd_bus_dev_cfg_t;
 
+/*!
+ *  \typedef    embedd_bus_done_t
+ *  \brief      completion callback of an asynchronous bus transfer
+ *
+ *  \param      ctx       context pointer passed when the transfer was started
+ *  \param      result    EMBEDD_RESULT_OK if the transfer succeeded
+ */
+typedef void (*embedd_bus_done_t)(void *ctx, EMBEDD_RESULT result);
+
+/*!
+ *  \typedef    embedd_bus_seg_dir_t
+ *  \brief      direction of a segment of a combined bus transfer
+ */
+typedef enum {
+    EMBEDD_BUS_SEG_WRITE = 0,
+    EMBEDD_BUS_SEG_READ
+} embedd_bus_seg_dir_t;
+
+/*!
+ *  \struct     embedd_bus_seg_t
+ *  \brief      one segment of a combined bus transfer
+ *
+ *  \param      data     pointer to the data to write or to the read buffer
+ *  \param      size     size of the segment in bytes
+ *  \param      dir      @embedd_bus_seg_dir_t direction of the segment
+ */
+typedef struct {
+    uint8_t *data;
+    uint32_t size;
+    uint8_t  dir;
+} embedd_bus_seg_t;
+
 /*!
  *  \struct     embedd_bus_t
  *  \brief      bus structure
  *
- *  \param      write     pointer to bus write function
- *  \param      read      pointer to bus read function
+ *  The asynchronous functions are optional and may be left NULL. When one of
+ *  them returns EMBEDD_RESULT_OK the transfer has been started and @done will
+ *  be called exactly once, usually from interrupt context, when it finishes.
+ *  When it returns an error @done is not called.
+ *
+ *  The combined functions are optional too. They run all of their segments as
+ *  a single bus transaction (a repeated START between segments on I2C), so no
+ *  other transfer can get in between. Use @embedd_bus_write_read and
+ *  @embedd_bus_transfer to fall back to separate transfers when they are NULL.
+ *  @write_read_async is the non-blocking @write_read, with the completion rules
+ *  of the other asynchronous functions.
+ *
+ *  @abort is optional as well. It stops the asynchronous transfer in progress
+ *  on the device's bus, if any, and must not be called from interrupt context.
+ *  Once it returned EMBEDD_RESULT_OK the @done callback of that transfer is
+ *  not called any more and its buffers are no longer accessed.
+ *
+ *  \param      write          pointer to bus write function
+ *  \param      read           pointer to bus read function
+ *  \param      write_async    pointer to function starting a non-blocking bus write
+ *  \param      read_async     pointer to function starting a non-blocking bus read
+ *  \param      write_read     pointer to function writing and then reading in one transaction
+ *  \param      transfer       pointer to function running an array of segments in one transaction
+ *  \param      write_read_async pointer to function starting a non-blocking write and read in one transaction
+ *  \param      abort          pointer to function stopping the asynchronous transfer in progress
  */
 typedef struct embedd_bus_t {
     EMBEDD_RESULT (*write)(const struct embedd_device_t* dev, const uint8_t* data_ptr, uint32_t data_size);
     EMBEDD_RESULT (*read) (const struct embedd_device_t* dev, uint8_t* data_ptr, uint32_t data_size);
+    EMBEDD_RESULT (*write_async)(const struct embedd_device_t* dev, const uint8_t* data_ptr, uint32_t data_size, embedd_bus_done_t done, void *ctx);
+    EMBEDD_RESULT (*read_async) (const struct embedd_device_t* dev, uint8_t* data_ptr, uint32_t data_size, embedd_bus_done_t done, void *ctx);
+    EMBEDD_RESULT (*write_read)(const struct embedd_device_t* dev, const uint8_t* wr_ptr, uint32_t wr_size, uint8_t* rd_ptr, uint32_t rd_size);
+    EMBEDD_RESULT (*transfer)  (const struct embedd_device_t* dev, const embedd_bus_seg_t* segs, uint32_t segs_num);
+    EMBEDD_RESULT (*write_read_async)(const struct embedd_device_t* dev, const uint8_t* wr_ptr, uint32_t wr_size, uint8_t* rd_ptr, uint32_t rd_size, embedd_bus_done_t done, void *ctx);
+    EMBEDD_RESULT (*abort)(const struct embedd_device_t* dev);
 } embedd_bus_t;
 
+/*!
+ *  \struct     embedd_hal_deadline_t
+ *  \brief      "ready-at" point in time used to postpone a wait instead of spinning
+ *
+ *  \param      ready_at     value of @embedd_hal_get_us at which the deadline expires
+ *  \param      armed        non-zero while the deadline is pending
+ */
+typedef struct {
+    uint32_t ready_at;
+    uint8_t  armed;
+} embedd_hal_deadline_t;
+
+/*!
+ *  \fn       embedd_bus_write_read
+ *  \brief    writes and then reads a device in one transaction if the bus can do it
+ *
+ *  Uses the bus @write_read function, a two segment @transfer, or a @write
+ *  followed by a @read, whichever is available first.
+ *
+ *  \param    dev      pointer to the device
+ *  \param    wr_ptr   pointer to the data to write
+ *  \param    wr_size  size of the data to write
+ *  \param    rd_ptr   pointer to the read buffer
+ *  \param    rd_size  size of the data to read
+ *
+ *  \result   EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT embedd_bus_write_read( const struct embedd_device_t* dev, const uint8_t* wr_ptr, uint32_t wr_size, uint8_t* rd_ptr, uint32_t rd_size );
+
+/*!
+ *  \fn       embedd_bus_transfer
+ *  \brief    runs an array of segments in one transaction if the bus can do it
+ *
+ *  Uses the bus @transfer function, @write_read for a write followed by a
+ *  read, or separate @write and @read calls, whichever is available first.
+ *
+ *  \param    dev       pointer to the device
+ *  \param    segs      pointer to the array of segments
+ *  \param    segs_num  number of segments
+ *
+ *  \result   EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT embedd_bus_transfer( const struct embedd_device_t* dev, const embedd_bus_seg_t* segs, uint32_t segs_num );
+
 /*!
  *  \fn       embedd_hal_sleep
  *  \brief    read data to bus device
@@ -75,4 +181,86 @@ typedef struct embedd_bus_t {
  */
 void embedd_hal_sleep( uint32_t mseconds );
 
+/*!
+ *  \fn       embedd_hal_sleep_us
+ *  \brief    blocking delay with microsecond resolution
+ *
+ *  The default implementation rounds the delay up to whole milliseconds and
+ *  calls @embedd_hal_sleep, so ports only need to override it when a
+ *  microsecond time base is available.
+ *
+ *  \param    useconds  time in us of sleep
+ */
+void embedd_hal_sleep_us( uint32_t useconds );
+
+/*!
+ *  \fn       embedd_hal_get_us
+ *  \brief    returns a free-running microsecond counter
+ *
+ *  The counter wraps at 2^32 us, so timestamps must only be compared through
+ *  their difference. The default implementation always returns 0.
+ *
+ *  \result   current time in us
+ */
+uint32_t embedd_hal_get_us( void );
+
+/*!
+ *  \fn       embedd_hal_deadline_arm
+ *  \brief    arms a deadline @useconds from now
+ *
+ *  A zero delay leaves the deadline disarmed, so no time base is read at all.
+ *
+ *  \param    deadline  pointer to the deadline
+ *  \param    useconds  time in us until the deadline expires
+ */
+void embedd_hal_deadline_arm( embedd_hal_deadline_t *deadline, uint32_t useconds );
+
+/*!
+ *  \fn       embedd_hal_deadline_expired
+ *  \brief    checks a deadline without blocking
+ *
+ *  \param    deadline  pointer to the deadline
+ *
+ *  \result   true if the deadline is disarmed or has passed
+ */
+bool embedd_hal_deadline_expired( const embedd_hal_deadline_t *deadline );
+
+/*!
+ *  \fn       embedd_hal_deadline_wait
+ *  \brief    blocks until the deadline has passed and disarms it
+ *
+ *  \param    deadline  pointer to the deadline
+ */
+void embedd_hal_deadline_wait( embedd_hal_deadline_t *deadline );
+
+/*!
+ *  \fn       embedd_hal_critical_enter
+ *  \brief    enters a section which must not be interrupted by bus completion callbacks
+ *
+ *  The default implementation does nothing, which is only safe when no
+ *  asynchronous bus functions are used.
+ *
+ *  \result   state to be passed to @embedd_hal_critical_exit
+ */
+uint32_t embedd_hal_critical_enter( void );
+
+/*!
+ *  \fn       embedd_hal_critical_exit
+ *  \brief    leaves a section entered with @embedd_hal_critical_enter
+ *
+ *  \param    state  value returned by the matching @embedd_hal_critical_enter
+ */
+void embedd_hal_critical_exit( uint32_t state );
+
+/*!
+ *  \fn       embedd_hal_in_isr
+ *  \brief    checks if the caller cannot be interrupted by bus completion callbacks
+ *
+ *  True in interrupt context and with interrupts masked, where waiting for an
+ *  asynchronous transfer would never end. The default implementation returns false.
+ *
+ *  \result   true if blocking on a transfer would deadlock
+ */
+bool embedd_hal_in_isr( void );
+
 #endif //_SRC_EMBEDD_HAL_H
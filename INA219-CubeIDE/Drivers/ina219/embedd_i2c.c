@@ -33,6 +33,7 @@ EMBEDD_RESULT embedd_i2c_set_dev_config(const struct embedd_device_t *dev, embed
         embedd_i2c_dev_cfg_t *current_cfg = embedd_i2c_get_dev_config(dev);
         if (current_cfg != NULL) {
             current_cfg->addr = config->addr;
+            current_cfg->port = config->port;
             return EMBEDD_RESULT_OK;
         }
     }
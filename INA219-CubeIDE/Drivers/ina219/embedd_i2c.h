@@ -58,9 +58,12 @@
  *  \brief    conficurations related to I2C device
  *
  *  \param    addr device's address on I2C bus
+ *  \param    port controller the device is attached to, left to the bus functions to interpret;
+ *            devices sharing a bus object on different controllers are told apart by it
  */
 typedef struct embedd_i2c_dev_cfg_t {
     uint16_t addr;
+    void *port;
 } embedd_i2c_dev_cfg_t;
 
 /*!
@@ -0,0 +1,247 @@
+/******************************************************************************
+* Company: Embedd Limited
+*
+* File: embedd_log.c
+*
+* Description: Provides a non-blocking log sink with priority levels
+*
+* Software License Agreement:
+*
+* This code is proprietary to Embedd Limited and may not be distributed
+* or copied without the express permission of Embedd Limited. This code
+* is provided "as is" without warranty of any kind, either expressed or
+* implied, including but not limited to the implied warranties of
+* merchantability and fitness for a particular purpose. This code is intended
+* for use only within the user's organization by its employees and authorized
+* agents, and may not be disclosed or used for any other purpose without
+* prior written consent from Embedd Limited.
+*
+* Unauthorized distribution or use of this code, or any portion of it,
+* including but not limited to publishing online or making it open source,
+* may result in severe civil and criminal penalties, and will be prosecuted to
+* the maximum extent possible under the law.
+*
+* ©️ 2024 Embedd Limited. All Rights Reserved.
+******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "embedd_log.h"
+
+// head only changes in a critical section, the drain reads it with acquire
+// ordering so the text of a line is complete before it is sent
+#define EMBEDD_LOG_LOAD(p)      __atomic_load_n( (p), __ATOMIC_ACQUIRE )
+#define EMBEDD_LOG_STORE(p, v)  __atomic_store_n( (p), (v), __ATOMIC_RELEASE )
+
+static const char embedd_log_cut[] = "...\r\n";
+
+EMBEDD_RESULT embedd_log_init( embedd_log_t *log, const embedd_log_port_t *port )
+{
+    if( ( log == NULL ) || ( port == NULL ) || ( port->send == NULL ) || ( port->busy == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    for( uint32_t level = 0; level < EMBEDD_LOG_LEVELS; level++ ) {
+        embedd_log_ring_t *ring = &log->ring[level];
+        if( ring->buf == NULL ) {
+            return EMBEDD_RESULT_ERR;
+        }
+        uint8_t *buf  = ring->buf;
+        uint32_t mask = ring->mask;
+        *ring = (embedd_log_ring_t){ .buf = buf, .mask = mask };
+    }
+    log->port          = port;
+    log->sending       = 0;
+    log->sending_level = 0;
+    return EMBEDD_RESULT_OK;
+}
+
+static EMBEDD_RESULT embedd_log_put( embedd_log_t *log, embedd_log_level_t level, const uint8_t *data, uint32_t size, bool truncated )
+{
+    if( ( log == NULL ) || ( (uint32_t)level >= EMBEDD_LOG_LEVELS ) || ( ( data == NULL ) && ( size != 0 ) ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    embedd_log_ring_t *ring = &log->ring[level];
+    uint32_t state = embedd_hal_critical_enter();
+    uint32_t head  = ring->head;
+    uint32_t held  = head - EMBEDD_LOG_LOAD( &ring->tail );
+    if( size > ring->mask + 1U - held ) {
+        ring->dropped++;
+        ring->dropped_bytes += size;
+        embedd_hal_critical_exit( state );
+        return EMBEDD_RESULT_ERR;
+    }
+    uint32_t offset = head & ring->mask;
+    uint32_t first  = ring->mask + 1U - offset;
+    if( first >= size ) {
+        memcpy( ring->buf + offset, data, size );
+    } else {
+        memcpy( ring->buf + offset, data, first );
+        memcpy( ring->buf, data + first, size - first );
+    }
+    EMBEDD_LOG_STORE( &ring->head, head + size );
+    ring->lines++;
+    if( truncated ) {
+        ring->truncated++;
+    }
+    if( held + size > ring->high_water ) {
+        ring->high_water = held + size;
+    }
+    embedd_hal_critical_exit( state );
+    return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT embedd_log_write( embedd_log_t *log, embedd_log_level_t level, const void *data, uint32_t size )
+{
+    return embedd_log_put( log, level, (const uint8_t*)data, size, false );
+}
+
+EMBEDD_RESULT embedd_log_vprintf( embedd_log_t *log, embedd_log_level_t level, const char *format, va_list args )
+{
+    char line[EMBEDD_LOG_LINE_MAX];
+    if( format == NULL ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    int size = vsnprintf( line, sizeof(line), format, args );
+    if( size < 0 ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    bool truncated = ( size >= (int)sizeof(line) );
+    if( truncated ) {
+        // a cut line still ends the line
+        size = sizeof(line) - 1;
+        memcpy( line + size - ( sizeof(embedd_log_cut) - 1U ), embedd_log_cut, sizeof(embedd_log_cut) - 1U );
+    }
+    return embedd_log_put( log, level, (const uint8_t*)line, (uint32_t)size, truncated );
+}
+
+EMBEDD_RESULT embedd_log_printf( embedd_log_t *log, embedd_log_level_t level, const char *format, ... )
+{
+    va_list args;
+    va_start( args, format );
+    EMBEDD_RESULT result = embedd_log_vprintf( log, level, format, args );
+    va_end( args );
+    return result;
+}
+
+// COBS encoding while the message is built, no message reaches 254 bytes
+typedef struct {
+    uint8_t *buf;
+    uint32_t out;
+    uint32_t code_at;
+} embedd_log_cobs_t;
+
+static inline void embedd_log_cobs_put( embedd_log_cobs_t *cobs, uint8_t byte )
+{
+    if( byte == 0 ) {
+        cobs->buf[cobs->code_at] = (uint8_t)( cobs->out - cobs->code_at );
+        cobs->code_at = cobs->out++;
+    } else {
+        cobs->buf[cobs->out++] = byte;
+    }
+}
+
+static inline void embedd_log_cobs_varint( embedd_log_cobs_t *cobs, uint32_t value )
+{
+    while( value >= 0x80U ) {
+        embedd_log_cobs_put( cobs, (uint8_t)( value | 0x80U ) );
+        value >>= 7;
+    }
+    embedd_log_cobs_put( cobs, (uint8_t)value );
+}
+
+EMBEDD_RESULT embedd_log_token( embedd_log_t *log, embedd_log_level_t level, uint32_t id, uint32_t argc, const uint32_t *argv )
+{
+    // code byte, 5 bytes for each varint, delimiter
+    uint8_t buf[1U + 5U * ( 1U + EMBEDD_LOG_TOKEN_ARGS_MAX ) + 1U];
+    if( ( (uint32_t)level >= EMBEDD_LOG_LEVELS ) || ( argc > EMBEDD_LOG_TOKEN_ARGS_MAX ) || ( ( argv == NULL ) && ( argc != 0 ) ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    embedd_log_cobs_t cobs = { .buf = buf, .out = 1, .code_at = 0 };
+    embedd_log_cobs_varint( &cobs, ( id << 2 ) | (uint32_t)level );
+    for( uint32_t i = 0; i < argc; i++ ) {
+        // zigzag keeps small negative numbers short, the host knows the signedness from the format
+        embedd_log_cobs_varint( &cobs, ( argv[i] << 1 ) ^ (uint32_t)( (int32_t)argv[i] >> 31 ) );
+    }
+    // ends the last block, its code byte slot becomes the delimiter
+    embedd_log_cobs_put( &cobs, 0 );
+    buf[cobs.code_at] = 0;
+    return embedd_log_put( log, level, buf, cobs.out, false );
+}
+
+void embedd_log_process( embedd_log_t *log )
+{
+    if( ( log == NULL ) || ( log->port == NULL ) ) {
+        return;
+    }
+    const embedd_log_port_t *port = log->port;
+    if( log->sending != 0 ) {
+        if( port->busy( port->ctx ) ) {
+            return;
+        }
+        // the port is done with the chunk, its space is free again
+        embedd_log_ring_t *ring = &log->ring[log->sending_level];
+        EMBEDD_LOG_STORE( &ring->tail, ring->tail + log->sending );
+        log->sending = 0;
+    }
+    for( uint32_t level = 0; level < EMBEDD_LOG_LEVELS; level++ ) {
+        embedd_log_ring_t *ring = &log->ring[level];
+        uint32_t tail = ring->tail;
+        uint32_t held = EMBEDD_LOG_LOAD( &ring->head ) - tail;
+        if( held == 0 ) {
+            continue;
+        }
+        // one contiguous piece, the rest follows from the start of the ring
+        uint32_t offset = tail & ring->mask;
+        uint32_t size   = ring->mask + 1U - offset;
+        if( size > held ) {
+            size = held;
+        }
+        if( ( port->max_chunk != 0 ) && ( size > port->max_chunk ) ) {
+            size = port->max_chunk;
+        }
+        uint32_t taken = port->send( port->ctx, ring->buf + offset, size );
+        if( taken != 0 ) {
+            log->sending       = ( taken < size ) ? taken : size;
+            log->sending_level = (uint8_t)level;
+        }
+        // a lower level never goes ahead of a higher one
+        return;
+    }
+}
+
+uint32_t embedd_log_pending( const embedd_log_t *log )
+{
+    if( log == NULL ) {
+        return 0;
+    }
+    uint32_t pending = 0;
+    for( uint32_t level = 0; level < EMBEDD_LOG_LEVELS; level++ ) {
+        pending += EMBEDD_LOG_LOAD( &log->ring[level].head ) - log->ring[level].tail;
+    }
+    return pending;
+}
+
+void embedd_log_get_stats( embedd_log_t *log, embedd_log_level_t level, embedd_log_stats_t *stats, bool reset )
+{
+    if( ( log == NULL ) || ( (uint32_t)level >= EMBEDD_LOG_LEVELS ) || ( stats == NULL ) ) {
+        return;
+    }
+    embedd_log_ring_t *ring = &log->ring[level];
+    uint32_t state = embedd_hal_critical_enter();
+    stats->capacity      = ring->mask + 1U;
+    stats->pending       = ring->head - ring->tail;
+    stats->high_water    = ring->high_water;
+    stats->lines         = ring->lines;
+    stats->dropped       = ring->dropped;
+    stats->dropped_bytes = ring->dropped_bytes;
+    stats->truncated     = ring->truncated;
+    if( reset ) {
+        ring->high_water    = stats->pending;
+        ring->lines         = 0;
+        ring->dropped       = 0;
+        ring->dropped_bytes = 0;
+        ring->truncated     = 0;
+    }
+    embedd_hal_critical_exit( state );
+}
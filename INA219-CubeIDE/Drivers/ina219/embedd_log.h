@@ -0,0 +1,341 @@
+/******************************************************************************
+* Company: Embedd Limited
+*
+* File: embedd_log.h
+*
+* Description: Provides a non-blocking log sink with priority levels
+*
+* Software License Agreement:
+*
+* This code is proprietary to Embedd Limited and may not be distributed
+* or copied without the express permission of Embedd Limited. This code
+* is provided "as is" without warranty of any kind, either expressed or
+* implied, including but not limited to the implied warranties of
+* merchantability and fitness for a particular purpose. This code is intended
+* for use only within the user's organization by its employees and authorized
+* agents, and may not be disclosed or used for any other purpose without
+* prior written consent from Embedd Limited.
+*
+* Unauthorized distribution or use of this code, or any portion of it,
+* including but not limited to publishing online or making it open source,
+* may result in severe civil and criminal penalties, and will be prosecuted to
+* the maximum extent possible under the law.
+*
+* ©️ 2024 Embedd Limited. All Rights Reserved.
+******************************************************************************/
+
+#ifndef _SRC_EMBEDD_LOG_H
+#define _SRC_EMBEDD_LOG_H
+
+#include <stdarg.h>
+
+#include "embedd_hal.h"
+
+/*
+ * Writers copy whole lines into the ring of their level and return at once;
+ * a line that does not fit is dropped and counted, never split. The drain,
+ * @embedd_log_process, hands the port one chunk at a time straight out of
+ * the ring, always from the highest level holding text. The chunk stays in
+ * the ring until the port is done with it, so a DMA transfer reads it in
+ * place. max_chunk bounds the time another user of the port, e.g. a
+ * telemetry frame, waits for the log.
+ */
+
+/*!
+ *  \def        EMBEDD_LOG_LINE_MAX
+ *  \brief      longest line formatted by @embedd_log_printf including the terminating zero,
+ *              longer lines are cut and end with "...\r\n"
+ */
+#define EMBEDD_LOG_LINE_MAX     160U
+
+/*
+ * Tokenized mode: the format strings stay in the ELF file in the section
+ * embedd_tlog and only their offset in it is sent, with the arguments as
+ * varints. tools/tlog_decode.py rebuilds the text from the ELF file, so no
+ * printf code runs on the device. A message is
+ *
+ *   varint( offset << 2 | level ) | varint( zigzag( argument ) ) ...
+ *
+ * COBS encoded and terminated by a 0x00 byte. Arguments are integers, chars
+ * or pointers of up to 32 bits; %s is looked up in the ELF file, so strings
+ * have to be constant. The section is left out of the image by this entry
+ * in the SECTIONS of the linker script, without it the strings end up in
+ * flash but are decoded all the same:
+ *
+ *   embedd_tlog 0 (INFO) :
+ *   {
+ *     KEEP(*(embedd_tlog))
+ *   }
+ */
+
+/*!
+ *  \def        EMBEDD_LOG_TOKENIZED
+ *  \brief      non-zero to make @EMBEDD_LOG send tokens instead of formatted text
+ */
+#ifndef EMBEDD_LOG_TOKENIZED
+#define EMBEDD_LOG_TOKENIZED    0
+#endif
+
+/*!
+ *  \def        EMBEDD_LOG_TOKEN_ARGS_MAX
+ *  \brief      most arguments of a tokenized message
+ */
+#define EMBEDD_LOG_TOKEN_ARGS_MAX  12U
+
+typedef enum {
+    EMBEDD_LOG_ERROR = 0,       //!< sent first
+    EMBEDD_LOG_INFO,
+    EMBEDD_LOG_DEBUG,           //!< sent when nothing else waits, dropped first
+    EMBEDD_LOG_LEVELS
+} embedd_log_level_t;
+
+/*!
+ *  \struct     embedd_log_port_t
+ *  \brief      output of the log
+ *
+ *  \param      send       starts sending a chunk which stays untouched until busy returns false,
+ *                         returns the number of bytes taken, 0 if the port is not available
+ *  \param      busy       returns true while a chunk is being sent
+ *  \param      max_chunk  largest chunk passed to send, 0 for no limit
+ *  \param      ctx        passed to the functions
+ */
+typedef struct {
+    uint32_t (*send)( void *ctx, const uint8_t *data, uint32_t size );
+    bool (*busy)( void *ctx );
+    uint32_t max_chunk;
+    void *ctx;
+} embedd_log_port_t;
+
+/*!
+ *  \struct     embedd_log_ring_t
+ *  \brief      text of one level, private
+ *
+ *  \param      buf         storage, mask + 1 bytes
+ *  \param      mask        capacity - 1, the capacity is a power of two
+ *  \param      head        bytes written, changed in a critical section
+ *  \param      tail        bytes sent, written by the drain only
+ *  \param      lines       lines written
+ *  \param      dropped     lines dropped because the ring was full
+ *  \param      dropped_bytes  bytes of those lines
+ *  \param      truncated   lines cut to @EMBEDD_LOG_LINE_MAX
+ *  \param      high_water  most bytes held
+ */
+typedef struct {
+    uint8_t *buf;
+    uint32_t mask;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t lines;
+    uint32_t dropped;
+    uint32_t dropped_bytes;
+    uint32_t truncated;
+    uint32_t high_water;
+} embedd_log_ring_t;
+
+/*!
+ *  \struct     embedd_log_stats_t
+ *  \brief      statistics of one level
+ *
+ *  \param      capacity       size of the ring in bytes
+ *  \param      pending        bytes waiting or being sent
+ *  \param      high_water     most bytes held
+ *  \param      lines          lines written
+ *  \param      dropped        lines dropped because the ring was full
+ *  \param      dropped_bytes  bytes of those lines
+ *  \param      truncated      lines cut to @EMBEDD_LOG_LINE_MAX
+ */
+typedef struct {
+    uint32_t capacity;
+    uint32_t pending;
+    uint32_t high_water;
+    uint32_t lines;
+    uint32_t dropped;
+    uint32_t dropped_bytes;
+    uint32_t truncated;
+} embedd_log_stats_t;
+
+/*!
+ *  \struct     embedd_log_t
+ *  \brief      log sink, create it with @EMBEDD_LOG_DEFINE
+ *
+ *  \param      ring         text of each level, private
+ *  \param      port         output
+ *  \param      sending      bytes of the chunk being sent, 0 if none, private
+ *  \param      sending_level  level the chunk belongs to, private
+ */
+typedef struct {
+    embedd_log_ring_t ring[EMBEDD_LOG_LEVELS];
+    const embedd_log_port_t *port;
+    uint32_t sending;
+    uint8_t  sending_level;
+} embedd_log_t;
+
+/*!
+ *  \macro  EMBEDD_LOG_DEFINE
+ *  \brief  creates a log sink with static rings
+ *
+ *  \param  var           name of the sink's variable
+ *  \param  _error_size   bytes of @EMBEDD_LOG_ERROR text, a power of two
+ *  \param  _info_size    bytes of @EMBEDD_LOG_INFO text, a power of two
+ *  \param  _debug_size   bytes of @EMBEDD_LOG_DEBUG text, a power of two
+ */
+#define EMBEDD_LOG_DEFINE(var, _error_size, _info_size, _debug_size)\
+  _Static_assert( ( (_error_size) != 0 ) && ( ( (_error_size) & ( (_error_size) - 1 ) ) == 0 ), #var " error size must be a power of two" );\
+  _Static_assert( ( (_info_size) != 0 ) && ( ( (_info_size) & ( (_info_size) - 1 ) ) == 0 ), #var " info size must be a power of two" );\
+  _Static_assert( ( (_debug_size) != 0 ) && ( ( (_debug_size) & ( (_debug_size) - 1 ) ) == 0 ), #var " debug size must be a power of two" );\
+  static uint8_t var##_error[_error_size];\
+  static uint8_t var##_info[_info_size];\
+  static uint8_t var##_debug[_debug_size];\
+  embedd_log_t var = { .ring = { { .buf = var##_error, .mask = (_error_size) - 1U },\
+                                 { .buf = var##_info, .mask = (_info_size) - 1U },\
+                                 { .buf = var##_debug, .mask = (_debug_size) - 1U } } };
+
+/*!
+ *  \fn       embedd_log_init
+ *  \brief    initializes a sink, discarding any text held
+ *
+ *  \param    log      pointer to the sink
+ *  \param    port     pointer to the output, kept
+ *
+ *  \result   EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT embedd_log_init( embedd_log_t *log, const embedd_log_port_t *port );
+
+/*!
+ *  \fn       embedd_log_write
+ *  \brief    copies a line into the ring of its level, from any context
+ *
+ *  The copy runs in a critical section, so interrupts may log too.
+ *
+ *  \param    log      pointer to the sink
+ *  \param    level    EMBEDD_LOG_*
+ *  \param    data     pointer to the text
+ *  \param    size     number of bytes
+ *
+ *  \result   EMBEDD_RESULT_OK if the line was taken, EMBEDD_RESULT_ERR if it was dropped
+ */
+EMBEDD_RESULT embedd_log_write( embedd_log_t *log, embedd_log_level_t level, const void *data, uint32_t size );
+
+/*!
+ *  \fn       embedd_log_printf
+ *  \brief    formats a line on the stack and writes it, see @embedd_log_write
+ *
+ *  \param    log      pointer to the sink
+ *  \param    level    EMBEDD_LOG_*
+ *  \param    format   printf format
+ *
+ *  \result   EMBEDD_RESULT_OK if the line was taken, EMBEDD_RESULT_ERR if it was dropped
+ */
+EMBEDD_RESULT embedd_log_printf( embedd_log_t *log, embedd_log_level_t level, const char *format, ... ) __attribute__ ((format (printf, 3, 4)));
+
+/*!
+ *  \fn       embedd_log_vprintf
+ *  \brief    @embedd_log_printf with a va_list
+ */
+EMBEDD_RESULT embedd_log_vprintf( embedd_log_t *log, embedd_log_level_t level, const char *format, va_list args );
+
+/*!
+ *  \fn       embedd_log_token
+ *  \brief    writes a tokenized message, see @embedd_log_write; use @EMBEDD_LOG_TOKEN
+ *
+ *  \param    log      pointer to the sink
+ *  \param    level    EMBEDD_LOG_*
+ *  \param    id       offset of the format string in the section embedd_tlog
+ *  \param    argc     number of arguments, at most @EMBEDD_LOG_TOKEN_ARGS_MAX
+ *  \param    argv     pointer to the arguments
+ *
+ *  \result   EMBEDD_RESULT_OK if the message was taken, EMBEDD_RESULT_ERR if it was dropped
+ */
+EMBEDD_RESULT embedd_log_token( embedd_log_t *log, embedd_log_level_t level, uint32_t id, uint32_t argc, const uint32_t *argv );
+
+static inline void embedd_log_format_check( const char *format, ... ) __attribute__ ((format (printf, 1, 2)));
+static inline void embedd_log_format_check( const char *format, ... )
+{
+    (void)format;
+}
+
+// argument conversion of EMBEDD_LOG_TOKEN, an argument wider than 32 bits does not compile
+#define EMBEDD_LOG_ARG(x)           ( (void)sizeof(char[( sizeof(x) <= 4U ) ? 1 : -1]), (uint32_t)(uintptr_t)(x) )
+#define EMBEDD_LOG_NARGS(...)       EMBEDD_LOG_NARGS_(0, ##__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define EMBEDD_LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, n, ...)  n
+#define EMBEDD_LOG_CAT(a, b)        EMBEDD_LOG_CAT_(a, b)
+#define EMBEDD_LOG_CAT_(a, b)       a##b
+#define EMBEDD_LOG_ARGS(...)        EMBEDD_LOG_CAT(EMBEDD_LOG_ARGS_, EMBEDD_LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+#define EMBEDD_LOG_ARGS_0()
+#define EMBEDD_LOG_ARGS_1(a)        , EMBEDD_LOG_ARG(a)
+#define EMBEDD_LOG_ARGS_2(a, ...)   , EMBEDD_LOG_ARG(a) EMBEDD_LOG_ARGS_1(__VA_ARGS__)
+#define EMBEDD_LOG_ARGS_3(a, ...)   , EMBEDD_LOG_ARG(a) EMBEDD_LOG_ARGS_2(__VA_ARGS__)
+#define EMBEDD_LOG_ARGS_4(a, ...)   , EMBEDD_LOG_ARG(a) EMBEDD_LOG_ARGS_3(__VA_ARGS__)
+#define EMBEDD_LOG_ARGS_5(a, ...)   , EMBEDD_LOG_ARG(a) EMBEDD_LOG_ARGS_4(__VA_ARGS__)
+#define EMBEDD_LOG_ARGS_6(a, ...)   , EMBEDD_LOG_ARG(a) EMBEDD_LOG_ARGS_5(__VA_ARGS__)
+#define EMBEDD_LOG_ARGS_7(a, ...)   , EMBEDD_LOG_ARG(a) EMBEDD_LOG_ARGS_6(__VA_ARGS__)
+#define EMBEDD_LOG_ARGS_8(a, ...)   , EMBEDD_LOG_ARG(a) EMBEDD_LOG_ARGS_7(__VA_ARGS__)
+#define EMBEDD_LOG_ARGS_9(a, ...)   , EMBEDD_LOG_ARG(a) EMBEDD_LOG_ARGS_8(__VA_ARGS__)
+#define EMBEDD_LOG_ARGS_10(a, ...)  , EMBEDD_LOG_ARG(a) EMBEDD_LOG_ARGS_9(__VA_ARGS__)
+#define EMBEDD_LOG_ARGS_11(a, ...)  , EMBEDD_LOG_ARG(a) EMBEDD_LOG_ARGS_10(__VA_ARGS__)
+#define EMBEDD_LOG_ARGS_12(a, ...)  , EMBEDD_LOG_ARG(a) EMBEDD_LOG_ARGS_11(__VA_ARGS__)
+
+/*!
+ *  \macro  EMBEDD_LOG_TOKEN
+ *  \brief  writes a tokenized message, the format string is only kept in the ELF file
+ *
+ *  \param  log      pointer to the sink
+ *  \param  level    EMBEDD_LOG_*
+ *  \param  format   printf format, a string literal, followed by up to @EMBEDD_LOG_TOKEN_ARGS_MAX arguments
+ */
+#define EMBEDD_LOG_TOKEN(log, level, format, ...)\
+  do {\
+    static const char _embedd_log_format[] __attribute__ ((section("embedd_tlog"), used)) = format;\
+    extern const char __start_embedd_tlog[];\
+    const uint32_t _embedd_log_args[] = { 0 EMBEDD_LOG_ARGS(__VA_ARGS__) };\
+    if( 0 ) {\
+      embedd_log_format_check( format, ##__VA_ARGS__ );\
+    }\
+    embedd_log_token( (log), (level), (uint32_t)( _embedd_log_format - __start_embedd_tlog ),\
+                      EMBEDD_LOG_NARGS(__VA_ARGS__), _embedd_log_args + 1 );\
+  } while( 0 )
+
+/*!
+ *  \macro  EMBEDD_LOG
+ *  \brief  writes a message as text or as token, depending on @EMBEDD_LOG_TOKENIZED
+ *
+ *  \param  log      pointer to the sink
+ *  \param  level    EMBEDD_LOG_*
+ *  \param  ...      printf format, a string literal, and its arguments
+ */
+#if EMBEDD_LOG_TOKENIZED
+#define EMBEDD_LOG(log, level, ...)  EMBEDD_LOG_TOKEN( log, level, __VA_ARGS__ )
+#else
+#define EMBEDD_LOG(log, level, ...)  (void)embedd_log_printf( log, level, __VA_ARGS__ )
+#endif
+
+/*!
+ *  \fn       embedd_log_process
+ *  \brief    releases the chunk sent and passes the next one to the port; call it from the main loop
+ *
+ *  \param    log      pointer to the sink
+ */
+void embedd_log_process( embedd_log_t *log );
+
+/*!
+ *  \fn       embedd_log_pending
+ *  \brief    bytes waiting or being sent, over all levels
+ *
+ *  \param    log      pointer to the sink
+ *
+ *  \result   number of bytes
+ */
+uint32_t embedd_log_pending( const embedd_log_t *log );
+
+/*!
+ *  \fn       embedd_log_get_stats
+ *  \brief    reads the statistics of a level
+ *
+ *  \param    log      pointer to the sink
+ *  \param    level    EMBEDD_LOG_*
+ *  \param    stats    pointer to the statistics to fill in
+ *  \param    reset    true to reset the high-water mark to the bytes held and clear the counters
+ */
+void embedd_log_get_stats( embedd_log_t *log, embedd_log_level_t level, embedd_log_stats_t *stats, bool reset );
+
+#endif //_SRC_EMBEDD_LOG_H
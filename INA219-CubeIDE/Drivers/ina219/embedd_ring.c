@@ -0,0 +1,94 @@
+/******************************************************************************
+* Company: Embedd Limited
+*
+* File: embedd_ring.c
+*
+* Description: Provides a lock-free single-producer single-consumer record ring
+*
+* Software License Agreement:
+*
+* This code is proprietary to Embedd Limited and may not be distributed
+* or copied without the express permission of Embedd Limited. This code
+* is provided "as is" without warranty of any kind, either expressed or
+* implied, including but not limited to the implied warranties of
+* merchantability and fitness for a particular purpose. This code is intended
+* for use only within the user's organization by its employees and authorized
+* agents, and may not be disclosed or used for any other purpose without
+* prior written consent from Embedd Limited.
+*
+* Unauthorized distribution or use of this code, or any portion of it,
+* including but not limited to publishing online or making it open source,
+* may result in severe civil and criminal penalties, and will be prosecuted to
+* the maximum extent possible under the law.
+*
+* ©️ 2024 Embedd Limited. All Rights Reserved.
+******************************************************************************/
+
+#include <string.h>
+
+#include "embedd_ring.h"
+
+// The index written by the other side is read with acquire and the own index
+// is published with release ordering, so a record is complete before it is
+// seen. 32 bit loads and stores are atomic on every supported core, these
+// compile to plain accesses and barriers even on Cortex-M0+.
+#define EMBEDD_RING_LOAD(p)      __atomic_load_n( (p), __ATOMIC_ACQUIRE )
+#define EMBEDD_RING_STORE(p, v)  __atomic_store_n( (p), (v), __ATOMIC_RELEASE )
+
+EMBEDD_RESULT embedd_ring_push( embedd_ring_t *ring, const void *record )
+{
+    if( ( ring == NULL ) || ( record == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    uint32_t head  = ring->head;
+    uint32_t count = head - EMBEDD_RING_LOAD( &ring->tail );
+    if( count > ring->mask ) {
+        ring->overflows++;
+        return EMBEDD_RESULT_ERR;
+    }
+    memcpy( ring->buf + ( head & ring->mask ) * ring->record_size, record, ring->record_size );
+    EMBEDD_RING_STORE( &ring->head, head + 1U );
+    if( count + 1U > ring->high_water ) {
+        ring->high_water = count + 1U;
+    }
+    return EMBEDD_RESULT_OK;
+}
+
+bool embedd_ring_pop( embedd_ring_t *ring, void *record )
+{
+    if( ( ring == NULL ) || ( record == NULL ) ) {
+        return false;
+    }
+    uint32_t tail = ring->tail;
+    if( tail == EMBEDD_RING_LOAD( &ring->head ) ) {
+        return false;
+    }
+    memcpy( record, ring->buf + ( tail & ring->mask ) * ring->record_size, ring->record_size );
+    EMBEDD_RING_STORE( &ring->tail, tail + 1U );
+    return true;
+}
+
+uint32_t embedd_ring_count( const embedd_ring_t *ring )
+{
+    if( ring == NULL ) {
+        return 0;
+    }
+    return EMBEDD_RING_LOAD( &ring->head ) - EMBEDD_RING_LOAD( &ring->tail );
+}
+
+void embedd_ring_get_stats( embedd_ring_t *ring, embedd_ring_stats_t *stats, bool reset )
+{
+    if( ( ring == NULL ) || ( stats == NULL ) ) {
+        return;
+    }
+    uint32_t state = embedd_hal_critical_enter();
+    stats->capacity   = ring->mask + 1U;
+    stats->count      = embedd_ring_count( ring );
+    stats->high_water = ring->high_water;
+    stats->overflows  = ring->overflows;
+    if( reset ) {
+        ring->high_water = stats->count;
+        ring->overflows  = 0;
+    }
+    embedd_hal_critical_exit( state );
+}
@@ -0,0 +1,135 @@
+/******************************************************************************
+* Company: Embedd Limited
+*
+* File: embedd_ring.h
+*
+* Description: Provides a lock-free single-producer single-consumer record ring
+*
+* Software License Agreement:
+*
+* This code is proprietary to Embedd Limited and may not be distributed
+* or copied without the express permission of Embedd Limited. This code
+* is provided "as is" without warranty of any kind, either expressed or
+* implied, including but not limited to the implied warranties of
+* merchantability and fitness for a particular purpose. This code is intended
+* for use only within the user's organization by its employees and authorized
+* agents, and may not be disclosed or used for any other purpose without
+* prior written consent from Embedd Limited.
+*
+* Unauthorized distribution or use of this code, or any portion of it,
+* including but not limited to publishing online or making it open source,
+* may result in severe civil and criminal penalties, and will be prosecuted to
+* the maximum extent possible under the law.
+*
+* ©️ 2024 Embedd Limited. All Rights Reserved.
+******************************************************************************/
+
+#ifndef _SRC_EMBEDD_RING_H
+#define _SRC_EMBEDD_RING_H
+
+#include "embedd_hal.h"
+
+/*!
+ *  \struct     embedd_ring_t
+ *  \brief      ring of fixed-size records between one producer and one consumer
+ *
+ *  One context pushes, e.g. an interrupt or a DMA completion, and one context
+ *  pops, e.g. the main loop; neither blocks the other and no critical section
+ *  is needed. The indices run freely and are masked on access, so all
+ *  capacity records are usable. Create rings with @EMBEDD_RING_DEFINE.
+ *
+ *  \param      buf         record storage, capacity * record_size bytes
+ *  \param      record_size size of one record in bytes
+ *  \param      mask        capacity - 1, the capacity is a power of two
+ *  \param      head        records pushed, written by the producer only
+ *  \param      tail        records popped, written by the consumer only
+ *  \param      high_water  highest number of records held, written by the producer only
+ *  \param      overflows   records rejected because the ring was full, written by the producer only
+ */
+typedef struct {
+    uint8_t *buf;
+    uint32_t record_size;
+    uint32_t mask;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t high_water;
+    uint32_t overflows;
+} embedd_ring_t;
+
+/*!
+ *  \struct     embedd_ring_stats_t
+ *  \brief      ring statistics
+ *
+ *  \param      capacity    number of records the ring holds
+ *  \param      count       number of records held now
+ *  \param      high_water  highest number of records held
+ *  \param      overflows   records rejected because the ring was full
+ */
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t high_water;
+    uint32_t overflows;
+} embedd_ring_stats_t;
+
+/*!
+ *  \macro  EMBEDD_RING_DEFINE
+ *  \brief  creates a statically allocated ring
+ *
+ *  \param  var        name of the ring's variable
+ *  \param  _type      type of a record
+ *  \param  _capacity  number of records, a power of two
+ */
+#define EMBEDD_RING_DEFINE(var, _type, _capacity)\
+  _Static_assert( ( (_capacity) != 0 ) && ( ( (_capacity) & ( (_capacity) - 1 ) ) == 0 ), #var " capacity must be a power of two" );\
+  static _type var##_records[_capacity];\
+  embedd_ring_t var = { .buf = (uint8_t*)var##_records, .record_size = sizeof(_type), .mask = (_capacity) - 1U };
+
+/*!
+ *  \fn       embedd_ring_push
+ *  \brief    copies a record into the ring, producer side
+ *
+ *  \param    ring    pointer to the ring
+ *  \param    record  pointer to the record, record_size bytes
+ *
+ *  \result   EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR when the ring is full
+ */
+EMBEDD_RESULT embedd_ring_push( embedd_ring_t *ring, const void *record );
+
+/*!
+ *  \fn       embedd_ring_pop
+ *  \brief    copies the oldest record out of the ring, consumer side
+ *
+ *  \param    ring    pointer to the ring
+ *  \param    record  pointer receiving record_size bytes
+ *
+ *  \result   true if a record was copied, false if the ring was empty
+ */
+bool embedd_ring_pop( embedd_ring_t *ring, void *record );
+
+/*!
+ *  \fn       embedd_ring_count
+ *  \brief    number of records held, exact on the consumer side, a lower
+ *            bound of the free space on the producer side
+ *
+ *  \param    ring    pointer to the ring
+ *
+ *  \result   number of records held
+ */
+uint32_t embedd_ring_count( const embedd_ring_t *ring );
+
+/*!
+ *  \fn       embedd_ring_get_stats
+ *  \brief    reads the statistics, consumer side
+ *
+ *  The producer owns the counters, so they are reset in a critical section;
+ *  a producer outside of the critical section's reach, e.g. another thread,
+ *  must not push during a reset.
+ *
+ *  \param    ring    pointer to the ring
+ *  \param    stats   pointer to the statistics to fill in
+ *  \param    reset   true to reset the high-water mark to the current count and clear the overflows
+ */
+void embedd_ring_get_stats( embedd_ring_t *ring, embedd_ring_stats_t *stats, bool reset );
+
+#endif //_SRC_EMBEDD_RING_H
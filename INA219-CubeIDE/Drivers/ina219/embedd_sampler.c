@@ -0,0 +1,213 @@
+/******************************************************************************
+* Company: Embedd Limited
+*
+* File: embedd_sampler.c
+*
+* Description: Provides a hardware-timer-paced sampling service
+*
+* Software License Agreement:
+*
+* This code is proprietary to Embedd Limited and may not be distributed
+* or copied without the express permission of Embedd Limited. This code
+* is provided "as is" without warranty of any kind, either expressed or
+* implied, including but not limited to the implied warranties of
+* merchantability and fitness for a particular purpose. This code is intended
+* for use only within the user's organization by its employees and authorized
+* agents, and may not be disclosed or used for any other purpose without
+* prior written consent from Embedd Limited.
+*
+* Unauthorized distribution or use of this code, or any portion of it,
+* including but not limited to publishing online or making it open source,
+* may result in severe civil and criminal penalties, and will be prosecuted to
+* the maximum extent possible under the law.
+*
+* ©️ 2024 Embedd Limited. All Rights Reserved.
+******************************************************************************/
+
+#include <string.h>
+
+#include "embedd_sampler.h"
+
+// dividers tried after the smallest one before the timer period is rounded
+#define EMBEDD_SAMPLER_DIVIDER_SEARCH 1024U
+
+static void embedd_sampler_reset_window( embedd_sampler_t *sampler, uint32_t now )
+{
+    sampler->window_start    = now;
+    sampler->ticks           = 0;
+    sampler->results         = 0;
+    sampler->dropped         = 0;
+    sampler->intervals       = 0;
+    sampler->interval_min_us = UINT32_MAX;
+    sampler->interval_max_us = 0;
+    sampler->jitter_sum_us   = 0;
+    sampler->jitter_max_us   = 0;
+}
+
+EMBEDD_RESULT embedd_sampler_init( embedd_sampler_t *sampler, embedd_sampler_timer_t timer, void *timer_ctx, uint32_t timer_max_us,
+                                   embedd_sampler_start_t start, void *start_ctx, void *slot, uint32_t slot_size )
+{
+    if( ( sampler == NULL ) || ( timer == NULL ) || ( start == NULL ) || ( timer_max_us < EMBEDD_SAMPLER_PERIOD_MIN_US ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    if( ( slot == NULL ) != ( slot_size == 0 ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    sampler->timer        = timer;
+    sampler->timer_ctx    = timer_ctx;
+    sampler->timer_max_us = timer_max_us;
+    sampler->start        = start;
+    sampler->start_ctx    = start_ctx;
+    sampler->period_us    = 0;
+    sampler->divider      = 1;
+    sampler->countdown    = 1;
+    sampler->slot         = slot;
+    sampler->slot_size    = slot_size;
+    sampler->posted       = 0;
+    sampler->taken        = 0;
+    sampler->has_last     = 0;
+    embedd_sampler_reset_window( sampler, embedd_hal_get_us() );
+    return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT embedd_sampler_set_period( embedd_sampler_t *sampler, uint32_t period_us )
+{
+    if( ( sampler == NULL ) || ( sampler->timer == NULL ) || ( period_us < EMBEDD_SAMPLER_PERIOD_MIN_US ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    uint32_t divider = ( period_us + sampler->timer_max_us - 1U ) / sampler->timer_max_us;
+    if( divider > 1U ) {
+        // round periods such as minutes usually split exactly into a few more timer periods
+        for( uint32_t d = divider; d < divider + EMBEDD_SAMPLER_DIVIDER_SEARCH; d++ ) {
+            if( ( period_us % d ) == 0U ) {
+                divider = d;
+                break;
+            }
+        }
+    }
+
+    if( sampler->timer( sampler->timer_ctx, 0 ) != EMBEDD_RESULT_OK ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    uint32_t state = embedd_hal_critical_enter();
+    sampler->period_us = period_us;
+    sampler->divider   = divider;
+    sampler->countdown = divider;
+    sampler->has_last  = 0;
+    embedd_sampler_reset_window( sampler, embedd_hal_get_us() );
+    embedd_hal_critical_exit( state );
+
+    return sampler->timer( sampler->timer_ctx, ( period_us + divider / 2U ) / divider );
+}
+
+EMBEDD_RESULT embedd_sampler_stop( embedd_sampler_t *sampler )
+{
+    if( ( sampler == NULL ) || ( sampler->timer == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    return sampler->timer( sampler->timer_ctx, 0 );
+}
+
+void embedd_sampler_tick( embedd_sampler_t *sampler )
+{
+    if( ( sampler == NULL ) || ( sampler->period_us == 0 ) ) {
+        return;
+    }
+    if( --sampler->countdown != 0U ) {
+        return;
+    }
+    sampler->countdown = sampler->divider;
+
+    uint32_t now = embedd_hal_get_us();
+    if( sampler->has_last ) {
+        uint32_t interval = now - sampler->last_us;
+        uint32_t jitter   = ( interval > sampler->period_us ) ? interval - sampler->period_us : sampler->period_us - interval;
+        if( interval < sampler->interval_min_us ) {
+            sampler->interval_min_us = interval;
+        }
+        if( interval > sampler->interval_max_us ) {
+            sampler->interval_max_us = interval;
+        }
+        if( jitter > sampler->jitter_max_us ) {
+            sampler->jitter_max_us = jitter;
+        }
+        sampler->jitter_sum_us += jitter;
+        sampler->intervals++;
+    }
+    if( sampler->ticks == 0 ) {
+        sampler->first_us = now;
+    }
+    sampler->last_us  = now;
+    sampler->has_last = 1;
+    sampler->ticks++;
+
+    sampler->start( sampler->start_ctx );
+}
+
+void embedd_sampler_post( embedd_sampler_t *sampler, const void *result )
+{
+    if( sampler == NULL ) {
+        return;
+    }
+    uint32_t state = embedd_hal_critical_enter();
+    if( ( sampler->slot != NULL ) && ( result != NULL ) ) {
+        memcpy( sampler->slot, result, sampler->slot_size );
+        if( sampler->posted != sampler->taken ) {
+            sampler->dropped++;
+        }
+    }
+    sampler->posted++;
+    sampler->results++;
+    embedd_hal_critical_exit( state );
+}
+
+bool embedd_sampler_take( embedd_sampler_t *sampler, void *result )
+{
+    if( ( sampler == NULL ) || ( result == NULL ) || ( sampler->slot == NULL ) ) {
+        return false;
+    }
+    // checked without locking first, the main loop polls this often
+    if( sampler->posted == sampler->taken ) {
+        return false;
+    }
+    uint32_t state = embedd_hal_critical_enter();
+    memcpy( result, sampler->slot, sampler->slot_size );
+    sampler->taken = sampler->posted;
+    embedd_hal_critical_exit( state );
+    return true;
+}
+
+void embedd_sampler_get_stats( embedd_sampler_t *sampler, embedd_sampler_stats_t *stats, bool reset )
+{
+    if( ( sampler == NULL ) || ( stats == NULL ) ) {
+        return;
+    }
+    uint32_t state = embedd_hal_critical_enter();
+    uint32_t now       = embedd_hal_get_us();
+    uint32_t span      = sampler->last_us - sampler->first_us;
+    uint32_t intervals = sampler->intervals;
+    uint64_t jitter    = sampler->jitter_sum_us;
+    stats->elapsed_us      = now - sampler->window_start;
+    stats->period_us       = sampler->period_us;
+    stats->ticks           = sampler->ticks;
+    stats->results         = sampler->results;
+    stats->dropped         = sampler->dropped;
+    stats->interval_min_us = ( intervals != 0 ) ? sampler->interval_min_us : 0;
+    stats->interval_max_us = sampler->interval_max_us;
+    stats->jitter_max_us   = sampler->jitter_max_us;
+    if( reset ) {
+        embedd_sampler_reset_window( sampler, now );
+    }
+    embedd_hal_critical_exit( state );
+
+    stats->requested_mhz  = ( stats->period_us != 0 ) ? (uint32_t)( 1000000000ULL / stats->period_us ) : 0;
+    stats->jitter_avg_us  = ( intervals != 0 ) ? (uint32_t)( jitter / intervals ) : 0;
+    stats->achieved_mhz   = 0;
+    stats->drift_ppm      = 0;
+    if( ( stats->ticks > 1U ) && ( span != 0 ) && ( stats->period_us != 0 ) ) {
+        uint64_t expected_us = (uint64_t)( stats->ticks - 1U ) * stats->period_us;
+        stats->achieved_mhz   = (uint32_t)( (uint64_t)( stats->ticks - 1U ) * 1000000000ULL / span );
+        // a longer span than expected is a start falling behind the period
+        stats->drift_ppm      = (int32_t)( ( (int64_t)span - (int64_t)expected_us ) * 1000000 / (int64_t)expected_us );
+    }
+}
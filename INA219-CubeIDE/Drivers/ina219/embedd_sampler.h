@@ -0,0 +1,247 @@
+/******************************************************************************
+* Company: Embedd Limited
+*
+* File: embedd_sampler.h
+*
+* Description: Provides a hardware-timer-paced sampling service
+*
+* Software License Agreement:
+*
+* This code is proprietary to Embedd Limited and may not be distributed
+* or copied without the express permission of Embedd Limited. This code
+* is provided "as is" without warranty of any kind, either expressed or
+* implied, including but not limited to the implied warranties of
+* merchantability and fitness for a particular purpose. This code is intended
+* for use only within the user's organization by its employees and authorized
+* agents, and may not be disclosed or used for any other purpose without
+* prior written consent from Embedd Limited.
+*
+* Unauthorized distribution or use of this code, or any portion of it,
+* including but not limited to publishing online or making it open source,
+* may result in severe civil and criminal penalties, and will be prosecuted to
+* the maximum extent possible under the law.
+*
+* ©️ 2024 Embedd Limited. All Rights Reserved.
+******************************************************************************/
+
+#ifndef _SRC_EMBEDD_SAMPLER_H
+#define _SRC_EMBEDD_SAMPLER_H
+
+#include "embedd_hal.h"
+
+/*!
+ *  \def   EMBEDD_SAMPLER_PERIOD_MIN_US
+ *  \brief Shortest sampling period accepted
+ */
+#ifndef EMBEDD_SAMPLER_PERIOD_MIN_US
+#define EMBEDD_SAMPLER_PERIOD_MIN_US 100U
+#endif
+
+/*!
+ *  \typedef    embedd_sampler_timer_t
+ *  \brief      programs and starts the periodic hardware timer, which calls
+ *              @embedd_sampler_tick from its interrupt every period
+ *
+ *  \param      ctx         context pointer given to @embedd_sampler_init
+ *  \param      period_us   timer period, at most the timer_max_us given to
+ *                          @embedd_sampler_init, 0 to stop the timer
+ *
+ *  \result     EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+typedef EMBEDD_RESULT (*embedd_sampler_timer_t)(void *ctx, uint32_t period_us);
+
+/*!
+ *  \typedef    embedd_sampler_start_t
+ *  \brief      starts one acquisition, called from the timer interrupt
+ *
+ *  \param      ctx         context pointer given to @embedd_sampler_init
+ */
+typedef void (*embedd_sampler_start_t)(void *ctx);
+
+/*!
+ *  \struct     embedd_sampler_t
+ *  \brief      sampling service paced by one hardware timer
+ *
+ *  Periods longer than the timer can count are divided into several timer
+ *  periods. Each acquisition started by the timer interrupt posts its result
+ *  with @embedd_sampler_post, the main context takes it with
+ *  @embedd_sampler_take. The time of every start is measured, so the
+ *  statistics show how well the requested rate holds.
+ *
+ *  \param      timer         programs the hardware timer
+ *  \param      timer_ctx     context pointer of @timer
+ *  \param      timer_max_us  longest period of the hardware timer
+ *  \param      start         starts an acquisition
+ *  \param      start_ctx     context pointer of @start
+ *  \param      period_us     requested sampling period
+ *  \param      divider       timer periods per sampling period
+ *  \param      countdown     timer periods until the next acquisition, private
+ *  \param      slot          result of the latest acquisition
+ *  \param      slot_size     size of @slot in bytes
+ *  \param      posted        number of results posted, private
+ *  \param      taken         value of @posted when the main context took the last result, private
+ *  \param      has_last      non-zero if @last_us is valid, private
+ *  \param      last_us       time of the last acquisition start, private
+ *  \param      first_us      time of the first acquisition start of the statistics window, private
+ *  \param      window_start  time the statistics window started at, private
+ *  \param      ticks         acquisitions started within the window, private
+ *  \param      results       results posted within the window, private
+ *  \param      dropped       results replaced before they were taken within the window, private
+ *  \param      intervals     intervals measured within the window, private
+ *  \param      interval_min_us, interval_max_us  shortest and longest interval, private
+ *  \param      jitter_sum_us sum of the deviations of the intervals from the period, private
+ *  \param      jitter_max_us largest deviation of an interval from the period, private
+ */
+typedef struct {
+    embedd_sampler_timer_t timer;
+    void *timer_ctx;
+    uint32_t timer_max_us;
+    embedd_sampler_start_t start;
+    void *start_ctx;
+    uint32_t period_us;
+    uint32_t divider;
+    uint32_t countdown;
+    void *slot;
+    uint32_t slot_size;
+    volatile uint32_t posted;
+    uint32_t taken;
+    uint8_t has_last;
+    uint32_t last_us;
+    uint32_t first_us;
+    uint32_t window_start;
+    uint32_t ticks;
+    uint32_t results;
+    uint32_t dropped;
+    uint32_t intervals;
+    uint32_t interval_min_us;
+    uint32_t interval_max_us;
+    uint64_t jitter_sum_us;
+    uint32_t jitter_max_us;
+} embedd_sampler_t;
+
+/*!
+ *  \struct     embedd_sampler_stats_t
+ *  \brief      sampling statistics since the last reset
+ *
+ *  The achieved rate is measured between the first and the last acquisition
+ *  start of the window, so it does not depend on when the window was read.
+ *  Times are taken with @embedd_hal_get_us, so a window must be shorter than
+ *  its wrap-around, about 71 minutes. When that time base runs from the same
+ *  oscillator as the sampling timer, as on the target, the achieved rate and
+ *  the drift show scheduling delays and period rounding, not the error of the
+ *  oscillator itself.
+ *
+ *  \param      elapsed_us       length of the statistics window
+ *  \param      period_us        requested sampling period
+ *  \param      requested_mhz    requested rate in mHz
+ *  \param      achieved_mhz     achieved rate in mHz, 0 if less than two acquisitions were started
+ *  \param      drift_ppm        deviation of the acquisition starts from the requested period in ppm,
+ *                               positive when they fall behind it
+ *  \param      ticks            acquisitions started
+ *  \param      results          results posted
+ *  \param      dropped          results replaced before the main context took them
+ *  \param      interval_min_us  shortest interval between two acquisition starts
+ *  \param      interval_max_us  longest interval between two acquisition starts
+ *  \param      jitter_avg_us    mean deviation of an interval from the period
+ *  \param      jitter_max_us    largest deviation of an interval from the period
+ */
+typedef struct {
+    uint32_t elapsed_us;
+    uint32_t period_us;
+    uint32_t requested_mhz;
+    uint32_t achieved_mhz;
+    int32_t  drift_ppm;
+    uint32_t ticks;
+    uint32_t results;
+    uint32_t dropped;
+    uint32_t interval_min_us;
+    uint32_t interval_max_us;
+    uint32_t jitter_avg_us;
+    uint32_t jitter_max_us;
+} embedd_sampler_stats_t;
+
+/*!
+ *  \fn       embedd_sampler_init
+ *  \brief    initializes a sampling service, the timer is not started
+ *
+ *  \param    sampler       pointer to the sampling service
+ *  \param    timer         programs the hardware timer
+ *  \param    timer_ctx     context pointer of @timer
+ *  \param    timer_max_us  longest period of the hardware timer
+ *  \param    start         starts an acquisition, called from the timer interrupt
+ *  \param    start_ctx     context pointer of @start
+ *  \param    slot          buffer holding the latest result, NULL if results are not handed over by the sampler
+ *  \param    slot_size     size of @slot in bytes, 0 without a slot
+ *
+ *  \result   EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT embedd_sampler_init( embedd_sampler_t *sampler, embedd_sampler_timer_t timer, void *timer_ctx, uint32_t timer_max_us,
+                                   embedd_sampler_start_t start, void *start_ctx, void *slot, uint32_t slot_size );
+
+/*!
+ *  \fn       embedd_sampler_set_period
+ *  \brief    (re)starts sampling with a new period and starts a new statistics window
+ *
+ *  A period the timer cannot count is divided into the fewest timer periods
+ *  that split it exactly; if none is found nearby the timer period is rounded.
+ *
+ *  \param    sampler    pointer to the sampling service
+ *  \param    period_us  sampling period, at least EMBEDD_SAMPLER_PERIOD_MIN_US
+ *
+ *  \result   EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT embedd_sampler_set_period( embedd_sampler_t *sampler, uint32_t period_us );
+
+/*!
+ *  \fn       embedd_sampler_stop
+ *  \brief    stops the timer, an acquisition in progress still posts its result
+ *
+ *  \param    sampler    pointer to the sampling service
+ *
+ *  \result   EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT embedd_sampler_stop( embedd_sampler_t *sampler );
+
+/*!
+ *  \fn       embedd_sampler_tick
+ *  \brief    timer interrupt handler, starts an acquisition every sampling period
+ *
+ *  \param    sampler    pointer to the sampling service
+ */
+void embedd_sampler_tick( embedd_sampler_t *sampler );
+
+/*!
+ *  \fn       embedd_sampler_post
+ *  \brief    hands the result of an acquisition to the main context, usually
+ *            called from interrupt context; a result not taken yet is replaced
+ *
+ *  Without a slot the result is only counted, e.g. when results are queued
+ *  in an @embedd_ring_t instead.
+ *
+ *  \param    sampler    pointer to the sampling service
+ *  \param    result     pointer to the result, slot_size bytes, may be NULL without a slot
+ */
+void embedd_sampler_post( embedd_sampler_t *sampler, const void *result );
+
+/*!
+ *  \fn       embedd_sampler_take
+ *  \brief    takes the latest result if one was posted since the last call
+ *
+ *  \param    sampler    pointer to the sampling service
+ *  \param    result     pointer receiving slot_size bytes
+ *
+ *  \result   true if a new result was copied to @result
+ */
+bool embedd_sampler_take( embedd_sampler_t *sampler, void *result );
+
+/*!
+ *  \fn       embedd_sampler_get_stats
+ *  \brief    reads the statistics and optionally starts a new window
+ *
+ *  \param    sampler    pointer to the sampling service
+ *  \param    stats      pointer to the statistics to fill in
+ *  \param    reset      true to start a new statistics window
+ */
+void embedd_sampler_get_stats( embedd_sampler_t *sampler, embedd_sampler_stats_t *stats, bool reset );
+
+#endif //_SRC_EMBEDD_SAMPLER_H
@@ -0,0 +1,269 @@
+/******************************************************************************
+* Company: Embedd Limited
+*
+* File: embedd_stats.c
+*
+* Description: Provides incremental windowed statistics
+*
+* Software License Agreement:
+*
+* This code is proprietary to Embedd Limited and may not be distributed
+* or copied without the express permission of Embedd Limited. This code
+* is provided "as is" without warranty of any kind, either expressed or
+* implied, including but not limited to the implied warranties of
+* merchantability and fitness for a particular purpose. This code is intended
+* for use only within the user's organization by its employees and authorized
+* agents, and may not be disclosed or used for any other purpose without
+* prior written consent from Embedd Limited.
+*
+* Unauthorized distribution or use of this code, or any portion of it,
+* including but not limited to publishing online or making it open source,
+* may result in severe civil and criminal penalties, and will be prosecuted to
+* the maximum extent possible under the law.
+*
+* ©️ 2024 Embedd Limited. All Rights Reserved.
+******************************************************************************/
+
+#include "embedd_stats.h"
+
+#define EMBEDD_STATS_Q16  65536LL
+
+static uint64_t embedd_stats_sat_add( uint64_t a, uint64_t b )
+{
+    return ( a + b < a ) ? UINT64_MAX : a + b;
+}
+
+static void embedd_stats_m2_add( embedd_stats_acc_t *acc, uint64_t dev2_q8 )
+{
+    uint32_t frac = (uint32_t)acc->m2_frac + (uint32_t)( dev2_q8 & 0xFFU );
+    acc->m2      = embedd_stats_sat_add( acc->m2, ( dev2_q8 >> 8 ) + ( frac >> 8 ) );
+    acc->m2_frac = (uint8_t)frac;
+}
+
+static void embedd_stats_m2_sub( embedd_stats_acc_t *acc, uint64_t dev2_q8 )
+{
+    uint64_t whole  = dev2_q8 >> 8;
+    uint8_t  frac   = (uint8_t)dev2_q8;
+    uint8_t  borrow = ( frac > acc->m2_frac ) ? 1U : 0U;
+    if( acc->m2 < whole + borrow ) {
+        acc->m2      = 0;
+        acc->m2_frac = 0;
+        return;
+    }
+    acc->m2     -= whole + borrow;
+    acc->m2_frac = (uint8_t)( acc->m2_frac - frac );
+}
+
+// (x - mean before) * (x - mean after) of a Welford step in 1/256 units squared,
+// both deviations in 1/65536 units and of the same sign
+static uint64_t embedd_stats_dev2_q8( int64_t d1, int64_t d2 )
+{
+    int64_t p;
+    if( ( d1 > -INT32_MAX ) && ( d1 < INT32_MAX ) && ( d2 > -INT32_MAX ) && ( d2 < INT32_MAX ) ) {
+        // below 32768 units: full precision
+        p = d1 * d2;
+        return ( p > 0 ) ? (uint64_t)( ( p + ( 1LL << 23 ) ) >> 24 ) : 0;
+    }
+    if( __builtin_mul_overflow( d1 / 4096, d2 / 4096, &p ) ) {
+        return UINT64_MAX;
+    }
+    return ( p > 0 ) ? (uint64_t)p : 0;
+}
+
+// unsigned integer square root, rounded down
+static uint64_t embedd_stats_isqrt( uint64_t x )
+{
+    uint64_t root = 0;
+    uint64_t bit  = 1ULL << 62;
+    while( bit > x ) {
+        bit >>= 2;
+    }
+    while( bit != 0 ) {
+        if( x >= root + bit ) {
+            x    -= root + bit;
+            root  = ( root >> 1 ) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+void embedd_stats_acc_reset( embedd_stats_acc_t *acc )
+{
+    if( acc == NULL ) {
+        return;
+    }
+    acc->n        = 0;
+    acc->min      = INT32_MAX;
+    acc->max      = INT32_MIN;
+    acc->mean_q16 = 0;
+    acc->m2       = 0;
+    acc->m2_frac  = 0;
+}
+
+void embedd_stats_acc_add( embedd_stats_acc_t *acc, int32_t value )
+{
+    if( acc == NULL ) {
+        return;
+    }
+    int64_t x  = (int64_t)value * EMBEDD_STATS_Q16;
+    int64_t d1 = x - acc->mean_q16;
+    acc->n++;
+    acc->mean_q16 += d1 / (int64_t)acc->n;
+    embedd_stats_m2_add( acc, embedd_stats_dev2_q8( d1, x - acc->mean_q16 ) );
+    if( value < acc->min ) {
+        acc->min = value;
+    }
+    if( value > acc->max ) {
+        acc->max = value;
+    }
+}
+
+// the reverse Welford step, min and max are not updated
+static void embedd_stats_acc_remove( embedd_stats_acc_t *acc, int32_t value )
+{
+    if( acc->n <= 1U ) {
+        embedd_stats_acc_reset( acc );
+        return;
+    }
+    int64_t x  = (int64_t)value * EMBEDD_STATS_Q16;
+    int64_t d1 = x - acc->mean_q16;
+    acc->n--;
+    acc->mean_q16 -= d1 / (int64_t)acc->n;
+    embedd_stats_m2_sub( acc, embedd_stats_dev2_q8( d1, x - acc->mean_q16 ) );
+}
+
+void embedd_stats_acc_summary( const embedd_stats_acc_t *acc, embedd_stats_summary_t *summary )
+{
+    if( ( acc == NULL ) || ( summary == NULL ) ) {
+        return;
+    }
+    *summary = (embedd_stats_summary_t){ 0 };
+    if( acc->n == 0 ) {
+        return;
+    }
+    int64_t  mean = ( acc->mean_q16 + EMBEDD_STATS_Q16 / 2 ) >> 16;
+    uint64_t rem  = ( acc->m2 % acc->n ) * 256U + acc->m2_frac;
+    summary->count       = acc->n;
+    summary->min         = acc->min;
+    summary->max         = acc->max;
+    summary->mean        = (int32_t)mean;
+    summary->variance_q8 = embedd_stats_sat_add( ( acc->m2 / acc->n ) << 8, rem / acc->n );
+    if( acc->m2 / acc->n > ( UINT64_MAX >> 8 ) ) {
+        summary->variance_q8 = UINT64_MAX;
+    }
+    // mean of the squares = mean squared + variance, in 1/65536 units squared while it fits
+    uint64_t ms;
+    uint32_t shift = 0;
+    if( ( acc->mean_q16 > -INT32_MAX ) && ( acc->mean_q16 < INT32_MAX ) && ( summary->variance_q8 < ( 1ULL << 54 ) ) ) {
+        ms    = ( (uint64_t)( acc->mean_q16 * acc->mean_q16 ) >> 16 ) + ( summary->variance_q8 << 8 );
+        shift = 8;
+    } else {
+        ms = embedd_stats_sat_add( (uint64_t)( mean * mean ), ( summary->variance_q8 + 128U ) >> 8 );
+    }
+    uint64_t root = embedd_stats_isqrt( ms );
+    if( ms - root * root > root ) {
+        root++;
+    }
+    summary->rms = (uint32_t)( ( root + ( ( 1ULL << shift ) >> 1 ) ) >> shift );
+}
+
+void embedd_stats_tumbling_init( embedd_stats_tumbling_t *win, uint32_t length )
+{
+    if( win == NULL ) {
+        return;
+    }
+    win->length = length;
+    embedd_stats_acc_reset( &win->acc );
+}
+
+bool embedd_stats_tumbling_add( embedd_stats_tumbling_t *win, int32_t value, embedd_stats_summary_t *summary )
+{
+    if( win == NULL ) {
+        return false;
+    }
+    embedd_stats_acc_add( &win->acc, value );
+    if( ( win->length == 0 ) || ( win->acc.n < win->length ) ) {
+        return false;
+    }
+    return embedd_stats_tumbling_close( win, summary );
+}
+
+bool embedd_stats_tumbling_close( embedd_stats_tumbling_t *win, embedd_stats_summary_t *summary )
+{
+    if( ( win == NULL ) || ( win->acc.n == 0 ) ) {
+        return false;
+    }
+    embedd_stats_acc_summary( &win->acc, summary );
+    embedd_stats_acc_reset( &win->acc );
+    return true;
+}
+
+bool embedd_stats_sliding_add( embedd_stats_sliding_t *win, int32_t value, embedd_stats_summary_t *summary )
+{
+    if( win == NULL ) {
+        return false;
+    }
+    uint32_t seq  = win->seq;
+    uint32_t mask = win->mask;
+    if( !win->full && ( seq == 0 ) ) {
+        embedd_stats_acc_reset( &win->acc );
+        embedd_stats_acc_reset( &win->fresh );
+    }
+
+    // the value leaving the window shares the slot of the new one
+    if( win->full ) {
+        embedd_stats_acc_remove( &win->acc, win->values[seq & mask] );
+    }
+    if( ( win->max_head != win->max_tail ) && ( seq - win->max_q[win->max_head & mask] > mask ) ) {
+        win->max_head++;
+    }
+    if( ( win->min_head != win->min_tail ) && ( seq - win->min_q[win->min_head & mask] > mask ) ) {
+        win->min_head++;
+    }
+    win->values[seq & mask] = value;
+
+    // candidates older and not larger (smaller) than the new value never become the maximum (minimum)
+    while( ( win->max_head != win->max_tail ) && ( win->values[win->max_q[( win->max_tail - 1U ) & mask] & mask] <= value ) ) {
+        win->max_tail--;
+    }
+    win->max_q[win->max_tail++ & mask] = seq;
+    while( ( win->min_head != win->min_tail ) && ( win->values[win->min_q[( win->min_tail - 1U ) & mask] & mask] >= value ) ) {
+        win->min_tail--;
+    }
+    win->min_q[win->min_tail++ & mask] = seq;
+
+    embedd_stats_acc_add( &win->acc, value );
+    embedd_stats_acc_add( &win->fresh, value );
+    if( win->fresh.n > mask ) {
+        // the fresh accumulator holds exactly the window now
+        win->acc = win->fresh;
+        embedd_stats_acc_reset( &win->fresh );
+    }
+
+    win->seq = seq + 1U;
+    if( ( win->seq & mask ) == 0U ) {
+        win->full = 1;
+    }
+    if( !win->full || ( --win->countdown != 0U ) ) {
+        return false;
+    }
+    win->countdown = win->hop;
+    if( summary == NULL ) {
+        return false;
+    }
+    return embedd_stats_sliding_summary( win, summary );
+}
+
+bool embedd_stats_sliding_summary( const embedd_stats_sliding_t *win, embedd_stats_summary_t *summary )
+{
+    if( ( win == NULL ) || ( summary == NULL ) || ( win->acc.n == 0 ) ) {
+        return false;
+    }
+    embedd_stats_acc_summary( &win->acc, summary );
+    summary->min = win->values[win->min_q[win->min_head & win->mask] & win->mask];
+    summary->max = win->values[win->max_q[win->max_head & win->mask] & win->mask];
+    return true;
+}
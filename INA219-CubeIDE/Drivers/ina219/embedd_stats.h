@@ -0,0 +1,221 @@
+/******************************************************************************
+* Company: Embedd Limited
+*
+* File: embedd_stats.h
+*
+* Description: Provides incremental windowed statistics
+*
+* Software License Agreement:
+*
+* This code is proprietary to Embedd Limited and may not be distributed
+* or copied without the express permission of Embedd Limited. This code
+* is provided "as is" without warranty of any kind, either expressed or
+* implied, including but not limited to the implied warranties of
+* merchantability and fitness for a particular purpose. This code is intended
+* for use only within the user's organization by its employees and authorized
+* agents, and may not be disclosed or used for any other purpose without
+* prior written consent from Embedd Limited.
+*
+* Unauthorized distribution or use of this code, or any portion of it,
+* including but not limited to publishing online or making it open source,
+* may result in severe civil and criminal penalties, and will be prosecuted to
+* the maximum extent possible under the law.
+*
+* ©️ 2024 Embedd Limited. All Rights Reserved.
+******************************************************************************/
+
+#ifndef _SRC_EMBEDD_STATS_H
+#define _SRC_EMBEDD_STATS_H
+
+#include "embedd_hal.h"
+
+/*!
+ *  \struct     embedd_stats_acc_t
+ *  \brief      Welford accumulator in fixed point
+ *
+ *  \param      n          number of values
+ *  \param      min        smallest value
+ *  \param      max        largest value
+ *  \param      mean_q16   mean in 1/65536 units
+ *  \param      m2         sum of the squared deviations from the mean in units squared, saturating
+ *  \param      m2_frac    fraction of m2 in 1/256 units squared
+ */
+typedef struct {
+    uint32_t n;
+    int32_t  min;
+    int32_t  max;
+    int64_t  mean_q16;
+    uint64_t m2;
+    uint8_t  m2_frac;
+} embedd_stats_acc_t;
+
+/*!
+ *  \struct     embedd_stats_summary_t
+ *  \brief      summary of one window
+ *
+ *  \param      count        number of values
+ *  \param      min          smallest value
+ *  \param      max          largest value
+ *  \param      mean         mean, rounded
+ *  \param      rms          root mean square, rounded
+ *  \param      variance_q8  population variance in 1/256 units squared
+ */
+typedef struct {
+    uint32_t count;
+    int32_t  min;
+    int32_t  max;
+    int32_t  mean;
+    uint32_t rms;
+    uint64_t variance_q8;
+} embedd_stats_summary_t;
+
+/*!
+ *  \struct     embedd_stats_tumbling_t
+ *  \brief      statistics of consecutive, non-overlapping windows
+ *
+ *  \param      acc      accumulator of the current window
+ *  \param      length   values per window, 0 to close windows with @embedd_stats_tumbling_close only
+ */
+typedef struct {
+    embedd_stats_acc_t acc;
+    uint32_t length;
+} embedd_stats_tumbling_t;
+
+/*!
+ *  \struct     embedd_stats_sliding_t
+ *  \brief      statistics of the latest values, updated with every value
+ *
+ *  The oldest value is removed from the accumulator as a new one is added.
+ *  A second accumulator is built over each run of length values and
+ *  replaces the first one when it is complete, so rounding errors of the
+ *  removals never build up. Minimum and maximum come from monotonic queues.
+ *  Create sliding windows with @EMBEDD_STATS_SLIDING_DEFINE.
+ *
+ *  \param      values      the latest values, private
+ *  \param      max_q       sequence numbers of the maximum candidates, private
+ *  \param      min_q       sequence numbers of the minimum candidates, private
+ *  \param      mask        length - 1, the length is a power of two
+ *  \param      hop         values between two summaries
+ *  \param      countdown   values until the next summary, private
+ *  \param      seq         sequence number of the next value, private
+ *  \param      full        non-zero once length values were added, private
+ *  \param      max_head, max_tail, min_head, min_tail  queue indices, private
+ *  \param      acc         accumulator of the window, private
+ *  \param      fresh       accumulator of the values since the last replacement, private
+ */
+typedef struct {
+    int32_t  *values;
+    uint32_t *max_q;
+    uint32_t *min_q;
+    uint32_t mask;
+    uint32_t hop;
+    uint32_t countdown;
+    uint32_t seq;
+    uint8_t  full;
+    uint32_t max_head;
+    uint32_t max_tail;
+    uint32_t min_head;
+    uint32_t min_tail;
+    embedd_stats_acc_t acc;
+    embedd_stats_acc_t fresh;
+} embedd_stats_sliding_t;
+
+/*!
+ *  \macro  EMBEDD_STATS_SLIDING_DEFINE
+ *  \brief  creates a statically allocated sliding window
+ *
+ *  \param  var       name of the window's variable
+ *  \param  _length   number of values in the window, a power of two
+ *  \param  _hop      values between two summaries, at least 1
+ */
+#define EMBEDD_STATS_SLIDING_DEFINE(var, _length, _hop)\
+  _Static_assert( ( (_length) != 0 ) && ( ( (_length) & ( (_length) - 1 ) ) == 0 ), #var " length must be a power of two" );\
+  _Static_assert( (_hop) != 0, #var " hop must not be 0" );\
+  static int32_t var##_values[_length];\
+  static uint32_t var##_max_q[_length];\
+  static uint32_t var##_min_q[_length];\
+  embedd_stats_sliding_t var = { .values = var##_values, .max_q = var##_max_q, .min_q = var##_min_q,\
+                                 .mask = (_length) - 1U, .hop = (_hop), .countdown = 1 };
+
+/*!
+ *  \fn       embedd_stats_acc_reset
+ *  \brief    empties an accumulator
+ *
+ *  \param    acc     pointer to the accumulator
+ */
+void embedd_stats_acc_reset( embedd_stats_acc_t *acc );
+
+/*!
+ *  \fn       embedd_stats_acc_add
+ *  \brief    adds a value to an accumulator
+ *
+ *  \param    acc     pointer to the accumulator
+ *  \param    value   value to add
+ */
+void embedd_stats_acc_add( embedd_stats_acc_t *acc, int32_t value );
+
+/*!
+ *  \fn       embedd_stats_acc_summary
+ *  \brief    summarizes an accumulator
+ *
+ *  \param    acc      pointer to the accumulator
+ *  \param    summary  pointer to the summary to fill in
+ */
+void embedd_stats_acc_summary( const embedd_stats_acc_t *acc, embedd_stats_summary_t *summary );
+
+/*!
+ *  \fn       embedd_stats_tumbling_init
+ *  \brief    initializes tumbling windows
+ *
+ *  \param    win     pointer to the windows
+ *  \param    length  values per window, 0 to close windows with @embedd_stats_tumbling_close only
+ */
+void embedd_stats_tumbling_init( embedd_stats_tumbling_t *win, uint32_t length );
+
+/*!
+ *  \fn       embedd_stats_tumbling_add
+ *  \brief    adds a value and closes the window when it holds length values
+ *
+ *  \param    win      pointer to the windows
+ *  \param    value    value to add
+ *  \param    summary  pointer to the summary filled in when the window closes
+ *
+ *  \result   true if a window was closed and @summary filled in
+ */
+bool embedd_stats_tumbling_add( embedd_stats_tumbling_t *win, int32_t value, embedd_stats_summary_t *summary );
+
+/*!
+ *  \fn       embedd_stats_tumbling_close
+ *  \brief    closes the current window, e.g. at the end of a time interval
+ *
+ *  \param    win      pointer to the windows
+ *  \param    summary  pointer to the summary to fill in
+ *
+ *  \result   true if the window held values and @summary was filled in
+ */
+bool embedd_stats_tumbling_close( embedd_stats_tumbling_t *win, embedd_stats_summary_t *summary );
+
+/*!
+ *  \fn       embedd_stats_sliding_add
+ *  \brief    adds a value, dropping the oldest one of a full window
+ *
+ *  \param    win      pointer to the window
+ *  \param    value    value to add
+ *  \param    summary  pointer to the summary filled in every hop values once the window is full, may be NULL
+ *
+ *  \result   true if @summary was filled in
+ */
+bool embedd_stats_sliding_add( embedd_stats_sliding_t *win, int32_t value, embedd_stats_summary_t *summary );
+
+/*!
+ *  \fn       embedd_stats_sliding_summary
+ *  \brief    summarizes the values in the window, full or not
+ *
+ *  \param    win      pointer to the window
+ *  \param    summary  pointer to the summary to fill in
+ *
+ *  \result   true if the window held values and @summary was filled in
+ */
+bool embedd_stats_sliding_summary( const embedd_stats_sliding_t *win, embedd_stats_summary_t *summary );
+
+#endif //_SRC_EMBEDD_STATS_H
@@ -0,0 +1,399 @@
+/******************************************************************************
+* Company: Embedd Limited
+*
+* File: embedd_telemetry.c
+*
+* Description: Provides a framed binary telemetry stream
+*
+* Software License Agreement:
+*
+* This code is proprietary to Embedd Limited and may not be distributed
+* or copied without the express permission of Embedd Limited. This code
+* is provided "as is" without warranty of any kind, either expressed or
+* implied, including but not limited to the implied warranties of
+* merchantability and fitness for a particular purpose. This code is intended
+* for use only within the user's organization by its employees and authorized
+* agents, and may not be disclosed or used for any other purpose without
+* prior written consent from Embedd Limited.
+*
+* Unauthorized distribution or use of this code, or any portion of it,
+* including but not limited to publishing online or making it open source,
+* may result in severe civil and criminal penalties, and will be prosecuted to
+* the maximum extent possible under the law.
+*
+* ©️ 2024 Embedd Limited. All Rights Reserved.
+******************************************************************************/
+
+#include "embedd_telemetry.h"
+
+enum {
+    EMBEDD_TELEMETRY_TEXT = 0,
+    EMBEDD_TELEMETRY_STREAMING,
+    EMBEDD_TELEMETRY_SWITCHING,     // ACK of BAUD on its way at the old rate
+    EMBEDD_TELEMETRY_CONFIRMING,    // switched, waiting for HELLO at the new rate
+    EMBEDD_TELEMETRY_STOPPING,      // ACK of STOP on its way, then back to the default rate
+};
+
+static const uint32_t embedd_telemetry_crc_table[16] = {
+    0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL, 0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+    0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL, 0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL,
+};
+
+static void embedd_telemetry_put16( uint8_t *dst, uint16_t value )
+{
+    dst[0] = (uint8_t)value;
+    dst[1] = (uint8_t)( value >> 8 );
+}
+
+static void embedd_telemetry_put32( uint8_t *dst, uint32_t value )
+{
+    embedd_telemetry_put16( dst, (uint16_t)value );
+    embedd_telemetry_put16( dst + 2, (uint16_t)( value >> 16 ) );
+}
+
+static uint32_t embedd_telemetry_get32( const uint8_t *src )
+{
+    return (uint32_t)src[0] | ( (uint32_t)src[1] << 8 ) | ( (uint32_t)src[2] << 16 ) | ( (uint32_t)src[3] << 24 );
+}
+
+uint32_t embedd_telemetry_crc32( const uint8_t *data, uint32_t size )
+{
+    uint32_t crc = 0xFFFFFFFFUL;
+    for( uint32_t i = 0; i < size; i++ ) {
+        crc ^= data[i];
+        crc = ( crc >> 4 ) ^ embedd_telemetry_crc_table[crc & 0x0FU];
+        crc = ( crc >> 4 ) ^ embedd_telemetry_crc_table[crc & 0x0FU];
+    }
+    return ~crc;
+}
+
+static uint32_t embedd_telemetry_crc( const embedd_telemetry_t *tm, const uint8_t *data, uint32_t size )
+{
+    if( tm->port->crc != NULL ) {
+        return tm->port->crc( tm->port->ctx, data, size );
+    }
+    return embedd_telemetry_crc32( data, size );
+}
+
+uint32_t embedd_telemetry_cobs_encode( const uint8_t *src, uint32_t size, uint8_t *dst )
+{
+    uint32_t code_at = 0;
+    uint32_t out     = 1;
+    uint8_t  code    = 1;
+    for( uint32_t i = 0; i < size; i++ ) {
+        if( src[i] == 0 ) {
+            dst[code_at] = code;
+            code_at = out++;
+            code = 1;
+            continue;
+        }
+        dst[out++] = src[i];
+        if( ++code == 0xFFU ) {
+            dst[code_at] = code;
+            code_at = out++;
+            code = 1;
+        }
+    }
+    dst[code_at] = code;
+    dst[out++] = 0;
+    return out;
+}
+
+uint32_t embedd_telemetry_cobs_decode( uint8_t *buf, uint32_t size )
+{
+    uint32_t in  = 0;
+    uint32_t out = 0;
+    while( in < size ) {
+        uint8_t code = buf[in++];
+        if( ( code == 0 ) || ( in + code - 1U > size ) ) {
+            return 0;
+        }
+        for( uint8_t i = 1; i < code; i++ ) {
+            buf[out++] = buf[in++];
+        }
+        if( ( code != 0xFFU ) && ( in < size ) ) {
+            buf[out++] = 0;
+        }
+    }
+    return out;
+}
+
+// numbers, checksums, encodes and sends a frame of header and payload
+static EMBEDD_RESULT embedd_telemetry_send( embedd_telemetry_t *tm, uint8_t *raw, uint32_t size )
+{
+    if( tm->port->busy( tm->port->ctx ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    embedd_telemetry_put16( raw + 2, tm->seq );
+    embedd_telemetry_put32( raw + size, embedd_telemetry_crc( tm, raw, size ) );
+    uint32_t encoded = embedd_telemetry_cobs_encode( raw, size + EMBEDD_TELEMETRY_CRC_SIZE, tm->encoded );
+    if( tm->port->send( tm->port->ctx, tm->encoded, encoded ) != EMBEDD_RESULT_OK ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    tm->seq++;
+    tm->stats.bytes += encoded;
+    return EMBEDD_RESULT_OK;
+}
+
+static void embedd_telemetry_discard( embedd_telemetry_t *tm )
+{
+    tm->fill  = EMBEDD_TELEMETRY_HEADER_SIZE;
+    tm->ready = 0;
+}
+
+// sends the waiting frame, or drops it when drop is set and the port is busy
+static void embedd_telemetry_send_frame( embedd_telemetry_t *tm, bool drop )
+{
+    uint32_t records = ( tm->fill - EMBEDD_TELEMETRY_HEADER_SIZE ) / tm->cfg.record_size;
+    if( embedd_telemetry_send( tm, tm->frame, tm->fill ) == EMBEDD_RESULT_OK ) {
+        tm->stats.frames++;
+        tm->stats.records += records;
+    } else if( drop ) {
+        // the sequence number tells the host
+        tm->seq++;
+        tm->stats.dropped_frames++;
+        tm->stats.dropped_records += records;
+    } else {
+        return;
+    }
+    embedd_telemetry_discard( tm );
+}
+
+static void embedd_telemetry_reply( embedd_telemetry_t *tm, uint8_t type, const uint8_t *payload, uint8_t size )
+{
+    tm->reply[0] = type;
+    tm->reply[1] = 0;
+    for( uint8_t i = 0; i < size; i++ ) {
+        tm->reply[EMBEDD_TELEMETRY_HEADER_SIZE + i] = payload[i];
+    }
+    tm->reply_size = (uint8_t)( EMBEDD_TELEMETRY_HEADER_SIZE + size );
+}
+
+static void embedd_telemetry_ack( embedd_telemetry_t *tm, uint8_t command, uint8_t status, uint32_t value )
+{
+    uint8_t ack[8] = { command, status, 0, 0 };
+    embedd_telemetry_put32( ack + 4, value );
+    embedd_telemetry_reply( tm, EMBEDD_TELEMETRY_ACK, ack, sizeof(ack) );
+}
+
+static void embedd_telemetry_command( embedd_telemetry_t *tm, const uint8_t *frame, uint32_t size )
+{
+    const uint8_t *payload = frame + EMBEDD_TELEMETRY_HEADER_SIZE;
+    uint32_t payload_size  = size - EMBEDD_TELEMETRY_HEADER_SIZE;
+    switch( frame[0] ) {
+    case EMBEDD_TELEMETRY_HELLO: {
+        uint8_t info[16] = { EMBEDD_TELEMETRY_VERSION, tm->cfg.record_type, tm->cfg.record_size, 0 };
+        embedd_telemetry_put32( info + 4, tm->baud );
+        embedd_telemetry_put32( info + 8, tm->port->max_baud );
+        embedd_telemetry_put32( info + 12, tm->cfg.period_us );
+        if( tm->state != EMBEDD_TELEMETRY_STREAMING ) {
+            embedd_telemetry_discard( tm );
+        }
+        tm->state = EMBEDD_TELEMETRY_STREAMING;
+        embedd_telemetry_reply( tm, EMBEDD_TELEMETRY_INFO, info, sizeof(info) );
+        break;
+    }
+    case EMBEDD_TELEMETRY_BAUD: {
+        uint32_t baud = 0;
+        if( ( payload_size == 4U ) && ( tm->port->baud != NULL ) ) {
+            baud = tm->port->baud( tm->port->ctx, embedd_telemetry_get32( payload ), false );
+        }
+        if( ( baud == 0 ) || ( baud > tm->port->max_baud ) ) {
+            embedd_telemetry_ack( tm, EMBEDD_TELEMETRY_BAUD, EMBEDD_TELEMETRY_ACK_REJECTED, 0 );
+            break;
+        }
+        // nothing but the ACK goes out at the old rate
+        embedd_telemetry_discard( tm );
+        tm->pending_baud = baud;
+        tm->state = EMBEDD_TELEMETRY_SWITCHING;
+        embedd_telemetry_ack( tm, EMBEDD_TELEMETRY_BAUD, EMBEDD_TELEMETRY_ACK_OK, baud );
+        break;
+    }
+    case EMBEDD_TELEMETRY_STOP:
+        embedd_telemetry_discard( tm );
+        tm->state = EMBEDD_TELEMETRY_STOPPING;
+        embedd_telemetry_ack( tm, EMBEDD_TELEMETRY_STOP, EMBEDD_TELEMETRY_ACK_OK, 0 );
+        break;
+    default:
+        embedd_telemetry_ack( tm, frame[0], EMBEDD_TELEMETRY_ACK_UNSUPPORTED, 0 );
+        break;
+    }
+}
+
+EMBEDD_RESULT embedd_telemetry_init( embedd_telemetry_t *tm, const embedd_telemetry_port_t *port, const embedd_telemetry_cfg_t *cfg )
+{
+    if( ( tm == NULL ) || ( port == NULL ) || ( cfg == NULL ) || ( port->send == NULL ) || ( port->busy == NULL ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    if( ( tm->frame == NULL ) || ( tm->encoded == NULL ) || ( tm->rx == NULL ) || ( cfg->record_size == 0 ) ||
+        ( tm->capacity < EMBEDD_TELEMETRY_HEADER_SIZE + cfg->record_size + EMBEDD_TELEMETRY_CRC_SIZE ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    tm->port        = port;
+    tm->cfg         = *cfg;
+    tm->baud        = cfg->baud;
+    tm->state       = EMBEDD_TELEMETRY_TEXT;
+    tm->seq         = 0;
+    tm->reply_size  = 0;
+    tm->rx_fill     = 0;
+    tm->rx_overflow = 0;
+    tm->stats       = (embedd_telemetry_stats_t){ 0 };
+    tm->frame[0]    = cfg->record_type;
+    tm->frame[1]    = cfg->record_size;
+    embedd_telemetry_discard( tm );
+    return EMBEDD_RESULT_OK;
+}
+
+bool embedd_telemetry_streaming( const embedd_telemetry_t *tm )
+{
+    return ( tm != NULL ) && ( ( tm->state != EMBEDD_TELEMETRY_TEXT ) || ( tm->reply_size != 0 ) );
+}
+
+EMBEDD_RESULT embedd_telemetry_add( embedd_telemetry_t *tm, const void *record, uint32_t now_us )
+{
+    if( ( tm == NULL ) || ( record == NULL ) || ( tm->state != EMBEDD_TELEMETRY_STREAMING ) ) {
+        return EMBEDD_RESULT_ERR;
+    }
+    if( tm->ready ) {
+        embedd_telemetry_send_frame( tm, true );
+    }
+    if( tm->fill == EMBEDD_TELEMETRY_HEADER_SIZE ) {
+        tm->first_us = now_us;
+    }
+    const uint8_t *src = (const uint8_t*)record;
+    for( uint8_t i = 0; i < tm->cfg.record_size; i++ ) {
+        tm->frame[tm->fill + i] = src[i];
+    }
+    tm->fill += tm->cfg.record_size;
+    if( tm->fill + tm->cfg.record_size + EMBEDD_TELEMETRY_CRC_SIZE > tm->capacity ) {
+        embedd_telemetry_flush( tm );
+    }
+    return EMBEDD_RESULT_OK;
+}
+
+void embedd_telemetry_flush( embedd_telemetry_t *tm )
+{
+    if( ( tm == NULL ) || ( tm->fill == EMBEDD_TELEMETRY_HEADER_SIZE ) ) {
+        return;
+    }
+    tm->ready = 1;
+    if( tm->reply_size == 0 ) {
+        embedd_telemetry_send_frame( tm, false );
+    }
+}
+
+uint32_t embedd_telemetry_send_log( embedd_telemetry_t *tm, const uint8_t *text, uint32_t size )
+{
+    if( ( tm == NULL ) || ( text == NULL ) || ( size == 0 ) || ( tm->state != EMBEDD_TELEMETRY_STREAMING ) ||
+        ( tm->reply_size != 0 ) || tm->ready ) {
+        return 0;
+    }
+    if( size > EMBEDD_TELEMETRY_LOG_MAX ) {
+        size = EMBEDD_TELEMETRY_LOG_MAX;
+    }
+    // encoded right away, so the reply buffer is free again on return
+    tm->reply[0] = EMBEDD_TELEMETRY_LOG;
+    tm->reply[1] = 0;
+    for( uint32_t i = 0; i < size; i++ ) {
+        tm->reply[EMBEDD_TELEMETRY_HEADER_SIZE + i] = text[i];
+    }
+    if( embedd_telemetry_send( tm, tm->reply, EMBEDD_TELEMETRY_HEADER_SIZE + size ) != EMBEDD_RESULT_OK ) {
+        return 0;
+    }
+    tm->stats.log_frames++;
+    return size;
+}
+
+void embedd_telemetry_receive( embedd_telemetry_t *tm, const uint8_t *data, uint32_t size )
+{
+    if( ( tm == NULL ) || ( data == NULL ) ) {
+        return;
+    }
+    for( uint32_t i = 0; i < size; i++ ) {
+        if( data[i] != 0 ) {
+            if( tm->rx_fill < tm->rx_capacity ) {
+                tm->rx[tm->rx_fill++] = data[i];
+            } else {
+                tm->rx_overflow = 1;
+            }
+            continue;
+        }
+        // a delimiter ends the frame, stray bytes before it fail the CRC; hosts send 0x00 first
+        uint32_t decoded = tm->rx_overflow ? 0 : embedd_telemetry_cobs_decode( tm->rx, tm->rx_fill );
+        if( ( decoded >= EMBEDD_TELEMETRY_HEADER_SIZE + EMBEDD_TELEMETRY_CRC_SIZE ) &&
+            ( embedd_telemetry_crc( tm, tm->rx, decoded - EMBEDD_TELEMETRY_CRC_SIZE ) ==
+              embedd_telemetry_get32( tm->rx + decoded - EMBEDD_TELEMETRY_CRC_SIZE ) ) ) {
+            tm->stats.rx_frames++;
+            embedd_telemetry_command( tm, tm->rx, decoded - EMBEDD_TELEMETRY_CRC_SIZE );
+        } else if( tm->rx_fill != 0 || tm->rx_overflow ) {
+            tm->stats.rx_errors++;
+        }
+        tm->rx_fill = 0;
+        tm->rx_overflow = 0;
+    }
+}
+
+static void embedd_telemetry_default_baud( embedd_telemetry_t *tm )
+{
+    if( ( tm->baud != tm->cfg.baud ) && ( tm->port->baud != NULL ) ) {
+        tm->port->baud( tm->port->ctx, tm->cfg.baud, true );
+        tm->baud = tm->cfg.baud;
+    }
+    tm->state = EMBEDD_TELEMETRY_TEXT;
+}
+
+void embedd_telemetry_process( embedd_telemetry_t *tm, uint32_t now_us )
+{
+    if( tm == NULL ) {
+        return;
+    }
+    if( tm->reply_size != 0 ) {
+        if( embedd_telemetry_send( tm, tm->reply, tm->reply_size ) != EMBEDD_RESULT_OK ) {
+            return;
+        }
+        tm->reply_size = 0;
+    }
+    switch( tm->state ) {
+    case EMBEDD_TELEMETRY_STREAMING:
+        if( tm->ready ) {
+            embedd_telemetry_send_frame( tm, false );
+        } else if( ( tm->cfg.max_age_us != 0 ) && ( tm->fill != EMBEDD_TELEMETRY_HEADER_SIZE ) &&
+                   ( now_us - tm->first_us >= tm->cfg.max_age_us ) ) {
+            embedd_telemetry_flush( tm );
+        }
+        break;
+    case EMBEDD_TELEMETRY_SWITCHING:
+        // the ACK has to leave at the old rate first
+        if( !tm->port->busy( tm->port->ctx ) ) {
+            tm->port->baud( tm->port->ctx, tm->pending_baud, true );
+            tm->baud = tm->pending_baud;
+            tm->confirm_us = now_us;
+            tm->state = EMBEDD_TELEMETRY_CONFIRMING;
+        }
+        break;
+    case EMBEDD_TELEMETRY_CONFIRMING:
+        // the host did not follow, the default rate is where it looks first
+        if( now_us - tm->confirm_us >= EMBEDD_TELEMETRY_CONFIRM_US ) {
+            embedd_telemetry_default_baud( tm );
+        }
+        break;
+    case EMBEDD_TELEMETRY_STOPPING:
+        if( !tm->port->busy( tm->port->ctx ) ) {
+            embedd_telemetry_default_baud( tm );
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void embedd_telemetry_get_stats( embedd_telemetry_t *tm, embedd_telemetry_stats_t *stats, bool reset )
+{
+    if( ( tm == NULL ) || ( stats == NULL ) ) {
+        return;
+    }
+    *stats = tm->stats;
+    if( reset ) {
+        tm->stats = (embedd_telemetry_stats_t){ 0 };
+    }
+}
@@ -0,0 +1,375 @@
+/******************************************************************************
+* Company: Embedd Limited
+*
+* File: embedd_telemetry.h
+*
+* Description: Provides a framed binary telemetry stream
+*
+* Software License Agreement:
+*
+* This code is proprietary to Embedd Limited and may not be distributed
+* or copied without the express permission of Embedd Limited. This code
+* is provided "as is" without warranty of any kind, either expressed or
+* implied, including but not limited to the implied warranties of
+* merchantability and fitness for a particular purpose. This code is intended
+* for use only within the user's organization by its employees and authorized
+* agents, and may not be disclosed or used for any other purpose without
+* prior written consent from Embedd Limited.
+*
+* Unauthorized distribution or use of this code, or any portion of it,
+* including but not limited to publishing online or making it open source,
+* may result in severe civil and criminal penalties, and will be prosecuted to
+* the maximum extent possible under the law.
+*
+* ©️ 2024 Embedd Limited. All Rights Reserved.
+******************************************************************************/
+
+#ifndef _SRC_EMBEDD_TELEMETRY_H
+#define _SRC_EMBEDD_TELEMETRY_H
+
+#include "embedd_hal.h"
+
+/*
+ * Frame format, both directions, little endian:
+ *
+ *   type u8 | record_size u8 | seq u16 | payload | crc u32
+ *
+ * The CRC is the CRC-32 of zlib over type..payload. The frame is COBS
+ * encoded and terminated by a 0x00 byte. Data frames carry a whole number
+ * of records of record_size bytes. Every frame sent by the device takes the
+ * next sequence number, so a gap tells the host how many frames were lost.
+ *
+ * The device talks text until the host sends HELLO. It then streams data
+ * frames until STOP, which also returns to the default baud rate. BAUD asks for another baud rate. The device answers
+ * with an ACK at the old rate, switches and stops streaming until HELLO
+ * arrives at the new rate. Without HELLO it returns to the default rate
+ * and to text after EMBEDD_TELEMETRY_CONFIRM_US.
+ *
+ * While streaming, text of the device travels in LOG frames of its own,
+ * sent only when no answer or data frame waits for the port.
+ */
+
+#define EMBEDD_TELEMETRY_VERSION        1U
+
+#define EMBEDD_TELEMETRY_HEADER_SIZE    4U
+#define EMBEDD_TELEMETRY_CRC_SIZE       4U
+#define EMBEDD_TELEMETRY_REPLY_SIZE     ( EMBEDD_TELEMETRY_HEADER_SIZE + 16U + EMBEDD_TELEMETRY_CRC_SIZE )
+#define EMBEDD_TELEMETRY_LOG_MAX        48U     //!< most text bytes in a LOG frame
+#define EMBEDD_TELEMETRY_CONTROL_SIZE   ( EMBEDD_TELEMETRY_HEADER_SIZE + EMBEDD_TELEMETRY_LOG_MAX + EMBEDD_TELEMETRY_CRC_SIZE )
+
+/*!
+ *  \def        EMBEDD_TELEMETRY_ENCODED_SIZE
+ *  \brief      worst-case size of a COBS encoded frame with its delimiter
+ */
+#define EMBEDD_TELEMETRY_ENCODED_SIZE(_frame_size)  ( (_frame_size) + (_frame_size) / 254U + 2U )
+
+/*!
+ *  \def        EMBEDD_TELEMETRY_CONFIRM_US
+ *  \brief      time the host has to confirm a new baud rate with HELLO
+ */
+#define EMBEDD_TELEMETRY_CONFIRM_US     2000000UL
+
+/* frame types sent by the host */
+#define EMBEDD_TELEMETRY_HELLO          0x01U   //!< start streaming, no payload
+#define EMBEDD_TELEMETRY_BAUD           0x02U   //!< u32 baud rate requested
+#define EMBEDD_TELEMETRY_STOP           0x03U   //!< stop streaming, back to text, no payload
+
+/* frame types sent by the device, data frame types start at 0x10 */
+#define EMBEDD_TELEMETRY_INFO           0x80U   //!< answer to HELLO, see embedd_telemetry_info_t
+#define EMBEDD_TELEMETRY_ACK            0x81U   //!< answer to BAUD and STOP, see embedd_telemetry_ack_t
+#define EMBEDD_TELEMETRY_LOG            0x82U   //!< log text, the payload is the text
+
+#define EMBEDD_TELEMETRY_ACK_OK           0U
+#define EMBEDD_TELEMETRY_ACK_REJECTED     1U
+#define EMBEDD_TELEMETRY_ACK_UNSUPPORTED  2U
+
+/*!
+ *  \struct     embedd_telemetry_info_t
+ *  \brief      payload of INFO
+ *
+ *  \param      version       protocol version, @EMBEDD_TELEMETRY_VERSION
+ *  \param      record_type   frame type of the data frames
+ *  \param      record_size   size of a record
+ *  \param      reserved      0
+ *  \param      baud          current baud rate
+ *  \param      max_baud      highest baud rate
+ *  \param      period_us     sampling period, 0 if unknown
+ */
+typedef struct {
+    uint8_t  version;
+    uint8_t  record_type;
+    uint8_t  record_size;
+    uint8_t  reserved;
+    uint32_t baud;
+    uint32_t max_baud;
+    uint32_t period_us;
+} embedd_telemetry_info_t;
+
+/*!
+ *  \struct     embedd_telemetry_ack_t
+ *  \brief      payload of ACK
+ *
+ *  \param      command    frame type of the command
+ *  \param      status     EMBEDD_TELEMETRY_ACK_*
+ *  \param      reserved   0
+ *  \param      value      baud rate switched to for BAUD, otherwise 0
+ */
+typedef struct {
+    uint8_t  command;
+    uint8_t  status;
+    uint16_t reserved;
+    uint32_t value;
+} embedd_telemetry_ack_t;
+
+/*!
+ *  \struct     embedd_telemetry_port_t
+ *  \brief      serial port of the telemetry stream
+ *
+ *  \param      send    starts sending an encoded frame which stays untouched until busy returns false,
+ *                      returns EMBEDD_RESULT_ERR if the port is busy
+ *  \param      busy    returns true while a frame is being sent
+ *  \param      baud    returns the baud rate used for a requested one, 0 if it is not possible;
+ *                      switches to it if apply is true
+ *  \param      crc     returns the CRC-32 of zlib, NULL to compute it in software
+ *  \param      max_baud  highest baud rate
+ *  \param      ctx     passed to the functions
+ */
+typedef struct {
+    EMBEDD_RESULT (*send)( void *ctx, const uint8_t *data, uint32_t size );
+    bool (*busy)( void *ctx );
+    uint32_t (*baud)( void *ctx, uint32_t baud, bool apply );
+    uint32_t (*crc)( void *ctx, const uint8_t *data, uint32_t size );
+    uint32_t max_baud;
+    void *ctx;
+} embedd_telemetry_port_t;
+
+/*!
+ *  \struct     embedd_telemetry_cfg_t
+ *  \brief      stream configuration
+ *
+ *  \param      record_type   frame type of the data frames, 0x10 to 0x7F
+ *  \param      record_size   size of a record
+ *  \param      baud          default baud rate, used until the host asks for another one
+ *  \param      max_age_us    longest time a record waits for its frame to fill, 0 to send full frames only
+ *  \param      period_us     sampling period reported in INFO, 0 if unknown
+ */
+typedef struct {
+    uint8_t  record_type;
+    uint8_t  record_size;
+    uint32_t baud;
+    uint32_t max_age_us;
+    uint32_t period_us;
+} embedd_telemetry_cfg_t;
+
+/*!
+ *  \struct     embedd_telemetry_stats_t
+ *  \brief      stream statistics
+ *
+ *  \param      frames           frames sent
+ *  \param      records          records sent
+ *  \param      bytes            encoded bytes sent
+ *  \param      dropped_frames   frames dropped because the port was still busy
+ *  \param      dropped_records  records in those frames
+ *  \param      rx_frames        valid frames received
+ *  \param      rx_errors        frames received with a bad CRC, bad encoding or too long
+ *  \param      log_frames       LOG frames sent
+ */
+typedef struct {
+    uint32_t frames;
+    uint32_t records;
+    uint32_t bytes;
+    uint32_t dropped_frames;
+    uint32_t dropped_records;
+    uint32_t rx_frames;
+    uint32_t rx_errors;
+    uint32_t log_frames;
+} embedd_telemetry_stats_t;
+
+/*!
+ *  \struct     embedd_telemetry_t
+ *  \brief      telemetry stream, create it with @EMBEDD_TELEMETRY_DEFINE
+ *
+ *  \param      frame        frame being filled, private
+ *  \param      encoded      encoded frame being sent, private
+ *  \param      rx           frame being received, private
+ *  \param      reply        answer waiting for the port or LOG frame being encoded, private
+ *  \param      capacity     size of frame
+ *  \param      rx_capacity  size of rx
+ *  \param      fill         bytes in frame, private
+ *  \param      rx_fill      bytes in rx, private
+ *  \param      reply_size   bytes in reply, 0 if none, private
+ *  \param      ready        non-zero if frame is full and waits for the port, private
+ *  \param      rx_overflow  non-zero while discarding a too long frame, private
+ *  \param      state        session state, private
+ *  \param      seq          sequence number of the next frame, private
+ *  \param      first_us     time the first record of frame was added, private
+ *  \param      baud         current baud rate, private
+ *  \param      pending_baud baud rate to switch to after ACK, private
+ *  \param      confirm_us   time the baud rate was switched, private
+ *  \param      port, cfg    serial port and configuration
+ *  \param      stats        statistics, private
+ */
+typedef struct {
+    uint8_t  *frame;
+    uint8_t  *encoded;
+    uint8_t  *rx;
+    uint8_t  reply[EMBEDD_TELEMETRY_CONTROL_SIZE];
+    uint16_t capacity;
+    uint16_t rx_capacity;
+    uint16_t fill;
+    uint16_t rx_fill;
+    uint8_t  reply_size;
+    uint8_t  ready;
+    uint8_t  rx_overflow;
+    uint8_t  state;
+    uint16_t seq;
+    uint32_t first_us;
+    uint32_t baud;
+    uint32_t pending_baud;
+    uint32_t confirm_us;
+    const embedd_telemetry_port_t *port;
+    embedd_telemetry_cfg_t cfg;
+    embedd_telemetry_stats_t stats;
+} embedd_telemetry_t;
+
+/*!
+ *  \macro  EMBEDD_TELEMETRY_DEFINE
+ *  \brief  creates a telemetry stream with static buffers
+ *
+ *  \param  var          name of the stream's variable
+ *  \param  _frame_size  size of a data frame including header and CRC, @EMBEDD_TELEMETRY_CONTROL_SIZE up to 65535 bytes
+ *  \param  _rx_size     size of the longest frame received, at least 16 bytes
+ */
+#define EMBEDD_TELEMETRY_DEFINE(var, _frame_size, _rx_size)\
+  _Static_assert( ( (_frame_size) >= EMBEDD_TELEMETRY_CONTROL_SIZE ) && ( (_frame_size) <= 0xFFFFU ), #var " frame size out of range" );\
+  _Static_assert( ( (_rx_size) >= 16U ) && ( (_rx_size) <= 0xFFFFU ), #var " rx size out of range" );\
+  static uint8_t var##_frame[_frame_size];\
+  static uint8_t var##_encoded[EMBEDD_TELEMETRY_ENCODED_SIZE( _frame_size )];\
+  static uint8_t var##_rx[_rx_size];\
+  embedd_telemetry_t var = { .frame = var##_frame, .encoded = var##_encoded, .rx = var##_rx,\
+                             .capacity = (_frame_size), .rx_capacity = (_rx_size) };
+
+/*!
+ *  \fn       embedd_telemetry_init
+ *  \brief    initializes a stream, it talks text until the host sends HELLO
+ *
+ *  \param    tm       pointer to the stream
+ *  \param    port     pointer to the serial port, kept
+ *  \param    cfg      pointer to the configuration, copied
+ *
+ *  \result   EMBEDD_RESULT_OK on success, EMBEDD_RESULT_ERR if not even one record fits into a frame
+ */
+EMBEDD_RESULT embedd_telemetry_init( embedd_telemetry_t *tm, const embedd_telemetry_port_t *port, const embedd_telemetry_cfg_t *cfg );
+
+/*!
+ *  \fn       embedd_telemetry_streaming
+ *  \brief    tells whether the port belongs to the binary stream, then no text may be sent
+ *
+ *  \param    tm       pointer to the stream
+ *
+ *  \result   true from HELLO until STOP is answered, also while a baud rate change waits for confirmation
+ */
+bool embedd_telemetry_streaming( const embedd_telemetry_t *tm );
+
+/*!
+ *  \fn       embedd_telemetry_add
+ *  \brief    adds a record to the current frame, the frame is sent when it is full
+ *
+ *  A full frame waits for the port while the next record arrives. If the
+ *  port is still busy then, the frame is dropped but keeps its sequence number.
+ *
+ *  \param    tm       pointer to the stream
+ *  \param    record   pointer to record_size bytes
+ *  \param    now_us   current time, starts the age of a new frame
+ *
+ *  \result   EMBEDD_RESULT_OK if the record was taken, EMBEDD_RESULT_ERR if not streaming
+ */
+EMBEDD_RESULT embedd_telemetry_add( embedd_telemetry_t *tm, const void *record, uint32_t now_us );
+
+/*!
+ *  \fn       embedd_telemetry_flush
+ *  \brief    sends the current frame if it holds records, or makes it wait for the port
+ *
+ *  \param    tm       pointer to the stream
+ */
+void embedd_telemetry_flush( embedd_telemetry_t *tm );
+
+/*!
+ *  \fn       embedd_telemetry_send_log
+ *  \brief    sends log text in a LOG frame while streaming
+ *
+ *  Answers and data frames go first, so the text is only taken when none
+ *  of them waits and the port is free.
+ *
+ *  \param    tm       pointer to the stream
+ *  \param    text     pointer to the text
+ *  \param    size     number of bytes
+ *
+ *  \result   number of bytes sent, at most @EMBEDD_TELEMETRY_LOG_MAX, 0 if not streaming or the port is taken
+ */
+uint32_t embedd_telemetry_send_log( embedd_telemetry_t *tm, const uint8_t *text, uint32_t size );
+
+/*!
+ *  \fn       embedd_telemetry_receive
+ *  \brief    passes received bytes, commands are answered from @embedd_telemetry_process
+ *
+ *  \param    tm       pointer to the stream
+ *  \param    data     pointer to the bytes
+ *  \param    size     number of bytes
+ */
+void embedd_telemetry_receive( embedd_telemetry_t *tm, const uint8_t *data, uint32_t size );
+
+/*!
+ *  \fn       embedd_telemetry_process
+ *  \brief    sends answers and aged frames, switches baud rates; call it from the main loop
+ *
+ *  \param    tm       pointer to the stream
+ *  \param    now_us   current time
+ */
+void embedd_telemetry_process( embedd_telemetry_t *tm, uint32_t now_us );
+
+/*!
+ *  \fn       embedd_telemetry_get_stats
+ *  \brief    reads the statistics
+ *
+ *  \param    tm       pointer to the stream
+ *  \param    stats    pointer to the statistics to fill in
+ *  \param    reset    true to clear the counters after reading
+ */
+void embedd_telemetry_get_stats( embedd_telemetry_t *tm, embedd_telemetry_stats_t *stats, bool reset );
+
+/*!
+ *  \fn       embedd_telemetry_cobs_encode
+ *  \brief    COBS encodes a buffer and appends the 0x00 delimiter
+ *
+ *  \param    src      pointer to the data
+ *  \param    size     number of bytes
+ *  \param    dst      pointer to @EMBEDD_TELEMETRY_ENCODED_SIZE(size) bytes, must not overlap src
+ *
+ *  \result   number of bytes written including the delimiter
+ */
+uint32_t embedd_telemetry_cobs_encode( const uint8_t *src, uint32_t size, uint8_t *dst );
+
+/*!
+ *  \fn       embedd_telemetry_cobs_decode
+ *  \brief    decodes a COBS frame in place
+ *
+ *  \param    buf      pointer to the encoded bytes without the delimiter
+ *  \param    size     number of bytes
+ *
+ *  \result   number of decoded bytes, 0 for an invalid encoding
+ */
+uint32_t embedd_telemetry_cobs_decode( uint8_t *buf, uint32_t size );
+
+/*!
+ *  \fn       embedd_telemetry_crc32
+ *  \brief    CRC-32 of zlib in software, 4 bits at a time
+ *
+ *  \param    data     pointer to the data
+ *  \param    size     number of bytes
+ *
+ *  \result   the CRC
+ */
+uint32_t embedd_telemetry_crc32( const uint8_t *data, uint32_t size );
+
+#endif //_SRC_EMBEDD_TELEMETRY_H
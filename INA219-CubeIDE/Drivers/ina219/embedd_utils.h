@@ -65,6 +65,82 @@ size_t  embedd_copy(void* dst, void* src, size_t Size);
  */
 size_t  embedd_pack(void* dst, void* src, size_t Size);
 
+/*!
+ * \brief Checks if data of the given size is reversed with one swap instead of
+ * the byte loop of \ref embedd_pack.
+ *
+ * Measured on the host only (tools/swap_bench.c): the swap unpacks a value in
+ * about 1.5 cycles against 7 to 13 for the loop, while a whole register read
+ * shows no difference beyond noise. No target figures were taken.
+ *
+ * \param Size The size of the data in bytes.
+ */
+#define EMBEDD_PACK_FAST(Size) ( (Size) == 1 || (Size) == 2 || (Size) == 4 )
+
+/*!
+ * \brief Reverses the byte order of a 16-bit value with __builtin_bswap16.
+ */
+static inline uint16_t embedd_swap16(uint16_t val) {
+    return __builtin_bswap16( val );
+}
+
+/*!
+ * \brief Reverses the byte order of a 32-bit value with __builtin_bswap32.
+ */
+static inline uint32_t embedd_swap32(uint32_t val) {
+    return __builtin_bswap32( val );
+}
+
+/*!
+ * \brief Reverses the byte order of data in place.
+ *
+ * Only sizes accepted by \ref EMBEDD_PACK_FAST are handled, the data may be
+ * unaligned.
+ *
+ * \param data Pointer to the data.
+ * \param Size The size of the data in bytes.
+ *
+ * \return true if the data was handled, false for other sizes.
+ */
+static inline bool embedd_swap_in_place(void* data, size_t Size) {
+    if (Size == 2) {
+        uint16_t val;
+        memcpy( &val, data, sizeof(val) );
+        val = embedd_swap16( val );
+        memcpy( data, &val, sizeof(val) );
+        return true;
+    }
+    if (Size == 4) {
+        uint32_t val;
+        memcpy( &val, data, sizeof(val) );
+        val = embedd_swap32( val );
+        memcpy( data, &val, sizeof(val) );
+        return true;
+    }
+    return Size == 1;
+}
+
+/*!
+ * \brief Copy data in reverse order, using one swap for 1, 2 and 4 bytes.
+ *
+ * Same as \ref embedd_pack, which remains the path for other sizes. The
+ * buffers must not overlap.
+ *
+ * \param dst Pointer to the destination buffer.
+ * \param src Pointer to the source buffer.
+ * \param Size The size of the data to be packed (in bytes).
+ *
+ * \return The size of the data that was packed.
+ */
+static inline size_t embedd_pack_fast(void* dst, const void* src, size_t Size) {
+    if (EMBEDD_PACK_FAST(Size)) {
+        memcpy( dst, src, Size );
+        embedd_swap_in_place( dst, Size );
+        return Size;
+    }
+    return embedd_pack( dst, (void*)src, Size );
+}
+
 /*!
  *  \struct table_t
  *  \brief  struct for common type of table data
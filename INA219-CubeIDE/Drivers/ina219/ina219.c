@@ -25,4 +25,5 @@
 const ina219_api_t ina219_api = {
   .ina219_write_reg = &ina219_write_reg,
   .ina219_read_reg = &ina219_read_reg,
+  .ina219_read_snapshot = &ina219_read_snapshot,
 };
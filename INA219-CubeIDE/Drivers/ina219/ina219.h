@@ -34,6 +34,21 @@
 #include "ina219_data_types.h"
 #include "ina219_events.h"
 #include "ina219_registers.h"
+#include "ina219_snapshot.h"
+#include "ina219_async.h"
+#include "ina219_static.h"
+#include "ina219_regmap.h"
+#include "ina219_shadow.h"
+#include "ina219_convert.h"
+#include "ina219_calibrate.h"
+#include "ina219_sample.h"
+#include "ina219_autorange.h"
+#include "ina219_poll.h"
+#include "ina219_trigger.h"
+#include "ina219_energy.h"
+#include "ina219_stats.h"
+#include "ina219_telemetry.h"
+#include "ina219_fields.h"
 
 /*!
  * \var ina219_api
@@ -41,6 +56,23 @@
  */
 extern const ina219_api_t ina219_api;
 
+#if INA219_STATIC_DISPATCH
+
+#define INA219_WRITE_REG(dev, _typename, var) \
+  ( INA219_STATIC_CHECK_SIZE(_typename), ina219_write_reg_direct(&(dev), \
+  _typename##_write_reg_addr, &(var), \
+  sizeof(_typename), _typename##_delay) )
+
+#define INA219_READ_REG(dev, _typename, var) \
+  ( INA219_STATIC_CHECK_SIZE(_typename), ina219_read_reg_direct(&(dev), \
+  _typename##_read_reg_addr, &(var), \
+  sizeof(_typename), _typename##_delay) )
+
+#define INA219_READ_SNAPSHOT(dev, snap) \
+  ina219_read_snapshot(&(dev), &(snap))
+
+#else
+
 /*!
  * \macro INA219_WRITE_REG
  * \brief write register macro
@@ -68,6 +100,18 @@ extern const ina219_api_t ina219_api;
   sizeof(_typename), _typename##_delay)
 
 /*!
+ * \macro INA219_READ_SNAPSHOT
+ * \brief read all registers from a single conversion macro
+ * 
+ * \param dev device object
+ * \param snap ina219_snapshot_t variable for read data
+ */
+#define INA219_READ_SNAPSHOT(dev, snap) \
+  ((ina219_api_t*)(dev).api)->ina219_read_snapshot(&(dev), &(snap))
+
+#endif // INA219_STATIC_DISPATCH
+
+/*!
 * \macro INA219_I2C_DEVICE_DEFINE
 * \brief Macro to create the device's objects
 *
@@ -82,4 +126,21 @@ extern const ina219_api_t ina219_api;
   };\
   EMBEDD_DEVICE_DEFINE_FULL(var, _name_of_device, &var##_cfg, &ina219_api, NULL, &var##_data, NULL, NULL)
 
+/*!
+* \macro INA219_I2C_DEVICE_DEFINE_STATIC
+* \brief Macro to create the device's objects bound to a bus and an address
+*
+* \param var name of device object's variable
+* \param _name_of_device string name of the device (for debug purpose)
+* \param _bus pointer to the embedd_bus_t the device is on
+* \param _addr device's address on I2C bus
+*/
+#define INA219_I2C_DEVICE_DEFINE_STATIC(var, _name_of_device, _bus, _addr)\
+  static ina219_data_t var##_data;\
+  static embedd_i2c_dev_cfg_t var##_i2c_cfg = { .addr = (_addr) };\
+  static embedd_dev_cfg_t var##_cfg = {\
+    .bus_cfg = { .bus_type = EMBEDD_BUS_TYPE_I2C, .configs = (void*)&var##_i2c_cfg },\
+  };\
+  EMBEDD_DEVICE_DEFINE_FULL(var, _name_of_device, &var##_cfg, &ina219_api, NULL, &var##_data, NULL, (_bus))
+
 #endif//_SRC_INA219_H
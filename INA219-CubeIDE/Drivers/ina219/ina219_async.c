@@ -0,0 +1,227 @@
+/*!
+ * \file ina219_async.c
+ * \brief Power monitor non-blocking register access
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+
+#include "embedd_device.h"
+#include "embedd_utils.h"
+#include "embedd_hal.h"
+
+#include "ina219_registers.h"
+#include "ina219_async.h"
+#include "ina219_shadow.h"
+
+enum {
+  INA219_ASYNC_IDLE = 0,
+  INA219_ASYNC_STARTING,
+  INA219_ASYNC_WAIT_READY,
+  INA219_ASYNC_ADDR,
+  INA219_ASYNC_WAIT_ADDR,
+  INA219_ASYNC_DATA,
+  INA219_ASYNC_ADDR_DATA,
+};
+
+static void ina219_async_start_next(ina219_async_t* async);
+static void ina219_async_done(void* ctx, EMBEDD_RESULT result);
+
+static void ina219_async_finish(ina219_async_t* async, EMBEDD_RESULT result) {
+    ina219_async_xfer_t* xfer = &async->queue[async->head];
+    if( result == EMBEDD_RESULT_OK ) {
+      async->completed++;
+    } else {
+      ((ina219_data_t*)async->dev->data)->reg_ptr_valid = 0;
+      if( xfer->write ) {
+        ina219_shadow_written( (ina219_data_t*)async->dev->data, xfer->reg_addr, xfer->reg, result );
+      }
+      async->errors++;
+    }
+    if( xfer->cb != NULL ) {
+      xfer->cb( async->dev, xfer->reg, result, xfer->user );
+    }
+    uint32_t state = embedd_hal_critical_enter();
+    async->head = (uint8_t)( ( async->head + 1 ) % async->depth );
+    async->count--;
+    embedd_hal_critical_exit( state );
+    ina219_async_start_next( async );
+}
+
+static void ina219_async_read_data(ina219_async_t* async) {
+    ina219_async_xfer_t* xfer = &async->queue[async->head];
+    embedd_device_t* dev = async->dev;
+    async->state = INA219_ASYNC_DATA;
+    if( dev->bus->read_async( dev, async->buf, xfer->reg_size, ina219_async_done, async ) != EMBEDD_RESULT_OK ) {
+      ina219_async_finish( async, EMBEDD_RESULT_ERR );
+    }
+}
+
+static void ina219_async_done(void* ctx, EMBEDD_RESULT result) {
+    ina219_async_t* async = (ina219_async_t*)ctx;
+    ina219_async_xfer_t* xfer = &async->queue[async->head];
+    ina219_data_t* _data = (ina219_data_t*)async->dev->data;
+    if( result != EMBEDD_RESULT_OK ) {
+      ina219_async_finish( async, result );
+      return;
+    }
+    if( async->state == INA219_ASYNC_ADDR ) {
+      _data->reg_ptr = xfer->reg_addr;
+      _data->reg_ptr_valid = 1;
+      if( xfer->delay != 0 ) {
+        // waited for in ina219_async_process(), never in interrupt context
+        embedd_hal_deadline_arm( &async->wait, xfer->delay * 1000U );
+        async->state = INA219_ASYNC_WAIT_ADDR;
+        return;
+      }
+      ina219_async_read_data( async );
+      return;
+    }
+    if( async->state == INA219_ASYNC_ADDR_DATA ) {
+      _data->reg_ptr = xfer->reg_addr;
+      _data->reg_ptr_valid = 1;
+      embedd_pack_fast( xfer->reg, async->buf + INA219_REGISTER_ADDR_SIZE, xfer->reg_size );
+    } else if( xfer->write ) {
+      _data->reg_ptr = xfer->reg_addr;
+      _data->reg_ptr_valid = 1;
+      if( xfer->reg_addr == ina219_configuration_write_reg_addr && ((ina219_configuration_t*)xfer->reg)->rst ) {
+        _data->reg_ptr_valid = 0;
+      }
+      ina219_shadow_written( _data, xfer->reg_addr, xfer->reg, EMBEDD_RESULT_OK );
+      embedd_hal_deadline_arm( &_data->ready, xfer->delay * 1000U );
+    } else {
+      embedd_pack_fast( xfer->reg, async->buf, xfer->reg_size );
+    }
+    ina219_async_finish( async, EMBEDD_RESULT_OK );
+}
+
+static void ina219_async_start_next(ina219_async_t* async) {
+    uint32_t state = embedd_hal_critical_enter();
+    if( async->count == 0 ) {
+      async->state = INA219_ASYNC_IDLE;
+      embedd_hal_critical_exit( state );
+      return;
+    }
+    embedd_hal_critical_exit( state );
+
+    ina219_async_xfer_t* xfer = &async->queue[async->head];
+    embedd_device_t* dev = async->dev;
+    ina219_data_t* _data = (ina219_data_t*)dev->data;
+    if( !embedd_hal_deadline_expired( &_data->ready ) ) {
+      // the delay of the previous write has not elapsed yet
+      async->wait = _data->ready;
+      async->state = INA219_ASYNC_WAIT_READY;
+      return;
+    }
+    _data->ready.armed = 0;
+    uint32_t reg_addr = xfer->reg_addr;
+    EMBEDD_RESULT result;
+    if( xfer->write ) {
+      embedd_pack_fast( async->buf, &reg_addr, INA219_REGISTER_ADDR_SIZE );
+      embedd_pack_fast( async->buf + INA219_REGISTER_ADDR_SIZE, xfer->reg, xfer->reg_size );
+      async->state = INA219_ASYNC_DATA;
+      result = dev->bus->write_async( dev, async->buf, INA219_REGISTER_ADDR_SIZE + xfer->reg_size, ina219_async_done, async );
+    } else if( _data->reg_ptr_valid && _data->reg_ptr == xfer->reg_addr ) {
+      _data->reg_ptr_hits++;
+      async->state = INA219_ASYNC_DATA;
+      result = dev->bus->read_async( dev, async->buf, xfer->reg_size, ina219_async_done, async );
+    } else if( xfer->delay == 0 && dev->bus->write_read_async != NULL ) {
+      // address and data in one transfer with a repeated START, the data lands behind the address
+      _data->reg_ptr_misses++;
+      embedd_pack_fast( async->buf, &reg_addr, INA219_REGISTER_ADDR_SIZE );
+      async->state = INA219_ASYNC_ADDR_DATA;
+      result = dev->bus->write_read_async( dev, async->buf, INA219_REGISTER_ADDR_SIZE,
+                                           async->buf + INA219_REGISTER_ADDR_SIZE, xfer->reg_size, ina219_async_done, async );
+    } else {
+      _data->reg_ptr_misses++;
+      embedd_pack_fast( async->buf, &reg_addr, INA219_REGISTER_ADDR_SIZE );
+      async->state = INA219_ASYNC_ADDR;
+      result = dev->bus->write_async( dev, async->buf, INA219_REGISTER_ADDR_SIZE, ina219_async_done, async );
+    }
+    if( result != EMBEDD_RESULT_OK ) {
+      ina219_async_finish( async, result );
+    }
+}
+
+static EMBEDD_RESULT ina219_async_queue(ina219_async_t* async, uint8_t write, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay, ina219_async_cb_t cb, void* user) {
+    if( async == NULL || async->dev == NULL || async->queue == NULL || reg == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    embedd_device_t* dev = async->dev;
+    if( dev->bus == NULL || dev->data == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    if( dev->bus->write_async == NULL || ( !write && dev->bus->read_async == NULL ) ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    if( reg_size == 0 || reg_size + INA219_REGISTER_ADDR_SIZE > sizeof(async->buf) ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    if( write && !ina219_regmap_writable( reg_addr ) ) {
+      return EMBEDD_RESULT_ERR;
+    }
+
+    uint32_t state = embedd_hal_critical_enter();
+    if( async->count >= async->depth ) {
+      embedd_hal_critical_exit( state );
+      return EMBEDD_RESULT_ERR;
+    }
+    ina219_async_xfer_t* xfer = &async->queue[( async->head + async->count ) % async->depth];
+    xfer->reg      = reg;
+    xfer->delay    = delay;
+    xfer->cb       = cb;
+    xfer->user     = user;
+    xfer->reg_addr = (uint8_t)reg_addr;
+    xfer->reg_size = (uint8_t)reg_size;
+    xfer->write    = write;
+    async->count++;
+    uint8_t idle = ( async->state == INA219_ASYNC_IDLE );
+    if( idle ) {
+      async->state = INA219_ASYNC_STARTING;
+    }
+    embedd_hal_critical_exit( state );
+
+    if( idle ) {
+      ina219_async_start_next( async );
+    }
+    return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT ina219_async_write_reg(ina219_async_t* async, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay, ina219_async_cb_t cb, void* user) {
+    return ina219_async_queue( async, 1, reg_addr, reg, reg_size, delay, cb, user );
+}
+
+EMBEDD_RESULT ina219_async_read_reg(ina219_async_t* async, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay, ina219_async_cb_t cb, void* user) {
+    return ina219_async_queue( async, 0, reg_addr, reg, reg_size, delay, cb, user );
+}
+
+void ina219_async_process(ina219_async_t* async) {
+    if( async == NULL || !embedd_hal_deadline_expired( &async->wait ) ) {
+      return;
+    }
+    if( async->state == INA219_ASYNC_WAIT_ADDR ) {
+      async->wait.armed = 0;
+      ina219_async_read_data( async );
+    } else if( async->state == INA219_ASYNC_WAIT_READY ) {
+      async->wait.armed = 0;
+      ina219_async_start_next( async );
+    }
+}
+
+bool ina219_async_busy(const ina219_async_t* async) {
+    return ( async != NULL ) && ( async->count != 0 );
+}
@@ -0,0 +1,193 @@
+/*!
+ * \file ina219_async.h
+ * \brief Power monitor non-blocking register access
+ *
+ * Queues register reads and writes and runs them through the asynchronous
+ * functions of the device's bus (interrupt or DMA driven), calling a user
+ * callback when each of them completes.
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#ifndef _SRC_INA219_ASYNC_H
+#define _SRC_INA219_ASYNC_H
+
+#include "embedd_device.h"
+#include "ina219_data_types.h"
+
+/*!
+ * \typedef ina219_async_cb_t
+ * \brief Completion callback of a queued register access, usually called from interrupt context
+ *
+ * \param dev pointer to the device the access was made on
+ * \param reg pointer to the caller's register variable
+ * \param result EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ * \param user user pointer given when the access was queued
+ */
+typedef void (*ina219_async_cb_t)(embedd_device_t* dev, void* reg, EMBEDD_RESULT result, void* user);
+
+/*!
+ * \struct ina219_async_xfer_t
+ * \brief Queued register access
+ *
+ * \var reg       pointer to the caller's register variable
+ * \var delay     delay in milliseconds after the address write
+ * \var cb        completion callback, may be NULL
+ * \var user      user pointer passed to cb
+ * \var reg_addr  register address
+ * \var reg_size  size of the register data in bytes
+ * \var write     non-zero for a register write
+ */
+typedef struct {
+  void*             reg;
+  uint32_t          delay;
+  ina219_async_cb_t cb;
+  void*             user;
+  uint8_t           reg_addr;
+  uint8_t           reg_size;
+  uint8_t           write;
+} ina219_async_xfer_t;
+
+/*!
+ * \struct ina219_async_t
+ * \brief Asynchronous register engine bound to one device
+ *
+ * \var dev        device the engine works on
+ * \var queue      statically allocated transfer queue
+ * \var depth      number of entries in queue
+ * \var head       index of the transfer in progress
+ * \var count      number of queued transfers including the one in progress
+ * \var state      state of the transfer in progress
+ * \var buf        buffer for the address and the register data on the bus
+ * \var wait       deadline of a delayed transfer, see \ref ina219_async_process
+ * \var completed  number of transfers finished successfully
+ * \var errors     number of transfers finished with an error
+ */
+typedef struct {
+  embedd_device_t*     dev;
+  ina219_async_xfer_t* queue;
+  uint8_t              depth;
+  volatile uint8_t     head;
+  volatile uint8_t     count;
+  volatile uint8_t     state;
+  uint8_t              buf[INA219_WRITE_MESSAGE_MAX_SIZE];
+  embedd_hal_deadline_t wait;
+  uint32_t             completed;
+  uint32_t             errors;
+} ina219_async_t;
+
+/*!
+ * \macro INA219_ASYNC_DEFINE
+ * \brief Macro to create an asynchronous register engine for a device
+ *
+ * \param var name of the engine's variable
+ * \param _dev device object created with INA219_I2C_DEVICE_DEFINE
+ * \param _depth maximum number of queued transfers
+ */
+#define INA219_ASYNC_DEFINE(var, _dev, _depth)\
+  static ina219_async_xfer_t var##_queue[_depth];\
+  ina219_async_t var = { .dev = &(_dev), .queue = var##_queue, .depth = (_depth) };
+
+/*!
+ * \macro INA219_ASYNC_WRITE_REG
+ * \brief queue register write macro
+ *
+ * \param async engine object
+ * \param _typename typename for register
+ * \param var variable for writing data, must stay valid until the callback
+ * \param cb completion callback
+ * \param user user pointer passed to the callback
+ */
+#define INA219_ASYNC_WRITE_REG(async, _typename, var, cb, user) \
+  ina219_async_write_reg(&(async), _typename##_write_reg_addr, &(var), \
+  sizeof(_typename), _typename##_delay, (cb), (user))
+
+/*!
+ * \macro INA219_ASYNC_READ_REG
+ * \brief queue register read macro
+ *
+ * \param async engine object
+ * \param _typename typename for register
+ * \param var variable for read data, must stay valid until the callback
+ * \param cb completion callback
+ * \param user user pointer passed to the callback
+ */
+#define INA219_ASYNC_READ_REG(async, _typename, var, cb, user) \
+  ina219_async_read_reg(&(async), _typename##_read_reg_addr, &(var), \
+  sizeof(_typename), _typename##_delay, (cb), (user))
+
+/*!
+ * ina219_async_write_reg
+ * 
+ * \brief Queues a register write and starts it if the bus is idle. The data is
+ * taken from \p reg when the transfer starts, not when it is queued.
+ * 
+ * \param async pointer to ina219_async_t the engine
+ * \param reg_addr uint32_t The register address to write to
+ * \param reg pointer to void Pointer to the data to write
+ * \param reg_size uint32_t Size of the register data in bytes
+ * \param delay uint32_t delay Delay in milliseconds after the write operation
+ * \param cb ina219_async_cb_t completion callback, may be NULL
+ * \param user pointer to void user pointer passed to the callback
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK if queued, EMBEDD_RESULT_ERR if the queue is full,
+ * the bus has no asynchronous functions or the register cannot be written
+ */
+EMBEDD_RESULT ina219_async_write_reg(ina219_async_t* async, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay, ina219_async_cb_t cb, void* user);
+
+/*!
+ * ina219_async_read_reg
+ * 
+ * \brief Queues a register read and starts it if the bus is idle. The pointer
+ * register cache of the device is used the same way as by ina219_read_reg;
+ * without a delay, an address write and the read run as one transfer when the
+ * bus has write_read_async.
+ * 
+ * \param async pointer to ina219_async_t the engine
+ * \param reg_addr uint32_t The register address to read from
+ * \param reg pointer to void Pointer to the variable receiving the data
+ * \param reg_size uint32_t Size of the register data in bytes
+ * \param delay uint32_t delay Delay in milliseconds after the address write
+ * \param cb ina219_async_cb_t completion callback, may be NULL
+ * \param user pointer to void user pointer passed to the callback
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK if queued, EMBEDD_RESULT_ERR if the queue is full
+ * or the bus has no asynchronous functions
+ */
+EMBEDD_RESULT ina219_async_read_reg(ina219_async_t* async, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay, ina219_async_cb_t cb, void* user);
+
+/*!
+ * ina219_async_process
+ * 
+ * \brief Continues a transfer waiting for a register delay to elapse. Delays
+ * cannot be waited for in interrupt context, so when registers with non-zero
+ * delays are accessed this must be called periodically from the main loop.
+ * 
+ * \param async pointer to ina219_async_t the engine
+ */
+void ina219_async_process(ina219_async_t* async);
+
+/*!
+ * ina219_async_busy
+ * 
+ * \param async pointer to ina219_async_t the engine
+ * 
+ * \return bool true while transfers are queued or in progress
+ */
+bool ina219_async_busy(const ina219_async_t* async);
+
+#endif//_SRC_INA219_ASYNC_H
@@ -0,0 +1,178 @@
+/*!
+ * \file ina219_autorange.c
+ * \brief Power monitor PGA and bus range auto-ranging
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#include "embedd_hal.h"
+
+#include "ina219_autorange.h"
+#include "ina219_calibrate.h"
+#include "ina219_shadow.h"
+
+// shunt voltage full scale of PGA setting pg in register counts
+#define INA219_AUTORANGE_SHUNT_FS(pg) ( 4000UL << (pg) )
+
+static EMBEDD_RESULT ina219_autorange_switch(ina219_autorange_t* ar, uint8_t pg, uint8_t brng) {
+    embedd_device_t* dev = ar->dev;
+    if( ina219_shadow_set_pg( dev, pg ) != EMBEDD_RESULT_OK ||
+        ina219_shadow_set_brng( dev, brng ) != EMBEDD_RESULT_OK ||
+        ina219_shadow_set_calibration( dev, ar->calibration[pg] ) != EMBEDD_RESULT_OK ||
+        ina219_shadow_commit( dev ) != EMBEDD_RESULT_OK ) {
+      ina219_shadow_discard( dev );
+      ar->switch_errors++;
+      return EMBEDD_RESULT_ERR;
+    }
+    // range and switch time are read together by ina219_autorange_tag()
+    uint32_t state = embedd_hal_critical_enter();
+    ar->range = INA219_RANGE( pg, brng );
+    ar->switched_at = embedd_hal_get_us();
+    embedd_hal_critical_exit( state );
+    ar->pg_below = 0;
+    ar->bus_below = 0;
+    ar->switches++;
+    return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT ina219_autorange_init(ina219_autorange_t* ar, embedd_device_t* dev, const ina219_autorange_cfg_t* cfg, uint32_t shunt_uohm) {
+    if( ar == NULL || cfg == NULL || shunt_uohm == 0 ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    if( cfg->pg_min > cfg->pg_max || !INA219_CONFIGURATION_PG_VALID( cfg->pg_max ) ||
+        !INA219_CONFIGURATION_BRNG_VALID( cfg->brng ) ||
+        cfg->up_pct > 100 || cfg->down_pct >= cfg->up_pct ||
+        ( cfg->brng_auto && cfg->bus_down_mv >= cfg->bus_up_mv ) ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    ar->dev = NULL;
+    ar->cfg = *cfg;
+    for( uint8_t pg = 0; pg < 4; pg++ ) {
+      // uV * 1e6 / uOhm: the current at the full scale of this PGA setting
+      uint64_t fs_ua = (uint64_t)INA219_AUTORANGE_SHUNT_FS( pg ) * INA219_SHUNT_VOLTAGE_LSB_UV * 1000000U / shunt_uohm;
+      ina219_calibrate_t cal;
+      if( fs_ua == 0 || fs_ua > UINT32_MAX ||
+          ina219_calibrate_solve( shunt_uohm, (uint32_t)fs_ua, cfg->brng, &cal ) != EMBEDD_RESULT_OK ) {
+        if( pg >= cfg->pg_min && pg <= cfg->pg_max ) {
+          return EMBEDD_RESULT_ERR;
+        }
+        // never switched to; samples of it are converted from the shunt voltage
+        cal.calibration = 0;
+      }
+      ar->calibration[pg] = cal.calibration;
+      for( uint8_t brng = 0; brng < 2; brng++ ) {
+        if( ina219_scale_init_calibration( &ar->scale[INA219_RANGE( pg, brng )], cal.calibration, shunt_uohm, pg, brng ) != EMBEDD_RESULT_OK ) {
+          return EMBEDD_RESULT_ERR;
+        }
+      }
+    }
+    ar->dev = dev;
+    ar->pg_below = 0;
+    ar->bus_below = 0;
+    ar->switches = 0;
+    ar->switch_errors = 0;
+    if( ina219_autorange_switch( ar, cfg->pg_max, cfg->brng ) != EMBEDD_RESULT_OK ) {
+      ar->dev = NULL;
+      return EMBEDD_RESULT_ERR;
+    }
+    return EMBEDD_RESULT_OK;
+}
+
+void ina219_autorange_tag(const ina219_autorange_t* ar, ina219_sample_t* sample) {
+    if( ar->dev == NULL ) {
+      return;
+    }
+    // the range stays the one the trigger or poll module read from the
+    // configuration of the conversion, the device may have switched since
+    uint32_t state = embedd_hal_critical_enter();
+    uint32_t switched_at = ar->switched_at;
+    embedd_hal_critical_exit( state );
+    // signed: a sample read before the switch belongs to the settling period too
+    if( (int32_t)( sample->timestamp_us - switched_at ) < (int32_t)ar->cfg.settle_us ) {
+      sample->flags |= INA219_SAMPLE_FLAG_SETTLING;
+    }
+}
+
+// true once a condition has held for dwell_us, and dwell_us passed since the last switch
+static bool ina219_autorange_dwell(ina219_autorange_t* ar, uint8_t* below, uint32_t* below_at, uint32_t now) {
+    if( !*below ) {
+      *below = 1;
+      *below_at = now;
+    }
+    return ( now - *below_at ) >= ar->cfg.dwell_us && ( now - ar->switched_at ) >= ar->cfg.dwell_us;
+}
+
+EMBEDD_RESULT ina219_autorange_update(ina219_autorange_t* ar, const ina219_sample_t* sample) {
+    if( ar == NULL || ar->dev == NULL || sample == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    if( ( sample->flags & INA219_SAMPLE_FLAG_SETTLING ) || sample->range != ar->range ) {
+      return EMBEDD_RESULT_OK;
+    }
+    const ina219_autorange_cfg_t* cfg = &ar->cfg;
+    uint8_t pg = INA219_RANGE_PG( ar->range );
+    uint8_t brng = INA219_RANGE_BRNG( ar->range );
+    uint8_t new_pg = pg;
+    uint8_t new_brng = brng;
+    uint32_t now = sample->timestamp_us;
+
+    int32_t shunt = ina219_shunt_voltage_value( sample->shunt_voltage );
+    uint32_t shunt_pct = (uint32_t)( shunt < 0 ? -shunt : shunt ) * 100U;
+    if( shunt_pct >= INA219_AUTORANGE_SHUNT_FS( pg ) * 100U || INA219_FIELD_GET( sample->bus_voltage, BUS_VOLTAGE, OVF ) ) {
+      // clipped, the actual value is unknown
+      new_pg = cfg->pg_max;
+    } else if( shunt_pct >= INA219_AUTORANGE_SHUNT_FS( pg ) * cfg->up_pct ) {
+      while( new_pg < cfg->pg_max && shunt_pct >= INA219_AUTORANGE_SHUNT_FS( new_pg ) * cfg->up_pct ) {
+        new_pg++;
+      }
+    } else if( pg > cfg->pg_min && shunt_pct < INA219_AUTORANGE_SHUNT_FS( pg - 1 ) * cfg->down_pct ) {
+      if( ina219_autorange_dwell( ar, &ar->pg_below, &ar->pg_below_at, now ) ) {
+        while( new_pg > cfg->pg_min && shunt_pct < INA219_AUTORANGE_SHUNT_FS( new_pg - 1 ) * cfg->down_pct ) {
+          new_pg--;
+        }
+      }
+    } else {
+      ar->pg_below = 0;
+    }
+
+    if( cfg->brng_auto ) {
+      uint32_t bus_mv = ina219_convert_bus_mv( sample->bus_voltage );
+      if( brng == INA219_CONFIGURATION_BRNG_EQ_16V_FSR_DEFAULT_VALUE ) {
+        if( bus_mv >= cfg->bus_up_mv ) {
+          new_brng = INA219_CONFIGURATION_BRNG_EQ_32V_FSR;
+        }
+      } else if( bus_mv < cfg->bus_down_mv ) {
+        if( ina219_autorange_dwell( ar, &ar->bus_below, &ar->bus_below_at, now ) ) {
+          new_brng = INA219_CONFIGURATION_BRNG_EQ_16V_FSR_DEFAULT_VALUE;
+        }
+      } else {
+        ar->bus_below = 0;
+      }
+    }
+
+    if( new_pg == pg && new_brng == brng ) {
+      return EMBEDD_RESULT_OK;
+    }
+    return ina219_autorange_switch( ar, new_pg, new_brng );
+}
+
+const ina219_scale_t* ina219_autorange_scale(const ina219_autorange_t* ar, uint8_t range) {
+    if( ar == NULL || ar->dev == NULL || range >= INA219_RANGE_COUNT ) {
+      return NULL;
+    }
+    return &ar->scale[range];
+}
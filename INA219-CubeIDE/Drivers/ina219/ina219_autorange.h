@@ -0,0 +1,163 @@
+/*!
+ * \file ina219_autorange.h
+ * \brief Power monitor PGA and bus range auto-ranging
+ *
+ * Picks the most sensitive PGA setting that holds the shunt voltage and the
+ * bus range that holds the bus voltage. Every PGA setting has its own
+ * calibration, so the current LSB follows the range. Samples carry the range
+ * they were taken in and are converted with the scale of that range, the
+ * switch never applies a scale to a sample of another range.
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#ifndef _SRC_INA219_AUTORANGE_H
+#define _SRC_INA219_AUTORANGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "embedd_device.h"
+#include "ina219_sample.h"
+#include "ina219_convert.h"
+
+/*!
+ * \struct ina219_autorange_cfg_t
+ * \brief Auto-ranging thresholds
+ *
+ * \var up_pct       switch to a wider PGA range when the shunt voltage reaches this
+ *                   percentage of the full scale; clipping and the overflow flag
+ *                   switch straight to the widest allowed range
+ * \var down_pct     switch to a narrower PGA range when the shunt voltage stays below
+ *                   this percentage of the narrower full scale, less than up_pct
+ * \var pg_min       narrowest INA219_CONFIGURATION_PG_* setting to use
+ * \var pg_max       widest INA219_CONFIGURATION_PG_* setting to use
+ * \var brng_auto    true to switch the bus range too, false to keep brng
+ * \var brng         INA219_CONFIGURATION_BRNG_* setting at start, or always without brng_auto
+ * \var bus_up_mv    switch to the 32 V range at this bus voltage
+ * \var bus_down_mv  switch to the 16 V range when the bus voltage stays below this
+ * \var dwell_us     time a narrower range must be sufficient, and the minimum time
+ *                   since the last switch, before switching to it
+ * \var settle_us    time after a switch during which samples are flagged
+ *                   INA219_SAMPLE_FLAG_SETTLING, at least one conversion time
+ */
+typedef struct {
+  uint8_t  up_pct;
+  uint8_t  down_pct;
+  uint8_t  pg_min;
+  uint8_t  pg_max;
+  bool     brng_auto;
+  uint8_t  brng;
+  uint16_t bus_up_mv;
+  uint16_t bus_down_mv;
+  uint32_t dwell_us;
+  uint32_t settle_us;
+} ina219_autorange_cfg_t;
+
+/*!
+ * \struct ina219_autorange_t
+ * \brief Auto-ranging state of one device
+ *
+ * \var dev            device controlled
+ * \var cfg            thresholds
+ * \var scale          conversion constants of every range tag
+ * \var calibration    calibration register value of every PGA setting
+ * \var range          INA219_RANGE tag the device is set to
+ * \var switched_at    time of the last switch
+ * \var pg_below_at    time since a narrower PGA range has been sufficient
+ * \var bus_below_at   time since the 16 V range has been sufficient
+ * \var pg_below       non-zero while a narrower PGA range is sufficient
+ * \var bus_below      non-zero while the 16 V range is sufficient
+ * \var switches       number of range switches
+ * \var switch_errors  number of switches which failed to be written
+ */
+typedef struct {
+  embedd_device_t* dev;
+  ina219_autorange_cfg_t cfg;
+  ina219_scale_t scale[INA219_RANGE_COUNT];
+  uint16_t calibration[4];
+  volatile uint8_t range;
+  volatile uint32_t switched_at;
+  uint32_t pg_below_at;
+  uint32_t bus_below_at;
+  uint8_t  pg_below;
+  uint8_t  bus_below;
+  uint32_t switches;
+  uint32_t switch_errors;
+} ina219_autorange_t;
+
+/*!
+ * ina219_autorange_init
+ * 
+ * \brief Solves the calibration of every PGA setting between pg_min and pg_max
+ * with \ref ina219_calibrate_solve, each for the full scale current of its range,
+ * and sets the device to the widest range.
+ * 
+ * \param ar pointer to ina219_autorange_t the state to initialize
+ * \param dev pointer to embedd_device_t the structure representing the device,
+ * its shadow registers must be valid
+ * \param cfg pointer to ina219_autorange_cfg_t the thresholds, copied
+ * \param shunt_uohm uint32_t shunt resistance in microohms
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_ERR if the thresholds are not valid, a
+ * calibration cannot be solved or the device cannot be written, othewise EMBEDD_RESULT_OK
+ */
+EMBEDD_RESULT ina219_autorange_init(ina219_autorange_t* ar, embedd_device_t* dev, const ina219_autorange_cfg_t* cfg, uint32_t shunt_uohm);
+
+/*!
+ * ina219_autorange_tag
+ * 
+ * \brief Flags a sample INA219_SAMPLE_FLAG_SETTLING when it was taken less than
+ * settle_us after the last range switch. The range of the sample is left alone:
+ * the trigger and poll modules set it from the configuration the conversion
+ * ran with, which queued samples keep after a later switch. Does nothing when
+ * \p ar is not initialized. Safe to call from interrupt context.
+ * 
+ * \param ar pointer to ina219_autorange_t the auto-ranging state
+ * \param sample pointer to ina219_sample_t the sample to tag
+ */
+void ina219_autorange_tag(const ina219_autorange_t* ar, ina219_sample_t* sample);
+
+/*!
+ * ina219_autorange_update
+ * 
+ * \brief Checks a sample against the thresholds and switches the range through
+ * the shadow registers when needed. Settling samples and samples of another
+ * range are ignored. Wider ranges are switched to at once, narrower ones only
+ * after dwell_us.
+ * 
+ * \param ar pointer to ina219_autorange_t the auto-ranging state
+ * \param sample pointer to ina219_sample_t the latest tagged sample
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_ERR if a switch failed to be written, the
+ * device keeps the previous range, othewise EMBEDD_RESULT_OK
+ */
+EMBEDD_RESULT ina219_autorange_update(ina219_autorange_t* ar, const ina219_sample_t* sample);
+
+/*!
+ * ina219_autorange_scale
+ * 
+ * \brief Returns the conversion constants of a range tag.
+ * 
+ * \param ar pointer to ina219_autorange_t the auto-ranging state
+ * \param range uint8_t INA219_RANGE tag, usually ina219_sample_t.range
+ * 
+ * \return pointer to ina219_scale_t, NULL if \p ar is not initialized
+ */
+const ina219_scale_t* ina219_autorange_scale(const ina219_autorange_t* ar, uint8_t range);
+
+#endif//_SRC_INA219_AUTORANGE_H
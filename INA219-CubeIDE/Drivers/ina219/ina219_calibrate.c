@@ -0,0 +1,89 @@
+/*!
+ * \file ina219_calibrate.c
+ * \brief Power monitor calibration solver
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#include "ina219_calibrate.h"
+#include "ina219_shadow.h"
+
+// 0.04096 expressed for a current LSB in nanoamperes and a resistance in microohms
+#define INA219_CALIBRATE_NUM     40960000000000ULL
+#define INA219_CURRENT_RAW_MAX   32767U
+#define INA219_CALIBRATION_MAX   0xFFFEU
+#define INA219_SHUNT_FS_UV_MIN   40000U
+
+EMBEDD_RESULT ina219_calibrate_solve(uint32_t shunt_uohm, uint32_t max_current_ua, uint8_t brng, ina219_calibrate_t* cal) {
+    if( cal == NULL || shunt_uohm == 0 || max_current_ua == 0 || !INA219_CONFIGURATION_BRNG_VALID( brng ) ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    // uA * uOhm = pV, rounded up to uV
+    uint64_t i_r = (uint64_t)max_current_ua * shunt_uohm;
+    uint64_t shunt_uv = i_r / 1000000U + ( i_r % 1000000U != 0 );
+    uint8_t pg = INA219_CONFIGURATION_PG_GAIN_EQ_1_RANGE_EQ_40_MV;
+    while( shunt_uv > ( (uint64_t)INA219_SHUNT_FS_UV_MIN << pg ) ) {
+      if( pg == INA219_CONFIGURATION_PG_GAIN_EQ_8_RANGE_EQ_320_MV ) {
+        return EMBEDD_RESULT_ERR;
+      }
+      pg++;
+    }
+
+    // max_current / LSB <= 32767 with LSB = 0.04096 / (Cal * R), truncated like the datasheet equation
+    uint64_t calibration = (uint64_t)INA219_CURRENT_RAW_MAX * ( INA219_CALIBRATE_NUM / 1000U ) / i_r;
+    if( calibration > INA219_CALIBRATION_MAX ) {
+      calibration = INA219_CALIBRATION_MAX;
+    }
+    calibration &= INA219_CALIBRATION_FS_MASK;
+    if( calibration == 0 ) {
+      return EMBEDD_RESULT_ERR;
+    }
+
+    // the LSB the device applies after truncation, never smaller than the requested one
+    uint64_t den = calibration * shunt_uohm;
+    uint64_t lsb_na = ( INA219_CALIBRATE_NUM + den / 2 ) / den;
+    if( lsb_na == 0 || lsb_na * INA219_POWER_LSB_RATIO > UINT32_MAX ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    cal->calibration = (uint16_t)calibration;
+    cal->current_lsb_na = (uint32_t)lsb_na;
+    cal->power_lsb_nw = (uint32_t)( lsb_na * INA219_POWER_LSB_RATIO );
+    cal->full_scale_ua = (uint32_t)( (uint64_t)INA219_CURRENT_RAW_MAX * ( INA219_CALIBRATE_NUM / 1000U ) / den );
+    cal->shunt_uohm = shunt_uohm;
+    cal->pg = pg;
+    cal->brng = brng;
+    // rejects LSBs the multiply and shift conversion cannot represent before anything is written
+    ina219_scale_t scale;
+    return ina219_scale_init_calibration( &scale, cal->calibration, shunt_uohm, pg, brng );
+}
+
+EMBEDD_RESULT ina219_calibrate_apply(embedd_device_t* dev, const ina219_calibrate_t* cal, ina219_scale_t* scale) {
+    if( cal == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    if( ina219_shadow_set_pg( dev, cal->pg ) != EMBEDD_RESULT_OK ||
+        ina219_shadow_set_brng( dev, cal->brng ) != EMBEDD_RESULT_OK ||
+        ina219_shadow_set_calibration( dev, cal->calibration ) != EMBEDD_RESULT_OK ||
+        ina219_shadow_commit( dev ) != EMBEDD_RESULT_OK ) {
+      ina219_shadow_discard( dev );
+      return EMBEDD_RESULT_ERR;
+    }
+    if( scale == NULL ) {
+      return EMBEDD_RESULT_OK;
+    }
+    return ina219_scale_init_calibration( scale, cal->calibration, cal->shunt_uohm, cal->pg, cal->brng );
+}
@@ -0,0 +1,96 @@
+/*!
+ * \file ina219_calibrate.h
+ * \brief Power monitor calibration solver
+ *
+ * Computes the calibration register, the PGA setting and the current and power
+ * LSBs from the shunt resistance and the largest expected current, so that the
+ * device reports finished current and power values.
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#ifndef _SRC_INA219_CALIBRATE_H
+#define _SRC_INA219_CALIBRATE_H
+
+#include <stdint.h>
+
+#include "embedd_device.h"
+#include "embedd_error.h"
+#include "ina219_convert.h"
+
+/*!
+ * \struct ina219_calibrate_t
+ * \brief Result of the calibration solver
+ *
+ * \var calibration     calibration register value
+ * \var current_lsb_na  current register LSB in nanoamperes, rounded
+ * \var power_lsb_nw    power register LSB in nanowatts, rounded
+ * \var full_scale_ua   current at which the current register reaches its full scale
+ * \var shunt_uohm      shunt resistance in microohms
+ * \var pg              INA219_CONFIGURATION_PG_* setting covering the expected current
+ * \var brng            INA219_CONFIGURATION_BRNG_* setting
+ */
+typedef struct {
+  uint16_t calibration;
+  uint32_t current_lsb_na;
+  uint32_t power_lsb_nw;
+  uint32_t full_scale_ua;
+  uint32_t shunt_uohm;
+  uint8_t  pg;
+  uint8_t  brng;
+} ina219_calibrate_t;
+
+/*!
+ * ina219_calibrate_solve
+ * 
+ * \brief Computes the calibration for a shunt and the largest expected current.
+ * The current LSB is the smallest one which keeps \p max_current_ua within the
+ * signed current register, i.e. the largest calibration value up to 0xFFFE, and
+ * the PGA is the most sensitive setting whose range holds the shunt voltage at
+ * that current. The power register cannot overflow with that choice: at full
+ * scale current and 32 V it reaches 52428 counts.
+ * 
+ * No bus access, the result is applied by \ref ina219_calibrate_apply.
+ * 
+ * \param shunt_uohm uint32_t shunt resistance in microohms
+ * \param max_current_ua uint32_t largest expected current in microamperes
+ * \param brng uint8_t INA219_CONFIGURATION_BRNG_* setting
+ * \param cal pointer to ina219_calibrate_t the result
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_ERR if an argument is zero or not valid, the
+ * shunt voltage at \p max_current_ua exceeds 320 mV, no calibration value fits or
+ * the LSBs do not fit \ref ina219_scale_init_calibration (current LSB above about
+ * 1.6 mA), othewise EMBEDD_RESULT_OK
+ */
+EMBEDD_RESULT ina219_calibrate_solve(uint32_t shunt_uohm, uint32_t max_current_ua, uint8_t brng, ina219_calibrate_t* cal);
+
+/*!
+ * ina219_calibrate_apply
+ * 
+ * \brief Writes the calibration, PGA and bus range through the shadow registers,
+ * only the registers which change are written, and computes the matching
+ * conversion constants. Staged shadow changes are dropped on error.
+ * 
+ * \param dev pointer to embedd_device_t the structure representing the device
+ * \param cal pointer to ina219_calibrate_t the solver result
+ * \param scale pointer to ina219_scale_t the constants to compute, may be NULL
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT ina219_calibrate_apply(embedd_device_t* dev, const ina219_calibrate_t* cal, ina219_scale_t* scale);
+
+#endif//_SRC_INA219_CALIBRATE_H
@@ -0,0 +1,134 @@
+/*!
+ * \file ina219_convert.c
+ * \brief Power monitor unit conversion
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#include "ina219_convert.h"
+#include "ina219_fields.h"
+
+#define INA219_SCALE_MUL_MAX 32767U
+
+// current LSB 0.04096 / (Cal * R) A is INA219_CALIBRATION_UA_NUM / (Cal * R) uA with R in microohms
+#define INA219_CALIBRATION_UA_NUM 40960000000ULL
+
+static const int16_t ina219_shunt_fs_raw[] = { 4000, 8000, 16000, 32000 };
+static const uint16_t ina219_bus_fs_mv[] = { 16000, 32000 };
+
+// out = raw * num / den: the largest shift keeping the multiplier within range gives the best precision
+static EMBEDD_RESULT ina219_scale_factor(ina219_scale_factor_t* f, uint64_t num, uint64_t den) {
+    f->mul = 0;
+    f->shift = 0;
+    if( num == 0 || den == 0 ) {
+      return EMBEDD_RESULT_OK;
+    }
+    for( int shift = 31; shift >= 0; shift-- ) {
+      if( num > ( UINT64_MAX >> shift ) ) {
+        continue;
+      }
+      uint64_t mul = ( ( num << shift ) + den / 2 ) / den;
+      if( mul <= INA219_SCALE_MUL_MAX ) {
+        f->mul = (uint16_t)mul;
+        f->shift = (uint8_t)shift;
+        return EMBEDD_RESULT_OK;
+      }
+    }
+    return EMBEDD_RESULT_ERR;
+}
+
+EMBEDD_RESULT ina219_scale_set_range(ina219_scale_t* scale, uint8_t pg, uint8_t brng) {
+    if( scale == NULL || !INA219_CONFIGURATION_PG_VALID( pg ) || !INA219_CONFIGURATION_BRNG_VALID( brng ) ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    scale->shunt_fs_raw = ina219_shunt_fs_raw[pg];
+    scale->bus_fs_mv = ina219_bus_fs_mv[brng];
+    return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT ina219_scale_init(ina219_scale_t* scale, uint32_t current_lsb_na, uint32_t shunt_uohm, uint8_t pg, uint8_t brng) {
+    if( scale == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    scale->current_lsb_na = current_lsb_na;
+    scale->shunt_uohm = shunt_uohm;
+    // nA -> uA, nW -> uW, uV / uOhm -> A = uV * 1e6 / uOhm uA
+    if( ina219_scale_factor( &scale->current, current_lsb_na, 1000U ) != EMBEDD_RESULT_OK ||
+        ina219_scale_factor( &scale->power, (uint64_t)current_lsb_na * INA219_POWER_LSB_RATIO, 1000U ) != EMBEDD_RESULT_OK ||
+        ina219_scale_factor( &scale->shunt_current, (uint64_t)INA219_SHUNT_VOLTAGE_LSB_UV * 1000000U, shunt_uohm ) != EMBEDD_RESULT_OK ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    return ina219_scale_set_range( scale, pg, brng );
+}
+
+EMBEDD_RESULT ina219_scale_init_calibration(ina219_scale_t* scale, uint16_t calibration, uint32_t shunt_uohm, uint8_t pg, uint8_t brng) {
+    calibration &= INA219_CALIBRATION_FS_MASK;
+    if( scale == NULL || shunt_uohm == 0 ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    if( calibration == 0 ) {
+      return ina219_scale_init( scale, 0, shunt_uohm, pg, brng );
+    }
+    uint64_t den = (uint64_t)calibration * shunt_uohm;
+    scale->current_lsb_na = (uint32_t)( ( INA219_CALIBRATION_UA_NUM * 1000U + den / 2 ) / den );
+    scale->shunt_uohm = shunt_uohm;
+    if( ina219_scale_factor( &scale->current, INA219_CALIBRATION_UA_NUM, den ) != EMBEDD_RESULT_OK ||
+        ina219_scale_factor( &scale->power, INA219_CALIBRATION_UA_NUM * INA219_POWER_LSB_RATIO, den ) != EMBEDD_RESULT_OK ||
+        ina219_scale_factor( &scale->shunt_current, (uint64_t)INA219_SHUNT_VOLTAGE_LSB_UV * 1000000U, shunt_uohm ) != EMBEDD_RESULT_OK ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    if( scale->current_lsb_na == 0 ) {
+      // below 0.5 nA; keep the calibrated path, ina219_convert_snapshot tells it by a non-zero LSB
+      scale->current_lsb_na = 1;
+    }
+    return ina219_scale_set_range( scale, pg, brng );
+}
+
+static void ina219_convert_words(const ina219_scale_t* scale, uint16_t shunt, uint16_t bus, uint16_t current, uint16_t power, ina219_measurement_t* meas) {
+    meas->shunt_uv = ina219_convert_shunt_uv( shunt );
+    meas->bus_mv = ina219_convert_bus_mv( bus );
+    meas->flags = 0;
+    if( scale->current_lsb_na != 0 ) {
+      meas->current_ua = ina219_convert_current_ua( scale, current );
+      meas->power_uw = ina219_convert_power_uw( scale, power );
+    } else {
+      meas->current_ua = ina219_convert_shunt_current_ua( scale, shunt );
+      meas->power_uw = 0;
+    }
+    if( INA219_FIELD_GET( bus, BUS_VOLTAGE, OVF ) ) {
+      meas->flags |= INA219_MEAS_FLAG_OVF;
+    }
+    if( INA219_FIELD_GET( bus, BUS_VOLTAGE, CNVR ) ) {
+      meas->flags |= INA219_MEAS_FLAG_CNVR;
+    }
+    int16_t shunt_raw = ina219_shunt_voltage_value( shunt );
+    if( shunt_raw >= scale->shunt_fs_raw || shunt_raw <= -scale->shunt_fs_raw ) {
+      meas->flags |= INA219_MEAS_FLAG_SHUNT_CLIPPED;
+    }
+    if( meas->bus_mv > scale->bus_fs_mv ) {
+      meas->flags |= INA219_MEAS_FLAG_BUS_CLIPPED;
+    }
+}
+
+void ina219_convert_snapshot(const ina219_scale_t* scale, const ina219_snapshot_t* snap, ina219_measurement_t* meas) {
+    ina219_convert_words( scale, ina219_reg_word( &snap->shunt_voltage ), ina219_reg_word( &snap->bus_voltage ),
+                          ina219_reg_word( &snap->current ), ina219_reg_word( &snap->power ), meas );
+}
+
+void ina219_convert_sample(const ina219_scale_t* scale, const ina219_sample_t* sample, ina219_measurement_t* meas) {
+    ina219_convert_words( scale, sample->shunt_voltage, sample->bus_voltage, sample->current, sample->power, meas );
+}
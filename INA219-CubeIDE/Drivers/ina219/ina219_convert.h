@@ -0,0 +1,247 @@
+/*!
+ * \file ina219_convert.h
+ * \brief Power monitor unit conversion
+ *
+ * Converts raw register words into engineering units with integer multiply
+ * and shift only. The constants are computed once by ina219_scale_init, which
+ * is the only place doing divisions.
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#ifndef _SRC_INA219_CONVERT_H
+#define _SRC_INA219_CONVERT_H
+
+#include <stdint.h>
+
+#include "embedd_error.h"
+#include "ina219_data_types.h"
+#include "ina219_fields.h"
+#include "ina219_sample.h"
+
+/*!
+ * \def INA219_SHUNT_VOLTAGE_LSB_UV
+ * \brief Shunt voltage register LSB in microvolts, the same for every PGA setting
+ */
+#define INA219_SHUNT_VOLTAGE_LSB_UV 10
+
+/*!
+ * \def INA219_BUS_VOLTAGE_LSB_MV
+ * \brief Bus voltage register LSB in millivolts
+ */
+#define INA219_BUS_VOLTAGE_LSB_MV   4
+
+/*!
+ * \def INA219_POWER_LSB_RATIO
+ * \brief Power register LSB as a multiple of the current register LSB
+ */
+#define INA219_POWER_LSB_RATIO      20
+
+/*!
+ * \def INA219_MEAS_FLAG_OVF
+ * \brief The device flagged a math overflow, current and power are not valid
+ */
+#define INA219_MEAS_FLAG_OVF           0x01
+
+/*!
+ * \def INA219_MEAS_FLAG_CNVR
+ * \brief Conversion ready flag of the bus voltage register was set
+ */
+#define INA219_MEAS_FLAG_CNVR          0x02
+
+/*!
+ * \def INA219_MEAS_FLAG_SHUNT_CLIPPED
+ * \brief The shunt voltage is at the full scale of the PGA setting
+ */
+#define INA219_MEAS_FLAG_SHUNT_CLIPPED 0x04
+
+/*!
+ * \def INA219_MEAS_FLAG_BUS_CLIPPED
+ * \brief The bus voltage is above the full scale of the BRNG setting
+ */
+#define INA219_MEAS_FLAG_BUS_CLIPPED   0x08
+
+/*!
+ * \struct ina219_scale_factor_t
+ * \brief Multiply and shift approximation of a scale: out = (raw * mul) >> shift, rounded
+ *
+ * \var mul    multiplier, at most 32767 so that a 16-bit raw value never overflows 32 bits
+ * \var shift  right shift applied to the product
+ */
+typedef struct {
+  uint16_t mul;
+  uint8_t  shift;
+} ina219_scale_factor_t;
+
+/*!
+ * \struct ina219_scale_t
+ * \brief Conversion constants of one device
+ *
+ * \var current_lsb_na  current register LSB in nanoamperes, 0 if the device is not calibrated
+ * \var shunt_uohm      shunt resistance in microohms, 0 if unknown
+ * \var current         current register to microamperes
+ * \var power           power register to microwatts
+ * \var shunt_current   shunt voltage register to microamperes through the shunt resistance
+ * \var shunt_fs_raw    shunt voltage full scale of the PGA setting in register counts
+ * \var bus_fs_mv       bus voltage full scale of the BRNG setting in millivolts
+ */
+typedef struct {
+  uint32_t current_lsb_na;
+  uint32_t shunt_uohm;
+  ina219_scale_factor_t current;
+  ina219_scale_factor_t power;
+  ina219_scale_factor_t shunt_current;
+  int16_t  shunt_fs_raw;
+  uint16_t bus_fs_mv;
+} ina219_scale_t;
+
+/*!
+ * \struct ina219_measurement_t
+ * \brief One sample in engineering units
+ *
+ * \var shunt_uv    shunt voltage in microvolts
+ * \var bus_mv      bus voltage in millivolts
+ * \var current_ua  current in microamperes, from the current register or, without
+ *                  calibration, from the shunt voltage and resistance
+ * \var power_uw    power in microwatts, 0 without calibration
+ * \var flags       INA219_MEAS_FLAG_* flags
+ */
+typedef struct {
+  int32_t  shunt_uv;
+  uint32_t bus_mv;
+  int32_t  current_ua;
+  uint32_t power_uw;
+  uint8_t  flags;
+} ina219_measurement_t;
+
+/*!
+ * ina219_scale_init
+ * 
+ * \brief Computes the conversion constants for a current LSB, a shunt resistance
+ * and a PGA/BRNG setting.
+ * 
+ * \param scale pointer to ina219_scale_t the constants to compute
+ * \param current_lsb_na uint32_t current register LSB in nanoamperes, 0 if not calibrated
+ * \param shunt_uohm uint32_t shunt resistance in microohms, 0 if unknown
+ * \param pg uint8_t INA219_CONFIGURATION_PG_* setting
+ * \param brng uint8_t INA219_CONFIGURATION_BRNG_* setting
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_ERR if a setting is not valid or a scale
+ * does not fit 32-bit arithmetic (current LSB above about 1.6 mA), othewise EMBEDD_RESULT_OK
+ */
+EMBEDD_RESULT ina219_scale_init(ina219_scale_t* scale, uint32_t current_lsb_na, uint32_t shunt_uohm, uint8_t pg, uint8_t brng);
+
+/*!
+ * ina219_scale_init_calibration
+ * 
+ * \brief Computes the conversion constants for a calibration register value and
+ * a shunt resistance. The current LSB the device applies is 0.04096 / (Cal * R),
+ * the factors are derived from that exact ratio rather than from the current
+ * LSB rounded to nanoamperes.
+ * 
+ * \param scale pointer to ina219_scale_t the constants to compute
+ * \param calibration uint16_t calibration register value, 0 if not calibrated
+ * \param shunt_uohm uint32_t shunt resistance in microohms
+ * \param pg uint8_t INA219_CONFIGURATION_PG_* setting
+ * \param brng uint8_t INA219_CONFIGURATION_BRNG_* setting
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT ina219_scale_init_calibration(ina219_scale_t* scale, uint16_t calibration, uint32_t shunt_uohm, uint8_t pg, uint8_t brng);
+
+/*!
+ * ina219_scale_set_range
+ * 
+ * \brief Updates the full scale limits after a PGA or BRNG change, the
+ * conversion factors do not depend on them.
+ * 
+ * \param scale pointer to ina219_scale_t the constants to update
+ * \param pg uint8_t INA219_CONFIGURATION_PG_* setting
+ * \param brng uint8_t INA219_CONFIGURATION_BRNG_* setting
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT ina219_scale_set_range(ina219_scale_t* scale, uint8_t pg, uint8_t brng);
+
+static inline int32_t ina219_scale_apply(const ina219_scale_factor_t* f, int32_t raw) {
+    int32_t val = raw * (int32_t)f->mul;
+    return f->shift ? ( val + ( 1L << ( f->shift - 1 ) ) ) >> f->shift : val;
+}
+
+static inline uint32_t ina219_scale_apply_u(const ina219_scale_factor_t* f, uint32_t raw) {
+    uint32_t val = raw * f->mul;
+    return f->shift ? ( val + ( 1UL << ( f->shift - 1 ) ) ) >> f->shift : val;
+}
+
+/*!
+ * \brief Shunt voltage register word to microvolts
+ */
+static inline int32_t ina219_convert_shunt_uv(uint16_t raw) {
+    return (int32_t)ina219_shunt_voltage_value( raw ) * INA219_SHUNT_VOLTAGE_LSB_UV;
+}
+
+/*!
+ * \brief Bus voltage register word to millivolts
+ */
+static inline uint32_t ina219_convert_bus_mv(uint16_t raw) {
+    return (uint32_t)ina219_bus_voltage_value( raw ) * INA219_BUS_VOLTAGE_LSB_MV;
+}
+
+/*!
+ * \brief Current register word to microamperes
+ */
+static inline int32_t ina219_convert_current_ua(const ina219_scale_t* scale, uint16_t raw) {
+    return ina219_scale_apply( &scale->current, ina219_current_value( raw ) );
+}
+
+/*!
+ * \brief Power register word to microwatts
+ */
+static inline uint32_t ina219_convert_power_uw(const ina219_scale_t* scale, uint16_t raw) {
+    return ina219_scale_apply_u( &scale->power, raw );
+}
+
+/*!
+ * \brief Shunt voltage register word to microamperes through the shunt resistance
+ */
+static inline int32_t ina219_convert_shunt_current_ua(const ina219_scale_t* scale, uint16_t raw) {
+    return ina219_scale_apply( &scale->shunt_current, ina219_shunt_voltage_value( raw ) );
+}
+
+/*!
+ * ina219_convert_snapshot
+ * 
+ * \brief Converts the measurement registers of a snapshot.
+ * 
+ * \param scale pointer to ina219_scale_t the conversion constants
+ * \param snap pointer to ina219_snapshot_t the registers to convert
+ * \param meas pointer to ina219_measurement_t the result
+ */
+void ina219_convert_snapshot(const ina219_scale_t* scale, const ina219_snapshot_t* snap, ina219_measurement_t* meas);
+
+/*!
+ * ina219_convert_sample
+ * 
+ * \brief Converts a sample with the constants of the range it was taken in.
+ * 
+ * \param scale pointer to ina219_scale_t the conversion constants of the sample's range
+ * \param sample pointer to ina219_sample_t the sample to convert
+ * \param meas pointer to ina219_measurement_t the result
+ */
+void ina219_convert_sample(const ina219_scale_t* scale, const ina219_sample_t* sample, ina219_measurement_t* meas);
+
+#endif//_SRC_INA219_CONVERT_H
@@ -1240,11 +1240,61 @@ typedef struct {
  *
  * \var in_buf    staticaly allocated buffer for input data
  * \var out_buf   staticaly allocated buffer for out data
+ * \var ready     point in time after which the device accepts the next access
+ * \var reg_ptr           register address the device's pointer register currently selects
+ * \var reg_ptr_valid     non-zero while reg_ptr is known to match the device
+ * \var reg_ptr_hits      number of reads which skipped the pointer write
+ * \var reg_ptr_misses    number of reads which had to write the pointer first
+ * \var snapshot_retries  number of times a snapshot was re-read because a conversion completed during it
+ * \var snapshot_triggered number of snapshots which fell back to a triggered conversion
+ * \var shadow_configuration  configuration register as last written to or read from the device
+ * \var shadow_calibration    calibration register as last written to or read from the device
+ * \var staged_configuration  shadow configuration with the field changes not committed yet
+ * \var staged_calibration    shadow calibration with the changes not committed yet
+ * \var shadow_valid          INA219_SHADOW_* bits of the shadow registers known to match the device
+ * \var shadow_skipped        number of commits which needed no bus write
  */
  typedef struct {
      uint8_t out_buf[INA219_WRITE_MESSAGE_MAX_SIZE];
      uint8_t in_buf[INA219_READ_MESSAGE_MAX_SIZE];
+     embedd_hal_deadline_t ready;
+     uint8_t  reg_ptr;
+     uint8_t  reg_ptr_valid;
+     uint32_t reg_ptr_hits;
+     uint32_t reg_ptr_misses;
+     uint32_t snapshot_retries;
+     uint32_t snapshot_triggered;
+     ina219_configuration_t shadow_configuration;
+     ina219_calibration_t   shadow_calibration;
+     ina219_configuration_t staged_configuration;
+     ina219_calibration_t   staged_calibration;
+     uint8_t  shadow_valid;
+     uint32_t shadow_skipped;
  } ina219_data_t;
+
+#pragma pack(push, 1)
+
+/*!
+ * \struct ina219_snapshot_t
+ * \brief All registers of the device, with the measurement registers taken from one ADC conversion.
+ *
+ * \var configuration Configuration register (00h)
+ * \var shunt_voltage Shunt voltage register (01h)
+ * \var bus_voltage   Bus voltage register (02h)
+ * \var power         Power register (03h)
+ * \var current       Current register (04h)
+ * \var calibration   Calibration register (05h)
+ */
+typedef struct {
+  ina219_configuration_t configuration;
+  ina219_shunt_voltage_t shunt_voltage;
+  ina219_bus_voltage_t   bus_voltage;
+  ina219_power_t         power;
+  ina219_current_t       current;
+  ina219_calibration_t   calibration;
+} ina219_snapshot_t;
+
+#pragma pack(pop)
 
 
 /*!
@@ -1253,11 +1303,13 @@ typedef struct {
  *
  * \var ina219_write_reg contains pointer to ina219_write_reg API's function
  * \var ina219_read_reg contains pointer to ina219_read_reg API's function
+ * \var ina219_read_snapshot contains pointer to ina219_read_snapshot API's function
 
  */
 typedef struct {
   EMBEDD_RESULT (*ina219_write_reg)(embedd_device_t* dev, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay);
   EMBEDD_RESULT (*ina219_read_reg)(embedd_device_t* dev, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay);
+  EMBEDD_RESULT (*ina219_read_snapshot)(embedd_device_t* dev, ina219_snapshot_t* snap);
 } ina219_api_t;
 
 #endif//_SRC_INA219_DATA_TYPES_H
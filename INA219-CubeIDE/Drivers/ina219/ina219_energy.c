@@ -0,0 +1,126 @@
+/*!
+ * \file ina219_energy.c
+ * \brief Power monitor energy and charge accumulator
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#include "ina219_energy.h"
+
+// bridged by default: the sample before and after this many periods
+#define INA219_ENERGY_DEFAULT_GAP_PERIODS 100U
+
+EMBEDD_RESULT ina219_energy_init(ina219_energy_t* acc, uint32_t period_us, uint32_t max_gap_us) {
+    if( acc == NULL || max_gap_us > 0x80000000UL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    if( max_gap_us == 0 ) {
+      if( period_us == 0 || period_us > 0x80000000UL / INA219_ENERGY_DEFAULT_GAP_PERIODS ) {
+        return EMBEDD_RESULT_ERR;
+      }
+      max_gap_us = period_us * INA219_ENERGY_DEFAULT_GAP_PERIODS;
+    }
+    acc->period_us = period_us;
+    acc->max_gap_us = max_gap_us;
+    ina219_energy_reset( acc );
+    return EMBEDD_RESULT_OK;
+}
+
+void ina219_energy_add(ina219_energy_t* acc, const ina219_measurement_t* meas, uint32_t timestamp_us) {
+    if( acc == NULL || meas == NULL ) {
+      return;
+    }
+    ina219_energy_totals_t* t = &acc->totals;
+    if( meas->flags & INA219_MEAS_FLAG_OVF ) {
+      t->invalid++;
+      return;
+    }
+    if( acc->has_last ) {
+      uint32_t dt = timestamp_us - acc->last_us;
+      if( dt > acc->max_gap_us ) {
+        // too long to guess what happened in between
+        t->lost_us += dt;
+      } else {
+        // (a + b) * dt, twice the area of the trapezoid
+        t->charge_hpc += (int64_t)( (int64_t)acc->last_current_ua + meas->current_ua ) * dt;
+        t->energy_hpj += (uint64_t)( (uint64_t)acc->last_power_uw + meas->power_uw ) * dt;
+        t->time_us += dt;
+        if( acc->period_us != 0 && dt > acc->period_us + acc->period_us / 2U ) {
+          t->gaps++;
+          t->missed += ( dt + acc->period_us / 2U ) / acc->period_us - 1U;
+        }
+      }
+    }
+    acc->last_us = timestamp_us;
+    acc->last_current_ua = meas->current_ua;
+    acc->last_power_uw = meas->power_uw;
+    acc->has_last = 1;
+    t->samples++;
+}
+
+void ina219_energy_checkpoint(const ina219_energy_t* acc, ina219_energy_totals_t* checkpoint) {
+    if( acc == NULL || checkpoint == NULL ) {
+      return;
+    }
+    *checkpoint = acc->totals;
+}
+
+void ina219_energy_restore(ina219_energy_t* acc, const ina219_energy_totals_t* checkpoint) {
+    if( acc == NULL || checkpoint == NULL ) {
+      return;
+    }
+    acc->totals = *checkpoint;
+    acc->has_last = 0;
+}
+
+void ina219_energy_reset(ina219_energy_t* acc) {
+    if( acc == NULL ) {
+      return;
+    }
+    acc->totals = (ina219_energy_totals_t){ 0 };
+    acc->has_last = 0;
+}
+
+void ina219_energy_read(const ina219_energy_t* acc, const ina219_energy_totals_t* since, ina219_energy_reading_t* reading) {
+    if( acc == NULL || reading == NULL ) {
+      return;
+    }
+    ina219_energy_totals_t t = acc->totals;
+    if( since != NULL ) {
+      t.charge_hpc -= since->charge_hpc;
+      t.energy_hpj -= since->energy_hpj;
+      t.time_us -= since->time_us;
+      t.lost_us -= since->lost_us;
+      t.samples -= since->samples;
+      t.invalid -= since->invalid;
+      t.gaps -= since->gaps;
+      t.missed -= since->missed;
+    }
+    reading->charge_uc = t.charge_hpc / INA219_ENERGY_HALF_PER_MICRO;
+    reading->charge_uah = t.charge_hpc / INA219_ENERGY_HALF_PER_MICRO_HOUR;
+    reading->energy_uj = t.energy_hpj / INA219_ENERGY_HALF_PER_MICRO;
+    reading->energy_uwh = t.energy_hpj / INA219_ENERGY_HALF_PER_MICRO_HOUR;
+    // half units over microseconds: twice the average in micro units
+    reading->avg_current_ua = t.time_us != 0 ? (int32_t)( t.charge_hpc / (int64_t)t.time_us / 2 ) : 0;
+    reading->avg_power_uw = t.time_us != 0 ? (uint32_t)( t.energy_hpj / t.time_us / 2U ) : 0;
+    reading->time_us = t.time_us;
+    reading->lost_us = t.lost_us;
+    reading->samples = t.samples;
+    reading->invalid = t.invalid;
+    reading->gaps = t.gaps;
+    reading->missed = t.missed;
+}
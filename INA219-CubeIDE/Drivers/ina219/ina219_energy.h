@@ -0,0 +1,197 @@
+/*!
+ * \file ina219_energy.h
+ * \brief Power monitor energy and charge accumulator
+ *
+ * Integrates the current and power of every sample over time with the
+ * trapezoidal rule. The accumulators are 64-bit integers counting half
+ * picocoulombs and half picojoules, i.e. (a + b) * dt of every interval in
+ * microamperes, microwatts and microseconds, so no rounding error builds up
+ * and a sample costs two 32x32 bit multiplications. An interval longer than
+ * the sampling period, e.g. after a missed sample, is bridged by the same
+ * straight line between its end samples up to a limit.
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#ifndef _SRC_INA219_ENERGY_H
+#define _SRC_INA219_ENERGY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "embedd_device.h"
+#include "ina219_convert.h"
+
+/*!
+ * \def INA219_ENERGY_HALF_PER_MICRO
+ * \brief Accumulator counts per microcoulomb or microjoule
+ */
+#define INA219_ENERGY_HALF_PER_MICRO 2000000LL
+
+/*!
+ * \def INA219_ENERGY_HALF_PER_MICRO_HOUR
+ * \brief Accumulator counts per microampere hour or microwatt hour
+ */
+#define INA219_ENERGY_HALF_PER_MICRO_HOUR 7200000000LL
+
+/*!
+ * \struct ina219_energy_totals_t
+ * \brief Accumulated totals, also used as a checkpoint
+ *
+ * The accumulators hold about 1280 Ah and 1.28 kWh, e.g. 12 hours at the
+ * full scale of 3.2 A and 32 V of a 0.1 Ohm shunt.
+ *
+ * \var charge_hpc  charge in half picocoulombs, negative for a reverse current
+ * \var energy_hpj  energy in half picojoules
+ * \var time_us     time integrated
+ * \var lost_us     time not integrated because samples were missing for longer than max_gap_us
+ * \var samples     number of samples accepted
+ * \var invalid     number of samples skipped because of a math overflow
+ * \var gaps        number of intervals longer than 1.5 sampling periods
+ * \var missed      estimated number of samples missing in those intervals
+ */
+typedef struct {
+  int64_t  charge_hpc;
+  uint64_t energy_hpj;
+  uint64_t time_us;
+  uint64_t lost_us;
+  uint32_t samples;
+  uint32_t invalid;
+  uint32_t gaps;
+  uint32_t missed;
+} ina219_energy_totals_t;
+
+/*!
+ * \struct ina219_energy_reading_t
+ * \brief Totals in engineering units
+ *
+ * \var charge_uc    charge in microcoulombs
+ * \var charge_uah   charge in microampere hours
+ * \var energy_uj    energy in microjoules
+ * \var energy_uwh   energy in microwatt hours
+ * \var avg_current_ua  average current over time_us in microamperes
+ * \var avg_power_uw    average power over time_us in microwatts
+ * \var time_us      time integrated
+ * \var lost_us      time not integrated
+ * \var samples, invalid, gaps, missed  see \ref ina219_energy_totals_t
+ */
+typedef struct {
+  int64_t  charge_uc;
+  int64_t  charge_uah;
+  uint64_t energy_uj;
+  uint64_t energy_uwh;
+  int32_t  avg_current_ua;
+  uint32_t avg_power_uw;
+  uint64_t time_us;
+  uint64_t lost_us;
+  uint32_t samples;
+  uint32_t invalid;
+  uint32_t gaps;
+  uint32_t missed;
+} ina219_energy_reading_t;
+
+/*!
+ * \struct ina219_energy_t
+ * \brief Accumulator state
+ *
+ * \var totals      accumulated totals
+ * \var period_us   nominal sampling period, 0 if unknown
+ * \var max_gap_us  longest interval bridged, a longer one is counted in lost_us
+ * \var last_us     timestamp of the previous sample
+ * \var last_current_ua, last_power_uw  values of the previous sample
+ * \var has_last    non-zero if the previous sample is valid
+ */
+typedef struct {
+  ina219_energy_totals_t totals;
+  uint32_t period_us;
+  uint32_t max_gap_us;
+  uint32_t last_us;
+  int32_t  last_current_ua;
+  uint32_t last_power_uw;
+  uint8_t  has_last;
+} ina219_energy_t;
+
+/*!
+ * ina219_energy_init
+ * 
+ * \brief Initializes an accumulator with zero totals.
+ * 
+ * \param acc pointer to ina219_energy_t the accumulator
+ * \param period_us uint32_t nominal sampling period in microseconds, 0 if unknown
+ * \param max_gap_us uint32_t longest interval between two samples that is
+ * bridged, at most 2^31 microseconds, 0 for 100 sampling periods
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT ina219_energy_init(ina219_energy_t* acc, uint32_t period_us, uint32_t max_gap_us);
+
+/*!
+ * ina219_energy_add
+ * 
+ * \brief Integrates the interval from the previous sample to this one. Samples
+ * with the math overflow flag are skipped, the interval is then bridged from
+ * the last valid sample.
+ * 
+ * \param acc pointer to ina219_energy_t the accumulator
+ * \param meas pointer to ina219_measurement_t the converted sample
+ * \param timestamp_us uint32_t time the sample was taken at, from \ref embedd_hal_get_us
+ */
+void ina219_energy_add(ina219_energy_t* acc, const ina219_measurement_t* meas, uint32_t timestamp_us);
+
+/*!
+ * ina219_energy_checkpoint
+ * 
+ * \brief Copies the totals, e.g. to compute the consumption of a test run
+ * with \ref ina219_energy_read or to store them across a reset.
+ * 
+ * \param acc pointer to ina219_energy_t the accumulator
+ * \param checkpoint pointer to ina219_energy_totals_t receiving the totals
+ */
+void ina219_energy_checkpoint(const ina219_energy_t* acc, ina219_energy_totals_t* checkpoint);
+
+/*!
+ * ina219_energy_restore
+ * 
+ * \brief Continues from stored totals. The next sample starts a new interval.
+ * 
+ * \param acc pointer to ina219_energy_t the accumulator
+ * \param checkpoint pointer to ina219_energy_totals_t the stored totals
+ */
+void ina219_energy_restore(ina219_energy_t* acc, const ina219_energy_totals_t* checkpoint);
+
+/*!
+ * ina219_energy_reset
+ * 
+ * \brief Clears the totals. The next sample starts a new interval.
+ * 
+ * \param acc pointer to ina219_energy_t the accumulator
+ */
+void ina219_energy_reset(ina219_energy_t* acc);
+
+/*!
+ * ina219_energy_read
+ * 
+ * \brief Converts the totals, or their increase since a checkpoint, to
+ * engineering units.
+ * 
+ * \param acc pointer to ina219_energy_t the accumulator
+ * \param since pointer to ina219_energy_totals_t a checkpoint, NULL for the totals
+ * \param reading pointer to ina219_energy_reading_t receiving the values
+ */
+void ina219_energy_read(const ina219_energy_t* acc, const ina219_energy_totals_t* since, ina219_energy_reading_t* reading);
+
+#endif//_SRC_INA219_ENERGY_H
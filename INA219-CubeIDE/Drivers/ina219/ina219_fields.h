@@ -0,0 +1,166 @@
+/*!
+ * \file ina219_fields.h
+ * \brief Power monitor register words and fields
+ *
+ * Every register type as a raw 16-bit word, and mask/shift definitions of the
+ * logical fields of each register. Decoding through the word does not depend on
+ * how the compiler lays out the bitfield structs and reduces to a shift and a
+ * mask.
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#ifndef _SRC_INA219_FIELDS_H
+#define _SRC_INA219_FIELDS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ina219_data_types.h"
+
+/* --------------------------------------------------------------------------
+ * Raw register words
+ * -------------------------------------------------------------------------- */
+
+typedef union { uint16_t word; ina219_configuration_t bits; } ina219_configuration_word_t;
+typedef union { uint16_t word; ina219_shunt_voltage_t bits; } ina219_shunt_voltage_word_t;
+typedef union { uint16_t word; ina219_bus_voltage_t   bits; } ina219_bus_voltage_word_t;
+typedef union { uint16_t word; ina219_power_t         bits; } ina219_power_word_t;
+typedef union { uint16_t word; ina219_current_t       bits; } ina219_current_word_t;
+typedef union { uint16_t word; ina219_calibration_t   bits; } ina219_calibration_word_t;
+
+_Static_assert( sizeof(ina219_configuration_word_t) == 2 && sizeof(ina219_shunt_voltage_word_t) == 2 &&
+                sizeof(ina219_bus_voltage_word_t) == 2 && sizeof(ina219_power_word_t) == 2 &&
+                sizeof(ina219_current_word_t) == 2 && sizeof(ina219_calibration_word_t) == 2,
+                "INA219 register types must be 16-bit words" );
+
+/*!
+ * \brief Returns any register variable as its 16-bit word
+ */
+static inline uint16_t ina219_reg_word(const void* reg) {
+    uint16_t word;
+    memcpy( &word, reg, sizeof(word) );
+    return word;
+}
+
+/*!
+ * \brief Sets any register variable from its 16-bit word
+ */
+static inline void ina219_reg_set_word(void* reg, uint16_t word) {
+    memcpy( reg, &word, sizeof(word) );
+}
+
+/*!
+ * \macro INA219_FIELD_GET
+ * \brief Extracts a field from a register word
+ *
+ * \param word register word
+ * \param _REG register name, e.g. CONFIGURATION
+ * \param _FIELD field name, e.g. PG
+ */
+#define INA219_FIELD_GET(word, _REG, _FIELD) \
+  ( (uint16_t)( (word) & INA219_##_REG##_##_FIELD##_MASK ) >> INA219_##_REG##_##_FIELD##_SHIFT )
+
+/*!
+ * \macro INA219_FIELD_SET
+ * \brief Returns a register word with one field replaced
+ *
+ * \param word register word
+ * \param _REG register name, e.g. CONFIGURATION
+ * \param _FIELD field name, e.g. PG
+ * \param val new value of the field
+ */
+#define INA219_FIELD_SET(word, _REG, _FIELD, val) \
+  (uint16_t)( ( (word) & ~INA219_##_REG##_##_FIELD##_MASK ) | \
+              ( ( (uint16_t)(val) << INA219_##_REG##_##_FIELD##_SHIFT ) & INA219_##_REG##_##_FIELD##_MASK ) )
+
+/* --------------------------------------------------------------------------
+ * Configuration (00h)
+ * -------------------------------------------------------------------------- */
+#define INA219_CONFIGURATION_MODE_SHIFT  0
+#define INA219_CONFIGURATION_MODE_MASK   0x0007U
+#define INA219_CONFIGURATION_SADC_SHIFT  3
+#define INA219_CONFIGURATION_SADC_MASK   0x0078U
+#define INA219_CONFIGURATION_BADC_SHIFT  7
+#define INA219_CONFIGURATION_BADC_MASK   0x0780U
+#define INA219_CONFIGURATION_PG_SHIFT    11
+#define INA219_CONFIGURATION_PG_MASK     0x1800U
+#define INA219_CONFIGURATION_BRNG_SHIFT  13
+#define INA219_CONFIGURATION_BRNG_MASK   0x2000U
+#define INA219_CONFIGURATION_RST_SHIFT   15
+#define INA219_CONFIGURATION_RST_MASK    0x8000U
+
+/* --------------------------------------------------------------------------
+ * Shunt voltage (01h): 15-bit magnitude with sign, sign-extended by the device
+ * -------------------------------------------------------------------------- */
+#define INA219_SHUNT_VOLTAGE_VALUE_SHIFT 0
+#define INA219_SHUNT_VOLTAGE_VALUE_MASK  0x7FFFU
+#define INA219_SHUNT_VOLTAGE_SIGN_SHIFT  15
+#define INA219_SHUNT_VOLTAGE_SIGN_MASK   0x8000U
+
+/*!
+ * \brief Shunt voltage as a signed number of 10 uV steps
+ */
+static inline int16_t ina219_shunt_voltage_value(uint16_t word) {
+    return (int16_t)word;
+}
+
+/* --------------------------------------------------------------------------
+ * Bus voltage (02h): the 13-bit value occupies bits 15..3 as in the datasheet
+ * -------------------------------------------------------------------------- */
+#define INA219_BUS_VOLTAGE_OVF_SHIFT     0
+#define INA219_BUS_VOLTAGE_OVF_MASK      0x0001U
+#define INA219_BUS_VOLTAGE_CNVR_SHIFT    1
+#define INA219_BUS_VOLTAGE_CNVR_MASK     0x0002U
+#define INA219_BUS_VOLTAGE_BD_SHIFT      3
+#define INA219_BUS_VOLTAGE_BD_MASK       0xFFF8U
+
+/*!
+ * \brief Bus voltage as a number of 4 mV steps
+ */
+static inline uint16_t ina219_bus_voltage_value(uint16_t word) {
+    return (uint16_t)( word >> INA219_BUS_VOLTAGE_BD_SHIFT );
+}
+
+/* --------------------------------------------------------------------------
+ * Power (03h): unsigned 16-bit
+ * -------------------------------------------------------------------------- */
+#define INA219_POWER_VALUE_SHIFT         0
+#define INA219_POWER_VALUE_MASK          0xFFFFU
+
+/* --------------------------------------------------------------------------
+ * Current (04h): 16-bit two's complement
+ * -------------------------------------------------------------------------- */
+#define INA219_CURRENT_VALUE_SHIFT       0
+#define INA219_CURRENT_VALUE_MASK        0x7FFFU
+#define INA219_CURRENT_CSIGN_SHIFT       15
+#define INA219_CURRENT_CSIGN_MASK        0x8000U
+
+/*!
+ * \brief Current as a signed number of current LSBs
+ */
+static inline int16_t ina219_current_value(uint16_t word) {
+    return (int16_t)word;
+}
+
+/* --------------------------------------------------------------------------
+ * Calibration (05h): bit 0 always reads 0 and cannot be written
+ * -------------------------------------------------------------------------- */
+#define INA219_CALIBRATION_FS_SHIFT      0
+#define INA219_CALIBRATION_FS_MASK       0xFFFEU
+
+#endif//_SRC_INA219_FIELDS_H
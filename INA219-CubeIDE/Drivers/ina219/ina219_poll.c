@@ -0,0 +1,283 @@
+/*!
+ * \file ina219_poll.c
+ * \brief Power monitor conversion-ready polling
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#include "embedd_hal.h"
+
+#include "ina219_registers.h"
+#include "ina219_shadow.h"
+#include "ina219_static.h"
+#include "ina219_poll.h"
+
+#if INA219_STATIC_DISPATCH
+#define INA219_POLL_READ(dev, _typename, var) \
+  ina219_read_reg_direct((dev), _typename##_read_reg_addr, &(var), \
+  sizeof(_typename), _typename##_delay)
+#else
+#define INA219_POLL_READ(dev, _typename, var) \
+  ina219_read_reg((dev), _typename##_read_reg_addr, &(var), \
+  sizeof(_typename), _typename##_delay)
+#endif
+
+// smallest delay before a stale read is repeated
+#define INA219_POLL_RETRY_MIN_US 50U
+
+#define INA219_POLL_LOCK_REF    0x01
+#define INA219_POLL_LOCK_ANCHOR 0x02
+
+// typical conversion time of every SADC/BADC value; 0..7 select the resolution only, 8..15 averaging
+static const uint32_t ina219_adc_time_us[16] = {
+  84, 148, 276, 532, 84, 148, 276, 532,
+  532, 1060, 2130, 4260, 8510, 17020, 34050, 68100,
+};
+
+uint32_t ina219_conversion_time_us(uint16_t configuration) {
+    uint8_t mode = (uint8_t)INA219_FIELD_GET( configuration, CONFIGURATION, MODE );
+    uint32_t shunt = ina219_adc_time_us[INA219_FIELD_GET( configuration, CONFIGURATION, SADC )];
+    uint32_t bus = ina219_adc_time_us[INA219_FIELD_GET( configuration, CONFIGURATION, BADC )];
+    switch( mode ) {
+      case INA219_CONFIGURATION_MODE_SHUNT_VOLTAGE_TRIGGERED:
+      case INA219_CONFIGURATION_MODE_SHUNT_VOLTAGE_CONTINUOUS:
+        return shunt;
+      case INA219_CONFIGURATION_MODE_BUS_VOLTAGE_TRIGGERED:
+      case INA219_CONFIGURATION_MODE_BUS_VOLTAGE_CONTINUOUS:
+        return bus;
+      case INA219_CONFIGURATION_MODE_SHUNT_AND_BUS_TRIGGERED:
+      case INA219_CONFIGURATION_MODE_SHUNT_AND_BUS_CONTINUOUS:
+        return shunt + bus;
+      default:
+        return 0;
+    }
+}
+
+static bool ina219_poll_triggered(uint16_t configuration) {
+    return INA219_FIELD_GET( configuration, CONFIGURATION, MODE ) < INA219_CONFIGURATION_MODE_ADC_OFF_DISABLED;
+}
+
+// a configuration write restarts the conversion, triggered modes need one per conversion
+static EMBEDD_RESULT ina219_poll_trigger(ina219_poll_t* poll) {
+    ina219_configuration_t cfg;
+    ina219_reg_set_word( &cfg, poll->configuration );
+    return ina219_write_reg( poll->dev, ina219_configuration_write_reg_addr, &cfg,
+                             sizeof(ina219_configuration), ina219_configuration_delay );
+}
+
+// derives the schedule from the committed configuration, when it changed
+static EMBEDD_RESULT ina219_poll_sync(ina219_poll_t* poll, uint32_t now, bool force) {
+    ina219_configuration_t cfg;
+    if( ina219_shadow_get_configuration( poll->dev, &cfg ) != EMBEDD_RESULT_OK ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    uint16_t word = ina219_reg_word( &cfg );
+    if( !force && word == poll->configuration ) {
+      return EMBEDD_RESULT_OK;
+    }
+    uint32_t period = ina219_conversion_time_us( word );
+    if( period == 0 ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    // all conversion times deviate from the typical ones by the same clock error
+    if( force || poll->period_us == 0 ) {
+      poll->period_q4 = period * 16U;
+    } else {
+      poll->period_q4 = (uint32_t)( (uint64_t)period * poll->period_q4 / poll->period_us );
+    }
+    poll->configuration = word;
+    poll->period_us = period;
+    poll->retry_us = period / 16U > INA219_POLL_RETRY_MIN_US ? period / 16U : INA219_POLL_RETRY_MIN_US;
+    poll->locked = 0;
+    poll->stale = 0;
+    poll->first_try = 0;
+    poll->probe_every = 1;
+    // the write of the configuration started a new conversion
+    poll->next_us = now + ( poll->period_q4 >> 4 );
+    if( ina219_poll_triggered( word ) && force ) {
+      return ina219_poll_trigger( poll );
+    }
+    return EMBEDD_RESULT_OK;
+}
+
+// conversions of the measured period between two points in time, rounded
+static uint32_t ina219_poll_count(const ina219_poll_t* poll, uint32_t span) {
+    return (uint32_t)( ( (uint64_t)span * 16U + poll->period_q4 / 2 ) / poll->period_q4 );
+}
+
+// a conversion completed at c, known to within the retry interval
+static void ina219_poll_lock(ina219_poll_t* poll, uint32_t c) {
+    poll->anchor_us = c;
+    poll->locked |= INA219_POLL_LOCK_ANCHOR;
+    if( !( poll->locked & INA219_POLL_LOCK_REF ) ) {
+      poll->ref_us = c;
+      poll->locked |= INA219_POLL_LOCK_REF;
+      return;
+    }
+    uint32_t span = c - poll->ref_us;
+    uint32_t k = ina219_poll_count( poll, span );
+    if( k > 2U * INA219_POLL_BASELINE ) {
+      // too long ago to count the conversions in between reliably
+      poll->ref_us = c;
+      return;
+    }
+    if( k == 0 ) {
+      return;
+    }
+    // the error of the bracketed times is divided by the number of conversions
+    uint32_t q4 = (uint32_t)( (uint64_t)span * 16U / k );
+    uint32_t typical_q4 = poll->period_us * 16U;
+    if( q4 > typical_q4 + typical_q4 / 4 || q4 < typical_q4 - typical_q4 / 4 ) {
+      poll->ref_us = c;
+      poll->probe_every = 1;
+      return;
+    }
+    poll->period_q4 = q4;
+    // the conversions are counted with the measured period, so the baseline may
+    // only grow as fast as that period gets more precise
+    if( poll->probe_every < INA219_POLL_PROBE_EVERY ) {
+      poll->probe_every = (uint8_t)( poll->probe_every * 2U );
+    }
+    if( k >= INA219_POLL_BASELINE ) {
+      // slide the baseline by half, so that it never gets short again
+      poll->ref_us += (uint32_t)( ( (uint64_t)( k / 2U ) * q4 + 8U ) >> 4 );
+    }
+}
+
+// the next read: just after the predicted completion of the next conversion
+static void ina219_poll_schedule(ina219_poll_t* poll, uint32_t now) {
+    uint32_t margin = poll->retry_us / 2U;
+    uint32_t next;
+    if( poll->locked & INA219_POLL_LOCK_ANCHOR ) {
+      // conversions completed since the anchor, the last one at or before now
+      uint32_t j = (uint32_t)( (uint64_t)( now - poll->anchor_us ) * 16U / poll->period_q4 );
+      next = poll->anchor_us + (uint32_t)( ( (uint64_t)( j + 1U ) * poll->period_q4 + 8U ) >> 4 );
+    } else {
+      // the conversion just read completed at some point before now; a quarter
+      // early is before the next one even on a device 25 % faster than typical
+      poll->next_us = now + ( ( poll->period_q4 * 3U ) >> 6 );
+      return;
+    }
+    if( ++poll->first_try >= poll->probe_every ) {
+      poll->first_try = 0;
+      poll->next_us = next - poll->retry_us;
+    } else {
+      poll->next_us = next + margin;
+    }
+}
+
+EMBEDD_RESULT ina219_poll_init(ina219_poll_t* poll, embedd_device_t* dev) {
+    if( poll == NULL || dev == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    poll->dev = dev;
+    poll->period_us = 0;
+    poll->stats = (ina219_poll_stats_t){ 0 };
+    return ina219_poll_sync( poll, embedd_hal_get_us(), true );
+}
+
+EMBEDD_RESULT ina219_poll_process(ina219_poll_t* poll, ina219_sample_t* sample, bool* ready) {
+    if( poll == NULL || poll->dev == NULL || sample == NULL || ready == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    *ready = false;
+    uint32_t now = embedd_hal_get_us();
+    if( ina219_poll_sync( poll, now, false ) != EMBEDD_RESULT_OK ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    if( (int32_t)( now - poll->next_us ) < 0 ) {
+      return EMBEDD_RESULT_OK;
+    }
+
+    embedd_device_t* dev = poll->dev;
+    ina219_bus_voltage_t bus;
+    if( INA219_POLL_READ( dev, ina219_bus_voltage, bus ) != EMBEDD_RESULT_OK ) {
+      poll->stats.errors++;
+      poll->stale = 0;
+      poll->next_us = now + poll->retry_us;
+      return EMBEDD_RESULT_ERR;
+    }
+    if( !INA219_FIELD_GET( ina219_reg_word( &bus ), BUS_VOLTAGE, CNVR ) ) {
+      // earlier than the device, try again shortly
+      poll->stats.stale++;
+      poll->stale = 1;
+      poll->stale_us = now;
+      poll->first_try = 0;
+      poll->next_us = now + poll->retry_us;
+      return EMBEDD_RESULT_OK;
+    }
+
+    ina219_shunt_voltage_t shunt;
+    ina219_current_t current;
+    ina219_power_t power;
+    if( INA219_POLL_READ( dev, ina219_shunt_voltage, shunt ) != EMBEDD_RESULT_OK ||
+        INA219_POLL_READ( dev, ina219_current, current ) != EMBEDD_RESULT_OK ||
+        INA219_POLL_READ( dev, ina219_power, power ) != EMBEDD_RESULT_OK ) {
+      poll->stats.errors++;
+      poll->stale = 0;
+      poll->next_us = now + poll->retry_us;
+      return EMBEDD_RESULT_ERR;
+    }
+    uint32_t end = embedd_hal_get_us();
+
+    sample->timestamp_us = now;
+    sample->shunt_voltage = ina219_reg_word( &shunt );
+    sample->bus_voltage = ina219_reg_word( &bus );
+    sample->power = ina219_reg_word( &power );
+    sample->current = ina219_reg_word( &current );
+    sample->range = INA219_RANGE( INA219_FIELD_GET( poll->configuration, CONFIGURATION, PG ),
+                                  INA219_FIELD_GET( poll->configuration, CONFIGURATION, BRNG ) );
+    sample->flags = 0;
+    if( end - now >= ( poll->period_q4 >> 4 ) ) {
+      sample->flags |= INA219_SAMPLE_FLAG_TORN;
+      poll->stats.torn++;
+    }
+    poll->stats.fresh++;
+    *ready = true;
+
+    if( ina219_poll_triggered( poll->configuration ) ) {
+      EMBEDD_RESULT result = ina219_poll_trigger( poll );
+      poll->stale = 0;
+      poll->next_us = embedd_hal_get_us() + ( poll->period_q4 >> 4 );
+      return result;
+    }
+    if( poll->stale ) {
+      // between the stale read and this one
+      ina219_poll_lock( poll, poll->stale_us + ( now - poll->stale_us ) / 2U );
+      poll->stale = 0;
+    }
+    ina219_poll_schedule( poll, now );
+    return EMBEDD_RESULT_OK;
+}
+
+uint32_t ina219_poll_wait_us(const ina219_poll_t* poll) {
+    if( poll == NULL ) {
+      return 0;
+    }
+    int32_t wait = (int32_t)( poll->next_us - embedd_hal_get_us() );
+    return wait > 0 ? (uint32_t)wait : 0;
+}
+
+void ina219_poll_get_stats(ina219_poll_t* poll, ina219_poll_stats_t* stats, bool reset) {
+    if( poll == NULL || stats == NULL ) {
+      return;
+    }
+    *stats = poll->stats;
+    if( reset ) {
+      poll->stats = (ina219_poll_stats_t){ 0 };
+    }
+}
@@ -0,0 +1,189 @@
+/*!
+ * \file ina219_poll.h
+ * \brief Power monitor conversion-ready polling
+ *
+ * Reads each conversion once: the next read is scheduled just after the next
+ * conversion completes and the CNVR flag confirms that the registers hold a
+ * conversion not read before. The schedule starts from the typical conversion
+ * time of the configuration and locks onto the device's own clock, which may
+ * be off by several percent: a stale read followed by a ready one brackets the
+ * time a conversion completed, and those times measure the actual period.
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#ifndef _SRC_INA219_POLL_H
+#define _SRC_INA219_POLL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "embedd_device.h"
+#include "ina219_sample.h"
+
+/*!
+ * \def INA219_POLL_PROBE_EVERY
+ * \brief Number of conversions found ready at the first read after which the
+ * next read is scheduled just before the predicted completion, so that the
+ * following reads bracket it again
+ */
+#ifndef INA219_POLL_PROBE_EVERY
+#define INA219_POLL_PROBE_EVERY 16
+#endif
+
+/*!
+ * \def INA219_POLL_BASELINE
+ * \brief Number of conversions over which the actual conversion time is measured
+ */
+#ifndef INA219_POLL_BASELINE
+#define INA219_POLL_BASELINE 256
+#endif
+
+/*!
+ * \def INA219_SAMPLE_FLAG_TORN
+ * \brief Reading the registers took longer than one conversion time, they may
+ * belong to two conversions
+ */
+#define INA219_SAMPLE_FLAG_TORN 0x02
+
+/*!
+ * \struct ina219_poll_stats_t
+ * \brief Polling statistics
+ *
+ * \var fresh   number of conversions read
+ * \var stale   number of reads dropped because CNVR was not set
+ * \var torn    number of conversions flagged INA219_SAMPLE_FLAG_TORN
+ * \var errors  number of failed reads
+ */
+typedef struct {
+  uint32_t fresh;
+  uint32_t stale;
+  uint32_t torn;
+  uint32_t errors;
+} ina219_poll_stats_t;
+
+/*!
+ * \struct ina219_poll_t
+ * \brief Polling state of one device
+ *
+ * \var dev            device polled
+ * \var configuration  configuration register value the schedule is derived from
+ * \var period_us      typical conversion time of that configuration
+ * \var period_q4      measured conversion time in 1/16 us
+ * \var retry_us       delay before reading again after a stale read
+ * \var next_us        time of the next read
+ * \var stale_us       time of the last stale read
+ * \var ref_us         completion time the conversion time is measured from
+ * \var anchor_us      latest bracketed completion time, the schedule is predicted from it
+ * \var locked         bits telling whether ref_us and anchor_us are valid
+ * \var stale         non-zero when the previous read was stale
+ * \var first_try      number of consecutive conversions found ready at the first read
+ * \var probe_every    value of first_try at which the next completion is bracketed again,
+ *                     grows to INA219_POLL_PROBE_EVERY while the period is measured
+ * \var stats          statistics
+ */
+typedef struct {
+  embedd_device_t* dev;
+  uint16_t configuration;
+  uint32_t period_us;
+  uint32_t period_q4;
+  uint32_t retry_us;
+  uint32_t next_us;
+  uint32_t stale_us;
+  uint32_t ref_us;
+  uint32_t anchor_us;
+  uint8_t  locked;
+  uint8_t  stale;
+  uint8_t  first_try;
+  uint8_t  probe_every;
+  ina219_poll_stats_t stats;
+} ina219_poll_t;
+
+/*!
+ * ina219_conversion_time_us
+ * 
+ * \brief Typical time of one conversion cycle of a configuration: the shunt
+ * and/or bus conversion times of the SADC and BADC settings, from 84 us for
+ * one 9-bit conversion to 136.2 ms for 128 samples of both.
+ * 
+ * \param configuration uint16_t configuration register value
+ * 
+ * \return uint32_t conversion time in microseconds, 0 if the mode does not convert
+ */
+uint32_t ina219_conversion_time_us(uint16_t configuration);
+
+/*!
+ * ina219_poll_init
+ * 
+ * \brief Initializes polling of a device in a continuous or triggered mode.
+ * In a triggered mode a conversion is triggered now and after every read.
+ * 
+ * \param poll pointer to ina219_poll_t the state to initialize
+ * \param dev pointer to embedd_device_t the structure representing the device,
+ * its configuration shadow must be valid
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_ERR if the device does not convert,
+ * othewise EMBEDD_RESULT_OK
+ */
+EMBEDD_RESULT ina219_poll_init(ina219_poll_t* poll, embedd_device_t* dev);
+
+/*!
+ * ina219_poll_process
+ * 
+ * \brief Reads the device when the next conversion is due. The bus voltage is
+ * read first: without CNVR the read is counted as stale, dropped and retried
+ * after retry_us. Otherwise shunt voltage, current and power follow, the power
+ * read clears CNVR. A configuration change through the shadow registers, e.g.
+ * by auto-ranging, restarts the schedule with the new conversion time, scaled
+ * by the measured deviation of the device's clock.
+ * 
+ * All four registers must be read within one conversion time, otherwise the
+ * sample is flagged INA219_SAMPLE_FLAG_TORN and conversions are missed; the
+ * shortest usable conversion time depends on the bus speed.
+ * 
+ * \param poll pointer to ina219_poll_t the polling state
+ * \param sample pointer to ina219_sample_t receiving a new conversion, tagged with
+ * the range of the configuration
+ * \param ready pointer to bool set to true when \p sample holds a new conversion
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT ina219_poll_process(ina219_poll_t* poll, ina219_sample_t* sample, bool* ready);
+
+/*!
+ * ina219_poll_wait_us
+ * 
+ * \brief Time until \ref ina219_poll_process needs to be called again.
+ * 
+ * \param poll pointer to ina219_poll_t the polling state
+ * 
+ * \return uint32_t time in microseconds, 0 if a read is due
+ */
+uint32_t ina219_poll_wait_us(const ina219_poll_t* poll);
+
+/*!
+ * ina219_poll_get_stats
+ * 
+ * \brief Returns the polling statistics.
+ * 
+ * \param poll pointer to ina219_poll_t the polling state
+ * \param stats pointer to ina219_poll_stats_t receiving the statistics
+ * \param reset bool true to clear the statistics
+ */
+void ina219_poll_get_stats(ina219_poll_t* poll, ina219_poll_stats_t* stats, bool reset);
+
+#endif//_SRC_INA219_POLL_H
@@ -26,67 +26,55 @@
 
 #include "ina219_registers.h"
 #include "ina219_data_types.h"
+#include "ina219_static.h"
 
 /* --------------------------------------------------------------------------
  * Power monitor register access methods
  * -------------------------------------------------------------------------- */
 
-EMBEDD_RESULT ina219_write_reg(embedd_device_t* dev, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay) {
-    EMBEDD_RESULT result = EMBEDD_RESULT_ERR;
-    if( dev == NULL || reg == NULL ) {
-      return result;
-    }
-    if( ( dev->bus == NULL ) || ( dev->data == NULL ) ) {
-      return result;
+EMBEDD_RESULT ina219_check_device(const embedd_device_t* dev) {
+    if( dev == NULL || dev->data == NULL ) {
+      return EMBEDD_RESULT_ERR;
     }
-    if( dev->bus->write == NULL) {
-      return result;
+#if !defined(INA219_STATIC_BUS_WRITE) || !defined(INA219_STATIC_BUS_READ)
+    if( dev->bus == NULL || dev->bus->write == NULL || dev->bus->read == NULL ) {
+      return EMBEDD_RESULT_ERR;
     }
-    ina219_data_t* _data = (ina219_data_t*)dev->data;
-    if(_data->out_buf == NULL) {
-      return result;
+#endif
+    return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT ina219_write_reg(embedd_device_t* dev, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay) {
+    if( reg == NULL || reg_size + INA219_REGISTER_ADDR_SIZE > INA219_WRITE_MESSAGE_MAX_SIZE ) {
+      return EMBEDD_RESULT_ERR;
     }
-    uint32_t msg_size = INA219_REGISTER_ADDR_SIZE + reg_size ;
-    uint8_t* _out_ptr = _data->out_buf;
-    embedd_pack( _out_ptr, &reg_addr, INA219_REGISTER_ADDR_SIZE );
-    embedd_pack( _out_ptr + INA219_REGISTER_ADDR_SIZE, reg, reg_size );
-    result = dev->bus->write( dev, _out_ptr, msg_size );
-    if(result != EMBEDD_RESULT_OK) {
-      return result;
+    if( ina219_check_device( dev ) != EMBEDD_RESULT_OK ) {
+      return EMBEDD_RESULT_ERR;
     }
-    embedd_hal_sleep( delay );
-    return result;
+    return ina219_write_reg_direct( dev, reg_addr, reg, reg_size, delay );
 }
 
 EMBEDD_RESULT ina219_read_reg(embedd_device_t* dev, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay) {
-    EMBEDD_RESULT result = EMBEDD_RESULT_ERR;
-    if( dev == NULL || reg == NULL ) {
-      return result;
+    if( reg == NULL || reg_size > INA219_READ_MESSAGE_MAX_SIZE ) {
+      return EMBEDD_RESULT_ERR;
     }
-    if( ( dev->bus == NULL ) || ( dev->data == NULL ) ) {
-      return result;
+    if( ina219_check_device( dev ) != EMBEDD_RESULT_OK ) {
+      return EMBEDD_RESULT_ERR;
     }
-    if( dev->bus->write == NULL || dev->bus->read == NULL ) {
-      return result;
+    return ina219_read_reg_direct( dev, reg_addr, reg, reg_size, delay );
+}
+
+bool ina219_ready(embedd_device_t* dev) {
+    if( dev == NULL || dev->data == NULL ) {
+      return false;
     }
     ina219_data_t* _data = (ina219_data_t*)dev->data;
-    if( _data->out_buf == NULL || _data->in_buf == NULL ) {
-      return result;
-    }
-    uint32_t msg_size = INA219_REGISTER_ADDR_SIZE;
-    uint8_t* _out_ptr = _data->out_buf;
-    uint8_t* _in_ptr  = _data->in_buf;
-    embedd_pack( _out_ptr, &reg_addr, INA219_REGISTER_ADDR_SIZE );
-    result = dev->bus->write( dev, _out_ptr, msg_size );
-    if( result != EMBEDD_RESULT_OK ) {
-      return result;
-    }
-    embedd_hal_sleep(delay);
-    result = dev->bus->read( dev, _in_ptr, reg_size );
-    if( result != EMBEDD_RESULT_OK ) {
-      return result;
+    return embedd_hal_deadline_expired( &_data->ready );
+}
+
+void ina219_reg_ptr_invalidate(embedd_device_t* dev) {
+    if( dev == NULL || dev->data == NULL ) {
+      return;
     }
-    embedd_pack( reg, _in_ptr, reg_size );
-    return result;
-}
-
+    ((ina219_data_t*)dev->data)->reg_ptr_valid = 0;
+}
@@ -43,7 +43,11 @@
  * \param reg_size uint32_t Size of the register data in bytes
  * \param delay uint32_t delay Delay in milliseconds after the write operation
  * 
- * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ * The delay is not spent inside this function: it arms a "ready-at" deadline
+ * which the next register access waits for, see \ref ina219_ready.
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR,
+ * also for a register the register map does not list as writable
  */
 EMBEDD_RESULT ina219_write_reg(embedd_device_t* dev, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay);
 
@@ -55,6 +59,13 @@ EMBEDD_RESULT ina219_write_reg(embedd_device_t* dev, uint32_t reg_addr, void* re
  * operation via the hardware abstraction layer (HAL). After reading, it unpacks the
  * received data into the provided buffer.
  * 
+ * The device keeps its pointer register between transactions, so the address
+ * write is skipped when the pointer already selects \p reg_addr. Hits and misses
+ * are counted in \ref ina219_data_t.
+ * 
+ * Registers of 1, 2 or 4 bytes are read straight into \p reg and byte-swapped
+ * in place, so \p reg is undefined when an error is returned.
+ * 
  * \param dev pointer to embedd_device_t the structure representing the device
  * \param reg_addr uint32_t The register address to write to
  * \param reg pointer to void Pointer to the data to write
@@ -65,6 +76,30 @@ EMBEDD_RESULT ina219_write_reg(embedd_device_t* dev, uint32_t reg_addr, void* re
  */
 EMBEDD_RESULT ina219_read_reg(embedd_device_t* dev, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay);
 
+/*!
+ * ina219_ready
+ * 
+ * \brief Non-blocking check whether the delay armed by the last register access
+ * has elapsed. A register access issued before that blocks until it has.
+ * 
+ * \param dev pointer to embedd_device_t the structure representing the device
+ * 
+ * \return bool true if the device can be accessed without waiting
+ */
+bool ina219_ready(embedd_device_t* dev);
+
+/*!
+ * ina219_reg_ptr_invalidate
+ * 
+ * \brief Forgets the cached pointer register value so that the next read writes
+ * the register address again. Bus errors and device resets invalidate the cache
+ * automatically; call this when the device may have been reset behind the
+ * driver's back, e.g. after a power cycle or an access by another bus master.
+ * 
+ * \param dev pointer to embedd_device_t the structure representing the device
+ */
+void ina219_reg_ptr_invalidate(embedd_device_t* dev);
+
 /* -------------------------------------------------------------------------
  * Registers functions prototypes - END
  * ------------------------------------------------------------------------*/
@@ -0,0 +1,136 @@
+/*!
+ * \file ina219_regmap.c
+ * \brief Power monitor register map
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#include <string.h>
+
+#include "embedd_device.h"
+
+#include "ina219_registers.h"
+#include "ina219_regmap.h"
+#include "ina219_shadow.h"
+
+#define INA219_REGMAP_DESC(_reg, _REG, _access, _flags) \
+  [INA219_REGMAP_##_REG] = { \
+    .name   = #_REG, \
+    .addr   = ina219_##_reg##_read_reg_addr, \
+    .size   = sizeof(ina219_##_reg), \
+    .access = (_access), \
+    .flags  = (_flags), \
+    .delay  = ina219_##_reg##_delay, \
+  },
+
+const ina219_reg_desc_t ina219_regmap[INA219_REGMAP_COUNT] = {
+  INA219_REGMAP_LIST(INA219_REGMAP_DESC)
+};
+
+// a full range read must fill a snapshot exactly
+#define INA219_REGMAP_SIZE(_reg, _REG, _access, _flags) + sizeof(ina219_##_reg)
+_Static_assert( sizeof(ina219_snapshot_t) == 0 INA219_REGMAP_LIST(INA219_REGMAP_SIZE),
+                "ina219_snapshot_t does not match the register map" );
+
+const ina219_reg_desc_t* ina219_regmap_find(uint32_t reg_addr) {
+    for( size_t i = 0; i < INA219_REGMAP_COUNT; i++ ) {
+      if( ina219_regmap[i].addr == reg_addr ) {
+        return &ina219_regmap[i];
+      }
+    }
+    return NULL;
+}
+
+// a register the device does not change on its own is taken from the shadow while it is valid
+static EMBEDD_RESULT ina219_regmap_read_desc(embedd_device_t* dev, const ina219_reg_desc_t* desc, void* val) {
+    if( !( desc->flags & INA219_REG_FLAG_VOLATILE ) ) {
+      if( desc->addr == ina219_configuration_read_reg_addr ) {
+        ina219_configuration_t cfg;
+        if( ina219_shadow_get_configuration( dev, &cfg ) == EMBEDD_RESULT_OK ) {
+          memcpy( val, &cfg, sizeof(cfg) );
+          return EMBEDD_RESULT_OK;
+        }
+      } else if( desc->addr == ina219_calibration_read_reg_addr ) {
+        ina219_calibration_t cal;
+        if( ina219_shadow_get_calibration( dev, &cal ) == EMBEDD_RESULT_OK ) {
+          memcpy( val, &cal, sizeof(cal) );
+          return EMBEDD_RESULT_OK;
+        }
+      }
+    }
+    return ina219_read_reg( dev, desc->addr, val, desc->size, desc->delay );
+}
+
+EMBEDD_RESULT ina219_regmap_read(embedd_device_t* dev, uint32_t reg_addr, void* val) {
+    const ina219_reg_desc_t* desc = ina219_regmap_find( reg_addr );
+    if( desc == NULL || !( desc->access & INA219_REG_ACCESS_RO ) || val == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    return ina219_regmap_read_desc( dev, desc, val );
+}
+
+EMBEDD_RESULT ina219_regmap_write(embedd_device_t* dev, uint32_t reg_addr, const void* val) {
+    const ina219_reg_desc_t* desc = ina219_regmap_find( reg_addr );
+    if( desc == NULL || !( desc->access & INA219_REG_ACCESS_WO ) ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    return ina219_write_reg( dev, desc->addr, (void*)val, desc->size, desc->delay );
+}
+
+EMBEDD_RESULT ina219_regmap_read_range(embedd_device_t* dev, uint32_t first_addr, uint32_t last_addr,
+                                       void* buf, size_t buf_size, size_t* read_size) {
+    if( buf == NULL || first_addr > last_addr ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    uint8_t* _buf_ptr = (uint8_t*)buf;
+    size_t offset = 0;
+    for( size_t i = 0; i < INA219_REGMAP_COUNT; i++ ) {
+      const ina219_reg_desc_t* desc = &ina219_regmap[i];
+      if( desc->addr < first_addr || desc->addr > last_addr || !( desc->access & INA219_REG_ACCESS_RO ) ) {
+        continue;
+      }
+      if( offset + desc->size > buf_size ) {
+        return EMBEDD_RESULT_ERR;
+      }
+      if( ina219_regmap_read_desc( dev, desc, _buf_ptr + offset ) != EMBEDD_RESULT_OK ) {
+        return EMBEDD_RESULT_ERR;
+      }
+      offset += desc->size;
+    }
+    if( read_size != NULL ) {
+      *read_size = offset;
+    }
+    return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT ina219_regmap_write_bulk(embedd_device_t* dev, const ina219_reg_write_t* writes, size_t count) {
+    if( writes == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    for( size_t i = 0; i < count; i++ ) {
+      const ina219_reg_desc_t* desc = ina219_regmap_find( writes[i].addr );
+      if( desc == NULL || !( desc->access & INA219_REG_ACCESS_WO ) || writes[i].val == NULL ) {
+        return EMBEDD_RESULT_ERR;
+      }
+    }
+    for( size_t i = 0; i < count; i++ ) {
+      if( ina219_regmap_write( dev, writes[i].addr, writes[i].val ) != EMBEDD_RESULT_OK ) {
+        return EMBEDD_RESULT_ERR;
+      }
+    }
+    return EMBEDD_RESULT_OK;
+}
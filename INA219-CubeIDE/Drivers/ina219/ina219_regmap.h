@@ -0,0 +1,234 @@
+/*!
+ * \file ina219_regmap.h
+ * \brief Power monitor register map
+ *
+ * Constant table describing every register of the device (address, size,
+ * access mode, volatility and delay) and register access built on top of it.
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#ifndef _SRC_INA219_REGMAP_H
+#define _SRC_INA219_REGMAP_H
+
+#include "embedd_device.h"
+#include "ina219_data_types.h"
+#include "ina219_registers.h"
+
+/*!
+ * \macro INA219_REGMAP_LIST
+ * \brief List of all registers in address order: X(name, NAME, access, flags)
+ *
+ * The address, size and delay of each entry come from the ina219_<name>
+ * definitions of ina219_registers.h.
+ */
+#define INA219_REGMAP_LIST(X) \
+  X(configuration, CONFIGURATION, INA219_REG_ACCESS_RW, INA219_REG_FLAG_CACHEABLE) \
+  X(shunt_voltage, SHUNT_VOLTAGE, INA219_REG_ACCESS_RO, INA219_REG_FLAG_VOLATILE)  \
+  X(bus_voltage,   BUS_VOLTAGE,   INA219_REG_ACCESS_RO, INA219_REG_FLAG_VOLATILE)  \
+  X(power,         POWER,         INA219_REG_ACCESS_RO, INA219_REG_FLAG_VOLATILE)  \
+  X(current,       CURRENT,       INA219_REG_ACCESS_RO, INA219_REG_FLAG_VOLATILE)  \
+  X(calibration,   CALIBRATION,   INA219_REG_ACCESS_RW, INA219_REG_FLAG_CACHEABLE)
+
+/*!
+ * \enum ina219_reg_access_t
+ * \brief Access mode of a register
+ */
+typedef enum {
+  INA219_REG_ACCESS_RO = 0x01,
+  INA219_REG_ACCESS_WO = 0x02,
+  INA219_REG_ACCESS_RW = INA219_REG_ACCESS_RO | INA219_REG_ACCESS_WO,
+} ina219_reg_access_t;
+
+/*!
+ * \def INA219_REG_FLAG_VOLATILE
+ * \brief The device changes the register on its own, e.g. with every conversion;
+ * it is always read from the device
+ */
+#define INA219_REG_FLAG_VOLATILE  0x01
+
+/*!
+ * \def INA219_REG_FLAG_CACHEABLE
+ * \brief The register only changes when it is written, so a copy of it can be
+ * trusted; writes of it are tracked by the register shadow
+ */
+#define INA219_REG_FLAG_CACHEABLE 0x02
+
+#define INA219_REGMAP_WRITABLE_BIT(_reg, _REG, _access, _flags) \
+  | ( ( (_access) & INA219_REG_ACCESS_WO ) ? ( 1U << ina219_##_reg##_read_reg_addr ) : 0U )
+#define INA219_REGMAP_CACHEABLE_BIT(_reg, _REG, _access, _flags) \
+  | ( ( (_flags) & INA219_REG_FLAG_CACHEABLE ) ? ( 1U << ina219_##_reg##_read_reg_addr ) : 0U )
+
+/*!
+ * \def INA219_REGMAP_WRITABLE
+ * \brief Bit mask of the addresses of the registers which can be written
+ */
+#define INA219_REGMAP_WRITABLE  ( 0U INA219_REGMAP_LIST(INA219_REGMAP_WRITABLE_BIT) )
+
+/*!
+ * \def INA219_REGMAP_CACHEABLE
+ * \brief Bit mask of the addresses of the registers flagged INA219_REG_FLAG_CACHEABLE
+ */
+#define INA219_REGMAP_CACHEABLE ( 0U INA219_REGMAP_LIST(INA219_REGMAP_CACHEABLE_BIT) )
+
+/*!
+ * ina219_regmap_writable
+ * 
+ * \param reg_addr uint32_t register address
+ * 
+ * \return bool true if the register exists and can be written
+ */
+static inline bool ina219_regmap_writable(uint32_t reg_addr) {
+    return reg_addr < 32U && ( ( INA219_REGMAP_WRITABLE >> reg_addr ) & 1U ) != 0U;
+}
+
+/*!
+ * ina219_regmap_cacheable
+ * 
+ * \param reg_addr uint32_t register address
+ * 
+ * \return bool true if the register exists and only changes when it is written
+ */
+static inline bool ina219_regmap_cacheable(uint32_t reg_addr) {
+    return reg_addr < 32U && ( ( INA219_REGMAP_CACHEABLE >> reg_addr ) & 1U ) != 0U;
+}
+
+/*!
+ * \enum ina219_regmap_index_t
+ * \brief Index of each register in \ref ina219_regmap
+ */
+#define INA219_REGMAP_INDEX(_reg, _REG, _access, _flags) INA219_REGMAP_##_REG,
+typedef enum {
+  INA219_REGMAP_LIST(INA219_REGMAP_INDEX)
+  INA219_REGMAP_COUNT
+} ina219_regmap_index_t;
+#undef INA219_REGMAP_INDEX
+
+/*!
+ * \struct ina219_reg_desc_t
+ * \brief Register descriptor
+ *
+ * \var name    register name
+ * \var addr    register address
+ * \var size    size of the register data in bytes
+ * \var access  \ref ina219_reg_access_t access mode
+ * \var flags   INA219_REG_FLAG_* flags
+ * \var delay   delay in milliseconds after the register access
+ */
+typedef struct {
+  const char* name;
+  uint8_t     addr;
+  uint8_t     size;
+  uint8_t     access;
+  uint8_t     flags;
+  uint32_t    delay;
+} ina219_reg_desc_t;
+
+/*!
+ * \struct ina219_reg_write_t
+ * \brief One entry of a bulk register write
+ *
+ * \var addr  register address
+ * \var val   pointer to the register variable to write
+ */
+typedef struct {
+  uint8_t     addr;
+  const void* val;
+} ina219_reg_write_t;
+
+/*!
+ * \var ina219_regmap
+ * \brief Descriptors of all registers, indexed by \ref ina219_regmap_index_t
+ */
+extern const ina219_reg_desc_t ina219_regmap[INA219_REGMAP_COUNT];
+
+/*!
+ * ina219_regmap_find
+ * 
+ * \brief Looks up the descriptor of a register.
+ * 
+ * \param reg_addr uint32_t register address
+ * 
+ * \return pointer to the descriptor or NULL if there is no such register
+ */
+const ina219_reg_desc_t* ina219_regmap_find(uint32_t reg_addr);
+
+/*!
+ * ina219_regmap_read
+ * 
+ * \brief Reads a register described by the register map. Registers which are
+ * not INA219_REG_FLAG_VOLATILE come from the register shadow while it is valid.
+ * 
+ * \param dev pointer to embedd_device_t the structure representing the device
+ * \param reg_addr uint32_t register address
+ * \param val pointer to the register variable, at least the register size
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, EMBEDD_RESULT_ERR on a bus
+ * error, an unknown register or a register which cannot be read
+ */
+EMBEDD_RESULT ina219_regmap_read(embedd_device_t* dev, uint32_t reg_addr, void* val);
+
+/*!
+ * ina219_regmap_write
+ * 
+ * \brief Writes a register described by the register map.
+ * 
+ * \param dev pointer to embedd_device_t the structure representing the device
+ * \param reg_addr uint32_t register address
+ * \param val pointer to the register variable
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, EMBEDD_RESULT_ERR on a bus
+ * error, an unknown register or a register which cannot be written
+ */
+EMBEDD_RESULT ina219_regmap_write(embedd_device_t* dev, uint32_t reg_addr, const void* val);
+
+/*!
+ * ina219_regmap_read_range
+ * 
+ * \brief Reads all readable registers from \p first_addr to \p last_addr and stores
+ * them back to back in \p buf, in address order. Reading the whole map fills an
+ * ina219_snapshot_t, though without its conversion consistency check. Registers
+ * which are not INA219_REG_FLAG_VOLATILE come from the register shadow while it
+ * is valid.
+ * 
+ * \param dev pointer to embedd_device_t the structure representing the device
+ * \param first_addr uint32_t address of the first register
+ * \param last_addr uint32_t address of the last register
+ * \param buf pointer to the destination buffer
+ * \param buf_size size_t size of \p buf in bytes
+ * \param read_size pointer to size_t receiving the number of bytes stored, may be NULL
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT ina219_regmap_read_range(embedd_device_t* dev, uint32_t first_addr, uint32_t last_addr,
+                                       void* buf, size_t buf_size, size_t* read_size);
+
+/*!
+ * ina219_regmap_write_bulk
+ * 
+ * \brief Writes a list of registers in the given order. All entries are checked
+ * against the register map before the first write, so a bad entry writes nothing.
+ * 
+ * \param dev pointer to embedd_device_t the structure representing the device
+ * \param writes pointer to the list of registers to write
+ * \param count size_t number of entries in \p writes
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT ina219_regmap_write_bulk(embedd_device_t* dev, const ina219_reg_write_t* writes, size_t count);
+
+#endif//_SRC_INA219_REGMAP_H
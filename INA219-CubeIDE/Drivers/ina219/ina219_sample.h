@@ -0,0 +1,108 @@
+/*!
+ * \file ina219_sample.h
+ * \brief Power monitor measurement sample
+ *
+ * One conversion as raw register words, with the time it was read and the
+ * range it was taken in. Samples are small enough to be queued and converted
+ * later with the scale of their range.
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#ifndef _SRC_INA219_SAMPLE_H
+#define _SRC_INA219_SAMPLE_H
+
+#include <stdint.h>
+
+#include "ina219_data_types.h"
+#include "ina219_fields.h"
+
+/*!
+ * \def INA219_RANGE
+ * \brief Range tag of a PGA and bus range setting
+ */
+#define INA219_RANGE(pg, brng) ( (uint8_t)( ( (pg) & 0x03 ) | ( ( (brng) & 0x01 ) << 2 ) ) )
+
+/*!
+ * \def INA219_RANGE_PG
+ * \brief INA219_CONFIGURATION_PG_* setting of a range tag
+ */
+#define INA219_RANGE_PG(range)   ( (uint8_t)( (range) & 0x03 ) )
+
+/*!
+ * \def INA219_RANGE_BRNG
+ * \brief INA219_CONFIGURATION_BRNG_* setting of a range tag
+ */
+#define INA219_RANGE_BRNG(range) ( (uint8_t)( ( (range) >> 2 ) & 0x01 ) )
+
+/*!
+ * \def INA219_RANGE_COUNT
+ * \brief Number of range tags
+ */
+#define INA219_RANGE_COUNT 8
+
+/*!
+ * \def INA219_SAMPLE_FLAG_SETTLING
+ * \brief The range was switched shortly before the sample was read, it may
+ * still hold a conversion taken in the previous range
+ */
+#define INA219_SAMPLE_FLAG_SETTLING 0x01
+
+/*!
+ * \struct ina219_sample_t
+ * \brief One conversion
+ *
+ * \var timestamp_us   value of embedd_hal_get_us when the registers were read
+ * \var shunt_voltage  shunt voltage register word
+ * \var bus_voltage    bus voltage register word
+ * \var power          power register word
+ * \var current        current register word
+ * \var range          INA219_RANGE tag of the PGA and bus range setting
+ * \var flags          INA219_SAMPLE_FLAG_* flags
+ */
+typedef struct {
+  uint32_t timestamp_us;
+  uint16_t shunt_voltage;
+  uint16_t bus_voltage;
+  uint16_t power;
+  uint16_t current;
+  uint8_t  range;
+  uint8_t  flags;
+} ina219_sample_t;
+
+/*!
+ * ina219_sample_from_snapshot
+ * 
+ * \brief Fills a sample from the registers of a snapshot, the range is taken
+ * from the configuration register of the snapshot.
+ * 
+ * \param sample pointer to ina219_sample_t the sample to fill
+ * \param snap pointer to ina219_snapshot_t the registers
+ * \param timestamp_us uint32_t time the snapshot was read
+ */
+static inline void ina219_sample_from_snapshot(ina219_sample_t* sample, const ina219_snapshot_t* snap, uint32_t timestamp_us) {
+    uint16_t cfg = ina219_reg_word( &snap->configuration );
+    sample->timestamp_us = timestamp_us;
+    sample->shunt_voltage = ina219_reg_word( &snap->shunt_voltage );
+    sample->bus_voltage = ina219_reg_word( &snap->bus_voltage );
+    sample->power = ina219_reg_word( &snap->power );
+    sample->current = ina219_reg_word( &snap->current );
+    sample->range = INA219_RANGE( INA219_FIELD_GET( cfg, CONFIGURATION, PG ), INA219_FIELD_GET( cfg, CONFIGURATION, BRNG ) );
+    sample->flags = 0;
+}
+
+#endif//_SRC_INA219_SAMPLE_H
@@ -0,0 +1,135 @@
+/*!
+ * \file ina219_shadow.c
+ * \brief Power monitor shadow registers
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#include "embedd_device.h"
+
+#include "ina219_registers.h"
+#include "ina219_shadow.h"
+
+static ina219_data_t* ina219_shadow_data(embedd_device_t* dev, uint8_t reg) {
+    if( dev == NULL || dev->data == NULL ) {
+      return NULL;
+    }
+    ina219_data_t* _data = (ina219_data_t*)dev->data;
+    return ( _data->shadow_valid & reg ) ? _data : NULL;
+}
+
+EMBEDD_RESULT ina219_shadow_resync(embedd_device_t* dev) {
+    if( dev == NULL || dev->data == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    ina219_data_t* _data = (ina219_data_t*)dev->data;
+    _data->shadow_valid = 0;
+    if( ina219_read_reg( dev, ina219_configuration_read_reg_addr, &_data->shadow_configuration,
+                         sizeof(ina219_configuration), ina219_configuration_delay ) != EMBEDD_RESULT_OK ||
+        ina219_read_reg( dev, ina219_calibration_read_reg_addr, &_data->shadow_calibration,
+                         sizeof(ina219_calibration), ina219_calibration_delay ) != EMBEDD_RESULT_OK ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    _data->staged_configuration = _data->shadow_configuration;
+    _data->staged_calibration = _data->shadow_calibration;
+    _data->shadow_valid = INA219_SHADOW_CONFIGURATION | INA219_SHADOW_CALIBRATION;
+    return EMBEDD_RESULT_OK;
+}
+
+#define INA219_SHADOW_SET_FIELD(_field, _FIELD) \
+EMBEDD_RESULT ina219_shadow_set_##_field(embedd_device_t* dev, uint8_t val) { \
+    ina219_data_t* _data = ina219_shadow_data( dev, INA219_SHADOW_CONFIGURATION ); \
+    if( _data == NULL || !( INA219_CONFIGURATION_##_FIELD##_VALID( val ) ) ) { \
+      return EMBEDD_RESULT_ERR; \
+    } \
+    uint16_t word = ina219_reg_word( &_data->staged_configuration ); \
+    ina219_reg_set_word( &_data->staged_configuration, INA219_FIELD_SET( word, CONFIGURATION, _FIELD, val ) ); \
+    return EMBEDD_RESULT_OK; \
+}
+
+INA219_SHADOW_SET_FIELD(mode, MODE)
+INA219_SHADOW_SET_FIELD(sadc, SADC)
+INA219_SHADOW_SET_FIELD(badc, BADC)
+INA219_SHADOW_SET_FIELD(pg, PG)
+INA219_SHADOW_SET_FIELD(brng, BRNG)
+
+EMBEDD_RESULT ina219_shadow_set_calibration(embedd_device_t* dev, uint16_t val) {
+    ina219_data_t* _data = ina219_shadow_data( dev, INA219_SHADOW_CALIBRATION );
+    if( _data == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    ina219_reg_set_word( &_data->staged_calibration, val & INA219_CALIBRATION_FS_MASK );
+    return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT ina219_shadow_commit(embedd_device_t* dev) {
+    if( dev == NULL || dev->data == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    ina219_data_t* _data = (ina219_data_t*)dev->data;
+    // both staged registers are only meaningful on top of a valid shadow
+    if( ( _data->shadow_valid & ( INA219_SHADOW_CONFIGURATION | INA219_SHADOW_CALIBRATION ) ) !=
+        ( INA219_SHADOW_CONFIGURATION | INA219_SHADOW_CALIBRATION ) ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    if( ina219_reg_word( &_data->staged_configuration ) != ina219_reg_word( &_data->shadow_configuration ) ) {
+      ina219_configuration_t cfg = _data->staged_configuration;
+      if( ina219_write_reg( dev, ina219_configuration_write_reg_addr, &cfg,
+                            sizeof(ina219_configuration), ina219_configuration_delay ) != EMBEDD_RESULT_OK ) {
+        return EMBEDD_RESULT_ERR;
+      }
+    } else {
+      _data->shadow_skipped++;
+    }
+    if( ina219_reg_word( &_data->staged_calibration ) != ina219_reg_word( &_data->shadow_calibration ) ) {
+      ina219_calibration_t cal = _data->staged_calibration;
+      if( ina219_write_reg( dev, ina219_calibration_write_reg_addr, &cal,
+                            sizeof(ina219_calibration), ina219_calibration_delay ) != EMBEDD_RESULT_OK ) {
+        return EMBEDD_RESULT_ERR;
+      }
+    } else {
+      _data->shadow_skipped++;
+    }
+    return EMBEDD_RESULT_OK;
+}
+
+void ina219_shadow_discard(embedd_device_t* dev) {
+    if( dev == NULL || dev->data == NULL ) {
+      return;
+    }
+    ina219_data_t* _data = (ina219_data_t*)dev->data;
+    _data->staged_configuration = _data->shadow_configuration;
+    _data->staged_calibration = _data->shadow_calibration;
+}
+
+EMBEDD_RESULT ina219_shadow_get_configuration(embedd_device_t* dev, ina219_configuration_t* cfg) {
+    ina219_data_t* _data = ina219_shadow_data( dev, INA219_SHADOW_CONFIGURATION );
+    if( _data == NULL || cfg == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    *cfg = _data->shadow_configuration;
+    return EMBEDD_RESULT_OK;
+}
+
+EMBEDD_RESULT ina219_shadow_get_calibration(embedd_device_t* dev, ina219_calibration_t* cal) {
+    ina219_data_t* _data = ina219_shadow_data( dev, INA219_SHADOW_CALIBRATION );
+    if( _data == NULL || cal == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    *cal = _data->shadow_calibration;
+    return EMBEDD_RESULT_OK;
+}
@@ -0,0 +1,203 @@
+/*!
+ * \file ina219_shadow.h
+ * \brief Power monitor shadow registers
+ *
+ * Write-through copies of the configuration and calibration registers. Fields
+ * are changed in the copies without bus reads and several changes go to the
+ * device in a single register write, or none when nothing changed.
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#ifndef _SRC_INA219_SHADOW_H
+#define _SRC_INA219_SHADOW_H
+
+#include "embedd_device.h"
+#include "ina219_data_types.h"
+#include "ina219_registers.h"
+#include "ina219_fields.h"
+#include "ina219_regmap.h"
+
+/*!
+ * \def INA219_SHADOW_CONFIGURATION
+ * \brief ina219_data_t.shadow_valid bit of the configuration register
+ */
+#define INA219_SHADOW_CONFIGURATION 0x01
+
+/*!
+ * \def INA219_SHADOW_CALIBRATION
+ * \brief ina219_data_t.shadow_valid bit of the calibration register
+ */
+#define INA219_SHADOW_CALIBRATION   0x02
+
+/*!
+ * \def INA219_CONFIGURATION_RESET_VALUE
+ * \brief Configuration register value after power-on or a reset through the rst bit
+ */
+#define INA219_CONFIGURATION_RESET_VALUE 0x399F
+
+/*!
+ * \def INA219_CALIBRATION_RESET_VALUE
+ * \brief Calibration register value after power-on or a reset through the rst bit
+ */
+#define INA219_CALIBRATION_RESET_VALUE   0x0000
+
+/*!
+ * ina219_shadow_reset
+ * 
+ * \brief Sets the shadow registers to the values the device has after a reset
+ * and drops staged changes.
+ * 
+ * \param _data pointer to ina219_data_t the data of the device
+ */
+static inline void ina219_shadow_reset(ina219_data_t* _data) {
+    ina219_reg_set_word( &_data->shadow_configuration, INA219_CONFIGURATION_RESET_VALUE );
+    ina219_reg_set_word( &_data->shadow_calibration, INA219_CALIBRATION_RESET_VALUE );
+    _data->staged_configuration = _data->shadow_configuration;
+    _data->staged_calibration = _data->shadow_calibration;
+    _data->shadow_valid = INA219_SHADOW_CONFIGURATION | INA219_SHADOW_CALIBRATION;
+}
+
+/*!
+ * ina219_shadow_written
+ * 
+ * \brief Keeps the shadow registers in line with a register write. Called by
+ * every register write path of the driver; a write replaces the staged changes
+ * of the written register.
+ * 
+ * \param _data pointer to ina219_data_t the data of the device
+ * \param reg_addr uint32_t address of the written register
+ * \param reg pointer to the written register variable
+ * \param result EMBEDD_RESULT result of the write
+ */
+static inline void ina219_shadow_written(ina219_data_t* _data, uint32_t reg_addr, const void* reg, EMBEDD_RESULT result) {
+    if( !ina219_regmap_cacheable( reg_addr ) ) {
+      return;
+    }
+    if( reg_addr == ina219_configuration_write_reg_addr ) {
+      if( result != EMBEDD_RESULT_OK ) {
+        // the device may or may not have taken the value
+        _data->shadow_valid &= (uint8_t)~INA219_SHADOW_CONFIGURATION;
+      } else if( INA219_FIELD_GET( ina219_reg_word( reg ), CONFIGURATION, RST ) ) {
+        ina219_shadow_reset( _data );
+      } else {
+        ina219_reg_set_word( &_data->shadow_configuration, ina219_reg_word( reg ) );
+        _data->staged_configuration = _data->shadow_configuration;
+        _data->shadow_valid |= INA219_SHADOW_CONFIGURATION;
+      }
+    } else if( reg_addr == ina219_calibration_write_reg_addr ) {
+      if( result != EMBEDD_RESULT_OK ) {
+        _data->shadow_valid &= (uint8_t)~INA219_SHADOW_CALIBRATION;
+      } else {
+        ina219_reg_set_word( &_data->shadow_calibration, ina219_reg_word( reg ) );
+        _data->staged_calibration = _data->shadow_calibration;
+        _data->shadow_valid |= INA219_SHADOW_CALIBRATION;
+      }
+    }
+}
+
+/*!
+ * ina219_shadow_resync
+ * 
+ * \brief Reads configuration and calibration from the device into the shadow
+ * registers and drops staged changes. Needed once at start-up unless the device
+ * is reset through the rst bit, and after an unexpected device reset.
+ * 
+ * \param dev pointer to embedd_device_t the structure representing the device
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT ina219_shadow_resync(embedd_device_t* dev);
+
+/*!
+ * ina219_shadow_set_mode, ina219_shadow_set_sadc, ina219_shadow_set_badc,
+ * ina219_shadow_set_pg, ina219_shadow_set_brng
+ * 
+ * \brief Stage a new value of one configuration field. Nothing is sent to the
+ * device until \ref ina219_shadow_commit.
+ * 
+ * \param dev pointer to embedd_device_t the structure representing the device
+ * \param val uint8_t new value, one of the INA219_CONFIGURATION_<FIELD>_* values
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_ERR if the value is not valid or the
+ * configuration shadow needs a resync, othewise EMBEDD_RESULT_OK
+ */
+EMBEDD_RESULT ina219_shadow_set_mode(embedd_device_t* dev, uint8_t val);
+EMBEDD_RESULT ina219_shadow_set_sadc(embedd_device_t* dev, uint8_t val);
+EMBEDD_RESULT ina219_shadow_set_badc(embedd_device_t* dev, uint8_t val);
+EMBEDD_RESULT ina219_shadow_set_pg(embedd_device_t* dev, uint8_t val);
+EMBEDD_RESULT ina219_shadow_set_brng(embedd_device_t* dev, uint8_t val);
+
+/*!
+ * ina219_shadow_set_calibration
+ * 
+ * \brief Stages a new calibration register value. Bit 0 cannot be set on the
+ * device and is cleared.
+ * 
+ * \param dev pointer to embedd_device_t the structure representing the device
+ * \param val uint16_t new calibration register value
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT ina219_shadow_set_calibration(embedd_device_t* dev, uint16_t val);
+
+/*!
+ * ina219_shadow_commit
+ * 
+ * \brief Writes every staged register which differs from the device, one register
+ * write each. Registers which are unchanged are not written.
+ * 
+ * \param dev pointer to embedd_device_t the structure representing the device
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT ina219_shadow_commit(embedd_device_t* dev);
+
+/*!
+ * ina219_shadow_discard
+ * 
+ * \brief Drops the staged changes.
+ * 
+ * \param dev pointer to embedd_device_t the structure representing the device
+ */
+void ina219_shadow_discard(embedd_device_t* dev);
+
+/*!
+ * ina219_shadow_get_configuration
+ * 
+ * \brief Returns the configuration register without a bus access.
+ * 
+ * \param dev pointer to embedd_device_t the structure representing the device
+ * \param cfg pointer to ina219_configuration_t receiving the committed value
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_ERR if the shadow needs a resync, othewise EMBEDD_RESULT_OK
+ */
+EMBEDD_RESULT ina219_shadow_get_configuration(embedd_device_t* dev, ina219_configuration_t* cfg);
+
+/*!
+ * ina219_shadow_get_calibration
+ * 
+ * \brief Returns the calibration register without a bus access.
+ * 
+ * \param dev pointer to embedd_device_t the structure representing the device
+ * \param cal pointer to ina219_calibration_t receiving the committed value
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_ERR if the shadow needs a resync, othewise EMBEDD_RESULT_OK
+ */
+EMBEDD_RESULT ina219_shadow_get_calibration(embedd_device_t* dev, ina219_calibration_t* cal);
+
+#endif//_SRC_INA219_SHADOW_H
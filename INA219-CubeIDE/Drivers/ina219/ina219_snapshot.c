@@ -0,0 +1,132 @@
+/*!
+ * \file ina219_snapshot.c
+ * \brief Power monitor coherent register snapshot
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+
+#include "embedd_device.h"
+
+#include "ina219_registers.h"
+#include "ina219_shadow.h"
+#include "ina219_snapshot.h"
+#include "ina219_static.h"
+
+#if INA219_STATIC_DISPATCH
+#define INA219_SNAPSHOT_READ(dev, _typename, var) \
+  ina219_read_reg_direct((dev), _typename##_read_reg_addr, &(var), \
+  sizeof(_typename), _typename##_delay)
+#define INA219_SNAPSHOT_WRITE(dev, _typename, var) \
+  ina219_write_reg_direct((dev), _typename##_write_reg_addr, &(var), \
+  sizeof(_typename), _typename##_delay)
+#else
+#define INA219_SNAPSHOT_READ(dev, _typename, var) \
+  ina219_read_reg((dev), _typename##_read_reg_addr, &(var), \
+  sizeof(_typename), _typename##_delay)
+#define INA219_SNAPSHOT_WRITE(dev, _typename, var) \
+  ina219_write_reg((dev), _typename##_write_reg_addr, &(var), \
+  sizeof(_typename), _typename##_delay)
+#endif
+
+// the results of a triggered conversion stay until the next trigger: in a
+// continuous mode the matching triggered one converts once, CNVR is waited
+// for, the other three registers are read and the configuration is restored
+static EMBEDD_RESULT ina219_snapshot_triggered(embedd_device_t* dev, ina219_snapshot_t* snap) {
+    ina219_data_t* _data = (ina219_data_t*)dev->data;
+    uint16_t word = ina219_reg_word( &snap->configuration );
+    uint8_t mode = (uint8_t)INA219_FIELD_GET( word, CONFIGURATION, MODE );
+    bool continuous = mode > INA219_CONFIGURATION_MODE_ADC_OFF_DISABLED;
+    bool staged_valid = ( _data->shadow_valid & INA219_SHADOW_CONFIGURATION ) != 0;
+    ina219_configuration_t staged = _data->staged_configuration;
+    ina219_configuration_t triggered;
+    EMBEDD_RESULT result = EMBEDD_RESULT_ERR;
+
+    _data->snapshot_triggered++;
+    if( continuous ) {
+      ina219_reg_set_word( &triggered, INA219_FIELD_SET( word, CONFIGURATION, MODE, mode - INA219_CONFIGURATION_MODE_ADC_OFF_DISABLED ) );
+      if( INA219_SNAPSHOT_WRITE( dev, ina219_configuration, triggered ) != EMBEDD_RESULT_OK ) {
+        return result;
+      }
+    }
+    embedd_hal_deadline_t timeout;
+    embedd_hal_deadline_arm( &timeout, INA219_SNAPSHOT_WAIT_US );
+    for( ;; ) {
+      if( INA219_SNAPSHOT_READ( dev, ina219_bus_voltage, snap->bus_voltage ) != EMBEDD_RESULT_OK ) {
+        break;
+      }
+      if( snap->bus_voltage.cnvr != INA219_BUS_VOLTAGE_CNVR_CONVERSION_NOT_READY ) {
+        if( INA219_SNAPSHOT_READ( dev, ina219_power,         snap->power )         == EMBEDD_RESULT_OK &&
+            INA219_SNAPSHOT_READ( dev, ina219_shunt_voltage, snap->shunt_voltage ) == EMBEDD_RESULT_OK &&
+            INA219_SNAPSHOT_READ( dev, ina219_current,       snap->current )       == EMBEDD_RESULT_OK ) {
+          result = EMBEDD_RESULT_OK;
+        }
+        break;
+      }
+      if( embedd_hal_deadline_expired( &timeout ) ) {
+        break;
+      }
+      embedd_hal_sleep_us( INA219_SNAPSHOT_POLL_US );
+    }
+    if( continuous ) {
+      if( INA219_SNAPSHOT_WRITE( dev, ina219_configuration, snap->configuration ) != EMBEDD_RESULT_OK ) {
+        return EMBEDD_RESULT_ERR;
+      }
+      // the writes above must not drop changes staged in the shadow
+      if( staged_valid ) {
+        _data->staged_configuration = staged;
+      }
+    }
+    return result;
+}
+
+EMBEDD_RESULT ina219_read_snapshot(embedd_device_t* dev, ina219_snapshot_t* snap) {
+    EMBEDD_RESULT result = EMBEDD_RESULT_ERR;
+    if( dev == NULL || snap == NULL || dev->data == NULL ) {
+      return result;
+    }
+    ina219_data_t* _data = (ina219_data_t*)dev->data;
+
+    // the shadow holds what the driver wrote, the bus is only needed without it
+    if( ina219_shadow_get_configuration( dev, &snap->configuration ) != EMBEDD_RESULT_OK &&
+        INA219_SNAPSHOT_READ( dev, ina219_configuration, snap->configuration ) != EMBEDD_RESULT_OK ) {
+      return result;
+    }
+    if( ina219_shadow_get_calibration( dev, &snap->calibration ) != EMBEDD_RESULT_OK &&
+        INA219_SNAPSHOT_READ( dev, ina219_calibration, snap->calibration ) != EMBEDD_RESULT_OK ) {
+      return result;
+    }
+
+    for( uint32_t attempt = 0; attempt <= INA219_SNAPSHOT_MAX_RETRIES; attempt++ ) {
+      if( attempt != 0 ) {
+        _data->snapshot_retries++;
+      }
+      // reading power clears CNVR, so a CNVR seen on the final bus voltage
+      // read means a conversion finished somewhere in between
+      if( INA219_SNAPSHOT_READ( dev, ina219_power,         snap->power )         != EMBEDD_RESULT_OK ||
+          INA219_SNAPSHOT_READ( dev, ina219_shunt_voltage, snap->shunt_voltage ) != EMBEDD_RESULT_OK ||
+          INA219_SNAPSHOT_READ( dev, ina219_current,       snap->current )       != EMBEDD_RESULT_OK ||
+          INA219_SNAPSHOT_READ( dev, ina219_bus_voltage,   snap->bus_voltage )   != EMBEDD_RESULT_OK ) {
+        return EMBEDD_RESULT_ERR;
+      }
+      if( snap->bus_voltage.cnvr == INA219_BUS_VOLTAGE_CNVR_CONVERSION_NOT_READY ) {
+        return EMBEDD_RESULT_OK;
+      }
+    }
+    // the reads take longer than a conversion
+    return ina219_snapshot_triggered( dev, snap );
+}
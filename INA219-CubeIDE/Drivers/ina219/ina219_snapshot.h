@@ -0,0 +1,91 @@
+/*!
+ * \file ina219_snapshot.h
+ * \brief Power monitor coherent register snapshot
+ *
+ * Reads all registers of the device in one call and guarantees that the
+ * measurement registers belong to the same ADC conversion.
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#ifndef _SRC_INA219_SNAPSHOT_H
+#define _SRC_INA219_SNAPSHOT_H
+
+#include "embedd_device.h"
+#include "ina219_data_types.h"
+
+/*!
+ * \def INA219_SNAPSHOT_MAX_RETRIES
+ * \brief Number of times the measurement registers are re-read when a new
+ * conversion completed while they were being read
+ */
+#ifndef INA219_SNAPSHOT_MAX_RETRIES
+#define INA219_SNAPSHOT_MAX_RETRIES 3
+#endif
+
+/*!
+ * \def INA219_SNAPSHOT_WAIT_US
+ * \brief Longest wait for the triggered conversion of the fallback, above the
+ * 136.2 ms of shunt and bus at 128 samples
+ */
+#ifndef INA219_SNAPSHOT_WAIT_US
+#define INA219_SNAPSHOT_WAIT_US 150000U
+#endif
+
+/*!
+ * \def INA219_SNAPSHOT_POLL_US
+ * \brief Time between two reads of CNVR while the fallback waits for its conversion
+ */
+#ifndef INA219_SNAPSHOT_POLL_US
+#define INA219_SNAPSHOT_POLL_US 50U
+#endif
+
+/*!
+ * ina219_read_snapshot
+ * 
+ * \brief Reads configuration, shunt voltage, bus voltage, power, current and
+ * calibration registers into \p snap.
+ * 
+ * Power is read first, which clears the CNVR flag, and bus voltage last. If CNVR
+ * is set again by then a conversion completed in the middle of the sequence and
+ * the measurement registers are read again, at most \ref INA219_SNAPSHOT_MAX_RETRIES
+ * times. Configuration and calibration do not change with conversions; they are
+ * taken from the register shadow and only read from the device when it is invalid.
+ * 
+ * A retry only succeeds when the four reads take less than a conversion cycle.
+ * With write_read each read takes 48 bit times, so the minimum cycle is 1.92 ms
+ * at 100 kHz, 480 us at 400 kHz and 192 us at 1 MHz; without write_read the
+ * reads take twice as long. A conversion completes during the reads about as
+ * often as their time goes into the cycle: shunt and bus at 12 bit (1.06 ms)
+ * are re-read in a third of the snapshots at 400 kHz. Below the minimum, e.g.
+ * 12 bit at 100 kHz or 9 and 10 bit at 400 kHz, every attempt fails and the
+ * snapshot falls back to a triggered conversion. A continuous mode is switched
+ * to its triggered counterpart and CNVR is waited for, up to
+ * \ref INA219_SNAPSHOT_WAIT_US. The registers are then read while they hold
+ * still, and the configuration is written back, which restarts the continuous
+ * conversions. Lower \ref INA219_SNAPSHOT_MAX_RETRIES to reach the fallback
+ * sooner with such settings.
+ * 
+ * \param dev pointer to embedd_device_t the structure representing the device
+ * \param snap pointer to ina219_snapshot_t the snapshot to fill
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK if all registers were read and belong to
+ * one conversion, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT ina219_read_snapshot(embedd_device_t* dev, ina219_snapshot_t* snap);
+
+#endif//_SRC_INA219_SNAPSHOT_H
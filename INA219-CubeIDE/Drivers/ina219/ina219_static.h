@@ -0,0 +1,202 @@
+/*!
+ * \file ina219_static.h
+ * \brief Power monitor static dispatch
+ *
+ * Inline register access used by the \ref INA219_STATIC_DISPATCH build mode,
+ * where the API macros call the driver directly instead of through
+ * \ref ina219_api and the device invariants are checked once at init.
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#ifndef _SRC_INA219_STATIC_H
+#define _SRC_INA219_STATIC_H
+
+#include "embedd_device.h"
+#include "embedd_utils.h"
+#include "embedd_hal.h"
+#include "ina219_data_types.h"
+#include "ina219_registers.h"
+#include "ina219_shadow.h"
+
+/*!
+ * \def INA219_STATIC_DISPATCH
+ * \brief Non-zero to make INA219_READ_REG, INA219_WRITE_REG and
+ * INA219_READ_SNAPSHOT direct, unchecked calls. \ref ina219_check_device must
+ * then succeed once for each device before it is used.
+ */
+#ifndef INA219_STATIC_DISPATCH
+#define INA219_STATIC_DISPATCH 0
+#endif
+
+/*!
+ * \def INA219_STATIC_BUS_WRITE
+ * \brief Optional name of the bus write function, called directly instead of
+ * through embedd_bus_t. INA219_STATIC_BUS_READ and INA219_STATIC_BUS_WRITE_READ
+ * do the same for the bus read and write_read functions. The functions must
+ * have external linkage.
+ */
+#ifdef INA219_STATIC_BUS_WRITE
+EMBEDD_RESULT INA219_STATIC_BUS_WRITE(const struct embedd_device_t* dev, const uint8_t* data_ptr, uint32_t data_size);
+#define INA219_BUS_WRITE(dev, data_ptr, data_size) INA219_STATIC_BUS_WRITE( (dev), (data_ptr), (data_size) )
+#else
+#define INA219_BUS_WRITE(dev, data_ptr, data_size) (dev)->bus->write( (dev), (data_ptr), (data_size) )
+#endif
+
+#ifdef INA219_STATIC_BUS_READ
+EMBEDD_RESULT INA219_STATIC_BUS_READ(const struct embedd_device_t* dev, uint8_t* data_ptr, uint32_t data_size);
+#define INA219_BUS_READ(dev, data_ptr, data_size) INA219_STATIC_BUS_READ( (dev), (data_ptr), (data_size) )
+#else
+#define INA219_BUS_READ(dev, data_ptr, data_size) (dev)->bus->read( (dev), (data_ptr), (data_size) )
+#endif
+
+#if defined(INA219_STATIC_BUS_WRITE_READ)
+EMBEDD_RESULT INA219_STATIC_BUS_WRITE_READ(const struct embedd_device_t* dev, const uint8_t* wr_ptr, uint32_t wr_size, uint8_t* rd_ptr, uint32_t rd_size);
+#define INA219_BUS_HAS_WRITE_READ(dev) 1
+#define INA219_BUS_WRITE_READ(dev, wr_ptr, wr_size, rd_ptr, rd_size) \
+  INA219_STATIC_BUS_WRITE_READ( (dev), (wr_ptr), (wr_size), (rd_ptr), (rd_size) )
+#elif defined(INA219_STATIC_BUS_READ)
+// a statically bound bus never looks at dev->bus
+#define INA219_BUS_HAS_WRITE_READ(dev) 0
+#define INA219_BUS_WRITE_READ(dev, wr_ptr, wr_size, rd_ptr, rd_size) EMBEDD_RESULT_ERR
+#else
+#define INA219_BUS_HAS_WRITE_READ(dev) ( (dev)->bus->write_read != NULL || (dev)->bus->transfer != NULL )
+#define INA219_BUS_WRITE_READ(dev, wr_ptr, wr_size, rd_ptr, rd_size) \
+  embedd_bus_write_read( (dev), (wr_ptr), (wr_size), (rd_ptr), (rd_size) )
+#endif
+
+/*!
+ * \def INA219_STATIC_CHECK_SIZE
+ * \brief Fails the build when a register does not fit the device buffers
+ */
+#define INA219_STATIC_CHECK_SIZE(_typename) \
+  (void)sizeof(char[ ( sizeof(_typename) + INA219_REGISTER_ADDR_SIZE <= INA219_WRITE_MESSAGE_MAX_SIZE && \
+                       sizeof(_typename) <= INA219_READ_MESSAGE_MAX_SIZE ) ? 1 : -1 ])
+
+/*!
+ * ina219_check_device
+ * 
+ * \brief Checks once everything the register access needs: the device data and
+ * the bus functions which are not statically bound.
+ * 
+ * \param dev pointer to embedd_device_t the structure representing the device
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK if the device can be used, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT ina219_check_device(const embedd_device_t* dev);
+
+static inline void ina219_unpack_reg(void* reg, uint8_t* in_ptr, uint32_t reg_size) {
+    if( in_ptr == (uint8_t*)reg ) {
+      embedd_swap_in_place( reg, reg_size );
+    } else {
+      embedd_pack( reg, in_ptr, reg_size );
+    }
+}
+
+/*!
+ * ina219_write_reg_direct
+ * 
+ * \brief \ref ina219_write_reg without argument checks, for a device which passed
+ * \ref ina219_check_device. Only the register address is checked against the
+ * register map.
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, EMBEDD_RESULT_ERR on a bus
+ * error or a register which cannot be written
+ */
+static inline EMBEDD_RESULT ina219_write_reg_direct(embedd_device_t* dev, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay) {
+    // the device ignores writes of read-only registers, the pointer would still move
+    if( !ina219_regmap_writable( reg_addr ) ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    ina219_data_t* _data = (ina219_data_t*)dev->data;
+    uint32_t msg_size = INA219_REGISTER_ADDR_SIZE + reg_size ;
+    uint8_t* _out_ptr = _data->out_buf;
+    embedd_pack_fast( _out_ptr, &reg_addr, INA219_REGISTER_ADDR_SIZE );
+    embedd_pack_fast( _out_ptr + INA219_REGISTER_ADDR_SIZE, reg, reg_size );
+    embedd_hal_deadline_wait( &_data->ready );
+    EMBEDD_RESULT result = INA219_BUS_WRITE( dev, _out_ptr, msg_size );
+    ina219_shadow_written( _data, reg_addr, reg, result );
+    if(result != EMBEDD_RESULT_OK) {
+      _data->reg_ptr_valid = 0;
+      return result;
+    }
+    // a write leaves the pointer on the written register unless it resets the device
+    _data->reg_ptr = (uint8_t)reg_addr;
+    _data->reg_ptr_valid = 1;
+    if( reg_addr == ina219_configuration_write_reg_addr && ((ina219_configuration_t*)reg)->rst ) {
+      _data->reg_ptr_valid = 0;
+    }
+    // the caller is free to do other work until the device is ready again
+    embedd_hal_deadline_arm( &_data->ready, delay * 1000U );
+    return result;
+}
+
+/*!
+ * ina219_read_reg_direct
+ * 
+ * \brief \ref ina219_read_reg without argument checks, for a device which passed
+ * \ref ina219_check_device.
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+static inline EMBEDD_RESULT ina219_read_reg_direct(embedd_device_t* dev, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay) {
+    EMBEDD_RESULT result;
+    ina219_data_t* _data = (ina219_data_t*)dev->data;
+    uint32_t msg_size = INA219_REGISTER_ADDR_SIZE;
+    uint8_t* _out_ptr = _data->out_buf;
+    // registers of 1, 2 or 4 bytes are read straight into the caller's variable and swapped in place
+    uint8_t* _in_ptr  = EMBEDD_PACK_FAST( reg_size ) ? (uint8_t*)reg : _data->in_buf;
+    embedd_hal_deadline_wait( &_data->ready );
+    if( _data->reg_ptr_valid && _data->reg_ptr == reg_addr ) {
+      // the device still points at this register, a plain read is enough
+      _data->reg_ptr_hits++;
+    } else if( delay == 0 && INA219_BUS_HAS_WRITE_READ( dev ) ) {
+      // address and data in one transaction with a repeated START in between
+      _data->reg_ptr_misses++;
+      embedd_pack_fast( _out_ptr, &reg_addr, INA219_REGISTER_ADDR_SIZE );
+      result = INA219_BUS_WRITE_READ( dev, _out_ptr, msg_size, _in_ptr, reg_size );
+      if( result != EMBEDD_RESULT_OK ) {
+        _data->reg_ptr_valid = 0;
+        return result;
+      }
+      _data->reg_ptr = (uint8_t)reg_addr;
+      _data->reg_ptr_valid = 1;
+      ina219_unpack_reg( reg, _in_ptr, reg_size );
+      return result;
+    } else {
+      _data->reg_ptr_misses++;
+      embedd_pack_fast( _out_ptr, &reg_addr, INA219_REGISTER_ADDR_SIZE );
+      result = INA219_BUS_WRITE( dev, _out_ptr, msg_size );
+      if( result != EMBEDD_RESULT_OK ) {
+        _data->reg_ptr_valid = 0;
+        return result;
+      }
+      _data->reg_ptr = (uint8_t)reg_addr;
+      _data->reg_ptr_valid = 1;
+      embedd_hal_deadline_arm( &_data->ready, delay * 1000U );
+      embedd_hal_deadline_wait( &_data->ready );
+    }
+    result = INA219_BUS_READ( dev, _in_ptr, reg_size );
+    if( result != EMBEDD_RESULT_OK ) {
+      _data->reg_ptr_valid = 0;
+      return result;
+    }
+    ina219_unpack_reg( reg, _in_ptr, reg_size );
+    return result;
+}
+
+#endif//_SRC_INA219_STATIC_H
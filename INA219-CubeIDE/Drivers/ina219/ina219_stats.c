@@ -0,0 +1,72 @@
+/*!
+ * \file ina219_stats.c
+ * \brief Power monitor windowed statistics
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+
+#include "ina219_stats.h"
+
+EMBEDD_RESULT ina219_stats_init(ina219_stats_t* stats, uint32_t length) {
+    if( stats == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    // windows are closed here, by sample count, not per quantity
+    embedd_stats_tumbling_init( &stats->current_ua, 0 );
+    embedd_stats_tumbling_init( &stats->bus_mv, 0 );
+    embedd_stats_tumbling_init( &stats->power_uw, 0 );
+    stats->length = length;
+    stats->samples = 0;
+    stats->start_us = 0;
+    stats->end_us = 0;
+    return EMBEDD_RESULT_OK;
+}
+
+bool ina219_stats_add(ina219_stats_t* stats, const ina219_measurement_t* meas, uint32_t timestamp_us, ina219_stats_record_t* record) {
+    if( stats == NULL || meas == NULL ) {
+      return false;
+    }
+    if( stats->samples == 0 ) {
+      stats->start_us = timestamp_us;
+    }
+    stats->end_us = timestamp_us;
+    stats->samples++;
+    embedd_stats_tumbling_add( &stats->bus_mv, (int32_t)meas->bus_mv, NULL );
+    if( !( meas->flags & INA219_MEAS_FLAG_OVF ) ) {
+      embedd_stats_tumbling_add( &stats->current_ua, meas->current_ua, NULL );
+      embedd_stats_tumbling_add( &stats->power_uw, (int32_t)meas->power_uw, NULL );
+    }
+    if( stats->length == 0 || stats->samples < stats->length ) {
+      return false;
+    }
+    return ina219_stats_close( stats, record );
+}
+
+bool ina219_stats_close(ina219_stats_t* stats, ina219_stats_record_t* record) {
+    if( stats == NULL || record == NULL || stats->samples == 0 ) {
+      return false;
+    }
+    *record = (ina219_stats_record_t){ 0 };
+    record->start_us = stats->start_us;
+    record->end_us = stats->end_us;
+    embedd_stats_tumbling_close( &stats->current_ua, &record->current_ua );
+    embedd_stats_tumbling_close( &stats->bus_mv, &record->bus_mv );
+    embedd_stats_tumbling_close( &stats->power_uw, &record->power_uw );
+    stats->samples = 0;
+    return true;
+}
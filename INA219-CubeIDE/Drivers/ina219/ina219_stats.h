@@ -0,0 +1,116 @@
+/*!
+ * \file ina219_stats.h
+ * \brief Power monitor windowed statistics
+ *
+ * Minimum, maximum, mean, variance and RMS of current, bus voltage and power
+ * over consecutive windows, one summary record per window. The update cost
+ * is constant per sample and no memory is allocated.
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#ifndef _SRC_INA219_STATS_H
+#define _SRC_INA219_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "embedd_device.h"
+#include "embedd_stats.h"
+#include "ina219_convert.h"
+
+/*!
+ * \struct ina219_stats_record_t
+ * \brief Summary of one window
+ *
+ * The current and power summaries leave out samples with the math overflow
+ * flag, so their count can be lower than that of the bus voltage.
+ *
+ * \var start_us    timestamp of the first sample
+ * \var end_us      timestamp of the last sample
+ * \var current_ua  current in microamperes
+ * \var bus_mv      bus voltage in millivolts
+ * \var power_uw    power in microwatts
+ */
+typedef struct {
+  uint32_t start_us;
+  uint32_t end_us;
+  embedd_stats_summary_t current_ua;
+  embedd_stats_summary_t bus_mv;
+  embedd_stats_summary_t power_uw;
+} ina219_stats_record_t;
+
+/*!
+ * \struct ina219_stats_t
+ * \brief Statistics state
+ *
+ * \var current_ua, bus_mv, power_uw  windows of each quantity
+ * \var length     samples per window, 0 to close windows with \ref ina219_stats_close only
+ * \var samples    samples in the current window
+ * \var start_us   timestamp of the first sample of the current window
+ * \var end_us     timestamp of the last sample of the current window
+ */
+typedef struct {
+  embedd_stats_tumbling_t current_ua;
+  embedd_stats_tumbling_t bus_mv;
+  embedd_stats_tumbling_t power_uw;
+  uint32_t length;
+  uint32_t samples;
+  uint32_t start_us;
+  uint32_t end_us;
+} ina219_stats_t;
+
+/*!
+ * ina219_stats_init
+ * 
+ * \brief Initializes the statistics with an empty window.
+ * 
+ * \param stats pointer to ina219_stats_t the statistics
+ * \param length uint32_t samples per window, e.g. one second of samples, 0 to
+ * close windows with \ref ina219_stats_close only
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT ina219_stats_init(ina219_stats_t* stats, uint32_t length);
+
+/*!
+ * ina219_stats_add
+ * 
+ * \brief Adds a sample and closes the window when it holds length samples.
+ * 
+ * \param stats pointer to ina219_stats_t the statistics
+ * \param meas pointer to ina219_measurement_t the converted sample
+ * \param timestamp_us uint32_t time the sample was taken at
+ * \param record pointer to ina219_stats_record_t filled in when the window closes
+ * 
+ * \return bool true if a window was closed and \p record filled in
+ */
+bool ina219_stats_add(ina219_stats_t* stats, const ina219_measurement_t* meas, uint32_t timestamp_us, ina219_stats_record_t* record);
+
+/*!
+ * ina219_stats_close
+ * 
+ * \brief Closes the current window early, e.g. at the end of a time interval.
+ * 
+ * \param stats pointer to ina219_stats_t the statistics
+ * \param record pointer to ina219_stats_record_t receiving the summary
+ * 
+ * \return bool true if the window held samples and \p record was filled in
+ */
+bool ina219_stats_close(ina219_stats_t* stats, ina219_stats_record_t* record);
+
+#endif//_SRC_INA219_STATS_H
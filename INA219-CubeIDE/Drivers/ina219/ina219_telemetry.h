@@ -0,0 +1,79 @@
+/*!
+ * \file ina219_telemetry.h
+ * \brief Power monitor telemetry records
+ *
+ * Fixed-size sample records for the binary stream of embedd_telemetry.h,
+ * decoded on the host by tools/telemetry_decode.py.
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#ifndef _SRC_INA219_TELEMETRY_H
+#define _SRC_INA219_TELEMETRY_H
+
+#include <stdint.h>
+
+#include "ina219_convert.h"
+
+/*!
+ * \def INA219_TELEMETRY_SAMPLE
+ * \brief Frame type of frames of \ref ina219_telemetry_sample_t records
+ */
+#define INA219_TELEMETRY_SAMPLE 0x10U
+
+/*!
+ * \struct ina219_telemetry_sample_t
+ * \brief One converted sample, 16 bytes little endian without padding
+ *
+ * \var timestamp_us  time the sample was taken at
+ * \var current_ua    current in microamperes
+ * \var power_uw      power in microwatts
+ * \var bus_mv        bus voltage in millivolts
+ * \var range         range tag of the sample, see \ref INA219_RANGE_PG
+ * \var flags         INA219_MEAS_FLAG_* of the sample
+ */
+typedef struct {
+  uint32_t timestamp_us;
+  int32_t  current_ua;
+  uint32_t power_uw;
+  uint16_t bus_mv;
+  uint8_t  range;
+  uint8_t  flags;
+} ina219_telemetry_sample_t;
+
+_Static_assert( sizeof(ina219_telemetry_sample_t) == 16, "ina219_telemetry_sample_t must be 16 bytes" );
+
+/*!
+ * ina219_telemetry_sample
+ * 
+ * \brief Fills a sample record.
+ * 
+ * \param meas pointer to ina219_measurement_t the converted sample
+ * \param timestamp_us uint32_t time the sample was taken at
+ * \param range uint8_t range tag of the sample
+ * \param record pointer to ina219_telemetry_sample_t the record
+ */
+static inline void ina219_telemetry_sample(const ina219_measurement_t* meas, uint32_t timestamp_us, uint8_t range, ina219_telemetry_sample_t* record) {
+    record->timestamp_us = timestamp_us;
+    record->current_ua = meas->current_ua;
+    record->power_uw = meas->power_uw;
+    record->bus_mv = (uint16_t)meas->bus_mv;
+    record->range = range;
+    record->flags = meas->flags;
+}
+
+#endif//_SRC_INA219_TELEMETRY_H
@@ -0,0 +1,219 @@
+/*!
+ * \file ina219_trigger.c
+ * \brief Power monitor timer-triggered acquisition
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#include "embedd_hal.h"
+
+#include "ina219_registers.h"
+#include "ina219_shadow.h"
+#include "ina219_poll.h"
+#include "ina219_trigger.h"
+
+enum {
+  INA219_TRIGGER_IDLE = 0,
+  INA219_TRIGGER_WRITING,
+  INA219_TRIGGER_CONVERTING,
+  INA219_TRIGGER_READING,
+};
+
+// smallest delay before a late conversion is polled again
+#define INA219_TRIGGER_RETRY_MIN_US 50U
+
+static void ina219_trigger_abort(ina219_trigger_t* trig) {
+    trig->stats.errors++;
+    trig->state = INA219_TRIGGER_IDLE;
+}
+
+static bool ina219_trigger_mode(uint16_t configuration) {
+    return INA219_FIELD_GET( configuration, CONFIGURATION, MODE ) < INA219_CONFIGURATION_MODE_ADC_OFF_DISABLED &&
+           INA219_FIELD_GET( configuration, CONFIGURATION, MODE ) != INA219_CONFIGURATION_MODE_POWERDOWN;
+}
+
+EMBEDD_RESULT ina219_trigger_init(ina219_trigger_t* trig, ina219_async_t* async, ina219_trigger_arm_t arm, void* arm_ctx, ina219_trigger_cb_t cb, void* user) {
+    if( trig == NULL || async == NULL || async->dev == NULL || arm == NULL || cb == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    ina219_configuration_t cfg;
+    if( ina219_shadow_get_configuration( async->dev, &cfg ) != EMBEDD_RESULT_OK ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    if( !ina219_trigger_mode( ina219_reg_word( &cfg ) ) ) {
+      if( ina219_shadow_set_mode( async->dev, INA219_CONFIGURATION_MODE_SHUNT_AND_BUS_TRIGGERED ) != EMBEDD_RESULT_OK ||
+          ina219_shadow_commit( async->dev ) != EMBEDD_RESULT_OK ) {
+        ina219_shadow_discard( async->dev );
+        return EMBEDD_RESULT_ERR;
+      }
+    }
+    trig->async = async;
+    trig->arm = arm;
+    trig->arm_ctx = arm_ctx;
+    trig->cb = cb;
+    trig->user = user;
+    trig->held = 0;
+    trig->stats = (ina219_trigger_stats_t){ 0 };
+    trig->state = INA219_TRIGGER_IDLE;
+    return EMBEDD_RESULT_OK;
+}
+
+static void ina219_trigger_read_done(embedd_device_t* dev, void* reg, EMBEDD_RESULT result, void* user) {
+    ina219_trigger_t* trig = (ina219_trigger_t*)user;
+    if( result != EMBEDD_RESULT_OK ) {
+      trig->failed = 1;
+    }
+    if( --trig->pending != 0 ) {
+      return;
+    }
+    if( trig->failed ) {
+      ina219_trigger_abort( trig );
+      return;
+    }
+    ina219_sample_t* sample = &trig->sample;
+    sample->shunt_voltage = ina219_reg_word( &trig->shunt_voltage );
+    sample->bus_voltage = ina219_reg_word( &trig->bus_voltage );
+    sample->current = ina219_reg_word( &trig->current );
+    sample->power = ina219_reg_word( &trig->power );
+    trig->stats.completed++;
+    trig->cb( sample, trig->user );
+    trig->state = INA219_TRIGGER_IDLE;
+}
+
+static void ina219_trigger_bus_done(embedd_device_t* dev, void* reg, EMBEDD_RESULT result, void* user) {
+    ina219_trigger_t* trig = (ina219_trigger_t*)user;
+    if( result != EMBEDD_RESULT_OK ) {
+      ina219_trigger_abort( trig );
+      return;
+    }
+    if( !INA219_FIELD_GET( ina219_reg_word( &trig->bus_voltage ), BUS_VOLTAGE, CNVR ) ) {
+      // slower than typical, poll again shortly
+      trig->stats.late++;
+      if( ++trig->retries > INA219_TRIGGER_MAX_RETRIES ) {
+        ina219_trigger_abort( trig );
+        return;
+      }
+      // a timer that fires at once must find the trigger converting
+      trig->state = INA219_TRIGGER_CONVERTING;
+      if( trig->arm( trig->arm_ctx, trig->retry_us ) != EMBEDD_RESULT_OK ) {
+        ina219_trigger_abort( trig );
+      }
+      return;
+    }
+    // power last, reading it clears CNVR
+    trig->pending = 3;
+    trig->failed = 0;
+    if( INA219_ASYNC_READ_REG( *trig->async, ina219_shunt_voltage, trig->shunt_voltage, ina219_trigger_read_done, trig ) != EMBEDD_RESULT_OK ) {
+      ina219_trigger_abort( trig );
+      return;
+    }
+    if( INA219_ASYNC_READ_REG( *trig->async, ina219_current, trig->current, ina219_trigger_read_done, trig ) != EMBEDD_RESULT_OK ) {
+      trig->failed = 1;
+      trig->pending--;
+    }
+    if( INA219_ASYNC_READ_REG( *trig->async, ina219_power, trig->power, ina219_trigger_read_done, trig ) != EMBEDD_RESULT_OK ) {
+      trig->failed = 1;
+      trig->pending--;
+    }
+}
+
+static void ina219_trigger_written(embedd_device_t* dev, void* reg, EMBEDD_RESULT result, void* user) {
+    ina219_trigger_t* trig = (ina219_trigger_t*)user;
+    if( result != EMBEDD_RESULT_OK ) {
+      ina219_trigger_abort( trig );
+      return;
+    }
+    // the conversion starts with the write
+    trig->sample.timestamp_us = embedd_hal_get_us();
+    trig->state = INA219_TRIGGER_CONVERTING;
+    if( trig->arm( trig->arm_ctx, trig->conversion_us ) != EMBEDD_RESULT_OK ) {
+      ina219_trigger_abort( trig );
+    }
+}
+
+void ina219_trigger_tick(ina219_trigger_t* trig) {
+    if( trig == NULL || trig->async == NULL ) {
+      return;
+    }
+    uint32_t state = embedd_hal_critical_enter();
+    if( trig->state != INA219_TRIGGER_IDLE || trig->held ) {
+      embedd_hal_critical_exit( state );
+      trig->stats.overruns++;
+      return;
+    }
+    trig->state = INA219_TRIGGER_WRITING;
+    embedd_hal_critical_exit( state );
+
+    // the shadow only changes while acquisition is held
+    ina219_configuration_t cfg;
+    if( ina219_shadow_get_configuration( trig->async->dev, &cfg ) != EMBEDD_RESULT_OK ) {
+      ina219_trigger_abort( trig );
+      return;
+    }
+    uint16_t word = ina219_reg_word( &cfg );
+    trig->trigger = cfg;
+    trig->conversion_us = ina219_conversion_time_us( word );
+    trig->retry_us = trig->conversion_us / 16U > INA219_TRIGGER_RETRY_MIN_US ? trig->conversion_us / 16U : INA219_TRIGGER_RETRY_MIN_US;
+    trig->retries = 0;
+    trig->sample.range = INA219_RANGE( INA219_FIELD_GET( word, CONFIGURATION, PG ), INA219_FIELD_GET( word, CONFIGURATION, BRNG ) );
+    trig->sample.flags = 0;
+    trig->stats.triggered++;
+    if( INA219_ASYNC_WRITE_REG( *trig->async, ina219_configuration, trig->trigger, ina219_trigger_written, trig ) != EMBEDD_RESULT_OK ) {
+      ina219_trigger_abort( trig );
+    }
+}
+
+void ina219_trigger_timeout(ina219_trigger_t* trig) {
+    if( trig == NULL || trig->state != INA219_TRIGGER_CONVERTING ) {
+      return;
+    }
+    trig->state = INA219_TRIGGER_READING;
+    if( INA219_ASYNC_READ_REG( *trig->async, ina219_bus_voltage, trig->bus_voltage, ina219_trigger_bus_done, trig ) != EMBEDD_RESULT_OK ) {
+      ina219_trigger_abort( trig );
+    }
+}
+
+bool ina219_trigger_hold(ina219_trigger_t* trig) {
+    if( trig == NULL ) {
+      return false;
+    }
+    uint32_t state = embedd_hal_critical_enter();
+    bool idle = ( trig->state == INA219_TRIGGER_IDLE );
+    if( idle ) {
+      trig->held = 1;
+    }
+    embedd_hal_critical_exit( state );
+    return idle;
+}
+
+void ina219_trigger_release(ina219_trigger_t* trig) {
+    if( trig != NULL ) {
+      trig->held = 0;
+    }
+}
+
+void ina219_trigger_get_stats(ina219_trigger_t* trig, ina219_trigger_stats_t* stats, bool reset) {
+    if( trig == NULL || stats == NULL ) {
+      return;
+    }
+    uint32_t state = embedd_hal_critical_enter();
+    *stats = trig->stats;
+    if( reset ) {
+      trig->stats = (ina219_trigger_stats_t){ 0 };
+    }
+    embedd_hal_critical_exit( state );
+}
@@ -0,0 +1,206 @@
+/*!
+ * \file ina219_trigger.h
+ * \brief Power monitor timer-triggered acquisition
+ *
+ * Each tick of a hardware timer starts one conversion in a triggered mode by
+ * writing the configuration register. A one-shot timer then waits one
+ * conversion time and the results are read, so every sample is taken at a
+ * known instant rather than at the phase of free-running conversions. All
+ * bus accesses go through the asynchronous register engine and run in
+ * interrupt context.
+ *
+ * Software License Agreement:
+ * 
+ * This code is proprietary to Embedd Limited and may not be distributed
+ * or copied without the express permission of Embedd Limited. This code
+ * is provided "as is" without warranty of any kind, either expressed or
+ * implied, including but not limited to the implied warranties of
+ * merchantability and fitness for a particular purpose. This code is intended
+ * for use only by the employees and authorized agents of Embedd Limited
+ * and its affiliates, and may not be disclosed or used for any other purpose
+ * without prior written consent from Embedd Limited.
+ * 
+ * Unauthorized distribution or use of this code, or any portion of it, may
+ * result in severe civil and criminal penalties, and will be prosecuted to
+ * the maximum extent possible under the law.
+ * 
+ * © 2024 Embedd Limited. All Rights Reserved.
+ */
+#ifndef _SRC_INA219_TRIGGER_H
+#define _SRC_INA219_TRIGGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "embedd_device.h"
+#include "ina219_data_types.h"
+#include "ina219_async.h"
+#include "ina219_sample.h"
+
+/*!
+ * \def INA219_TRIGGER_MAX_RETRIES
+ * \brief Number of times the results are polled again when the conversion is
+ * not ready after its typical conversion time
+ */
+#ifndef INA219_TRIGGER_MAX_RETRIES
+#define INA219_TRIGGER_MAX_RETRIES 8
+#endif
+
+/*!
+ * \typedef ina219_trigger_arm_t
+ * \brief Starts the one-shot timer, which calls \ref ina219_trigger_timeout when it expires
+ *
+ * The timer must not expire early and must reach the longest conversion time,
+ * 136.2 ms for shunt and bus at 128 samples each.
+ *
+ * \param ctx context pointer given to \ref ina219_trigger_init
+ * \param delay_us delay in microseconds
+ *
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+typedef EMBEDD_RESULT (*ina219_trigger_arm_t)(void* ctx, uint32_t delay_us);
+
+/*!
+ * \typedef ina219_trigger_cb_t
+ * \brief Called from interrupt context with every completed sample
+ *
+ * \param sample pointer to the sample, valid until the callback returns
+ * \param user user pointer given to \ref ina219_trigger_init
+ */
+typedef void (*ina219_trigger_cb_t)(const ina219_sample_t* sample, void* user);
+
+/*!
+ * \struct ina219_trigger_stats_t
+ * \brief Acquisition statistics
+ *
+ * \var triggered  number of conversions triggered
+ * \var completed  number of samples delivered
+ * \var late       number of times the conversion was not ready after its conversion time
+ * \var overruns   number of ticks skipped because the previous sample was not complete or acquisition was held
+ * \var errors     number of acquisitions aborted by a bus error or a conversion that never became ready
+ */
+typedef struct {
+  uint32_t triggered;
+  uint32_t completed;
+  uint32_t late;
+  uint32_t overruns;
+  uint32_t errors;
+} ina219_trigger_stats_t;
+
+/*!
+ * \struct ina219_trigger_t
+ * \brief Triggered acquisition state of one device
+ *
+ * \var async          asynchronous register engine of the device, at least 3 entries deep
+ * \var arm            one-shot timer of the platform
+ * \var arm_ctx        context pointer of arm
+ * \var cb             sample callback
+ * \var user           user pointer of cb
+ * \var state          acquisition step in progress
+ * \var held           non-zero while \ref ina219_trigger_hold keeps ticks from starting conversions
+ * \var retries        number of times the conversion was polled again
+ * \var pending        number of result registers still being read
+ * \var failed         non-zero when reading a result register failed
+ * \var conversion_us  typical conversion time of the configuration written
+ * \var retry_us       delay before polling a late conversion again
+ * \var trigger        configuration register written to start a conversion
+ * \var bus_voltage, shunt_voltage, current, power  result registers
+ * \var sample         the sample being acquired
+ * \var stats          statistics
+ */
+typedef struct {
+  ina219_async_t*       async;
+  ina219_trigger_arm_t  arm;
+  void*                 arm_ctx;
+  ina219_trigger_cb_t   cb;
+  void*                 user;
+  volatile uint8_t      state;
+  volatile uint8_t      held;
+  uint8_t               retries;
+  volatile uint8_t      pending;
+  volatile uint8_t      failed;
+  uint32_t              conversion_us;
+  uint32_t              retry_us;
+  ina219_configuration_t trigger;
+  ina219_bus_voltage_t   bus_voltage;
+  ina219_shunt_voltage_t shunt_voltage;
+  ina219_current_t       current;
+  ina219_power_t         power;
+  ina219_sample_t       sample;
+  ina219_trigger_stats_t stats;
+} ina219_trigger_t;
+
+/*!
+ * ina219_trigger_init
+ * 
+ * \brief Initializes triggered acquisition. The device is switched to the
+ * shunt and bus triggered mode unless its configuration already selects a
+ * triggered mode. Call it before the timer ticks.
+ * 
+ * \param trig pointer to ina219_trigger_t the state to initialize
+ * \param async pointer to ina219_async_t the engine of the device, its
+ * configuration shadow must be valid
+ * \param arm ina219_trigger_arm_t one-shot timer of the platform
+ * \param arm_ctx pointer to void context pointer of \p arm
+ * \param cb ina219_trigger_cb_t sample callback
+ * \param user pointer to void user pointer of \p cb
+ * 
+ * \return EMBEDD_RESULT EMBEDD_RESULT_OK on success, othewise EMBEDD_RESULT_ERR
+ */
+EMBEDD_RESULT ina219_trigger_init(ina219_trigger_t* trig, ina219_async_t* async, ina219_trigger_arm_t arm, void* arm_ctx, ina219_trigger_cb_t cb, void* user);
+
+/*!
+ * ina219_trigger_tick
+ * 
+ * \brief Starts a conversion with the configuration of the shadow registers.
+ * Called from the interrupt of the timer pacing the samples; the sample is
+ * timestamped when the trigger write completes.
+ * 
+ * \param trig pointer to ina219_trigger_t the acquisition state
+ */
+void ina219_trigger_tick(ina219_trigger_t* trig);
+
+/*!
+ * ina219_trigger_timeout
+ * 
+ * \brief Reads the results of the conversion. Called from the interrupt of
+ * the one-shot timer started through the arm function.
+ * 
+ * \param trig pointer to ina219_trigger_t the acquisition state
+ */
+void ina219_trigger_timeout(ina219_trigger_t* trig);
+
+/*!
+ * ina219_trigger_hold
+ * 
+ * \brief Keeps ticks from starting conversions, so that the device can be
+ * accessed with the blocking functions, e.g. for a range switch or a
+ * calibration change. Fails while a sample is being acquired.
+ * 
+ * \param trig pointer to ina219_trigger_t the acquisition state
+ * 
+ * \return bool true if acquisition is held, false if it is busy
+ */
+bool ina219_trigger_hold(ina219_trigger_t* trig);
+
+/*!
+ * ina219_trigger_release
+ * 
+ * \brief Lets the next tick start a conversion again.
+ * 
+ * \param trig pointer to ina219_trigger_t the acquisition state
+ */
+void ina219_trigger_release(ina219_trigger_t* trig);
+
+/*!
+ * ina219_trigger_get_stats
+ * 
+ * \brief Returns the acquisition statistics.
+ * 
+ * \param trig pointer to ina219_trigger_t the acquisition state
+ * \param stats pointer to ina219_trigger_stats_t receiving the statistics
+ * \param reset bool true to clear the statistics
+ */
+void ina219_trigger_get_stats(ina219_trigger_t* trig, ina219_trigger_stats_t* stats, bool reset);
+
+#endif//_SRC_INA219_TRIGGER_H
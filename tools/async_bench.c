@@ -0,0 +1,280 @@
+/*!
+ * \file async_bench.c
+ * \brief Host test and benchmark of the ina219_async engine on the simulated bus
+ *
+ * The simulated bus completes asynchronous transfers when the simulated
+ * clock passes their end, calling the done callback as the DMA interrupt
+ * would. The program first checks the engine against it: queued reads
+ * return what the device holds, a queued write reaches the device and the
+ * register shadow, a full queue rejects a transfer, an injected NACK ends in
+ * an error callback the engine recovers from, and a read with a delay waits
+ * for ina219_async_process. It exits with 1 if a check fails.
+ *
+ * It then reads the six registers every 2 ms for a simulated second, once
+ * blocking with INA219_READ_REG and once queued, and fills the rest of the
+ * time with 10 us units of other work, printing the share of the time left
+ * for that work, the transactions per set and the bus load, with and without
+ * the combined write_read_async of the bus. A set still in progress when the
+ * next one is due counts as late and the next one is skipped. The time the
+ * transfer interrupts take on the target is not modelled, so the queued
+ * runs show the upper bound of the time left.
+ *
+ * Build and run from the repository root:
+ *
+ *   D=INA219-CubeIDE/Drivers/ina219
+ *   gcc -O2 -I$D -Itools tools/async_bench.c tools/ina219_sim.c \
+ *       $D/ina219.c $D/ina219_registers.c $D/ina219_shadow.c $D/ina219_snapshot.c \
+ *       $D/ina219_async.c $D/embedd_i2c.c $D/embedd_hal.c $D/embedd_utils.c -lm -o async_bench
+ *   ./async_bench [-b bus kHz]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ina219.h"
+#include "ina219_async.h"
+#include "ina219_sim.h"
+
+#define BENCH_ADDR      0x40
+#define BENCH_PERIOD_US 2000U
+#define BENCH_WORK_US   10U
+
+INA219_I2C_DEVICE_DEFINE(bench_sensor, "INA219 sim")
+INA219_ASYNC_DEFINE(bench_async, bench_sensor, 8)
+
+static uint32_t bench_bus_hz = 400000U;
+static ina219_sim_t bench_sim;
+static embedd_bus_t bench_bus_split;
+static int bench_failed;
+
+static struct {
+  uint32_t calls;
+  uint32_t errors;
+} bench_cb_stats;
+
+static void bench_cb(embedd_device_t* dev, void* reg, EMBEDD_RESULT result, void* user) {
+    (void)dev;
+    (void)reg;
+    (void)user;
+    bench_cb_stats.calls++;
+    if( result != EMBEDD_RESULT_OK ) {
+      bench_cb_stats.errors++;
+    }
+}
+
+static void bench_check(bool ok, const char* what) {
+    printf("%-52s %s\n", what, ok ? "ok" : "FAILED");
+    if( !ok ) {
+      bench_failed = 1;
+    }
+}
+
+static int bench_setup(const embedd_bus_t* bus) {
+    ina219_sim_reset();
+    ina219_sim_set_bus_hz( bench_bus_hz );
+    ina219_sim_init( &bench_sim, BENCH_ADDR, 100000U, 1 );
+    bench_sim.current = (ina219_sim_wave_t){ .shape = INA219_SIM_DC, .offset = 400000, .noise = 5000 };
+    bench_sim.bus = (ina219_sim_wave_t){ .shape = INA219_SIM_DC, .offset = 12000 };
+    if( ina219_sim_attach( &bench_sim ) != EMBEDD_RESULT_OK ) {
+      return -1;
+    }
+    embedd_i2c_dev_cfg_t i2c_cfg = { .addr = BENCH_ADDR };
+    embedd_i2c_set_dev_config( &bench_sensor, &i2c_cfg );
+    bench_sensor.bus = (embedd_bus_t*)bus;
+    ina219_reg_ptr_invalidate( &bench_sensor );
+    bench_async.head = 0;
+    bench_async.count = 0;
+    bench_async.state = 0;
+    bench_async.wait.armed = 0;
+    bench_async.completed = 0;
+    bench_async.errors = 0;
+    bench_cb_stats.calls = 0;
+    bench_cb_stats.errors = 0;
+    if( ina219_check_device( &bench_sensor ) != EMBEDD_RESULT_OK ||
+        ina219_shadow_resync( &bench_sensor ) != EMBEDD_RESULT_OK ) {
+      return -1;
+    }
+    return 0;
+}
+
+// runs the simulated clock until the queue is empty, at most for limit_us
+static void bench_drain(uint32_t limit_us) {
+    for( uint32_t t = 0; t < limit_us && ina219_async_busy( &bench_async ); t += BENCH_WORK_US ) {
+      embedd_hal_sleep_us( BENCH_WORK_US );
+      ina219_async_process( &bench_async );
+    }
+}
+
+static void bench_tests(void) {
+    if( bench_setup( &ina219_sim_bus ) != 0 ) {
+      bench_check( false, "device set up" );
+      return;
+    }
+
+    // power-down after the first conversions keeps the results still while they are compared
+    embedd_hal_sleep_us( 5000U );
+    ina219_shadow_set_mode( &bench_sensor, INA219_CONFIGURATION_MODE_POWERDOWN );
+    bench_check( ina219_shadow_commit( &bench_sensor ) == EMBEDD_RESULT_OK, "power-down written blocking" );
+
+    static const uint8_t addrs[] = {
+      ina219_configuration_read_reg_addr, ina219_shunt_voltage_read_reg_addr, ina219_bus_voltage_read_reg_addr,
+      ina219_power_read_reg_addr, ina219_current_read_reg_addr, ina219_calibration_read_reg_addr,
+    };
+    uint16_t regs[6];
+    bool queued = true;
+    for( size_t i = 0; i < 6; i++ ) {
+      queued = queued && ina219_async_read_reg( &bench_async, addrs[i], &regs[i], sizeof(regs[i]), 0, bench_cb, NULL ) == EMBEDD_RESULT_OK;
+    }
+    bench_check( queued && ina219_async_busy( &bench_async ), "six reads queued, engine busy" );
+    bench_drain( 10000U );
+    bool same = true;
+    for( size_t i = 0; i < 6; i++ ) {
+      same = same && regs[i] == ina219_sim_peek( &bench_sim, addrs[i] );
+    }
+    bench_check( !ina219_async_busy( &bench_async ) && bench_cb_stats.calls == 6 && bench_cb_stats.errors == 0,
+                 "six callbacks without error" );
+    bench_check( same, "queued reads match the device registers" );
+
+    ina219_calibration_t cal;
+    ina219_reg_set_word( &cal, 0x2000 );
+    bench_check( INA219_ASYNC_WRITE_REG( bench_async, ina219_calibration, cal, bench_cb, NULL ) == EMBEDD_RESULT_OK,
+                 "calibration write queued" );
+    bench_drain( 10000U );
+    ina219_calibration_t shadow;
+    bench_check( ina219_sim_peek( &bench_sim, ina219_calibration_read_reg_addr ) == 0x2000 &&
+                 ina219_shadow_get_calibration( &bench_sensor, &shadow ) == EMBEDD_RESULT_OK &&
+                 ina219_reg_word( &shadow ) == 0x2000, "queued write reaches the device and the shadow" );
+
+    ina219_power_t power;
+    bench_check( ina219_async_write_reg( &bench_async, ina219_power_read_reg_addr, &power, sizeof(power), 0, bench_cb, NULL ) != EMBEDD_RESULT_OK,
+                 "write of a read-only register rejected" );
+
+    uint32_t accepted = 0;
+    for( size_t i = 0; i < bench_async.depth + 1U; i++ ) {
+      if( ina219_async_read_reg( &bench_async, addrs[i % 6], &regs[i % 6], sizeof(regs[0]), 0, NULL, NULL ) == EMBEDD_RESULT_OK ) {
+        accepted++;
+      }
+    }
+    bench_check( accepted == bench_async.depth, "full queue rejects a transfer" );
+    bench_drain( 10000U );
+
+    uint32_t errors = bench_cb_stats.errors;
+    ina219_sim_inject( &bench_sim, INA219_SIM_FAULT_NACK, 1 );
+    INA219_ASYNC_READ_REG( bench_async, ina219_bus_voltage, regs[0], bench_cb, NULL );
+    INA219_ASYNC_READ_REG( bench_async, ina219_bus_voltage, regs[1], bench_cb, NULL );
+    bench_drain( 10000U );
+    bench_check( bench_cb_stats.errors == errors + 1U && regs[1] == ina219_sim_peek( &bench_sim, ina219_bus_voltage_read_reg_addr ),
+                 "NACK reported, next transfer recovers" );
+
+    // a read with a delay after the address write stops until ina219_async_process sees it elapse
+    uint32_t calls = bench_cb_stats.calls;
+    ina219_async_read_reg( &bench_async, ina219_shunt_voltage_read_reg_addr, &regs[0], sizeof(regs[0]), 1, bench_cb, NULL );
+    embedd_hal_sleep_us( 900U );
+    ina219_async_process( &bench_async );
+    bool early = bench_cb_stats.calls != calls;
+    bench_drain( 10000U );
+    bench_check( !early && bench_cb_stats.calls == calls + 1U, "delayed read completes from ina219_async_process" );
+}
+
+typedef struct {
+  uint32_t sets;
+  uint32_t late;
+  uint64_t work_us;
+  uint64_t elapsed_us;
+  uint32_t transfers;
+  uint64_t bus_us;
+} bench_result_t;
+
+static int bench_run(const embedd_bus_t* bus, bool queued, bench_result_t* res) {
+    memset( res, 0, sizeof *res );
+    if( bench_setup( bus ) != 0 ) {
+      return -1;
+    }
+    ina219_sim_stats_t stats;
+    ina219_sim_get_stats( &bench_sim, &stats, true );
+    uint64_t start = ina219_sim_now_us();
+    uint64_t end = start + 1000000U;
+    ina219_configuration_t configuration;
+    ina219_shunt_voltage_t shunt_voltage;
+    ina219_bus_voltage_t bus_voltage;
+    ina219_power_t power;
+    ina219_current_t current;
+    ina219_calibration_t calibration;
+    for( uint64_t period = start; period < end; period += BENCH_PERIOD_US ) {
+      if( queued && ina219_async_busy( &bench_async ) ) {
+        // the previous set did not finish within its period, this one is skipped
+        res->late++;
+      } else if( queued ) {
+        INA219_ASYNC_READ_REG( bench_async, ina219_configuration, configuration, NULL, NULL );
+        INA219_ASYNC_READ_REG( bench_async, ina219_shunt_voltage, shunt_voltage, NULL, NULL );
+        INA219_ASYNC_READ_REG( bench_async, ina219_bus_voltage, bus_voltage, NULL, NULL );
+        INA219_ASYNC_READ_REG( bench_async, ina219_power, power, NULL, NULL );
+        INA219_ASYNC_READ_REG( bench_async, ina219_current, current, NULL, NULL );
+        INA219_ASYNC_READ_REG( bench_async, ina219_calibration, calibration, NULL, NULL );
+        res->sets++;
+      } else if( INA219_READ_REG( bench_sensor, ina219_configuration, configuration ) != EMBEDD_RESULT_OK ||
+                 INA219_READ_REG( bench_sensor, ina219_shunt_voltage, shunt_voltage ) != EMBEDD_RESULT_OK ||
+                 INA219_READ_REG( bench_sensor, ina219_bus_voltage, bus_voltage ) != EMBEDD_RESULT_OK ||
+                 INA219_READ_REG( bench_sensor, ina219_power, power ) != EMBEDD_RESULT_OK ||
+                 INA219_READ_REG( bench_sensor, ina219_current, current ) != EMBEDD_RESULT_OK ||
+                 INA219_READ_REG( bench_sensor, ina219_calibration, calibration ) != EMBEDD_RESULT_OK ) {
+        return -1;
+      } else {
+        res->sets++;
+      }
+      // other work until the next period, the transfers complete in the background
+      while( ina219_sim_now_us() + BENCH_WORK_US <= period + BENCH_PERIOD_US ) {
+        embedd_hal_sleep_us( BENCH_WORK_US );
+        ina219_async_process( &bench_async );
+        res->work_us += BENCH_WORK_US;
+      }
+      if( ina219_sim_now_us() < period + BENCH_PERIOD_US ) {
+        embedd_hal_sleep_us( (uint32_t)( period + BENCH_PERIOD_US - ina219_sim_now_us() ) );
+      }
+    }
+    bench_drain( 10000U );
+    if( bench_async.errors != 0 ) {
+      return -1;
+    }
+    res->elapsed_us = ina219_sim_now_us() - start;
+    ina219_sim_get_stats( &bench_sim, &stats, false );
+    res->transfers = stats.transfers;
+    res->bus_us = stats.bus_us;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    for( int i = 1; i + 1 < argc; i += 2 ) {
+      if( strcmp( argv[i], "-b" ) == 0 ) {
+        bench_bus_hz = (uint32_t)strtoul( argv[i + 1], NULL, 0 ) * 1000U;
+      }
+    }
+    if( bench_bus_hz == 0 ) {
+      fprintf(stderr, "usage: %s [-b bus kHz]\n", argv[0]);
+      return 1;
+    }
+
+    bench_tests();
+
+    bench_bus_split = ina219_sim_bus;
+    bench_bus_split.write_read_async = NULL;
+    static const struct { const char* name; const embedd_bus_t* bus; bool queued; } runs[] = {
+      { "blocking", &ina219_sim_bus, false },
+      { "queued, write + read", &bench_bus_split, true },
+      { "queued, write_read_async", &ina219_sim_bus, true },
+    };
+    printf("\nSix registers every %u us at %lu kHz:\n", BENCH_PERIOD_US, (unsigned long)( bench_bus_hz / 1000U ));
+    printf("%-26s %6s %6s %8s %9s %8s\n", "read", "sets", "late", "txn/set", "bus busy", "free");
+    for( size_t i = 0; i < sizeof runs / sizeof runs[0]; i++ ) {
+      bench_result_t res;
+      if( bench_run( runs[i].bus, runs[i].queued, &res ) != 0 ) {
+        fprintf(stderr, "%s: register access failed\n", runs[i].name);
+        return 1;
+      }
+      printf("%-26s %6lu %6lu %8.2f %7.1f %% %6.1f %%\n", runs[i].name, (unsigned long)res.sets, (unsigned long)res.late,
+             res.sets ? (double)res.transfers / res.sets : 0.0, 100.0 * res.bus_us / res.elapsed_us,
+             100.0 * res.work_us / res.elapsed_us);
+    }
+    return bench_failed;
+}
@@ -0,0 +1,286 @@
+/*!
+ * \file bus_sched_test.c
+ * \brief Host test of embedd_bus_sched on the simulated bus
+ *
+ * Two simulated devices share the asynchronous bus of ina219_sim through one
+ * scheduler. The program checks that
+ *
+ *   order        queued transactions run by priority, then earliest
+ *                deadline, then submission order, and a transaction started
+ *                after its deadline counts as late
+ *   dispatch     each transaction starts when the previous one completes,
+ *                so the busy time equals the wire time of the transfers and
+ *                the utilization is 100 % until the queue empties and halves
+ *                over an equally long idle time
+ *   data         every transaction reads what the device holds
+ *   timeout      a blocking client transfer hanging on the bus is aborted
+ *                after EMBEDD_BUS_SCHED_TIMEOUT_US, one waiting behind a
+ *                hanging transfer leaves the queue, neither calls back later
+ *                and the client works again at once
+ *   abort        aborting an asynchronous client transfer in progress starts
+ *                the next queued transaction without calling back
+ *
+ * and exits with 1 if a check fails. The bus clock is given in kHz with -b.
+ *
+ * Build and run from the repository root:
+ *
+ *   D=INA219-CubeIDE/Drivers/ina219
+ *   gcc -O2 -I$D -Itools tools/bus_sched_test.c tools/ina219_sim.c \
+ *       $D/ina219.c $D/ina219_registers.c $D/ina219_shadow.c $D/ina219_snapshot.c \
+ *       $D/embedd_bus_sched.c $D/embedd_i2c.c $D/embedd_hal.c $D/embedd_utils.c -lm -o bus_sched_test
+ *   ./bus_sched_test [-b bus kHz]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ina219.h"
+#include "embedd_bus_sched.h"
+#include "ina219_sim.h"
+
+#define BENCH_ADDR_A 0x40
+#define BENCH_ADDR_B 0x41
+#define BENCH_TXNS   6U
+
+static uint32_t bench_bus_hz = 400000U;
+static ina219_sim_t bench_sim_a;
+static ina219_sim_t bench_sim_b;
+static embedd_bus_sched_t bench_sched;
+static embedd_bus_sched_client_t bench_client_a;
+static embedd_bus_sched_client_t bench_client_b;
+static int bench_failed;
+
+INA219_I2C_DEVICE_DEFINE_STATIC(bench_dev_a, "INA219 A", &bench_client_a.bus, BENCH_ADDR_A)
+INA219_I2C_DEVICE_DEFINE_STATIC(bench_dev_b, "INA219 B", &bench_client_b.bus, BENCH_ADDR_B)
+
+// transactions reading a register, each with its own buffers
+static embedd_bus_txn_t bench_txns[BENCH_TXNS];
+static uint8_t bench_reg[BENCH_TXNS];
+static uint8_t bench_data[BENCH_TXNS][2];
+
+// completion order and results of the transactions
+static uint32_t bench_order[BENCH_TXNS];
+static EMBEDD_RESULT bench_results[BENCH_TXNS];
+static uint32_t bench_done_num;
+
+static uint32_t bench_client_calls;
+
+static void bench_check(bool ok, const char* what) {
+    printf("%-66s %s\n", what, ok ? "ok" : "FAILED");
+    if( !ok ) {
+      bench_failed = 1;
+    }
+}
+
+static void bench_txn_done(embedd_bus_txn_t* txn, EMBEDD_RESULT result) {
+    uint32_t id = (uint32_t)( txn - bench_txns );
+    if( bench_done_num < BENCH_TXNS ) {
+      bench_order[bench_done_num++] = id;
+    }
+    bench_results[id] = result;
+}
+
+static void bench_client_done(void* ctx, EMBEDD_RESULT result) {
+    (void)ctx;
+    (void)result;
+    bench_client_calls++;
+}
+
+static void bench_txn_init(uint32_t id, const embedd_device_t* dev, uint8_t reg, uint8_t priority) {
+    bench_reg[id] = reg;
+    memset( bench_data[id], 0, sizeof bench_data[id] );
+    bench_txns[id] = (embedd_bus_txn_t){
+      .dev = dev,
+      .segs = {
+        { .data = &bench_reg[id], .size = 1, .dir = EMBEDD_BUS_SEG_WRITE },
+        { .data = bench_data[id], .size = 2, .dir = EMBEDD_BUS_SEG_READ },
+      },
+      .segs_num = 2,
+      .priority = priority,
+      .done = bench_txn_done,
+    };
+}
+
+static void bench_txn_deadline(uint32_t id, uint32_t deadline) {
+    bench_txns[id].has_deadline = 1;
+    bench_txns[id].deadline = deadline;
+}
+
+static bool bench_txn_data_ok(uint32_t id, ina219_sim_t* sim) {
+    uint16_t word = ina219_sim_peek( sim, bench_reg[id] );
+    return bench_data[id][0] == (uint8_t)( word >> 8 ) && bench_data[id][1] == (uint8_t)word;
+}
+
+// runs the simulated clock until the scheduler is idle, at most for limit_us
+static void bench_drain(uint32_t limit_us) {
+    for( uint32_t t = 0; t < limit_us && embedd_bus_sched_busy( &bench_sched ); t++ ) {
+      ina219_sim_advance( 1U );
+    }
+}
+
+static int bench_setup(void) {
+    ina219_sim_reset();
+    ina219_sim_set_bus_hz( bench_bus_hz );
+    ina219_sim_init( &bench_sim_a, BENCH_ADDR_A, 100000U, 1 );
+    ina219_sim_init( &bench_sim_b, BENCH_ADDR_B, 100000U, 2 );
+    if( ina219_sim_attach( &bench_sim_a ) != EMBEDD_RESULT_OK || ina219_sim_attach( &bench_sim_b ) != EMBEDD_RESULT_OK ) {
+      return -1;
+    }
+    if( embedd_bus_sched_init( &bench_sched, &ina219_sim_bus ) != EMBEDD_RESULT_OK ||
+        embedd_bus_sched_client_init( &bench_client_a, &bench_sched, 1, 0 ) != EMBEDD_RESULT_OK ||
+        embedd_bus_sched_client_init( &bench_client_b, &bench_sched, 0, 0 ) != EMBEDD_RESULT_OK ) {
+      return -1;
+    }
+    bench_done_num = 0;
+    bench_client_calls = 0;
+    return 0;
+}
+
+static void bench_test_order(void) {
+    if( bench_setup() != 0 ) {
+      bench_check( false, "set up" );
+      return;
+    }
+    embedd_bus_sched_stats_t stats;
+    ina219_sim_stats_t sim_a, sim_b;
+    embedd_bus_sched_get_stats( &bench_sched, &stats, true );
+    ina219_sim_get_stats( &bench_sim_a, &sim_a, true );
+    ina219_sim_get_stats( &bench_sim_b, &sim_b, true );
+
+    // 0 takes the idle bus at once, the others wait for it
+    uint32_t now = embedd_hal_get_us();
+    bench_txn_init( 0, &bench_dev_a, 0, 0 );
+    bench_txn_init( 1, &bench_dev_b, 1, 0 );
+    bench_txn_init( 2, &bench_dev_a, 2, 0 );
+    bench_txn_deadline( 2, now + 100000U );
+    bench_txn_init( 3, &bench_dev_b, 3, 0 );
+    bench_txn_deadline( 3, now + 1U );
+    bench_txn_init( 4, &bench_dev_a, 4, 1 );
+    bench_txn_init( 5, &bench_dev_b, 5, 0 );
+    bool submitted = true;
+    for( uint32_t id = 0; id < BENCH_TXNS; id++ ) {
+      submitted = submitted && embedd_bus_sched_submit( &bench_sched, &bench_txns[id] ) == EMBEDD_RESULT_OK;
+    }
+    bench_check( submitted, "six transactions queued" );
+    bench_check( embedd_bus_sched_submit( &bench_sched, &bench_txns[1] ) != EMBEDD_RESULT_OK, "a queued transaction is not queued twice" );
+    bench_drain( 100000U );
+
+    static const uint32_t expect[BENCH_TXNS] = { 0, 4, 3, 2, 1, 5 };
+    bench_check( bench_done_num == BENCH_TXNS && memcmp( bench_order, expect, sizeof expect ) == 0,
+                 "priority, then deadline, then submission order" );
+    bool data = true;
+    for( uint32_t id = 0; id < BENCH_TXNS; id++ ) {
+      data = data && bench_results[id] == EMBEDD_RESULT_OK &&
+             bench_txn_data_ok( id, bench_txns[id].dev == &bench_dev_a ? &bench_sim_a : &bench_sim_b );
+    }
+    bench_check( data, "every transaction reads what the device holds" );
+
+    embedd_bus_sched_get_stats( &bench_sched, &stats, false );
+    ina219_sim_get_stats( &bench_sim_a, &sim_a, false );
+    ina219_sim_get_stats( &bench_sim_b, &sim_b, false );
+    printf("%lu transactions in %lu us, busy %lu us, wire time %lu us, utilization %lu.%02lu %%\n",
+           (unsigned long)stats.completed, (unsigned long)stats.elapsed_us, (unsigned long)stats.busy_us,
+           (unsigned long)( sim_a.bus_us + sim_b.bus_us ), (unsigned long)( stats.utilization / 100U ),
+           (unsigned long)( stats.utilization % 100U ));
+    bench_check( stats.completed == BENCH_TXNS && stats.errors == 0, "completions counted" );
+    bench_check( stats.late == 1, "the transaction started after its deadline counts as late" );
+    bench_check( stats.busy_us == sim_a.bus_us + sim_b.bus_us, "busy time equals the wire time, no gap between transactions" );
+    // the clock moves in steps of 1 us, the window ends up to 1 us after the last transaction
+    bench_check( stats.elapsed_us <= stats.busy_us + 1U && stats.utilization >= 9900U, "utilization 100 % while the queue is not empty" );
+
+    ina219_sim_advance( stats.elapsed_us );
+    embedd_bus_sched_get_stats( &bench_sched, &stats, true );
+    bench_check( stats.utilization >= 4900U && stats.utilization <= 5100U, "utilization 50 % after as long idle" );
+}
+
+static void bench_test_timeout(void) {
+    if( bench_setup() != 0 ) {
+      bench_check( false, "set up" );
+      return;
+    }
+    // a hanging transfer holds the bus far longer than a client waits
+    ina219_sim_set_timeout_us( 5U * EMBEDD_BUS_SCHED_TIMEOUT_US );
+    uint8_t reg = 0;
+    uint8_t data[2];
+    embedd_bus_sched_stats_t stats;
+
+    ina219_sim_inject( &bench_sim_a, INA219_SIM_FAULT_TIMEOUT, 1 );
+    uint32_t t0 = embedd_hal_get_us();
+    EMBEDD_RESULT result = bench_dev_a.bus->write_read( &bench_dev_a, &reg, 1, data, 2 );
+    uint32_t waited = embedd_hal_get_us() - t0;
+    printf("hanging transfer in progress failed after %lu us\n", (unsigned long)waited);
+    bench_check( result != EMBEDD_RESULT_OK && waited >= EMBEDD_BUS_SCHED_TIMEOUT_US &&
+                 waited < EMBEDD_BUS_SCHED_TIMEOUT_US + 1000U, "blocking transfer fails after the timeout" );
+    bench_check( !bench_client_a.txn.queued && !embedd_bus_sched_busy( &bench_sched ) && ina219_sim_idle(),
+                 "the transfer in progress is aborted" );
+    embedd_bus_sched_get_stats( &bench_sched, &stats, true );
+    bench_check( stats.errors == 1 && stats.completed == 0, "the aborted transfer counts as an error" );
+    memset( data, 0, sizeof data );
+    result = bench_dev_a.bus->write_read( &bench_dev_a, &reg, 1, data, 2 );
+    uint16_t word = ina219_sim_peek( &bench_sim_a, reg );
+    bench_check( result == EMBEDD_RESULT_OK && data[0] == (uint8_t)( word >> 8 ) && data[1] == (uint8_t)word,
+                 "the client works again at once" );
+
+    // a transaction of the other device hangs, the client's transfer waits behind it
+    ina219_sim_inject( &bench_sim_b, INA219_SIM_FAULT_TIMEOUT, 1 );
+    bench_txn_init( 0, &bench_dev_b, 0, 0 );
+    embedd_bus_sched_submit( &bench_sched, &bench_txns[0] );
+    t0 = embedd_hal_get_us();
+    result = bench_dev_a.bus->write_read( &bench_dev_a, &reg, 1, data, 2 );
+    waited = embedd_hal_get_us() - t0;
+    printf("transfer waiting behind a hanging one failed after %lu us\n", (unsigned long)waited);
+    bench_check( result != EMBEDD_RESULT_OK && !bench_client_a.txn.queued && bench_sched.active == &bench_txns[0] &&
+                 bench_sched.queue == NULL, "a waiting transfer leaves the queue, the one in progress goes on" );
+    bench_drain( 10U * EMBEDD_BUS_SCHED_TIMEOUT_US );
+    bench_check( bench_done_num == 1 && bench_results[0] != EMBEDD_RESULT_OK, "the hanging transfer completes with its error" );
+    memset( data, 0, sizeof data );
+    result = bench_dev_a.bus->write_read( &bench_dev_a, &reg, 1, data, 2 );
+    bench_check( result == EMBEDD_RESULT_OK && data[0] == (uint8_t)( word >> 8 ) && data[1] == (uint8_t)word,
+                 "the client works again" );
+}
+
+static void bench_test_abort(void) {
+    if( bench_setup() != 0 ) {
+      bench_check( false, "set up" );
+      return;
+    }
+    ina219_sim_set_timeout_us( 5U * EMBEDD_BUS_SCHED_TIMEOUT_US );
+    uint8_t reg = 0;
+    uint8_t data[2];
+
+    // an asynchronous client transfer hangs, a transaction waits behind it
+    ina219_sim_inject( &bench_sim_b, INA219_SIM_FAULT_TIMEOUT, 1 );
+    EMBEDD_RESULT result = bench_dev_b.bus->write_read_async( &bench_dev_b, &reg, 1, data, 2, bench_client_done, NULL );
+    bench_txn_init( 0, &bench_dev_a, 0, 0 );
+    embedd_bus_sched_submit( &bench_sched, &bench_txns[0] );
+    ina219_sim_advance( 1000U );
+    bench_check( result == EMBEDD_RESULT_OK && bench_sched.active == &bench_client_b.txn, "asynchronous transfer in progress" );
+    result = bench_dev_b.bus->abort( &bench_dev_b );
+    bench_check( result == EMBEDD_RESULT_OK && !bench_client_b.txn.queued && bench_sched.active == &bench_txns[0] &&
+                 !ina219_sim_idle(), "abort starts the next transaction at once" );
+    bench_drain( 10U * EMBEDD_BUS_SCHED_TIMEOUT_US );
+    ina219_sim_advance( 10U * EMBEDD_BUS_SCHED_TIMEOUT_US );
+    bench_check( bench_done_num == 1 && bench_results[0] == EMBEDD_RESULT_OK && bench_txn_data_ok( 0, &bench_sim_a ),
+                 "the next transaction completes" );
+    bench_check( bench_client_calls == 0, "the aborted transfer never calls back" );
+    bench_check( bench_dev_b.bus->abort( &bench_dev_b ) == EMBEDD_RESULT_OK, "abort without a transfer in progress" );
+}
+
+int main(int argc, char** argv) {
+    for( int i = 1; i + 1 < argc; i += 2 ) {
+      if( strcmp( argv[i], "-b" ) == 0 ) {
+        bench_bus_hz = (uint32_t)strtoul( argv[i + 1], NULL, 0 ) * 1000U;
+      }
+    }
+    if( bench_bus_hz == 0 ) {
+      fprintf(stderr, "usage: %s [-b bus kHz]\n", argv[0]);
+      return 1;
+    }
+
+    printf("bus %lu kHz\n", (unsigned long)( bench_bus_hz / 1000U ));
+    bench_test_order();
+    bench_test_timeout();
+    bench_test_abort();
+    return bench_failed;
+}
@@ -0,0 +1,219 @@
+/*!
+ * \file convert_bench.c
+ * \brief Host accuracy test and benchmark of the ina219_convert constants
+ *
+ * Converts every current, power and shunt voltage register value with the
+ * multiply and shift constants of ina219_scale_init, for current LSBs from
+ * 1 nA to 1.6 mA in steps of about 10 % and shunts from 1 mOhm to 1 Ohm,
+ * and with those of ina219_scale_init_calibration for every 256th
+ * calibration value on the same shunts, and compares the results with a
+ * double precision reference. A multiplier of at least 16384 and a rounded
+ * shift bound the error to half a unit plus 30.5 ppm of the value; the
+ * program prints the largest errors and exits with 1 if a value is off by
+ * more than a unit plus 31 ppm or constants for a valid setting cannot be
+ * computed. It then prints the
+ * cost of ina219_convert_sample in cycles per sample, best of five runs. On
+ * x86 the time stamp counter is read, elsewhere the time is converted with
+ * the clock given by -m.
+ *
+ * Build and run from the repository root:
+ *
+ *   D=INA219-CubeIDE/Drivers/ina219
+ *   gcc -O2 -I$D tools/convert_bench.c $D/ina219_convert.c -lm -o convert_bench
+ *   ./convert_bench [-n samples] [-m host clock MHz]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "ina219_convert.h"
+
+#define BENCH_ERR_UNITS 1.0
+#define BENCH_ERR_PPM   31.0
+
+static uint32_t bench_samples = 1000000U;
+static double bench_mhz = 0.0;
+
+static const uint32_t bench_shunts_uohm[] = { 1000U, 1500U, 10000U, 33000U, 100000U, 270000U, 1000000U };
+#define BENCH_SHUNTS ( sizeof bench_shunts_uohm / sizeof bench_shunts_uohm[0] )
+
+typedef struct {
+  const char* name;
+  uint32_t values;
+  double max_err;
+  double max_ppm;
+  uint32_t over;
+} bench_error_t;
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t bench_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void bench_error(bench_error_t* e, double value, double ref) {
+    double err = fabs( value - ref );
+    e->values++;
+    if( err > e->max_err ) {
+      e->max_err = err;
+    }
+    // below 100000 units the rounding to a whole unit dominates the relative error
+    if( fabs( ref ) >= 100000.0 && err / fabs( ref ) * 1e6 > e->max_ppm ) {
+      e->max_ppm = err / fabs( ref ) * 1e6;
+    }
+    if( err > BENCH_ERR_UNITS + fabs( ref ) * BENCH_ERR_PPM * 1e-6 ) {
+      e->over++;
+    }
+}
+
+// current and power of every register value, current LSB in nanoamperes
+static void bench_check_scale(const ina219_scale_t* scale, double lsb_na, bench_error_t* current, bench_error_t* power) {
+    for( int32_t raw = INT16_MIN; raw <= INT16_MAX; raw++ ) {
+      bench_error( current, ina219_convert_current_ua( scale, (uint16_t)raw ), raw * lsb_na / 1000.0 );
+    }
+    for( uint32_t raw = 0; raw <= UINT16_MAX; raw++ ) {
+      bench_error( power, ina219_convert_power_uw( scale, (uint16_t)raw ), raw * lsb_na * INA219_POWER_LSB_RATIO / 1000.0 );
+    }
+}
+
+static void bench_print_error(const bench_error_t* e) {
+    printf("%-26s %10lu %10.3f %9.2f %8lu\n", e->name, (unsigned long)e->values, e->max_err, e->max_ppm, (unsigned long)e->over);
+}
+
+static int bench_accuracy(void) {
+    bench_error_t errors[] = {
+      { .name = "current, LSB" },
+      { .name = "power, LSB" },
+      { .name = "current, calibration" },
+      { .name = "power, calibration" },
+      { .name = "current from shunt" },
+    };
+    uint32_t failed = 0;
+    uint32_t skipped = 0;
+    ina219_scale_t scale;
+
+    for( double lsb = 1.0; lsb <= 1600000.0; lsb = ceil( lsb * 1.1 ) ) {
+      if( ina219_scale_init( &scale, (uint32_t)lsb, 100000U, INA219_CONFIGURATION_PG_GAIN_EQ_8_RANGE_EQ_320_MV, INA219_CONFIGURATION_BRNG_EQ_32V_FSR ) != EMBEDD_RESULT_OK ) {
+        failed++;
+        continue;
+      }
+      bench_check_scale( &scale, lsb, &errors[0], &errors[1] );
+    }
+
+    for( size_t s = 0; s < BENCH_SHUNTS; s++ ) {
+      for( uint32_t cal = 2; cal <= INA219_CALIBRATION_FS_MASK; cal += 256U ) {
+        // the current LSB the device applies, 0.04096 / (Cal * R)
+        double lsb = 0.04096 / ( (double)cal * bench_shunts_uohm[s] * 1e-6 ) * 1e9;
+        EMBEDD_RESULT result = ina219_scale_init_calibration( &scale, (uint16_t)cal, bench_shunts_uohm[s],
+                                                              INA219_CONFIGURATION_PG_GAIN_EQ_8_RANGE_EQ_320_MV, INA219_CONFIGURATION_BRNG_EQ_32V_FSR );
+        if( result != EMBEDD_RESULT_OK ) {
+          // above 1.6 mA the scale does not fit 32-bit arithmetic, as documented
+          if( lsb <= 1600000.0 ) {
+            failed++;
+          } else {
+            skipped++;
+          }
+          continue;
+        }
+        bench_check_scale( &scale, lsb, &errors[2], &errors[3] );
+      }
+      if( ina219_scale_init( &scale, 0, bench_shunts_uohm[s], INA219_CONFIGURATION_PG_GAIN_EQ_8_RANGE_EQ_320_MV, INA219_CONFIGURATION_BRNG_EQ_32V_FSR ) != EMBEDD_RESULT_OK ) {
+        failed++;
+        continue;
+      }
+      for( int32_t raw = -32000; raw <= 32000; raw++ ) {
+        bench_error( &errors[4], ina219_convert_shunt_current_ua( &scale, (uint16_t)raw ),
+                     raw * (double)INA219_SHUNT_VOLTAGE_LSB_UV / ( bench_shunts_uohm[s] * 1e-6 ) );
+      }
+    }
+
+    printf("%-26s %10s %10s %9s %8s\n", "conversion", "values", "max error", "max ppm", "over");
+    uint32_t over = 0;
+    for( size_t i = 0; i < sizeof errors / sizeof errors[0]; i++ ) {
+      bench_print_error( &errors[i] );
+      over += errors[i].over;
+    }
+    printf("bound %.0f unit + %.0f ppm, %lu settings failed, %lu calibrations above 1.6 mA skipped\n",
+           BENCH_ERR_UNITS, BENCH_ERR_PPM, (unsigned long)failed, (unsigned long)skipped);
+    return ( over != 0 || failed != 0 ) ? -1 : 0;
+}
+
+static int bench_speed(void) {
+    ina219_sample_t* samples = malloc( bench_samples * sizeof(ina219_sample_t) );
+    if( samples == NULL ) {
+      return -1;
+    }
+    srand( 1 );
+    for( uint32_t i = 0; i < bench_samples; i++ ) {
+      samples[i] = (ina219_sample_t){
+        .shunt_voltage = (uint16_t)( rand() % 64001 - 32000 ),
+        .bus_voltage = (uint16_t)( ( rand() % 8000 ) << 3 | 0x2 ),
+        .power = (uint16_t)rand(),
+        .current = (uint16_t)rand(),
+      };
+    }
+    ina219_scale_t scale;
+    if( ina219_scale_init_calibration( &scale, 4096U, 100000U, INA219_CONFIGURATION_PG_GAIN_EQ_8_RANGE_EQ_320_MV, INA219_CONFIGURATION_BRNG_EQ_32V_FSR ) != EMBEDD_RESULT_OK ) {
+      free( samples );
+      return -1;
+    }
+    double best = 0.0;
+    for( int run = 0; run < 5; run++ ) {
+      volatile int32_t sink = 0;
+      ina219_measurement_t meas;
+      double t0 = bench_now();
+      uint64_t c0 = bench_cycles();
+      for( uint32_t i = 0; i < bench_samples; i++ ) {
+        ina219_convert_sample( &scale, &samples[i], &meas );
+        sink = meas.current_ua + (int32_t)meas.power_uw;
+      }
+      uint64_t c1 = bench_cycles();
+      double t1 = bench_now();
+      (void)sink;
+      double cycles = ( c1 != c0 ) ? (double)( c1 - c0 ) : ( t1 - t0 ) * bench_mhz / 1000.0;
+      if( run == 0 || cycles < best ) {
+        best = cycles;
+      }
+    }
+    printf("\nina219_convert_sample %8.1f cycles/sample\n", best / bench_samples);
+    free( samples );
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    for( int i = 1; i + 1 < argc; i += 2 ) {
+      if( strcmp( argv[i], "-n" ) == 0 ) {
+        bench_samples = (uint32_t)strtoul( argv[i + 1], NULL, 0 );
+      } else if( strcmp( argv[i], "-m" ) == 0 ) {
+        bench_mhz = strtod( argv[i + 1], NULL );
+      }
+    }
+    if( bench_samples == 0 ) {
+      fprintf(stderr, "usage: %s [-n samples] [-m host clock MHz]\n", argv[0]);
+      return 1;
+    }
+    if( bench_cycles() == 0 && bench_mhz <= 0.0 ) {
+      fprintf(stderr, "no cycle counter, give the host clock with -m\n");
+      return 1;
+    }
+
+    int failed = bench_accuracy() != 0;
+    if( bench_speed() != 0 ) {
+      return 1;
+    }
+    return failed;
+}
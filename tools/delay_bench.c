@@ -0,0 +1,131 @@
+/*!
+ * \file delay_bench.c
+ * \brief Host benchmark of the register access rate before and after the delay service
+ *
+ * Reads the six INA219 registers in turn from the simulated device for a
+ * simulated second, once through a copy of the original register read,
+ * which passed every register delay to HAL_Delay(), and once through
+ * ina219_read_reg. HAL_Delay() waits for one more tick than asked for, so
+ * the original read spent up to 1 ms even on the delays of 0 all INA219
+ * registers have; it is modelled on a 1 ms tick in simulated time. The
+ * program prints register accesses per second, the time per access and how
+ * much of that time the bus was busy, for 100 kHz, 400 kHz and 1 MHz.
+ *
+ * Build and run from the repository root:
+ *
+ *   D=INA219-CubeIDE/Drivers/ina219
+ *   gcc -O2 -I$D -Itools tools/delay_bench.c tools/ina219_sim.c \
+ *       $D/ina219.c $D/ina219_registers.c $D/ina219_shadow.c $D/ina219_snapshot.c \
+ *       $D/embedd_i2c.c $D/embedd_hal.c $D/embedd_utils.c -lm -o delay_bench
+ *   ./delay_bench [-s simulated seconds per run]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ina219.h"
+#include "ina219_sim.h"
+
+#define BENCH_ADDR 0x40
+
+INA219_I2C_DEVICE_DEFINE_STATIC(bench_sensor, "INA219 sim", &ina219_sim_bus, BENCH_ADDR)
+
+static double bench_seconds = 1.0;
+static ina219_sim_t bench_sim;
+
+static const struct { uint8_t addr; uint32_t delay; } bench_regs[] = {
+  { ina219_configuration_read_reg_addr, ina219_configuration_delay },
+  { ina219_shunt_voltage_read_reg_addr, ina219_shunt_voltage_delay },
+  { ina219_bus_voltage_read_reg_addr,   ina219_bus_voltage_delay },
+  { ina219_power_read_reg_addr,         ina219_power_delay },
+  { ina219_current_read_reg_addr,       ina219_current_delay },
+  { ina219_calibration_read_reg_addr,   ina219_calibration_delay },
+};
+#define BENCH_REGS ( sizeof bench_regs / sizeof bench_regs[0] )
+
+// HAL_Delay() on a 1 ms SysTick: it waits for the delay plus one tick to pass
+static void bench_hal_delay(uint32_t ms) {
+    uint64_t tickstart = ina219_sim_now_us() / 1000U;
+    uint64_t wait = (uint64_t)ms + 1U;
+    uint64_t until = ( tickstart + wait ) * 1000U;
+    ina219_sim_advance( until - ina219_sim_now_us() );
+}
+
+// the register read before the delay service: address write, HAL_Delay, read
+static EMBEDD_RESULT bench_read_reg_hal_delay(embedd_device_t* dev, uint8_t reg_addr, uint16_t* reg, uint32_t delay) {
+    uint8_t addr = reg_addr;
+    uint8_t data[2];
+    if( dev->bus->write( dev, &addr, 1 ) != EMBEDD_RESULT_OK ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    bench_hal_delay( delay );
+    if( dev->bus->read( dev, data, 2 ) != EMBEDD_RESULT_OK ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    *reg = (uint16_t)( ( data[0] << 8 ) | data[1] );
+    return EMBEDD_RESULT_OK;
+}
+
+static EMBEDD_RESULT bench_read_reg_service(embedd_device_t* dev, uint8_t reg_addr, uint16_t* reg, uint32_t delay) {
+    return ina219_read_reg( dev, reg_addr, reg, sizeof(*reg), delay );
+}
+
+typedef EMBEDD_RESULT (*bench_read_t)(embedd_device_t* dev, uint8_t reg_addr, uint16_t* reg, uint32_t delay);
+
+static int bench_run(const char* name, uint32_t bus_hz, bench_read_t read) {
+    ina219_sim_reset();
+    ina219_sim_set_bus_hz( bus_hz );
+    ina219_sim_init( &bench_sim, BENCH_ADDR, 100000U, 1 );
+    if( ina219_sim_attach( &bench_sim ) != EMBEDD_RESULT_OK ) {
+      return -1;
+    }
+    ina219_reg_ptr_invalidate( &bench_sensor );
+    if( ina219_check_device( &bench_sensor ) != EMBEDD_RESULT_OK ) {
+      return -1;
+    }
+    ina219_sim_stats_t stats;
+    ina219_sim_get_stats( &bench_sim, &stats, true );
+
+    uint64_t start = ina219_sim_now_us();
+    uint64_t end = start + (uint64_t)( bench_seconds * 1e6 );
+    uint32_t accesses = 0;
+    volatile uint16_t sink = 0;
+    while( ina219_sim_now_us() < end ) {
+      uint16_t reg;
+      if( read( &bench_sensor, bench_regs[accesses % BENCH_REGS].addr, &reg, bench_regs[accesses % BENCH_REGS].delay ) != EMBEDD_RESULT_OK ) {
+        return -1;
+      }
+      sink = reg;
+      accesses++;
+    }
+    (void)sink;
+    double elapsed = (double)( ina219_sim_now_us() - start );
+    ina219_sim_get_stats( &bench_sim, &stats, false );
+    printf("%-11s %5lu kHz %10.0f %9.1f %7.1f %%\n", name, (unsigned long)( bus_hz / 1000U ),
+           accesses * 1e6 / elapsed, elapsed / accesses, 100.0 * stats.bus_us / elapsed);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    for( int i = 1; i + 1 < argc; i += 2 ) {
+      if( strcmp( argv[i], "-s" ) == 0 ) {
+        bench_seconds = strtod( argv[i + 1], NULL );
+      }
+    }
+    if( bench_seconds <= 0.0 ) {
+      fprintf(stderr, "usage: %s [-s simulated seconds per run]\n", argv[0]);
+      return 1;
+    }
+
+    static const uint32_t bus_hz[] = { 100000U, 400000U, 1000000U };
+    printf("%-11s %9s %10s %9s %9s\n", "read", "bus", "access/s", "us each", "bus busy");
+    for( size_t j = 0; j < sizeof bus_hz / sizeof bus_hz[0]; j++ ) {
+      if( bench_run( "HAL_Delay", bus_hz[j], bench_read_reg_hal_delay ) != 0 ||
+          bench_run( "deadline", bus_hz[j], bench_read_reg_service ) != 0 ) {
+        fprintf(stderr, "register read failed at %lu Hz\n", (unsigned long)bus_hz[j]);
+        return 1;
+      }
+    }
+    return 0;
+}
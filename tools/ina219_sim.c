@@ -0,0 +1,510 @@
+/*!
+ * \file ina219_sim.c
+ * \brief Behavioral model of the INA219 on a simulated I2C bus, for host builds
+ *
+ * See ina219_sim.h. Link it with the driver sources instead of the STM32 bus
+ * functions of main.c.
+ */
+
+#include <math.h>
+#include <stddef.h>
+
+#include "ina219.h"
+#include "ina219_sim.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define INA219_SIM_ADDR_FIRST 0x40U
+#define INA219_SIM_ADDR_LAST  0x4FU
+
+#define INA219_SIM_REG_COUNT 6U
+
+// shunt voltage register full scale of each PGA setting, in 10 uV steps
+static const int32_t ina219_sim_shunt_fs[4] = { 4000, 8000, 16000, 32000 };
+
+// typical conversion time of every SADC/BADC value, the datasheet's table
+static const uint32_t ina219_sim_adc_us[16] = {
+  84, 148, 276, 532, 84, 148, 276, 532,
+  532, 1060, 2130, 4260, 8510, 17020, 34050, 68100,
+};
+
+// the one bus all simulated devices are on, and the asynchronous transfer running on it
+static struct {
+  ina219_sim_t* devices;
+  uint64_t now;
+  uint32_t hz;
+  uint32_t timeout_us;
+  bool busy;
+  uint64_t done_at;
+  embedd_bus_done_t done;
+  void* ctx;
+  EMBEDD_RESULT result;
+} ina219_sim_state = {
+  .hz = INA219_SIM_BUS_HZ,
+  .timeout_us = INA219_SIM_TIMEOUT_US,
+};
+
+/* --------------------------------------------------------------------------
+ * Inputs
+ * -------------------------------------------------------------------------- */
+
+static uint64_t ina219_sim_random(ina219_sim_t* sim) {
+    // xorshift64*
+    sim->rng ^= sim->rng >> 12;
+    sim->rng ^= sim->rng << 25;
+    sim->rng ^= sim->rng >> 27;
+    return sim->rng * 0x2545F4914F6CDD1DULL;
+}
+
+static double ina219_sim_uniform(ina219_sim_t* sim) {
+    return ( ( ina219_sim_random( sim ) >> 11 ) + 0.5 ) * ( 1.0 / 9007199254740992.0 );
+}
+
+static double ina219_sim_gauss(ina219_sim_t* sim) {
+    return sqrt( -2.0 * log( ina219_sim_uniform( sim ) ) ) * cos( 2.0 * M_PI * ina219_sim_uniform( sim ) );
+}
+
+double ina219_sim_wave_value(const ina219_sim_wave_t* wave, uint64_t t_us) {
+    double phase = wave->period_us != 0 ? (double)( t_us % wave->period_us ) / wave->period_us : 0.0;
+    switch( wave->shape ) {
+      case INA219_SIM_SINE:
+        return wave->offset + wave->amplitude * sin( 2.0 * M_PI * phase );
+      case INA219_SIM_SQUARE:
+        return wave->offset + ( phase < 0.5 ? wave->amplitude : -wave->amplitude );
+      case INA219_SIM_RAMP:
+        return wave->offset + wave->amplitude * ( 2.0 * phase - 1.0 );
+      case INA219_SIM_FUNC:
+        return wave->offset + ( wave->func != NULL ? wave->func( t_us, wave->ctx ) : 0.0 );
+      default:
+        return wave->offset;
+    }
+}
+
+static double ina219_sim_sample(ina219_sim_t* sim, const ina219_sim_wave_t* wave, uint64_t t_us) {
+    double value = ina219_sim_wave_value( wave, t_us );
+    if( wave->noise != 0 ) {
+      value += wave->noise * ina219_sim_gauss( sim );
+    }
+    return value;
+}
+
+/* --------------------------------------------------------------------------
+ * Conversions
+ * -------------------------------------------------------------------------- */
+
+uint32_t ina219_sim_conversion_us(const ina219_sim_t* sim, uint16_t configuration) {
+    uint8_t mode = (uint8_t)INA219_FIELD_GET( configuration, CONFIGURATION, MODE );
+    uint64_t t = 0;
+    // bit 0 of the mode converts the shunt, bit 1 the bus voltage
+    if( mode & 0x01U ) {
+      t += ina219_sim_adc_us[INA219_FIELD_GET( configuration, CONFIGURATION, SADC )];
+    }
+    if( mode & 0x02U ) {
+      t += ina219_sim_adc_us[INA219_FIELD_GET( configuration, CONFIGURATION, BADC )];
+    }
+    return (uint32_t)( ( t * (uint64_t)( 1000000 + sim->clock_ppm ) + 500000U ) / 1000000U );
+}
+
+// a conversion with one ADC setting of an input over [t0, t1): the samples are
+// spread over the time, each quantized to the resolution and clamped to the
+// full scale, and averaged
+static int32_t ina219_sim_adc(ina219_sim_t* sim, uint8_t adc, const ina219_sim_wave_t* wave,
+                              double to_counts, int32_t lo, int32_t hi, uint64_t t0, uint64_t t1) {
+    uint32_t samples = ( adc & 0x08U ) ? 1U << ( adc & 0x07U ) : 1U;
+    double step = ( adc & 0x08U ) ? 1.0 : (double)( 1U << ( 3U - ( adc & 0x03U ) ) );
+    double sum = 0.0;
+    for( uint32_t i = 0; i < samples; i++ ) {
+      uint64_t t = t0 + (uint64_t)( ( i + 0.5 ) * ( t1 - t0 ) / samples );
+      double counts = step * nearbyint( ina219_sim_sample( sim, wave, t ) * to_counts / step );
+      sum += counts < lo ? lo : counts > hi ? hi : counts;
+    }
+    return (int32_t)lround( sum / samples );
+}
+
+// latches the results of the cycle which just ended
+static void ina219_sim_latch(ina219_sim_t* sim) {
+    uint16_t config = sim->regs[ina219_configuration_read_reg_addr];
+    uint8_t mode = (uint8_t)INA219_FIELD_GET( config, CONFIGURATION, MODE );
+    uint64_t t = sim->cycle_start;
+    if( mode & 0x01U ) {
+      uint8_t sadc = (uint8_t)INA219_FIELD_GET( config, CONFIGURATION, SADC );
+      int32_t fs = ina219_sim_shunt_fs[INA219_FIELD_GET( config, CONFIGURATION, PG )];
+      uint64_t end = t + ina219_sim_conversion_us( sim, INA219_FIELD_SET( config, CONFIGURATION, MODE, 0x01U ) );
+      // uA through the shunt to 10 uV steps
+      int32_t shunt = ina219_sim_adc( sim, sadc, &sim->current, sim->shunt_uohm / 1e7, -fs, fs, t, end );
+      sim->regs[ina219_shunt_voltage_read_reg_addr] = (uint16_t)(int16_t)shunt;
+      t = end;
+    }
+    if( mode & 0x02U ) {
+      uint8_t badc = (uint8_t)INA219_FIELD_GET( config, CONFIGURATION, BADC );
+      int32_t fs = INA219_FIELD_GET( config, CONFIGURATION, BRNG ) ? 8000 : 4000;
+      // mV to 4 mV steps
+      int32_t bus = ina219_sim_adc( sim, badc, &sim->bus, 0.25, 0, fs, t, sim->cycle_end );
+      sim->regs[ina219_bus_voltage_read_reg_addr] = (uint16_t)( bus << INA219_BUS_VOLTAGE_BD_SHIFT );
+    }
+    // current and power follow from the latest shunt and bus voltages
+    int32_t shunt = (int16_t)sim->regs[ina219_shunt_voltage_read_reg_addr];
+    int32_t current = (int32_t)( (int64_t)shunt * sim->regs[ina219_calibration_read_reg_addr] / 4096 );
+    uint32_t bus = ina219_bus_voltage_value( sim->regs[ina219_bus_voltage_read_reg_addr] );
+    sim->ovf = 0;
+    if( current > INT16_MAX || current < INT16_MIN ) {
+      current = current > INT16_MAX ? INT16_MAX : INT16_MIN;
+      sim->ovf = 1;
+    }
+    uint32_t power = (uint32_t)( current < 0 ? -current : current ) * bus / 5000U;
+    if( power > UINT16_MAX ) {
+      power = UINT16_MAX;
+      sim->ovf = 1;
+    }
+    sim->regs[ina219_current_read_reg_addr] = (uint16_t)(int16_t)current;
+    sim->regs[ina219_power_read_reg_addr] = (uint16_t)power;
+}
+
+// starts a conversion cycle, or stops converting in the modes without one
+static void ina219_sim_start(ina219_sim_t* sim, uint64_t now, uint32_t wakeup_us) {
+    uint32_t t = ina219_sim_conversion_us( sim, sim->regs[ina219_configuration_read_reg_addr] );
+    sim->converting = t != 0;
+    sim->cycle_start = now + wakeup_us;
+    sim->cycle_end = sim->cycle_start + t;
+}
+
+// completes the conversions which ended by now
+static void ina219_sim_update(ina219_sim_t* sim, uint64_t now) {
+    while( sim->converting && sim->cycle_end <= now ) {
+      uint16_t config = sim->regs[ina219_configuration_read_reg_addr];
+      bool continuous = INA219_FIELD_GET( config, CONFIGURATION, MODE ) > INA219_CONFIGURATION_MODE_ADC_OFF_DISABLED;
+      uint64_t t = sim->cycle_end - sim->cycle_start;
+      if( continuous && now - sim->cycle_end >= t ) {
+        // only the last of the cycles nobody looked at needs its results
+        uint64_t skipped = ( now - sim->cycle_end ) / t;
+        sim->stats.conversions += (uint32_t)skipped;
+        sim->stats.overwritten += (uint32_t)( skipped - 1U ) + sim->cnvr;
+        sim->cnvr = 1;
+        sim->cycle_start += skipped * t;
+        sim->cycle_end += skipped * t;
+      }
+      ina219_sim_latch( sim );
+      sim->stats.conversions++;
+      sim->stats.overwritten += sim->cnvr;
+      sim->cnvr = 1;
+      if( continuous ) {
+        sim->cycle_start = sim->cycle_end;
+        sim->cycle_end += ina219_sim_conversion_us( sim, config );
+      } else {
+        sim->converting = 0;
+      }
+    }
+}
+
+/* --------------------------------------------------------------------------
+ * Registers
+ * -------------------------------------------------------------------------- */
+
+static void ina219_sim_power_on(ina219_sim_t* sim) {
+    for( uint32_t i = 0; i < INA219_SIM_REG_COUNT; i++ ) {
+      sim->regs[i] = 0;
+    }
+    sim->regs[ina219_configuration_read_reg_addr] = INA219_CONFIGURATION_RESET_VALUE;
+    sim->ptr = ina219_configuration_read_reg_addr;
+    sim->cnvr = 0;
+    sim->ovf = 0;
+}
+
+static uint16_t ina219_sim_reg(const ina219_sim_t* sim, uint8_t reg) {
+    if( reg >= INA219_SIM_REG_COUNT ) {
+      return 0;
+    }
+    if( reg == ina219_bus_voltage_read_reg_addr ) {
+      return sim->regs[reg] | ( sim->cnvr ? INA219_BUS_VOLTAGE_CNVR_MASK : 0 ) | ( sim->ovf ? INA219_BUS_VOLTAGE_OVF_MASK : 0 );
+    }
+    return sim->regs[reg];
+}
+
+static void ina219_sim_write_reg(ina219_sim_t* sim, uint8_t reg, uint16_t word, uint64_t now) {
+    if( reg == ina219_configuration_write_reg_addr ) {
+      bool powered_down = INA219_FIELD_GET( sim->regs[reg], CONFIGURATION, MODE ) == INA219_CONFIGURATION_MODE_POWERDOWN;
+      if( word & INA219_CONFIGURATION_RST_MASK ) {
+        // a reset also returns the pointer and the results to their power-on values
+        ina219_sim_power_on( sim );
+        sim->stats.resets++;
+      } else {
+        sim->regs[reg] = word & (uint16_t)~INA219_CONFIGURATION_RST_MASK;
+      }
+      // any write aborts the running conversion and starts a new one
+      sim->cnvr = 0;
+      ina219_sim_start( sim, now, powered_down ? INA219_SIM_WAKEUP_US : 0 );
+    } else if( reg == ina219_calibration_write_reg_addr ) {
+      sim->regs[reg] = word & INA219_CALIBRATION_FS_MASK;
+    }
+    // the result registers are read-only
+}
+
+uint16_t ina219_sim_peek(ina219_sim_t* sim, uint8_t reg) {
+    ina219_sim_update( sim, ina219_sim_state.now );
+    return ina219_sim_reg( sim, reg );
+}
+
+/* --------------------------------------------------------------------------
+ * Bus
+ * -------------------------------------------------------------------------- */
+
+static ina219_sim_t* ina219_sim_find(uint16_t addr) {
+    for( ina219_sim_t* sim = ina219_sim_state.devices; sim != NULL; sim = sim->next ) {
+      if( sim->addr == addr ) {
+        return sim;
+      }
+    }
+    return NULL;
+}
+
+// wire time of some bytes with their acknowledge bits, in ns
+static uint64_t ina219_sim_wire_ns(uint32_t bytes) {
+    return (uint64_t)bytes * 9U * 1000000000U / ina219_sim_state.hz;
+}
+
+static bool ina219_sim_fault(ina219_sim_t* sim, ina219_sim_fault_t fault) {
+    if( sim->fault_next[fault] != 0 ) {
+      sim->fault_next[fault]--;
+      return true;
+    }
+    return sim->fault_ppm[fault] != 0 && ina219_sim_random( sim ) % 1000000U < sim->fault_ppm[fault];
+}
+
+// runs a transaction at the current time, the data changes hands at the time
+// of its segment; *duration receives the time the transaction holds the bus
+static EMBEDD_RESULT ina219_sim_transact(const embedd_device_t* dev, const embedd_bus_seg_t* segs, uint32_t segs_num, uint64_t* duration) {
+    embedd_i2c_dev_cfg_t* cfg = embedd_i2c_get_dev_config( dev );
+    ina219_sim_t* sim = cfg != NULL ? ina219_sim_find( cfg->addr ) : NULL;
+    uint64_t now = ina219_sim_state.now;
+    // START and STOP take about a bit time each
+    uint64_t ns = ina219_sim_wire_ns( 1 ) * 2U / 9U;
+    *duration = 0;
+    if( sim == NULL || segs == NULL || segs_num == 0 ) {
+      *duration = ( ns + ina219_sim_wire_ns( 1 ) + 999U ) / 1000U;
+      return EMBEDD_RESULT_ERR;
+    }
+    sim->stats.transfers++;
+    if( ina219_sim_fault( sim, INA219_SIM_FAULT_TIMEOUT ) ) {
+      sim->stats.timeouts++;
+      *duration = ina219_sim_state.timeout_us;
+      sim->stats.bus_us += *duration;
+      return EMBEDD_RESULT_ERR;
+    }
+    if( ina219_sim_fault( sim, INA219_SIM_FAULT_NACK ) ) {
+      sim->stats.nacks++;
+      *duration = ( ns + ina219_sim_wire_ns( 1 ) + 999U ) / 1000U;
+      sim->stats.bus_us += *duration;
+      return EMBEDD_RESULT_ERR;
+    }
+    for( uint32_t i = 0; i < segs_num; i++ ) {
+      const embedd_bus_seg_t* seg = &segs[i];
+      // the address byte, a repeated START before all but the first segment
+      ns += ina219_sim_wire_ns( 1 ) + ( i != 0 ? ina219_sim_wire_ns( 1 ) / 9U : 0 );
+      ina219_sim_update( sim, now + ns / 1000U );
+      if( seg->dir == EMBEDD_BUS_SEG_WRITE ) {
+        if( seg->size >= 1 ) {
+          sim->ptr = seg->data[0];
+        }
+        // a register takes both bytes, further ones are ignored
+        if( seg->size >= 3 ) {
+          ina219_sim_write_reg( sim, sim->ptr, (uint16_t)( ( seg->data[1] << 8 ) | seg->data[2] ), now + ns / 1000U );
+        }
+      } else {
+        // the pointer does not advance, longer reads repeat the register
+        uint16_t word = ina219_sim_reg( sim, sim->ptr );
+        for( uint32_t j = 0; j < seg->size; j++ ) {
+          seg->data[j] = (uint8_t)( j & 1U ? word : word >> 8 );
+        }
+        if( sim->ptr == ina219_power_read_reg_addr && seg->size != 0 ) {
+          sim->cnvr = 0;
+        }
+      }
+      ns += ina219_sim_wire_ns( seg->size );
+      sim->stats.bytes += seg->size;
+    }
+    *duration = ( ns + 999U ) / 1000U;
+    sim->stats.bus_us += *duration;
+    return EMBEDD_RESULT_OK;
+}
+
+// a blocking transaction, fails like a busy HAL while an asynchronous one runs
+static EMBEDD_RESULT ina219_sim_run(const embedd_device_t* dev, const embedd_bus_seg_t* segs, uint32_t segs_num) {
+    if( ina219_sim_state.busy ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    uint64_t duration;
+    EMBEDD_RESULT result = ina219_sim_transact( dev, segs, segs_num, &duration );
+    ina219_sim_advance( duration );
+    return result;
+}
+
+static EMBEDD_RESULT ina219_sim_run_async(const embedd_device_t* dev, const embedd_bus_seg_t* segs, uint32_t segs_num, embedd_bus_done_t done, void* ctx) {
+    if( ina219_sim_state.busy || done == NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    uint64_t duration;
+    ina219_sim_state.result = ina219_sim_transact( dev, segs, segs_num, &duration );
+    ina219_sim_state.done_at = ina219_sim_state.now + duration;
+    ina219_sim_state.done = done;
+    ina219_sim_state.ctx = ctx;
+    ina219_sim_state.busy = true;
+    return EMBEDD_RESULT_OK;
+}
+
+static EMBEDD_RESULT ina219_sim_bus_write(const embedd_device_t* dev, const uint8_t* data_ptr, uint32_t data_size) {
+    embedd_bus_seg_t seg = { .data = (uint8_t*)data_ptr, .size = data_size, .dir = EMBEDD_BUS_SEG_WRITE };
+    return ina219_sim_run( dev, &seg, 1 );
+}
+
+static EMBEDD_RESULT ina219_sim_bus_read(const embedd_device_t* dev, uint8_t* data_ptr, uint32_t data_size) {
+    embedd_bus_seg_t seg = { .data = data_ptr, .size = data_size, .dir = EMBEDD_BUS_SEG_READ };
+    return ina219_sim_run( dev, &seg, 1 );
+}
+
+static EMBEDD_RESULT ina219_sim_bus_write_async(const embedd_device_t* dev, const uint8_t* data_ptr, uint32_t data_size, embedd_bus_done_t done, void* ctx) {
+    embedd_bus_seg_t seg = { .data = (uint8_t*)data_ptr, .size = data_size, .dir = EMBEDD_BUS_SEG_WRITE };
+    return ina219_sim_run_async( dev, &seg, 1, done, ctx );
+}
+
+static EMBEDD_RESULT ina219_sim_bus_read_async(const embedd_device_t* dev, uint8_t* data_ptr, uint32_t data_size, embedd_bus_done_t done, void* ctx) {
+    embedd_bus_seg_t seg = { .data = data_ptr, .size = data_size, .dir = EMBEDD_BUS_SEG_READ };
+    return ina219_sim_run_async( dev, &seg, 1, done, ctx );
+}
+
+static EMBEDD_RESULT ina219_sim_bus_write_read(const embedd_device_t* dev, const uint8_t* wr_ptr, uint32_t wr_size, uint8_t* rd_ptr, uint32_t rd_size) {
+    embedd_bus_seg_t segs[2] = {
+      { .data = (uint8_t*)wr_ptr, .size = wr_size, .dir = EMBEDD_BUS_SEG_WRITE },
+      { .data = rd_ptr,           .size = rd_size, .dir = EMBEDD_BUS_SEG_READ  },
+    };
+    return ina219_sim_run( dev, segs, 2 );
+}
+
+static EMBEDD_RESULT ina219_sim_bus_write_read_async(const embedd_device_t* dev, const uint8_t* wr_ptr, uint32_t wr_size, uint8_t* rd_ptr, uint32_t rd_size, embedd_bus_done_t done, void* ctx) {
+    embedd_bus_seg_t segs[2] = {
+      { .data = (uint8_t*)wr_ptr, .size = wr_size, .dir = EMBEDD_BUS_SEG_WRITE },
+      { .data = rd_ptr,           .size = rd_size, .dir = EMBEDD_BUS_SEG_READ  },
+    };
+    return ina219_sim_run_async( dev, segs, 2, done, ctx );
+}
+
+static EMBEDD_RESULT ina219_sim_bus_transfer(const embedd_device_t* dev, const embedd_bus_seg_t* segs, uint32_t segs_num) {
+    return ina219_sim_run( dev, segs, segs_num );
+}
+
+// the data changed hands when the transfer started, an abort only drops the completion
+static EMBEDD_RESULT ina219_sim_bus_abort(const embedd_device_t* dev) {
+    (void)dev;
+    ina219_sim_state.busy = false;
+    ina219_sim_state.done = NULL;
+    return EMBEDD_RESULT_OK;
+}
+
+embedd_bus_t ina219_sim_bus = {
+  .write       = ina219_sim_bus_write,
+  .read        = ina219_sim_bus_read,
+  .write_async = ina219_sim_bus_write_async,
+  .read_async  = ina219_sim_bus_read_async,
+  .write_read  = ina219_sim_bus_write_read,
+  .transfer    = ina219_sim_bus_transfer,
+  .write_read_async = ina219_sim_bus_write_read_async,
+  .abort       = ina219_sim_bus_abort,
+};
+
+/* --------------------------------------------------------------------------
+ * Devices and time
+ * -------------------------------------------------------------------------- */
+
+void ina219_sim_init(ina219_sim_t* sim, uint8_t addr, uint32_t shunt_uohm, uint64_t seed) {
+    *sim = (ina219_sim_t){ .addr = addr, .shunt_uohm = shunt_uohm, .rng = seed != 0 ? seed : 1U };
+    ina219_sim_power_on( sim );
+    ina219_sim_start( sim, ina219_sim_state.now, 0 );
+}
+
+EMBEDD_RESULT ina219_sim_attach(ina219_sim_t* sim) {
+    if( sim == NULL || sim->addr < INA219_SIM_ADDR_FIRST || sim->addr > INA219_SIM_ADDR_LAST ||
+        ina219_sim_find( sim->addr ) != NULL ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    sim->next = ina219_sim_state.devices;
+    ina219_sim_state.devices = sim;
+    return EMBEDD_RESULT_OK;
+}
+
+void ina219_sim_detach(ina219_sim_t* sim) {
+    for( ina219_sim_t** link = &ina219_sim_state.devices; *link != NULL; link = &(*link)->next ) {
+      if( *link == sim ) {
+        *link = sim->next;
+        sim->next = NULL;
+        return;
+      }
+    }
+}
+
+void ina219_sim_reset(void) {
+    ina219_sim_state.devices = NULL;
+    ina219_sim_state.now = 0;
+    ina219_sim_state.hz = INA219_SIM_BUS_HZ;
+    ina219_sim_state.timeout_us = INA219_SIM_TIMEOUT_US;
+    ina219_sim_state.busy = false;
+}
+
+void ina219_sim_set_bus_hz(uint32_t hz) {
+    if( hz != 0 ) {
+      ina219_sim_state.hz = hz;
+    }
+}
+
+void ina219_sim_set_timeout_us(uint32_t timeout_us) {
+    ina219_sim_state.timeout_us = timeout_us;
+}
+
+uint64_t ina219_sim_now_us(void) {
+    return ina219_sim_state.now;
+}
+
+void ina219_sim_advance(uint64_t us) {
+    uint64_t until = ina219_sim_state.now + us;
+    // a callback may start the next transfer, which can end within the time too
+    while( ina219_sim_state.busy && ina219_sim_state.done_at <= until ) {
+      ina219_sim_state.now = ina219_sim_state.done_at;
+      ina219_sim_state.busy = false;
+      ina219_sim_state.done( ina219_sim_state.ctx, ina219_sim_state.result );
+    }
+    ina219_sim_state.now = until;
+}
+
+bool ina219_sim_idle(void) {
+    return !ina219_sim_state.busy;
+}
+
+void ina219_sim_inject(ina219_sim_t* sim, ina219_sim_fault_t fault, uint32_t count) {
+    if( sim != NULL && fault < INA219_SIM_FAULTS ) {
+      sim->fault_next[fault] = count;
+    }
+}
+
+void ina219_sim_get_stats(ina219_sim_t* sim, ina219_sim_stats_t* stats, bool reset) {
+    ina219_sim_update( sim, ina219_sim_state.now );
+    *stats = sim->stats;
+    if( reset ) {
+      sim->stats = (ina219_sim_stats_t){ 0 };
+    }
+}
+
+#if INA219_SIM_HAL
+
+uint32_t embedd_hal_get_us(void) {
+    return (uint32_t)ina219_sim_state.now;
+}
+
+void embedd_hal_sleep(uint32_t mseconds) {
+    ina219_sim_advance( (uint64_t)mseconds * 1000U );
+}
+
+void embedd_hal_sleep_us(uint32_t useconds) {
+    ina219_sim_advance( useconds );
+}
+
+#endif
@@ -0,0 +1,350 @@
+/*!
+ * \file ina219_sim.h
+ * \brief Behavioral model of the INA219 on a simulated I2C bus, for host builds
+ *
+ * \ref ina219_sim_bus is an embedd_bus_t: a device object bound to it talks to
+ * the simulated INA219 registered at the address of its I2C configuration,
+ * any other address NACKs. The model keeps the register file with the
+ * register pointer of the device, so a read returns the register the last
+ * write pointed to, and the reset bit, the read-only registers and bit 0 of
+ * the calibration register behave as in the datasheet. Conversions take the
+ * typical time of the SADC, BADC and MODE settings, averaging samples the
+ * input over the whole conversion; at the end of a cycle the shunt and bus
+ * voltages, current and power are latched, CNVR is set and OVF tells an out
+ * of range current or power. Reading the power register or writing the
+ * configuration clears CNVR.
+ *
+ * Time is virtual. Every transfer takes the wire time of its bytes at the
+ * bus clock and \ref ina219_sim_advance moves the clock on; unless
+ * INA219_SIM_HAL is 0 the model also provides embedd_hal_get_us and the
+ * sleep functions of embedd_hal.h on top of it, so a driver polling or
+ * waiting for a conversion runs in simulated time. Asynchronous transfers
+ * complete, and call their done callback, when the clock passes their end.
+ *
+ * The model is not thread safe, all devices share one bus and one clock.
+ */
+#ifndef _TOOLS_INA219_SIM_H
+#define _TOOLS_INA219_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "embedd_hal.h"
+
+/*!
+ * \def INA219_SIM_HAL
+ * \brief Non-zero to implement embedd_hal_get_us, embedd_hal_sleep and
+ * embedd_hal_sleep_us with the simulated clock, overriding the weak defaults
+ * of embedd_hal.c
+ */
+#ifndef INA219_SIM_HAL
+#define INA219_SIM_HAL 1
+#endif
+
+/*!
+ * \def INA219_SIM_BUS_HZ
+ * \brief Default clock of the simulated I2C bus
+ */
+#define INA219_SIM_BUS_HZ 400000U
+
+/*!
+ * \def INA219_SIM_TIMEOUT_US
+ * \brief Default time a transfer hangs before an injected timeout fails it,
+ * the timeout of the HAL transfers of the firmware
+ */
+#define INA219_SIM_TIMEOUT_US 100000U
+
+/*!
+ * \def INA219_SIM_WAKEUP_US
+ * \brief Time the device needs to leave power-down before it converts
+ */
+#define INA219_SIM_WAKEUP_US 40U
+
+/*!
+ * \enum ina219_sim_shape_t
+ * \brief Shape of a simulated input
+ *
+ * \var INA219_SIM_DC      constant offset
+ * \var INA219_SIM_SINE    sine of amplitude around offset
+ * \var INA219_SIM_SQUARE  offset + amplitude in the first half of the period, offset - amplitude in the second
+ * \var INA219_SIM_RAMP    rises from offset - amplitude to offset + amplitude over the period
+ * \var INA219_SIM_FUNC    value returned by the function of the waveform
+ */
+typedef enum {
+  INA219_SIM_DC = 0,
+  INA219_SIM_SINE,
+  INA219_SIM_SQUARE,
+  INA219_SIM_RAMP,
+  INA219_SIM_FUNC,
+} ina219_sim_shape_t;
+
+/*!
+ * \enum ina219_sim_fault_t
+ * \brief Faults injected into the transfers of a device
+ *
+ * \var INA219_SIM_FAULT_NACK     the device does not acknowledge its address
+ * \var INA219_SIM_FAULT_TIMEOUT  the device holds the bus until the transfer times out
+ */
+typedef enum {
+  INA219_SIM_FAULT_NACK = 0,
+  INA219_SIM_FAULT_TIMEOUT,
+  INA219_SIM_FAULTS,
+} ina219_sim_fault_t;
+
+/*!
+ * \typedef ina219_sim_func_t
+ * \brief Input of an INA219_SIM_FUNC waveform
+ *
+ * \param t_us time in microseconds since the simulation started
+ * \param ctx context pointer of the waveform
+ *
+ * \return double value of the input, in the unit of the waveform
+ */
+typedef double (*ina219_sim_func_t)(uint64_t t_us, void* ctx);
+
+/*!
+ * \struct ina219_sim_wave_t
+ * \brief Waveform of a simulated input
+ *
+ * \var shape      ina219_sim_shape_t
+ * \var offset     mean value
+ * \var amplitude  peak deviation from offset
+ * \var period_us  period of the sine, square and ramp shapes
+ * \var noise      standard deviation of the gaussian noise added to every
+ *                 sample the ADC takes, 0 for none
+ * \var func       input of INA219_SIM_FUNC, offset is added
+ * \var ctx        context pointer passed to func
+ */
+typedef struct {
+  uint8_t  shape;
+  int32_t  offset;
+  int32_t  amplitude;
+  uint32_t period_us;
+  uint32_t noise;
+  ina219_sim_func_t func;
+  void*    ctx;
+} ina219_sim_wave_t;
+
+/*!
+ * \struct ina219_sim_stats_t
+ * \brief Statistics of a simulated device
+ *
+ * \var transfers    transactions addressed to the device, failed ones included
+ * \var bytes        bytes moved after the address byte
+ * \var bus_us       time the transactions held the bus
+ * \var nacks        transactions failed by an injected NACK
+ * \var timeouts     transactions failed by an injected timeout
+ * \var conversions  conversion cycles completed
+ * \var overwritten  conversions latched while CNVR was still set, their
+ *                   predecessor was never read completely
+ * \var resets       resets through the RST bit
+ */
+typedef struct {
+  uint32_t transfers;
+  uint32_t bytes;
+  uint64_t bus_us;
+  uint32_t nacks;
+  uint32_t timeouts;
+  uint32_t conversions;
+  uint32_t overwritten;
+  uint32_t resets;
+} ina219_sim_stats_t;
+
+/*!
+ * \struct ina219_sim_t
+ * \brief State of one simulated INA219
+ *
+ * The waveforms, the shunt, the clock error and the fault rates may be
+ * changed at any time, they take effect with the next conversion or transfer.
+ *
+ * \var addr          7-bit I2C address
+ * \var shunt_uohm    shunt resistance in microohms
+ * \var current       current through the shunt in microamperes
+ * \var bus           voltage at IN- against ground in millivolts
+ * \var clock_ppm     deviation of the device's clock, stretches all conversion times
+ * \var fault_ppm     probability of every fault per transaction, in parts per million
+ * \var fault_next    number of the following transactions failing with each fault
+ * \var regs          register file, 00h to 05h
+ * \var ptr           register pointer
+ * \var cnvr          conversion ready flag
+ * \var ovf           math overflow flag
+ * \var converting    non-zero while a conversion cycle runs
+ * \var cycle_start   start of the running conversion cycle
+ * \var cycle_end     end of the running conversion cycle
+ * \var rng           state of the noise generator
+ * \var stats         statistics
+ * \var next          next device on the bus
+ */
+typedef struct ina219_sim_t {
+  uint8_t  addr;
+  uint32_t shunt_uohm;
+  ina219_sim_wave_t current;
+  ina219_sim_wave_t bus;
+  int32_t  clock_ppm;
+  uint32_t fault_ppm[INA219_SIM_FAULTS];
+  uint32_t fault_next[INA219_SIM_FAULTS];
+  uint16_t regs[6];
+  uint8_t  ptr;
+  uint8_t  cnvr;
+  uint8_t  ovf;
+  uint8_t  converting;
+  uint64_t cycle_start;
+  uint64_t cycle_end;
+  uint64_t rng;
+  ina219_sim_stats_t stats;
+  struct ina219_sim_t* next;
+} ina219_sim_t;
+
+/*!
+ * \var ina219_sim_bus
+ * \brief The simulated I2C bus, with the synchronous, asynchronous, combined
+ * and abort functions of embedd_bus_t
+ */
+extern embedd_bus_t ina219_sim_bus;
+
+/*!
+ * ina219_sim_init
+ *
+ * \brief Powers a device up: default registers, pointer at the configuration
+ * register and the first conversion running. The inputs are 0 mA and 0 V.
+ *
+ * \param sim pointer to ina219_sim_t the device
+ * \param addr uint8_t 7-bit I2C address, 0x40 to 0x4F
+ * \param shunt_uohm uint32_t shunt resistance in microohms
+ * \param seed uint64_t seed of the noise generator
+ */
+void ina219_sim_init(ina219_sim_t* sim, uint8_t addr, uint32_t shunt_uohm, uint64_t seed);
+
+/*!
+ * ina219_sim_attach
+ *
+ * \brief Connects a device to the bus.
+ *
+ * \param sim pointer to ina219_sim_t an initialized device
+ *
+ * \return EMBEDD_RESULT EMBEDD_RESULT_ERR if the address is not one of the
+ * INA219 or already taken, othewise EMBEDD_RESULT_OK
+ */
+EMBEDD_RESULT ina219_sim_attach(ina219_sim_t* sim);
+
+/*!
+ * ina219_sim_detach
+ *
+ * \brief Disconnects a device, its address NACKs afterwards.
+ *
+ * \param sim pointer to ina219_sim_t the device
+ */
+void ina219_sim_detach(ina219_sim_t* sim);
+
+/*!
+ * ina219_sim_reset
+ *
+ * \brief Disconnects all devices, drops a running asynchronous transfer
+ * without calling its callback and restarts the clock at 0 with the default
+ * bus clock and timeout.
+ */
+void ina219_sim_reset(void);
+
+/*!
+ * ina219_sim_set_bus_hz
+ *
+ * \brief Sets the clock of the bus the wire time of the transfers derives from.
+ *
+ * \param hz uint32_t bus clock, e.g. 100000, 400000 or 1000000
+ */
+void ina219_sim_set_bus_hz(uint32_t hz);
+
+/*!
+ * ina219_sim_set_timeout_us
+ *
+ * \brief Sets the time a transfer failed by INA219_SIM_FAULT_TIMEOUT takes.
+ *
+ * \param timeout_us uint32_t time in microseconds
+ */
+void ina219_sim_set_timeout_us(uint32_t timeout_us);
+
+/*!
+ * ina219_sim_now_us
+ *
+ * \return uint64_t the simulated time in microseconds
+ */
+uint64_t ina219_sim_now_us(void);
+
+/*!
+ * ina219_sim_advance
+ *
+ * \brief Moves the clock on. An asynchronous transfer ending within the time
+ * completes and its done callback is called, at the end of the transfer as an
+ * interrupt would.
+ *
+ * \param us uint64_t time in microseconds
+ */
+void ina219_sim_advance(uint64_t us);
+
+/*!
+ * ina219_sim_idle
+ *
+ * \return bool true when no asynchronous transfer is running
+ */
+bool ina219_sim_idle(void);
+
+/*!
+ * ina219_sim_inject
+ *
+ * \brief Fails the next transactions of a device.
+ *
+ * \param sim pointer to ina219_sim_t the device
+ * \param fault ina219_sim_fault_t the fault
+ * \param count uint32_t number of transactions, 0 to cancel
+ */
+void ina219_sim_inject(ina219_sim_t* sim, ina219_sim_fault_t fault, uint32_t count);
+
+/*!
+ * ina219_sim_peek
+ *
+ * \brief Reads a register as the device would, without a transfer, the register
+ * pointer or clearing CNVR. Conversions completed by now are latched first.
+ *
+ * \param sim pointer to ina219_sim_t the device
+ * \param reg uint8_t register address
+ *
+ * \return uint16_t the register, 0 for an address the device does not have
+ */
+uint16_t ina219_sim_peek(ina219_sim_t* sim, uint8_t reg);
+
+/*!
+ * ina219_sim_conversion_us
+ *
+ * \brief Conversion cycle time of a configuration on a device, with its clock error.
+ *
+ * \param sim pointer to ina219_sim_t the device
+ * \param configuration uint16_t configuration register value
+ *
+ * \return uint32_t time in microseconds, 0 if the mode does not convert
+ */
+uint32_t ina219_sim_conversion_us(const ina219_sim_t* sim, uint16_t configuration);
+
+/*!
+ * ina219_sim_wave_value
+ *
+ * \brief Noise free value of a waveform.
+ *
+ * \param wave pointer to ina219_sim_wave_t the waveform
+ * \param t_us uint64_t time in microseconds
+ *
+ * \return double the value
+ */
+double ina219_sim_wave_value(const ina219_sim_wave_t* wave, uint64_t t_us);
+
+/*!
+ * ina219_sim_get_stats
+ *
+ * \brief Returns the statistics of a device.
+ *
+ * \param sim pointer to ina219_sim_t the device
+ * \param stats pointer to ina219_sim_stats_t receiving the statistics
+ * \param reset bool true to clear the statistics
+ */
+void ina219_sim_get_stats(ina219_sim_t* sim, ina219_sim_stats_t* stats, bool reset);
+
+#endif//_TOOLS_INA219_SIM_H
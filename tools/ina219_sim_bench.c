@@ -0,0 +1,206 @@
+/*!
+ * \file ina219_sim_bench.c
+ * \brief Host benchmark of the INA219 driver against the simulated device
+ *
+ * Polls a simulated INA219 with ina219_poll for every combination of bus
+ * clock and ADC setting and prints, per run, the conversions the device
+ * made, how many of them the driver read, how many reads found no new
+ * conversion or straddled two, how busy the bus was, the mean and standard
+ * deviation of the current read against the noisy 400 mA input, and the host
+ * time per sample. A last run fails one in every 1000000 / -f transactions,
+ * every tenth of them with a timeout and the others with a NACK, and shows
+ * how many faults the driver recovered from, reading a new conversion after
+ * them, and how long that took at worst. The program exits with 1 when it did
+ * not recover from all of them.
+ *
+ * Build and run from the repository root:
+ *
+ *   D=INA219-CubeIDE/Drivers/ina219
+ *   gcc -O2 -I$D -Itools tools/ina219_sim_bench.c tools/ina219_sim.c \
+ *       $D/ina219.c $D/ina219_registers.c $D/ina219_shadow.c $D/ina219_snapshot.c \
+ *       $D/ina219_calibrate.c $D/ina219_convert.c $D/ina219_poll.c \
+ *       $D/embedd_i2c.c $D/embedd_hal.c $D/embedd_utils.c -lm -o ina219_sim_bench
+ *   ./ina219_sim_bench [-s simulated seconds per run] [-f fault ppm]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ina219.h"
+#include "ina219_sim.h"
+
+#define BENCH_ADDR       0x40
+#define BENCH_SHUNT_UOHM 100000    // 0.1 Ohm as on the breakout boards
+#define BENCH_CURRENT_UA 400000
+#define BENCH_MAX_UA     1000000
+
+INA219_I2C_DEVICE_DEFINE(bench_sensor, "INA219 sim")
+
+static double bench_seconds = 2.0;
+static uint32_t bench_fault_ppm = 10000U;
+static ina219_sim_t bench_sim;
+
+typedef struct {
+  uint32_t samples;
+  double   sum;
+  double   sum_sq;
+  ina219_poll_stats_t poll;
+  ina219_sim_stats_t sim;
+  double   host_us;
+  uint32_t faults;
+  uint32_t recovered;
+  uint64_t recovery_us;
+} bench_result_t;
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// a powered-up device with the input, the driver synchronized to it and calibrated
+static int bench_setup(uint32_t bus_hz, uint8_t adc, ina219_scale_t* scale) {
+    ina219_sim_reset();
+    ina219_sim_set_bus_hz( bus_hz );
+    ina219_sim_init( &bench_sim, BENCH_ADDR, BENCH_SHUNT_UOHM, 1 );
+    bench_sim.current = (ina219_sim_wave_t){ .shape = INA219_SIM_DC, .offset = BENCH_CURRENT_UA, .noise = 5000 };
+    bench_sim.bus = (ina219_sim_wave_t){ .shape = INA219_SIM_DC, .offset = 12000, .noise = 20 };
+    // a device clock 1.5 % slow, for the poll module to measure
+    bench_sim.clock_ppm = 15000;
+    if( ina219_sim_attach( &bench_sim ) != EMBEDD_RESULT_OK ) {
+      return -1;
+    }
+
+    embedd_i2c_dev_cfg_t i2c_cfg = { .addr = BENCH_ADDR };
+    embedd_i2c_set_dev_config( &bench_sensor, &i2c_cfg );
+    bench_sensor.bus = &ina219_sim_bus;
+    ina219_reg_ptr_invalidate( &bench_sensor );
+    if( ina219_check_device( &bench_sensor ) != EMBEDD_RESULT_OK ||
+        ina219_shadow_resync( &bench_sensor ) != EMBEDD_RESULT_OK ) {
+      return -1;
+    }
+    ina219_calibrate_t cal;
+    if( ina219_calibrate_solve( BENCH_SHUNT_UOHM, BENCH_MAX_UA, INA219_CONFIGURATION_BRNG_EQ_16V_FSR_DEFAULT_VALUE, &cal ) != EMBEDD_RESULT_OK ||
+        ina219_calibrate_apply( &bench_sensor, &cal, scale ) != EMBEDD_RESULT_OK ) {
+      return -1;
+    }
+    ina219_shadow_set_sadc( &bench_sensor, adc );
+    ina219_shadow_set_badc( &bench_sensor, adc );
+    return ina219_shadow_commit( &bench_sensor ) == EMBEDD_RESULT_OK ? 0 : -1;
+}
+
+static int bench_run(uint32_t bus_hz, uint8_t adc, uint32_t fault_ppm, bench_result_t* res) {
+    ina219_scale_t scale;
+    ina219_poll_t poll;
+    memset( res, 0, sizeof *res );
+    if( bench_setup( bus_hz, adc, &scale ) != 0 || ina219_poll_init( &poll, &bench_sensor ) != EMBEDD_RESULT_OK ) {
+      return -1;
+    }
+    ina219_sim_get_stats( &bench_sim, &res->sim, true );
+    uint64_t end = ina219_sim_now_us() + (uint64_t)( bench_seconds * 1e6 );
+    // faults at a fixed spacing, none in the last tenth of the run so the driver can recover from all
+    uint64_t faults_end = end - (uint64_t)( bench_seconds * 1e5 );
+    uint32_t fault_every = fault_ppm != 0U ? 1000000U / fault_ppm : 0U;
+    uint32_t next_fault = fault_every;
+    uint32_t pending = 0;
+    uint64_t pending_since = 0;
+    double t0 = bench_now();
+    while( ina219_sim_now_us() < end ) {
+      if( fault_every != 0U && bench_sim.stats.transfers >= next_fault && ina219_sim_now_us() < faults_end ) {
+        res->faults++;
+        ina219_sim_inject( &bench_sim, res->faults % 10U == 0U ? INA219_SIM_FAULT_TIMEOUT : INA219_SIM_FAULT_NACK, 1 );
+        next_fault = bench_sim.stats.transfers + fault_every;
+        if( pending++ == 0U ) {
+          pending_since = ina219_sim_now_us();
+        }
+      }
+      ina219_sample_t sample;
+      ina219_measurement_t meas;
+      bool ready = false;
+      if( ina219_poll_process( &poll, &sample, &ready ) != EMBEDD_RESULT_OK ) {
+        // a failed read is retried after the retry delay
+        embedd_hal_sleep_us( poll.retry_us );
+        continue;
+      }
+      if( ready ) {
+        if( pending != 0U ) {
+          uint64_t recovery_us = ina219_sim_now_us() - pending_since;
+          res->recovery_us = recovery_us > res->recovery_us ? recovery_us : res->recovery_us;
+          res->recovered += pending;
+          pending = 0;
+        }
+        ina219_convert_sample( &scale, &sample, &meas );
+        res->samples++;
+        res->sum += meas.current_ua;
+        res->sum_sq += (double)meas.current_ua * meas.current_ua;
+      }
+      embedd_hal_sleep_us( ina219_poll_wait_us( &poll ) );
+    }
+    res->host_us = bench_now() - t0;
+    ina219_poll_get_stats( &poll, &res->poll, false );
+    ina219_sim_get_stats( &bench_sim, &res->sim, false );
+    return 0;
+}
+
+static void bench_print(const char* name, uint32_t bus_hz, const bench_result_t* res) {
+    double mean = res->samples ? res->sum / res->samples : 0.0;
+    double var = res->samples ? res->sum_sq / res->samples - mean * mean : 0.0;
+    printf("%-11s %5lu kHz %7lu %7lu %6lu %5lu %6lu %5.1f %% %9.0f %7.0f %7.2f\n",
+           name, (unsigned long)( bus_hz / 1000U ), (unsigned long)res->sim.conversions,
+           (unsigned long)res->poll.fresh, (unsigned long)res->poll.stale, (unsigned long)res->poll.torn,
+           (unsigned long)res->sim.overwritten, 100.0 * res->sim.bus_us / ( bench_seconds * 1e6 ),
+           mean - BENCH_CURRENT_UA, sqrt( var > 0.0 ? var : 0.0 ),
+           res->samples ? res->host_us / res->samples : 0.0);
+}
+
+int main(int argc, char** argv) {
+    for( int i = 1; i + 1 < argc; i += 2 ) {
+      if( strcmp( argv[i], "-s" ) == 0 ) {
+        bench_seconds = strtod( argv[i + 1], NULL );
+      } else if( strcmp( argv[i], "-f" ) == 0 ) {
+        bench_fault_ppm = (uint32_t)strtoul( argv[i + 1], NULL, 0 );
+      }
+    }
+    if( bench_seconds <= 0.0 ) {
+      fprintf(stderr, "usage: %s [-s simulated seconds per run] [-f fault ppm]\n", argv[0]);
+      return 1;
+    }
+
+    static const struct { const char* name; uint8_t adc; } adcs[] = {
+      { "9 bit", INA219_CONFIGURATION_SADC_9_BIT },
+      { "12 bit", INA219_CONFIGURATION_SADC_12_BIT_DEFAULT },
+      { "16 samples", INA219_CONFIGURATION_SADC_16_SAMPLES },
+      { "128 samples", INA219_CONFIGURATION_SADC_128_SAMPLES },
+    };
+    static const uint32_t bus_hz[] = { 100000U, 400000U, 1000000U };
+    bench_result_t res;
+
+    printf("%-11s %9s %7s %7s %6s %5s %6s %7s %9s %7s %7s\n", "ADC", "bus", "conv", "read", "stale",
+           "torn", "missed", "busy", "mean uA", "sd uA", "host us");
+    for( size_t i = 0; i < sizeof adcs / sizeof adcs[0]; i++ ) {
+      for( size_t j = 0; j < sizeof bus_hz / sizeof bus_hz[0]; j++ ) {
+        if( bench_run( bus_hz[j], adcs[i].adc, 0, &res ) != 0 ) {
+          fprintf(stderr, "%s at %lu Hz: the driver failed to set the device up\n", adcs[i].name, (unsigned long)bus_hz[j]);
+          return 1;
+        }
+        bench_print( adcs[i].name, bus_hz[j], &res );
+      }
+    }
+
+    // faults from the first read on, the set up runs without them
+    if( bench_run( 400000U, INA219_CONFIGURATION_SADC_12_BIT_DEFAULT, bench_fault_ppm, &res ) != 0 ) {
+      fprintf(stderr, "fault run: the driver failed to set the device up\n");
+      return 1;
+    }
+    printf("\nOne fault every %lu transfers, 12 bit at 400 kHz:\n",
+           (unsigned long)( bench_fault_ppm != 0U ? 1000000U / bench_fault_ppm : 0U ));
+    printf("  %lu transfers, %lu NACKs, %lu timeouts, %lu failed reads, %lu of %lu conversions read\n",
+           (unsigned long)res.sim.transfers, (unsigned long)res.sim.nacks, (unsigned long)res.sim.timeouts,
+           (unsigned long)res.poll.errors, (unsigned long)res.samples, (unsigned long)res.sim.conversions);
+    printf("  recovered from %lu of %lu faults, at worst after %lu us\n",
+           (unsigned long)res.recovered, (unsigned long)res.faults, (unsigned long)res.recovery_us);
+    return res.recovered == res.faults ? 0 : 1;
+}
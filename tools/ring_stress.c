@@ -0,0 +1,206 @@
+/*!
+ * \file ring_stress.c
+ * \brief Host stress test of embedd_ring with a producer and a consumer thread
+ *
+ * A producer thread pushes numbered records and a consumer thread pops
+ * them, checking that every record arrives whole and in order. Three runs
+ * are made on a ring of BENCH_CAPACITY records:
+ *
+ *   burst     the producer pushes a full ring and waits for it to drain,
+ *             so it never exceeds the capacity: no record may be lost and
+ *             no push may fail
+ *   blocking  the producer retries a failed push: no record may be lost,
+ *             the overflow counter equals the failed pushes
+ *   lossy     the producer drops a record whose push failed and yields
+ *             after every push, the consumer twice after every pop: the
+ *             records received and the drops add up to the records
+ *             pushed, the overflow counter equals the drops and a ring
+ *             that overflowed was full
+ *
+ * The high-water mark never exceeds the capacity. The program prints the
+ * counts and the rate of each run and exits with 1 if a check fails. Build
+ * with -fsanitize=thread as well to have the memory ordering checked.
+ *
+ * Build and run from the repository root:
+ *
+ *   D=INA219-CubeIDE/Drivers/ina219
+ *   gcc -O2 -pthread -I$D tools/ring_stress.c $D/embedd_ring.c $D/embedd_hal.c -o ring_stress
+ *   ./ring_stress [-n records per run]
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "embedd_ring.h"
+
+#define BENCH_CAPACITY 64U
+
+// a record the size of a sample, the payload is derived from the sequence number
+typedef struct {
+  uint32_t seq;
+  uint32_t payload[5];
+} bench_record_t;
+
+EMBEDD_RING_DEFINE(bench_ring, bench_record_t, BENCH_CAPACITY)
+
+typedef enum {
+  BENCH_BURST = 0,
+  BENCH_BLOCKING,
+  BENCH_LOSSY,
+} bench_mode_t;
+
+static uint32_t bench_records = 1000000U;
+static bench_mode_t bench_mode;
+static volatile int bench_done;
+
+static struct {
+  uint32_t failed;
+  uint32_t dropped;
+} bench_producer_stats;
+
+static struct {
+  uint32_t received;
+  uint32_t out_of_order;
+  uint32_t corrupt;
+} bench_consumer_stats;
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench_fill(bench_record_t* rec, uint32_t seq) {
+    rec->seq = seq;
+    for( uint32_t i = 0; i < 5U; i++ ) {
+      rec->payload[i] = seq * 2654435761U + i;
+    }
+}
+
+static void* bench_producer(void* arg) {
+    (void)arg;
+    bench_record_t rec;
+    for( uint32_t seq = 0; seq < bench_records; seq++ ) {
+      bench_fill( &rec, seq );
+      if( bench_mode == BENCH_BURST && ( seq % BENCH_CAPACITY ) == 0 ) {
+        // the next burst only starts on an empty ring
+        while( embedd_ring_count( &bench_ring ) != 0 ) {
+          sched_yield();
+        }
+      }
+      while( embedd_ring_push( &bench_ring, &rec ) != EMBEDD_RESULT_OK ) {
+        bench_producer_stats.failed++;
+        if( bench_mode == BENCH_LOSSY ) {
+          bench_producer_stats.dropped++;
+          break;
+        }
+        sched_yield();
+      }
+      if( bench_mode == BENCH_LOSSY ) {
+        sched_yield();
+      }
+    }
+    __atomic_store_n( &bench_done, 1, __ATOMIC_RELEASE );
+    return NULL;
+}
+
+static void* bench_consumer(void* arg) {
+    (void)arg;
+    bench_record_t rec;
+    bench_record_t expect;
+    uint32_t next = 0;
+    for( ;; ) {
+      if( !embedd_ring_pop( &bench_ring, &rec ) ) {
+        // the producer's last push is visible before its done flag
+        if( __atomic_load_n( &bench_done, __ATOMIC_ACQUIRE ) && embedd_ring_count( &bench_ring ) == 0 ) {
+          break;
+        }
+        sched_yield();
+        continue;
+      }
+      bench_consumer_stats.received++;
+      bench_fill( &expect, rec.seq );
+      if( memcmp( &rec, &expect, sizeof rec ) != 0 ) {
+        bench_consumer_stats.corrupt++;
+      }
+      // a lossy run skips sequence numbers, every run must keep them increasing
+      if( rec.seq < next || ( bench_mode != BENCH_LOSSY && rec.seq != next ) ) {
+        bench_consumer_stats.out_of_order++;
+      }
+      next = rec.seq + 1U;
+      if( bench_mode == BENCH_LOSSY ) {
+        // half the rate of the producer, which yields once per record
+        sched_yield();
+        sched_yield();
+      }
+    }
+    return NULL;
+}
+
+static int bench_run(const char* name, bench_mode_t mode) {
+    bench_mode = mode;
+    bench_done = 0;
+    memset( &bench_producer_stats, 0, sizeof bench_producer_stats );
+    memset( &bench_consumer_stats, 0, sizeof bench_consumer_stats );
+    bench_ring.head = 0;
+    bench_ring.tail = 0;
+    bench_ring.high_water = 0;
+    bench_ring.overflows = 0;
+
+    pthread_t producer, consumer;
+    double t0 = bench_now();
+    if( pthread_create( &consumer, NULL, bench_consumer, NULL ) != 0 ||
+        pthread_create( &producer, NULL, bench_producer, NULL ) != 0 ) {
+      fprintf(stderr, "%s: cannot start the threads\n", name);
+      return -1;
+    }
+    pthread_join( producer, NULL );
+    pthread_join( consumer, NULL );
+    double t1 = bench_now();
+
+    embedd_ring_stats_t stats;
+    embedd_ring_get_stats( &bench_ring, &stats, false );
+    uint32_t lost = bench_records - bench_consumer_stats.received - bench_producer_stats.dropped;
+    bool ok = lost == 0 && bench_consumer_stats.out_of_order == 0 && bench_consumer_stats.corrupt == 0 &&
+              stats.count == 0 && stats.high_water <= stats.capacity && stats.overflows == bench_producer_stats.failed;
+    if( mode != BENCH_LOSSY ) {
+      ok = ok && bench_consumer_stats.received == bench_records;
+    } else {
+      ok = ok && stats.overflows == bench_producer_stats.dropped && ( stats.overflows == 0 || stats.high_water == stats.capacity );
+    }
+    if( mode == BENCH_BURST ) {
+      ok = ok && stats.overflows == 0 && stats.high_water <= BENCH_CAPACITY;
+    }
+    printf("%-9s %10lu %10lu %8lu %8lu %6lu %6lu %9lu %8.2f  %s\n", name,
+           (unsigned long)bench_consumer_stats.received, (unsigned long)bench_producer_stats.dropped, (unsigned long)lost,
+           (unsigned long)bench_consumer_stats.out_of_order, (unsigned long)bench_consumer_stats.corrupt,
+           (unsigned long)stats.high_water, (unsigned long)stats.overflows,
+           bench_consumer_stats.received * 1e3 / ( t1 - t0 ), ok ? "ok" : "FAILED");
+    return ok ? 0 : -1;
+}
+
+int main(int argc, char** argv) {
+    for( int i = 1; i + 1 < argc; i += 2 ) {
+      if( strcmp( argv[i], "-n" ) == 0 ) {
+        bench_records = (uint32_t)strtoul( argv[i + 1], NULL, 0 );
+      }
+    }
+    if( bench_records == 0 ) {
+      fprintf(stderr, "usage: %s [-n records per run]\n", argv[0]);
+      return 1;
+    }
+
+    printf("%lu records of %lu bytes per run, capacity %u\n", (unsigned long)bench_records,
+           (unsigned long)sizeof(bench_record_t), BENCH_CAPACITY);
+    printf("%-9s %10s %10s %8s %8s %6s %6s %9s %8s\n", "run", "received", "dropped", "lost",
+           "order", "torn", "high", "overflow", "Mrec/s");
+    int failed = 0;
+    failed |= bench_run( "burst", BENCH_BURST ) != 0;
+    failed |= bench_run( "blocking", BENCH_BLOCKING ) != 0;
+    failed |= bench_run( "lossy", BENCH_LOSSY ) != 0;
+    return failed;
+}
@@ -0,0 +1,226 @@
+/*!
+ * \file snapshot_bench.c
+ * \brief Host benchmark of ina219_read_snapshot against six separate register reads
+ *
+ * Reads the registers of a simulated INA219 converting shunt and bus
+ * continuously with the ADC setting given by -a, 12 bit by default, once with
+ * the six INA219_READ_REG calls the example used to make and once with
+ * ina219_read_snapshot, and prints the bus transactions and the simulated
+ * microseconds per set of registers. A set starts every -p microseconds, at a
+ * varying phase to the conversions. For the six reads it also counts the sets
+ * in which a conversion completed between the first and the last measurement
+ * register, so shunt, bus, current and power came from two conversions; the
+ * snapshot re-reads those, the retries and the snapshots which fell back to a
+ * triggered conversion are printed. A snapshot whose current and power do not
+ * follow from its shunt and bus voltages is torn, the program exits with 1
+ * if one is or a snapshot fails. Both run on a bus with write_read, where an
+ * address write and a read share one transaction, and on one without, at the
+ * bus clock given by -b.
+ *
+ * Build and run from the repository root:
+ *
+ *   D=INA219-CubeIDE/Drivers/ina219
+ *   gcc -O2 -I$D -Itools tools/snapshot_bench.c tools/ina219_sim.c \
+ *       $D/ina219.c $D/ina219_registers.c $D/ina219_shadow.c $D/ina219_snapshot.c \
+ *       $D/embedd_i2c.c $D/embedd_hal.c $D/embedd_utils.c -lm -o snapshot_bench
+ *   ./snapshot_bench [-n sets per run] [-p microseconds between sets] [-a SADC/BADC value] [-b bus kHz]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ina219.h"
+#include "ina219_sim.h"
+
+#define BENCH_ADDR 0x40
+
+INA219_I2C_DEVICE_DEFINE(bench_sensor, "INA219 sim")
+
+static uint32_t bench_sets = 10000U;
+static uint32_t bench_period_us = 2500U;
+static uint32_t bench_adc = INA219_CONFIGURATION_SADC_12_BIT_DEFAULT;
+static uint32_t bench_bus_hz = 400000U;
+static ina219_sim_t bench_sim;
+static embedd_bus_t bench_bus_split;
+
+typedef struct {
+  uint32_t transfers;
+  uint64_t us;
+  uint32_t torn;
+  uint32_t retries;
+  uint32_t triggered;
+} bench_result_t;
+
+// the time a set took is counted, the rest of the period is waited for
+static void bench_pace(uint64_t start, bench_result_t* res) {
+    uint64_t took = ina219_sim_now_us() - start;
+    res->us += took;
+    if( took < bench_period_us ) {
+      embedd_hal_sleep_us( (uint32_t)( bench_period_us - took ) );
+    }
+}
+
+static int bench_setup(const embedd_bus_t* bus) {
+    ina219_sim_reset();
+    ina219_sim_set_bus_hz( bench_bus_hz );
+    ina219_sim_init( &bench_sim, BENCH_ADDR, 100000U, 1 );
+    bench_sim.current = (ina219_sim_wave_t){ .shape = INA219_SIM_DC, .offset = 400000, .noise = 5000 };
+    bench_sim.bus = (ina219_sim_wave_t){ .shape = INA219_SIM_DC, .offset = 12000 };
+    if( ina219_sim_attach( &bench_sim ) != EMBEDD_RESULT_OK ) {
+      return -1;
+    }
+    embedd_i2c_dev_cfg_t i2c_cfg = { .addr = BENCH_ADDR };
+    embedd_i2c_set_dev_config( &bench_sensor, &i2c_cfg );
+    bench_sensor.bus = (embedd_bus_t*)bus;
+    ina219_reg_ptr_invalidate( &bench_sensor );
+    ((ina219_data_t*)bench_sensor.data)->snapshot_retries = 0;
+    ((ina219_data_t*)bench_sensor.data)->snapshot_triggered = 0;
+    if( ina219_check_device( &bench_sensor ) != EMBEDD_RESULT_OK ||
+        ina219_shadow_resync( &bench_sensor ) != EMBEDD_RESULT_OK ) {
+      return -1;
+    }
+    // a calibration of 4096 makes the current register equal the shunt voltage register
+    ina219_shadow_set_sadc( &bench_sensor, (uint8_t)bench_adc );
+    ina219_shadow_set_badc( &bench_sensor, (uint8_t)bench_adc );
+    ina219_shadow_set_calibration( &bench_sensor, 4096U );
+    if( ina219_shadow_commit( &bench_sensor ) != EMBEDD_RESULT_OK ) {
+      return -1;
+    }
+    // the first conversion with the new setting
+    embedd_hal_sleep_us( 2U * bench_period_us );
+    return 0;
+}
+
+static int bench_six_reads(const embedd_bus_t* bus, bench_result_t* res) {
+    memset( res, 0, sizeof *res );
+    if( bench_setup( bus ) != 0 ) {
+      return -1;
+    }
+    ina219_sim_stats_t stats;
+    ina219_sim_get_stats( &bench_sim, &stats, true );
+    for( uint32_t i = 0; i < bench_sets; i++ ) {
+      uint64_t start = ina219_sim_now_us();
+      ina219_configuration_t configuration;
+      ina219_shunt_voltage_t shunt_voltage;
+      ina219_bus_voltage_t bus_voltage;
+      ina219_power_t power;
+      ina219_current_t current;
+      ina219_calibration_t calibration;
+      if( INA219_READ_REG( bench_sensor, ina219_configuration, configuration ) != EMBEDD_RESULT_OK ||
+          INA219_READ_REG( bench_sensor, ina219_shunt_voltage, shunt_voltage ) != EMBEDD_RESULT_OK ) {
+        return -1;
+      }
+      ina219_sim_get_stats( &bench_sim, &stats, false );
+      uint32_t conversions = stats.conversions;
+      if( INA219_READ_REG( bench_sensor, ina219_bus_voltage, bus_voltage ) != EMBEDD_RESULT_OK ||
+          INA219_READ_REG( bench_sensor, ina219_power, power ) != EMBEDD_RESULT_OK ||
+          INA219_READ_REG( bench_sensor, ina219_current, current ) != EMBEDD_RESULT_OK ) {
+        return -1;
+      }
+      // the shunt voltage was latched before the conversion the others came from
+      ina219_sim_get_stats( &bench_sim, &stats, false );
+      if( stats.conversions != conversions ) {
+        res->torn++;
+      }
+      if( INA219_READ_REG( bench_sensor, ina219_calibration, calibration ) != EMBEDD_RESULT_OK ) {
+        return -1;
+      }
+      bench_pace( start, res );
+    }
+    ina219_sim_get_stats( &bench_sim, &stats, false );
+    res->transfers = stats.transfers;
+    return 0;
+}
+
+// current and power are computed from the shunt and bus voltages of the same conversion
+static bool bench_consistent(const ina219_snapshot_t* snap) {
+    int32_t shunt = (int16_t)ina219_reg_word( &snap->shunt_voltage );
+    int32_t current = (int16_t)ina219_reg_word( &snap->current );
+    uint32_t bus = ina219_bus_voltage_value( ina219_reg_word( &snap->bus_voltage ) );
+    uint32_t power = (uint32_t)( current < 0 ? -current : current ) * bus / 5000U;
+    return current == shunt && ina219_reg_word( &snap->power ) == power;
+}
+
+static int bench_snapshot(const embedd_bus_t* bus, bench_result_t* res) {
+    memset( res, 0, sizeof *res );
+    if( bench_setup( bus ) != 0 ) {
+      return -1;
+    }
+    ina219_sim_stats_t stats;
+    ina219_sim_get_stats( &bench_sim, &stats, true );
+    for( uint32_t i = 0; i < bench_sets; i++ ) {
+      uint64_t start = ina219_sim_now_us();
+      ina219_snapshot_t snap;
+      if( ina219_read_snapshot( &bench_sensor, &snap ) != EMBEDD_RESULT_OK ) {
+        return -1;
+      }
+      if( !bench_consistent( &snap ) ) {
+        res->torn++;
+      }
+      bench_pace( start, res );
+    }
+    ina219_sim_get_stats( &bench_sim, &stats, false );
+    res->transfers = stats.transfers;
+    res->retries = ((ina219_data_t*)bench_sensor.data)->snapshot_retries;
+    res->triggered = ((ina219_data_t*)bench_sensor.data)->snapshot_triggered;
+    return 0;
+}
+
+static void bench_print(const char* name, const char* bus, const bench_result_t* res) {
+    printf("%-10s %-12s %8.2f %8.1f %9.2f %% %9.2f %% %9.2f %%\n", name, bus,
+           (double)res->transfers / bench_sets, (double)res->us / bench_sets,
+           100.0 * res->torn / bench_sets, 100.0 * res->retries / bench_sets,
+           100.0 * res->triggered / bench_sets);
+}
+
+int main(int argc, char** argv) {
+    for( int i = 1; i + 1 < argc; i += 2 ) {
+      if( strcmp( argv[i], "-n" ) == 0 ) {
+        bench_sets = (uint32_t)strtoul( argv[i + 1], NULL, 0 );
+      } else if( strcmp( argv[i], "-p" ) == 0 ) {
+        bench_period_us = (uint32_t)strtoul( argv[i + 1], NULL, 0 );
+      } else if( strcmp( argv[i], "-a" ) == 0 ) {
+        bench_adc = (uint32_t)strtoul( argv[i + 1], NULL, 0 );
+      } else if( strcmp( argv[i], "-b" ) == 0 ) {
+        bench_bus_hz = (uint32_t)strtoul( argv[i + 1], NULL, 0 ) * 1000U;
+      }
+    }
+    if( bench_sets == 0 || bench_adc > 15U || bench_bus_hz == 0 ) {
+      fprintf(stderr, "usage: %s [-n sets per run] [-p microseconds between sets] [-a SADC/BADC value] [-b bus kHz]\n", argv[0]);
+      return 1;
+    }
+
+    // the same bus without write_read, so every address write is a transaction of its own
+    bench_bus_split = ina219_sim_bus;
+    bench_bus_split.write_read = NULL;
+    bench_bus_split.transfer = NULL;
+    bench_bus_split.write_read_async = NULL;
+
+    static const struct { const char* name; const embedd_bus_t* bus; } buses[] = {
+      { "write_read", &ina219_sim_bus },
+      { "write, read", &bench_bus_split },
+    };
+    bench_result_t res;
+    printf("ADC setting %lu, conversion cycle %lu us, bus %lu kHz\n", (unsigned long)bench_adc,
+           (unsigned long)ina219_sim_conversion_us( &bench_sim, (uint16_t)( INA219_CONFIGURATION_MODE_SHUNT_AND_BUS_CONTINUOUS | bench_adc << INA219_CONFIGURATION_BADC_SHIFT | bench_adc << INA219_CONFIGURATION_SADC_SHIFT ) ),
+           (unsigned long)( bench_bus_hz / 1000U ));
+    printf("%-10s %-12s %8s %8s %11s %11s %11s\n", "read", "bus", "txn/set", "us/set", "torn", "retried", "triggered");
+    int failed = 0;
+    for( size_t i = 0; i < sizeof buses / sizeof buses[0]; i++ ) {
+      if( bench_six_reads( buses[i].bus, &res ) != 0 ) {
+        fprintf(stderr, "six reads on %s failed\n", buses[i].name);
+        return 1;
+      }
+      bench_print( "six reads", buses[i].name, &res );
+      if( bench_snapshot( buses[i].bus, &res ) != 0 ) {
+        fprintf(stderr, "snapshot on %s failed\n", buses[i].name);
+        return 1;
+      }
+      bench_print( "snapshot", buses[i].name, &res );
+      if( res.torn != 0 ) {
+        failed = 1;
+      }
+    }
+    return failed;
+}
@@ -0,0 +1,259 @@
+/*!
+ * \file swap_bench.c
+ * \brief Host benchmark of the byte-swapping register path against embedd_pack
+ *
+ * Unpacks 1, 2 and 4 byte big-endian values once with the byte loop of
+ * embedd_pack and once with embedd_pack_fast, then reads registers from a
+ * device held in memory once through a copy of the register read before
+ * the swap, which staged the data in in_buf and copied it out with
+ * embedd_pack, and once through ina219_read_reg_direct, which reads into
+ * the caller's variable and swaps it in place. The memory bus takes no
+ * time, so the figures are the cost of the driver alone: cycles per value
+ * or per read, best of five runs. The results of both paths are compared
+ * and the program exits with 1 if they differ. On x86 the time stamp counter
+ * is read, elsewhere the time is converted with the clock given by -m.
+ * The figures are host figures. Only the unpack differs beyond run-to-run
+ * noise, the register read is dominated by the calls through embedd_bus_t.
+ * They say nothing about the M0+ target, which has no cycle counter; its
+ * figures would need a build for the board timed with SysTick.
+ *
+ * Build and run from the repository root:
+ *
+ *   D=INA219-CubeIDE/Drivers/ina219
+ *   gcc -O2 -I$D tools/swap_bench.c $D/ina219.c $D/ina219_registers.c $D/ina219_shadow.c \
+ *       $D/ina219_snapshot.c $D/embedd_i2c.c $D/embedd_hal.c $D/embedd_utils.c -o swap_bench
+ *   ./swap_bench [-n values] [-m host clock MHz]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "ina219.h"
+
+#define BENCH_ADDR 0x40
+
+static uint32_t bench_values = 1000000U;
+static double bench_mhz = 0.0;
+static uint8_t *bench_input;
+static uint8_t *bench_output;
+static uint8_t *bench_expect;
+
+// register file of the device in memory, big-endian as on the bus
+static uint8_t bench_mem[6][2];
+static uint8_t bench_mem_ptr;
+
+static EMBEDD_RESULT bench_mem_write(const embedd_device_t* dev, const uint8_t* data_ptr, uint32_t data_size) {
+    (void)dev;
+    if( data_size == 0 || data_ptr[0] >= 6 ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    bench_mem_ptr = data_ptr[0];
+    return EMBEDD_RESULT_OK;
+}
+
+static EMBEDD_RESULT bench_mem_read(const embedd_device_t* dev, uint8_t* data_ptr, uint32_t data_size) {
+    (void)dev;
+    memcpy( data_ptr, bench_mem[bench_mem_ptr], data_size > 2 ? 2 : data_size );
+    return EMBEDD_RESULT_OK;
+}
+
+static EMBEDD_RESULT bench_mem_write_read(const embedd_device_t* dev, const uint8_t* wr_ptr, uint32_t wr_size, uint8_t* rd_ptr, uint32_t rd_size) {
+    if( bench_mem_write( dev, wr_ptr, wr_size ) != EMBEDD_RESULT_OK ) {
+      return EMBEDD_RESULT_ERR;
+    }
+    return bench_mem_read( dev, rd_ptr, rd_size );
+}
+
+static embedd_bus_t bench_mem_bus = {
+  .write = bench_mem_write,
+  .read = bench_mem_read,
+  .write_read = bench_mem_write_read,
+};
+
+INA219_I2C_DEVICE_DEFINE_STATIC(bench_sensor, "INA219 memory", &bench_mem_bus, BENCH_ADDR)
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t bench_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// the register read before the swap: the data is staged in in_buf and copied out by embedd_pack
+static EMBEDD_RESULT bench_read_reg_staged(embedd_device_t* dev, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay) {
+    EMBEDD_RESULT result;
+    ina219_data_t* _data = (ina219_data_t*)dev->data;
+    uint32_t msg_size = INA219_REGISTER_ADDR_SIZE;
+    uint8_t* _out_ptr = _data->out_buf;
+    uint8_t* _in_ptr  = _data->in_buf;
+    embedd_hal_deadline_wait( &_data->ready );
+    if( _data->reg_ptr_valid && _data->reg_ptr == reg_addr ) {
+      _data->reg_ptr_hits++;
+    } else if( delay == 0 && dev->bus->write_read != NULL ) {
+      _data->reg_ptr_misses++;
+      embedd_pack( _out_ptr, &reg_addr, INA219_REGISTER_ADDR_SIZE );
+      result = dev->bus->write_read( dev, _out_ptr, msg_size, _in_ptr, reg_size );
+      if( result != EMBEDD_RESULT_OK ) {
+        _data->reg_ptr_valid = 0;
+        return result;
+      }
+      _data->reg_ptr = (uint8_t)reg_addr;
+      _data->reg_ptr_valid = 1;
+      embedd_pack( reg, _in_ptr, reg_size );
+      return result;
+    } else {
+      return EMBEDD_RESULT_ERR;
+    }
+    result = dev->bus->read( dev, _in_ptr, reg_size );
+    if( result != EMBEDD_RESULT_OK ) {
+      _data->reg_ptr_valid = 0;
+      return result;
+    }
+    embedd_pack( reg, _in_ptr, reg_size );
+    return result;
+}
+
+static EMBEDD_RESULT bench_read_reg_swap(embedd_device_t* dev, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay) {
+    return ina219_read_reg_direct( dev, reg_addr, reg, reg_size, delay );
+}
+
+typedef EMBEDD_RESULT (*bench_read_t)(embedd_device_t* dev, uint32_t reg_addr, void* reg, uint32_t reg_size, uint32_t delay);
+
+static double bench_cycles_since(uint64_t c0, double t0) {
+    uint64_t c1 = bench_cycles();
+    double t1 = bench_now();
+    return ( c1 != c0 ) ? (double)( c1 - c0 ) : ( t1 - t0 ) * bench_mhz / 1000.0;
+}
+
+// cycles per value of the best of five runs
+static double bench_unpack(size_t size, bool fast) {
+    double best = 0.0;
+    uint32_t count = bench_values / 4U * 4U / size * size;
+    for( int run = 0; run < 5; run++ ) {
+      double t0 = bench_now();
+      uint64_t c0 = bench_cycles();
+      // the register sizes are constants at every call site in the driver
+      if( fast && size == 1 ) {
+        for( uint32_t i = 0; i < count; i += 1 ) {
+          embedd_pack_fast( bench_output + i, bench_input + i, 1 );
+        }
+      } else if( fast && size == 2 ) {
+        for( uint32_t i = 0; i < count; i += 2 ) {
+          embedd_pack_fast( bench_output + i, bench_input + i, 2 );
+        }
+      } else if( fast ) {
+        for( uint32_t i = 0; i < count; i += 4 ) {
+          embedd_pack_fast( bench_output + i, bench_input + i, 4 );
+        }
+      } else {
+        for( uint32_t i = 0; i < count; i += size ) {
+          embedd_pack( bench_output + i, bench_input + i, size );
+        }
+      }
+      double cycles = bench_cycles_since( c0, t0 );
+      if( run == 0 || cycles < best ) {
+        best = cycles;
+      }
+    }
+    return best / ( count / size );
+}
+
+// cycles per read of the best of five runs, every register in turn or the same one again
+static double bench_read(bench_read_t read, bool same, uint16_t* sum) {
+    double best = 0.0;
+    for( int run = 0; run < 5; run++ ) {
+      uint16_t total = 0;
+      ina219_reg_ptr_invalidate( &bench_sensor );
+      double t0 = bench_now();
+      uint64_t c0 = bench_cycles();
+      for( uint32_t i = 0; i < bench_values; i++ ) {
+        uint16_t reg;
+        if( read( &bench_sensor, same ? 1U : i % 6U, &reg, sizeof(reg), 0 ) != EMBEDD_RESULT_OK ) {
+          return -1.0;
+        }
+        total = (uint16_t)( total * 31U + reg );
+      }
+      double cycles = bench_cycles_since( c0, t0 );
+      *sum = total;
+      if( run == 0 || cycles < best ) {
+        best = cycles;
+      }
+    }
+    return best / bench_values;
+}
+
+int main(int argc, char** argv) {
+    for( int i = 1; i + 1 < argc; i += 2 ) {
+      if( strcmp( argv[i], "-n" ) == 0 ) {
+        bench_values = (uint32_t)strtoul( argv[i + 1], NULL, 0 );
+      } else if( strcmp( argv[i], "-m" ) == 0 ) {
+        bench_mhz = strtod( argv[i + 1], NULL );
+      }
+    }
+    if( bench_values < 4U ) {
+      fprintf(stderr, "usage: %s [-n values] [-m host clock MHz]\n", argv[0]);
+      return 1;
+    }
+    if( bench_cycles() == 0 && bench_mhz <= 0.0 ) {
+      fprintf(stderr, "no cycle counter, give the host clock with -m\n");
+      return 1;
+    }
+
+    bench_input = malloc( bench_values );
+    bench_output = malloc( bench_values );
+    bench_expect = malloc( bench_values );
+    if( bench_input == NULL || bench_output == NULL || bench_expect == NULL ) {
+      return 1;
+    }
+    srand( 1 );
+    for( uint32_t i = 0; i < bench_values; i++ ) {
+      bench_input[i] = (uint8_t)rand();
+    }
+    for( uint8_t r = 0; r < 6; r++ ) {
+      bench_mem[r][0] = (uint8_t)rand();
+      bench_mem[r][1] = (uint8_t)rand();
+    }
+
+    int failed = 0;
+    static const size_t sizes[] = { 1, 2, 4 };
+    printf("%-22s %12s %12s\n", "unpack", "embedd_pack", "pack_fast");
+    for( size_t j = 0; j < sizeof sizes / sizeof sizes[0]; j++ ) {
+      double loop = bench_unpack( sizes[j], false );
+      memcpy( bench_expect, bench_output, bench_values );
+      double fast = bench_unpack( sizes[j], true );
+      if( memcmp( bench_expect, bench_output, bench_values ) != 0 ) {
+        fprintf(stderr, "%lu byte values differ\n", (unsigned long)sizes[j]);
+        failed = 1;
+      }
+      printf("%lu byte value %15.2f %12.2f cycles\n", (unsigned long)sizes[j], loop, fast);
+    }
+
+    if( ina219_check_device( &bench_sensor ) != EMBEDD_RESULT_OK ) {
+      fprintf(stderr, "device check failed\n");
+      return 1;
+    }
+    printf("\n%-22s %12s %12s\n", "16-bit register read", "staged", "swapped");
+    for( int same = 0; same < 2; same++ ) {
+      uint16_t sum_staged, sum_swap;
+      double staged = bench_read( bench_read_reg_staged, same, &sum_staged );
+      double swap = bench_read( bench_read_reg_swap, same, &sum_swap );
+      if( staged < 0.0 || swap < 0.0 || sum_staged != sum_swap ) {
+        fprintf(stderr, "register reads differ\n");
+        failed = 1;
+      }
+      printf("%-22s %12.2f %12.2f cycles\n", same ? "pointer hit" : "address and data", staged, swap);
+    }
+    return failed;
+}
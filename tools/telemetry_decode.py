@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+"""Decoder of the binary telemetry stream of the INA219 firmware.
+
+Frames are COBS encoded and end with a 0x00 byte. Decoded, a frame is
+
+    type u8 | record_size u8 | seq u16 | payload | crc32 u32
+
+little endian, with the CRC-32 of zlib over type..payload. See
+Drivers/ina219/embedd_telemetry.h for the session commands and
+Drivers/ina219/ina219_telemetry.h for the sample records. Log text of the
+device arrives in LOG frames and goes to stderr; --elf decodes a tokenized
+log, see tlog_decode.py.
+
+    telemetry_decode.py --port /dev/ttyACM0 [--baud 921600] [--csv out.csv] [--seconds 10] [--elf fw.elf]
+    telemetry_decode.py --file capture.bin [--csv out.csv] [--elf fw.elf]
+    telemetry_decode.py --bench [--frames 20000]
+
+--port needs pyserial. --bench measures the decoder on synthetic frames
+and compares it with the byte rate of the serial link.
+"""
+
+import argparse
+import random
+import struct
+import sys
+import time
+import zlib
+
+HELLO, BAUD, STOP = 0x01, 0x02, 0x03
+INFO, ACK, LOG = 0x80, 0x81, 0x82
+INA219_SAMPLE = 0x10
+
+HEADER = struct.Struct('<BBH')
+SAMPLE = struct.Struct('<IiIHBB')
+INFO_PAYLOAD = struct.Struct('<BBBBIII')
+ACK_PAYLOAD = struct.Struct('<BBHI')
+ACK_STATUS = {0: 'ok', 1: 'rejected', 2: 'unsupported'}
+DEFAULT_BAUD = 115200
+
+
+def cobs_encode(data):
+    out = bytearray()
+    for block in data.split(b'\x00'):
+        # blocks longer than 254 bytes are split without an implied zero
+        while len(block) >= 254:
+            out.append(0xFF)
+            out += block[:254]
+            block = block[254:]
+        out.append(len(block) + 1)
+        out += block
+    out.append(0)
+    return bytes(out)
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i, n = 0, len(data)
+    while i < n:
+        code = data[i]
+        if code == 0 or i + code > n:
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < n:
+            out.append(0)
+    return bytes(out)
+
+
+def build_frame(frame_type, payload=b'', seq=0, record_size=0):
+    raw = HEADER.pack(frame_type, record_size, seq) + payload
+    return cobs_encode(raw + struct.pack('<I', zlib.crc32(raw)))
+
+
+class Decoder:
+    """Splits a byte stream into frames, checks them and counts losses."""
+
+    def __init__(self, text=None):
+        self.text = text if text is not None else sys.stderr.buffer
+        self.pending = b''
+        self.next_seq = None
+        self.frames = 0
+        self.records = 0
+        self.lost = 0
+        self.errors = 0
+
+    def feed(self, data):
+        """Yields (type, seq, payload, record_size) of every valid frame in data."""
+        chunks = (self.pending + data).split(b'\x00')
+        self.pending = chunks.pop()
+        for chunk in chunks:
+            if not chunk:
+                continue
+            raw = cobs_decode(chunk)
+            if raw is None or len(raw) < HEADER.size + 4 or \
+                    zlib.crc32(raw[:-4]) != struct.unpack_from('<I', raw, len(raw) - 4)[0]:
+                # text before the first frame ends up here too
+                self.errors += 1
+                continue
+            frame_type, record_size, seq = HEADER.unpack_from(raw)
+            if self.next_seq is not None:
+                self.lost += (seq - self.next_seq) & 0xFFFF
+            self.next_seq = (seq + 1) & 0xFFFF
+            self.frames += 1
+            yield frame_type, seq, raw[HEADER.size:-4], record_size
+
+    def samples(self, data):
+        """Yields the sample records in data as tuples of SAMPLE fields."""
+        for frame_type, _, payload, record_size in self.feed(data):
+            if frame_type == LOG:
+                self.text.write(payload)
+                self.text.flush()
+                continue
+            if frame_type != INA219_SAMPLE or record_size != SAMPLE.size:
+                continue
+            for record in SAMPLE.iter_unpack(payload):
+                self.records += 1
+                yield record
+
+
+class TokenText:
+    """Formats the tokenized log carried by LOG frames, an alternative text of Decoder."""
+
+    def __init__(self, elf):
+        from tlog_decode import Elf, TokenDecoder
+        self.tokens = TokenDecoder(Elf(elf))
+
+    def write(self, data):
+        for _, text in self.tokens.feed(data):
+            sys.stderr.write(text)
+
+    def flush(self):
+        sys.stderr.flush()
+
+
+def synthetic_stream(frames, records_per_frame=16):
+    rng = random.Random(1)
+    out = bytearray()
+    t = 0
+    for seq in range(frames):
+        payload = bytearray()
+        for _ in range(records_per_frame):
+            t += 1000
+            payload += SAMPLE.pack(t & 0xFFFFFFFF, rng.randint(-3200000, 3200000),
+                                   rng.randint(0, 100000000), rng.randint(0, 32000), 3, 0)
+        out += build_frame(INA219_SAMPLE, bytes(payload), seq & 0xFFFF, SAMPLE.size)
+    return bytes(out)
+
+
+def bench(frames):
+    stream = synthetic_stream(frames)
+    decoder = Decoder()
+    start = time.perf_counter()
+    # serial ports deliver a few kilobytes per read
+    for i in range(0, len(stream), 4096):
+        for _ in decoder.samples(stream[i:i + 4096]):
+            pass
+    elapsed = time.perf_counter() - start
+    rate = len(stream) / elapsed
+    print('%d frames, %d records, %d bytes in %.3f s' % (decoder.frames, decoder.records, len(stream), elapsed))
+    print('%.2f MB/s, %.0f frames/s, %.0f records/s, %d errors, %d lost' %
+          (rate / 1e6, decoder.frames / elapsed, decoder.records / elapsed, decoder.errors, decoder.lost))
+    for baud in (115200, 921600, 2000000):
+        # 10 bits per byte on the wire
+        print('  %7d baud: %6.0f records/s on the link, decoder %.0fx faster' %
+              (baud, baud / 10 * decoder.records / len(stream), rate / (baud / 10)))
+
+
+def command(port, decoder, frame_type, payload, expect, timeout=1.0):
+    # the leading delimiter ends any text the device sent before
+    port.write(b'\x00' + build_frame(frame_type, payload))
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        for reply_type, _, reply, _ in decoder.feed(port.read(256)):
+            if reply_type == expect:
+                return reply
+    raise RuntimeError('no answer to command 0x%02X' % frame_type)
+
+
+def open_session(port, decoder, baud):
+    info = INFO_PAYLOAD.unpack(command(port, decoder, HELLO, b'', INFO))
+    print('protocol %d, records 0x%02X of %d bytes, %d baud, up to %d baud, period %d us' %
+          (info[0], info[1], info[2], info[4], info[5], info[6]), file=sys.stderr)
+    if baud and baud != port.baudrate:
+        _, status, _, actual = ACK_PAYLOAD.unpack(command(port, decoder, BAUD, struct.pack('<I', baud), ACK))
+        if status != 0:
+            raise RuntimeError('baud rate %d %s' % (baud, ACK_STATUS.get(status, status)))
+        port.baudrate = actual
+        port.reset_input_buffer()
+        decoder.pending = b''
+        # confirms the new rate, the device falls back to the default otherwise
+        command(port, decoder, HELLO, b'', INFO)
+        print('switched to %d baud' % actual, file=sys.stderr)
+    decoder.next_seq = None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument('--port', help='serial port of the board')
+    source.add_argument('--file', help='raw capture of the serial port')
+    source.add_argument('--bench', action='store_true', help='measure the decoder throughput')
+    parser.add_argument('--baud', type=int, help='baud rate to switch to after connecting')
+    parser.add_argument('--csv', help='write the samples to this file instead of stdout')
+    parser.add_argument('--seconds', type=float, help='stop after this time')
+    parser.add_argument('--frames', type=int, default=20000, help='frames of the benchmark')
+    parser.add_argument('--elf', help='ELF file of a firmware with a tokenized log')
+    args = parser.parse_args()
+
+    if args.bench:
+        bench(args.frames)
+        return
+
+    out = open(args.csv, 'w') if args.csv else sys.stdout
+    out.write('timestamp_us,current_ua,power_uw,bus_mv,range,flags\n')
+    decoder = Decoder(TokenText(args.elf) if args.elf else None)
+    if args.file:
+        with open(args.file, 'rb') as capture:
+            for record in decoder.samples(capture.read()):
+                out.write('%d,%d,%d,%d,%d,%d\n' % record)
+    else:
+        import serial
+        port = serial.Serial(args.port, DEFAULT_BAUD, timeout=0.1)
+        try:
+            open_session(port, decoder, args.baud)
+            start = time.monotonic()
+            while args.seconds is None or time.monotonic() - start < args.seconds:
+                for record in decoder.samples(port.read(4096)):
+                    out.write('%d,%d,%d,%d,%d,%d\n' % record)
+        except KeyboardInterrupt:
+            pass
+        finally:
+            # back to text at the default rate
+            port.write(b'\x00' + build_frame(STOP))
+            port.flush()
+            port.close()
+    if out is not sys.stdout:
+        out.close()
+    print('%d frames, %d records, %d lost frames, %d bad frames' %
+          (decoder.frames, decoder.records, decoder.lost, decoder.errors), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+"""Decoder of the tokenized log of the INA219 firmware.
+
+Built with EMBEDD_LOG_TOKENIZED=1, the firmware sends no text. A message is
+
+    varint(offset << 2 | level) | varint(zigzag(argument)) ...
+
+COBS encoded and terminated by a 0x00 byte. offset points into the section
+embedd_tlog of the ELF file, which holds the printf format strings; %s
+arguments are addresses of constant strings in the image. See
+Drivers/ina219/embedd_log.h for the linker script entry keeping the section
+out of flash.
+
+    tlog_decode.py --elf INA219-CubeIDE.elf --port /dev/ttyACM0 [--baud 115200] [--seconds 10]
+    tlog_decode.py --elf INA219-CubeIDE.elf --file capture.bin
+
+--port needs pyserial. While the binary telemetry stream runs, the messages
+arrive in its LOG frames instead, see telemetry_decode.py --elf.
+"""
+
+import argparse
+import re
+import struct
+import sys
+import time
+
+SECTION = 'embedd_tlog'
+LEVELS = 'EID'
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+SPEC = re.compile(r'%([-+ #0]*)(\d*)(?:\.(\d+))?(?:hh|h|ll|l|j|z|t)?([diouxXcsp%])')
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i, n = 0, len(data)
+    while i < n:
+        code = data[i]
+        if code == 0 or i + code > n:
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < n:
+            out.append(0)
+    return bytes(out)
+
+
+class Elf:
+    """Section contents of an ELF file, 32 or 64 bit, little or big endian."""
+
+    def __init__(self, path):
+        with open(path, 'rb') as elf:
+            data = elf.read()
+        if data[:4] != b'\x7fELF':
+            raise ValueError('%s is no ELF file' % path)
+        wide = data[4] == 2
+        order = '<' if data[5] == 1 else '>'
+        if wide:
+            shoff, = struct.unpack_from(order + 'Q', data, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from(order + 'HHH', data, 0x3A)
+            header = struct.Struct(order + 'IIQQQQIIQQ')
+        else:
+            shoff, = struct.unpack_from(order + 'I', data, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from(order + 'HHH', data, 0x2E)
+            header = struct.Struct(order + 'IIIIIIIIII')
+        headers = [header.unpack_from(data, shoff + i * shentsize) for i in range(shnum)]
+        names = headers[shstrndx]
+        self.sections = {}
+        self.loaded = []
+        for name, sh_type, flags, addr, offset, size in (h[:6] for h in headers):
+            end = data.index(b'\0', names[4] + name)
+            contents = b'' if sh_type == SHT_NOBITS else data[offset:offset + size]
+            self.sections[data[names[4] + name:end].decode()] = contents
+            if flags & SHF_ALLOC and sh_type != SHT_NOBITS:
+                self.loaded.append((addr, contents))
+
+    def string(self, address):
+        """The zero terminated string at address of the image, None if there is none."""
+        for start, contents in self.loaded:
+            if start <= address < start + len(contents):
+                end = contents.find(b'\0', address - start)
+                return contents[address - start:end if end >= 0 else None].decode(errors='replace')
+        return None
+
+
+def varints(data):
+    value = shift = 0
+    for byte in data:
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            yield value
+            value = shift = 0
+    if shift:
+        raise ValueError('truncated varint')
+
+
+class TokenDecoder:
+    """Splits a byte stream into messages and formats them with the strings of the ELF file."""
+
+    def __init__(self, elf):
+        self.elf = elf
+        self.formats = elf.sections.get(SECTION)
+        if self.formats is None:
+            raise ValueError('no section %s, is the firmware built with EMBEDD_LOG_TOKENIZED=1?' % SECTION)
+        self.cache = {}
+        self.pending = b''
+        self.messages = 0
+        self.errors = 0
+        self.wire_bytes = 0
+        self.text_bytes = 0
+
+    def format_of(self, offset):
+        if offset not in self.cache:
+            end = self.formats.find(b'\0', offset)
+            if offset >= len(self.formats) or end < 0:
+                return None
+            text = self.formats[offset:end].decode(errors='replace')
+            self.cache[offset] = (text, [m for m in SPEC.finditer(text) if m.group(4) != '%'])
+        return self.cache[offset]
+
+    def convert(self, spec, value):
+        flags, width, precision, conversion = spec.groups()
+        signed = value - (1 << 32) if value & 0x80000000 else value
+        if conversion == 's':
+            string = self.elf.string(value)
+            value = string if string is not None else '<0x%08X>' % value
+        elif conversion == 'c':
+            value = chr(value & 0xFF)
+        elif conversion in 'di':
+            value, conversion = signed, 'd'
+        elif conversion == 'u':
+            conversion = 'd'
+        elif conversion == 'p':
+            flags, conversion = flags + '#', 'x'
+        return ('%' + flags + width + ('.' + precision if precision else '') + conversion) % value
+
+    def message(self, raw):
+        fields = list(varints(raw))
+        head, args = fields[0], fields[1:]
+        # zigzag back to the 32 bit pattern the device had
+        args = [((a >> 1) ^ -(a & 1)) & 0xFFFFFFFF for a in args]
+        found = self.format_of(head >> 2)
+        if found is None or len(found[1]) != len(args):
+            raise ValueError('unknown message 0x%X' % (head >> 2))
+        text, specs = found
+        out, pos = [], 0
+        for spec, value in zip(specs, args):
+            out.append(text[pos:spec.start()].replace('%%', '%'))
+            out.append(self.convert(spec, value))
+            pos = spec.end()
+        out.append(text[pos:].replace('%%', '%'))
+        return LEVELS[head & 3] if (head & 3) < len(LEVELS) else '?', ''.join(out)
+
+    def feed(self, data):
+        """Yields (level, text) of every message in data, level is one of E, I and D."""
+        self.wire_bytes += len(data)
+        chunks = (self.pending + data).split(b'\x00')
+        self.pending = chunks.pop()
+        for chunk in chunks:
+            if not chunk:
+                continue
+            raw = cobs_decode(chunk)
+            try:
+                if not raw:
+                    raise ValueError('bad encoding')
+                level, text = self.message(raw)
+            except ValueError:
+                # a message cut by a dropped chunk or bytes before the first delimiter
+                self.errors += 1
+                continue
+            self.messages += 1
+            self.text_bytes += len(text)
+            yield level, text
+
+    def summary(self):
+        ratio = self.text_bytes / self.wire_bytes if self.wire_bytes else 0
+        return '%d messages, %d bytes received for %d bytes of text (%.1fx), %d bad messages' % (
+            self.messages, self.wire_bytes, self.text_bytes, ratio, self.errors)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--elf', required=True, help='ELF file of the running firmware')
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument('--port', help='serial port of the board')
+    source.add_argument('--file', help='raw capture of the serial port')
+    parser.add_argument('--baud', type=int, default=115200, help='baud rate of the port')
+    parser.add_argument('--levels', action='store_true', help='start every message with its level')
+    parser.add_argument('--seconds', type=float, help='stop after this time')
+    args = parser.parse_args()
+
+    decoder = TokenDecoder(Elf(args.elf))
+
+    def show(data):
+        for level, text in decoder.feed(data):
+            sys.stdout.write(level + ' ' + text if args.levels else text)
+        sys.stdout.flush()
+
+    if args.file:
+        with open(args.file, 'rb') as capture:
+            show(capture.read())
+    else:
+        import serial
+        port = serial.Serial(args.port, args.baud, timeout=0.1)
+        try:
+            start = time.monotonic()
+            while args.seconds is None or time.monotonic() - start < args.seconds:
+                show(port.read(4096))
+        except KeyboardInterrupt:
+            pass
+        finally:
+            port.close()
+    print(decoder.summary(), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()